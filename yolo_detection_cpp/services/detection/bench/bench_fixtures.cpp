@@ -0,0 +1,195 @@
+#include "bench_fixtures.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+namespace hms::bench {
+
+namespace {
+
+constexpr int kCandidates = 8400;
+constexpr int kClasses = 80;
+
+/// First video frame of `path`, decoded; null if FFmpeg can't read one
+AVFrame* decodeFirstFrame(const std::string& path) {
+    AVFormatContext* fmt = nullptr;
+    if (avformat_open_input(&fmt, path.c_str(), nullptr, nullptr) < 0) return nullptr;
+
+    AVFrame* result = nullptr;
+    AVCodecContext* dec = nullptr;
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+
+    const AVCodec* codec = nullptr;
+    int stream = -1;
+    if (avformat_find_stream_info(fmt, nullptr) >= 0) {
+        stream = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    }
+    if (stream >= 0 && codec) {
+        dec = avcodec_alloc_context3(codec);
+        if (avcodec_parameters_to_context(dec, fmt->streams[stream]->codecpar) >= 0
+            && avcodec_open2(dec, codec, nullptr) >= 0) {
+            bool flushed = false;
+            while (!result) {
+                int rc = avcodec_receive_frame(dec, frame);
+                if (rc == 0) {
+                    result = frame;
+                    frame = nullptr;
+                    break;
+                }
+                if (rc != AVERROR(EAGAIN) || flushed) break;
+                if (av_read_frame(fmt, pkt) < 0) {
+                    avcodec_send_packet(dec, nullptr);  // drain (single-image inputs)
+                    flushed = true;
+                    continue;
+                }
+                if (pkt->stream_index == stream) avcodec_send_packet(dec, pkt);
+                av_packet_unref(pkt);
+            }
+        }
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&dec);
+    avformat_close_input(&fmt);
+    return result;
+}
+
+/// `src` scaled into a w x h BGR24 frame
+std::shared_ptr<FrameData> toBgr(const AVFrame* src, int w, int h) {
+    SwsContext* sws = sws_getContext(src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                                     w, h, AV_PIX_FMT_BGR24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws) return nullptr;
+    auto frame = std::make_shared<FrameData>();
+    frame->resize(w, h);
+    uint8_t* dst[] = {frame->pixels.data()};
+    int dst_stride[] = {frame->stride};
+    sws_scale(sws, src->data, src->linesize, 0, src->height, dst, dst_stride);
+    sws_freeContext(sws);
+    return frame;
+}
+
+std::vector<FrameFixture> buildFixtures() {
+    std::vector<FrameFixture> fixtures;
+    for (const auto& res : kResolutions) {
+        fixtures.push_back({std::string("synthetic ") + res.name,
+                            makeSyntheticFrame(res.width, res.height)});
+    }
+
+    const char* recording = std::getenv("HMS_BENCH_RECORDING");
+    if (!recording || !*recording) return fixtures;
+
+    AVFrame* decoded = decodeFirstFrame(recording);
+    if (!decoded) {
+        spdlog::warn("bench: can't decode a frame from {}, recorded fixtures skipped", recording);
+        return fixtures;
+    }
+    spdlog::info("bench: recorded fixtures from {} ({}x{})", recording, decoded->width, decoded->height);
+    for (const auto& res : kResolutions) {
+        if (auto frame = toBgr(decoded, res.width, res.height)) {
+            fixtures.push_back({std::string("recorded ") + res.name, std::move(frame)});
+        }
+    }
+    av_frame_free(&decoded);
+    return fixtures;
+}
+
+}  // namespace
+
+std::shared_ptr<FrameData> makeSyntheticFrame(int width, int height, unsigned seed) {
+    auto frame = std::make_shared<FrameData>();
+    frame->resize(width, height);
+    frame->timestamp = SteadyClock::now();
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = frame->pixels.data() + static_cast<size_t>(y) * frame->stride;
+        for (int x = 0; x < width; ++x) {
+            int base = 40 + 120 * y / height + 60 * x / width;
+            row[x * 3 + 0] = static_cast<uint8_t>(std::clamp(base + noise(rng), 0, 255));
+            row[x * 3 + 1] = static_cast<uint8_t>(std::clamp(base + 10 + noise(rng), 0, 255));
+            row[x * 3 + 2] = static_cast<uint8_t>(std::clamp(base - 10 + noise(rng), 0, 255));
+        }
+    }
+
+    // Objects: solid blocks sized relative to the frame
+    std::uniform_int_distribution<int> colour(0, 255);
+    for (int o = 0; o < 6; ++o) {
+        int bw = width / 10 + o * width / 60, bh = height / 5 + o * height / 40;
+        int bx = (o * 2 + 1) * width / 14, by = (o % 3) * height / 4 + height / 10;
+        uint8_t b = static_cast<uint8_t>(colour(rng)), g = static_cast<uint8_t>(colour(rng)),
+                r = static_cast<uint8_t>(colour(rng));
+        for (int y = by; y < std::min(by + bh, height); ++y) {
+            uint8_t* row = frame->pixels.data() + static_cast<size_t>(y) * frame->stride;
+            for (int x = bx; x < std::min(bx + bw, width); ++x) {
+                row[x * 3 + 0] = b;
+                row[x * 3 + 1] = g;
+                row[x * 3 + 2] = r;
+            }
+        }
+    }
+    return frame;
+}
+
+const std::vector<FrameFixture>& frameFixtures() {
+    static const auto fixtures = buildFixtures();
+    return fixtures;
+}
+
+std::vector<float> makeYoloOutput(int objects, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> noise(0.0f, 0.04f);
+    std::uniform_real_distribution<float> pos(40.0f, 600.0f);
+    std::uniform_real_distribution<float> jitter(-6.0f, 6.0f);
+    std::uniform_int_distribution<int> cls_dist(0, 7);
+
+    std::vector<float> out(static_cast<size_t>(4 + kClasses) * kCandidates);
+    auto at = [&](int row, int i) -> float& { return out[static_cast<size_t>(row) * kCandidates + i]; };
+
+    for (int i = 0; i < kCandidates; ++i) {
+        at(0, i) = pos(rng);
+        at(1, i) = pos(rng);
+        at(2, i) = 20.0f;
+        at(3, i) = 20.0f;
+        for (int c = 0; c < kClasses; ++c) at(4 + c, i) = noise(rng);
+    }
+    for (int o = 0; o < objects; ++o) {
+        float cx = pos(rng), cy = pos(rng);
+        int cls = cls_dist(rng);
+        for (int k = 0; k < 25; ++k) {
+            int i = (o * 331 + k * 97) % kCandidates;
+            at(0, i) = cx + jitter(rng);
+            at(1, i) = cy + jitter(rng);
+            at(2, i) = 80.0f + jitter(rng);
+            at(3, i) = 160.0f + jitter(rng);
+            at(4 + cls, i) = 0.55f + 0.015f * k + 0.001f * o;
+        }
+    }
+    return out;
+}
+
+Contention::Contention(int threads, std::function<void()> fn) {
+    for (int i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, fn] {
+            while (!stop_.load(std::memory_order_relaxed)) fn();
+        });
+    }
+}
+
+Contention::~Contention() {
+    stop_.store(true);
+    for (auto& t : threads_) t.join();
+}
+
+}  // namespace hms::bench
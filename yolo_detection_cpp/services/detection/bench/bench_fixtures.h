@@ -0,0 +1,59 @@
+#pragma once
+
+#include "frame_data.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hms::bench {
+
+/// One input frame of the suite, e.g. "synthetic 1080p"
+struct FrameFixture {
+    std::string name;
+    std::shared_ptr<FrameData> frame;  // BGR24, tightly packed rows
+};
+
+/// Benchmark resolutions: 640x480, 1080p and 4K
+struct Resolution {
+    const char* name;
+    int width, height;
+};
+inline constexpr Resolution kResolutions[] = {
+    {"640x480", 640, 480},
+    {"1080p", 1920, 1080},
+    {"4K", 3840, 2160},
+};
+
+/// Deterministic camera-like BGR frame: gradient background, a few solid
+/// "objects" and sensor noise, so encoders see realistic entropy
+std::shared_ptr<FrameData> makeSyntheticFrame(int width, int height, unsigned seed = 42);
+
+/// Synthetic frames at every resolution, plus a recorded frame at each one
+/// when HMS_BENCH_RECORDING names a video or image file FFmpeg can open
+/// (its first decoded frame, scaled). Built once and cached.
+const std::vector<FrameFixture>& frameFixtures();
+
+/// Synthetic YOLO output [1, 84, 8400]: background noise on every candidate
+/// plus clusters of ~25 overlapping candidates around each object
+std::vector<float> makeYoloOutput(int objects, unsigned seed = 42);
+
+/// Runs `fn` on `threads` background threads until destroyed: the contention
+/// a benchmark measures against
+class Contention {
+public:
+    Contention(int threads, std::function<void()> fn);
+    ~Contention();
+
+    Contention(const Contention&) = delete;
+    Contention& operator=(const Contention&) = delete;
+
+private:
+    std::atomic<bool> stop_{false};
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace hms::bench
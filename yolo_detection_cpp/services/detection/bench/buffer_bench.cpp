@@ -0,0 +1,116 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "bench_fixtures.h"
+#include "camera_buffer.h"
+#include "frame_data.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// CameraBuffer and FramePool, alone and under the contention a busy camera
+// sees: one capture thread writing, detection / events / HTTP reading.
+
+using namespace hms;
+using namespace hms::bench;
+
+namespace {
+
+// A 15 s preroll at 5 fps, and its pool (see BufferService)
+constexpr size_t kBufferCapacity = 75;
+constexpr size_t kPoolSize = kBufferCapacity + 30;
+
+std::vector<std::shared_ptr<FrameData>> makeFrames(size_t n) {
+    std::vector<std::shared_ptr<FrameData>> frames;
+    for (size_t i = 0; i < n; ++i) {
+        auto f = std::make_shared<FrameData>();
+        f->frame_number = i + 1;
+        f->resize(64, 48);
+        frames.push_back(std::move(f));
+    }
+    return frames;
+}
+
+}  // namespace
+
+TEST_CASE("CameraBuffer push", "[buffer][camera_buffer]") {
+    auto frames = makeFrames(2 * kBufferCapacity);
+    for (int readers : {0, 1, 4, 16}) {
+        CameraBuffer buffer(kBufferCapacity);
+        Contention contention(readers, [&] {
+            auto f = buffer.getLatestFrame();
+            (void)f;
+        });
+        size_t i = 0;
+        BENCHMARK("push, " + std::to_string(readers) + " readers") {
+            buffer.push(frames[i++ % frames.size()]);
+        };
+    }
+}
+
+TEST_CASE("CameraBuffer reads under a writer", "[buffer][camera_buffer]") {
+    auto frames = makeFrames(2 * kBufferCapacity);
+    for (int readers : {0, 3, 15}) {
+        CameraBuffer buffer(kBufferCapacity);
+        for (const auto& f : frames) buffer.push(f);
+
+        size_t w = 0;
+        Contention writer(1, [&] { buffer.push(frames[w++ % frames.size()]); });
+        Contention contention(readers, [&] {
+            auto f = buffer.getLatestFrame();
+            (void)f;
+        });
+        const auto suffix = ", writer + " + std::to_string(readers) + " readers";
+
+        BENCHMARK("getLatestFrame" + suffix) {
+            return buffer.getLatestFrame();
+        };
+        BENCHMARK("snapshot view" + suffix) {
+            size_t held = 0;
+            buffer.snapshot().forEach([&](const std::shared_ptr<FrameData>&) { ++held; });
+            return held;
+        };
+    }
+}
+
+TEST_CASE("FramePool acquire and release", "[buffer][frame_pool]") {
+    for (int threads : {0, 1, 3, 7}) {
+        FramePool pool(kPoolSize, kBufferCapacity);
+        Contention contention(threads, [&] {
+            auto f = pool.acquire();
+            (void)f;
+        });
+        BENCHMARK("acquire + release, " + std::to_string(threads) + " contending") {
+            return pool.acquire() != nullptr;
+        };
+    }
+}
+
+TEST_CASE("Capture path: pool to buffer", "[buffer][frame_pool][camera_buffer]") {
+    // What the capture thread does per decoded frame, while consumers pin
+    // the newest frame for a moment
+    for (const auto& res : kResolutions) {
+        FramePool pool(kPoolSize, kBufferCapacity);
+        CameraBuffer buffer(kBufferCapacity);
+        {
+            // Size every pooled frame first: steady state, not first-touch page faults
+            std::vector<std::shared_ptr<FrameData>> all;
+            for (size_t i = 0; i < kPoolSize; ++i) all.push_back(pool.acquire());
+            for (auto& f : all) f->resize(res.width, res.height);
+        }
+        Contention consumers(3, [&] {
+            if (auto f = buffer.getLatestFrame()) (void)f->pixels.data();
+        });
+
+        uint64_t n = 0;
+        BENCHMARK(std::string("acquire + resize + push, ") + res.name) {
+            auto frame = pool.acquire();
+            if (!frame) return false;
+            frame->resize(res.width, res.height);
+            frame->frame_number = ++n;
+            buffer.push(std::move(frame));
+            return true;
+        };
+    }
+}
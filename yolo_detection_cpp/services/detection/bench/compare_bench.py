@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare two detection_bench runs saved with `-r xml::out=<file>`.
+
+    compare_bench.py baseline.xml candidate.xml [--threshold 10]
+
+Prints each benchmark's mean in both runs and the change, and exits 1 if
+any benchmark got slower by more than the threshold (percent).
+"""
+
+import argparse
+import sys
+import xml.etree.ElementTree as ET
+
+
+def load(path):
+    """Benchmark name -> (mean ns, std dev ns)"""
+    results = {}
+    for bench in ET.parse(path).getroot().iter("BenchmarkResults"):
+        mean = float(bench.find("mean").get("value"))
+        stddev = float(bench.find("standardDeviation").get("value"))
+        results[bench.get("name")] = (mean, stddev)
+    return results
+
+
+def human(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return f"{ns / scale:.2f} {unit}"
+    return f"{ns:.1f} ns"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="regression threshold in percent (default 10)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    candidate = load(args.candidate)
+
+    regressions = 0
+    width = max((len(n) for n in candidate), default=10)
+    print(f"{'benchmark':<{width}}  {'baseline':>10}  {'candidate':>10}  {'change':>8}")
+    for name, (mean, _) in candidate.items():
+        if name not in baseline:
+            print(f"{name:<{width}}  {'-':>10}  {human(mean):>10}  {'new':>8}")
+            continue
+        base, base_stddev = baseline[name]
+        change = (mean - base) / base * 100 if base > 0 else 0.0
+        # Only flag changes bigger than the baseline's own noise
+        slower = change > args.threshold and mean - base > 2 * base_stddev
+        regressions += slower
+        mark = "  <-- slower" if slower else ""
+        print(f"{name:<{width}}  {human(base):>10}  {human(mean):>10}  {change:>+7.1f}%{mark}")
+
+    for name in baseline.keys() - candidate.keys():
+        print(f"{name:<{width}}  {human(baseline[name][0]):>10}  {'-':>10}  {'gone':>8}")
+
+    if regressions:
+        print(f"\n{regressions} benchmark(s) slower by more than {args.threshold:g}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
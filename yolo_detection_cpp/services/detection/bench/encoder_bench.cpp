@@ -0,0 +1,59 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "bench_fixtures.h"
+#include "event_recorder.h"
+#include "jpeg_encoder.h"
+#include "snapshot_writer.h"
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <filesystem>
+#include <string>
+
+// Snapshot JPEG encoding and transcode-mode event recording
+
+using namespace hms;
+using namespace hms::bench;
+
+TEST_CASE("SnapshotWriter encodeJpeg", "[encoder][jpeg]") {
+    for (const auto& fixture : frameFixtures()) {
+        const auto& f = *fixture.frame;
+        BENCHMARK("encodeJpeg, " + fixture.name) {
+            return SnapshotWriter::encodeJpeg(f.pixels.data(), f.width, f.height, f.stride);
+        };
+    }
+}
+
+TEST_CASE("JpegEncoder snapshot + vision rendition", "[encoder][jpeg]") {
+    for (const auto& fixture : frameFixtures()) {
+        const auto& f = *fixture.frame;
+        std::array<JpegEncoder::Output, 2> outputs{{{.max_width = 0}, {.max_width = 640}}};
+        BENCHMARK("full + 640 wide, " + fixture.name) {
+            return JpegEncoder::encode(f.pixels.data(), f.width, f.height, f.stride, outputs);
+        };
+    }
+}
+
+TEST_CASE("EventRecorder writeFrame", "[encoder][recorder]") {
+    spdlog::set_level(spdlog::level::warn);  // a start/finalize line per sample otherwise
+    auto dir = std::filesystem::temp_directory_path() / "hms_detection_bench";
+    std::filesystem::create_directories(dir);
+
+    for (const auto& fixture : frameFixtures()) {
+        const auto& f = *fixture.frame;
+        // A fresh recording per sample keeps every run under the max duration
+        // cap; x264's lookahead fill is amortised over the sample's iterations
+        BENCHMARK_ADVANCED("writeFrame (x264 transcode), " + fixture.name)(Catch::Benchmark::Chronometer meter) {
+            EventRecorder recorder;
+            if (!recorder.start("bench", {}, f.width, f.height, 30, dir.string())) {
+                FAIL("EventRecorder failed to start (no H.264 encoder?)");
+            }
+            meter.measure([&] { return recorder.writeFrame(f); });
+            recorder.finalize();
+            std::filesystem::remove(recorder.filePath());
+        };
+    }
+    std::filesystem::remove_all(dir);
+}
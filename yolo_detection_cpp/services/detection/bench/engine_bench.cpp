@@ -0,0 +1,75 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "bench_fixtures.h"
+#include "detection_engine.h"
+
+#include <string>
+#include <vector>
+
+// DetectionEngine preprocess / postprocess / NMS. No model is loaded: these
+// are the CPU stages around Session::Run.
+
+using namespace hms;
+using namespace hms::bench;
+
+namespace {
+
+constexpr int kCandidates = 8400;
+
+std::vector<Detection> makeBoxes(int n) {
+    std::vector<Detection> boxes;
+    boxes.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        float x = static_cast<float>((i * 37) % 600), y = static_cast<float>((i * 53) % 600);
+        float conf = 0.5f + (i % 50) / 100.0f;
+        boxes.push_back({static_cast<uint16_t>(i % 4), conf, x, y, x + 60, y + 120});
+    }
+    return boxes;
+}
+
+}  // namespace
+
+TEST_CASE("DetectionEngine preprocess", "[engine][preprocess]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    std::vector<float> tensor(static_cast<size_t>(3) * engine.inputWidth() * engine.inputHeight());
+
+    for (auto mode : {ResizeMode::Nearest, ResizeMode::Bilinear}) {
+        engine.setResizeMode(mode);
+        const char* mode_name = mode == ResizeMode::Nearest ? "nearest" : "bilinear";
+        for (const auto& fixture : frameFixtures()) {
+            float scale, pad_x, pad_y;
+            BENCHMARK("preprocess " + std::string(mode_name) + ", " + fixture.name) {
+                engine.preprocessInto(*fixture.frame, tensor.data(), scale, pad_x, pad_y);
+                return tensor[0];
+            };
+        }
+    }
+}
+
+TEST_CASE("DetectionEngine postprocess", "[engine][postprocess]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    const std::vector<std::string> all;
+    const std::vector<std::string> filter = {"person", "car", "dog"};
+
+    for (int objects : {0, 12, 50}) {
+        auto output = makeYoloOutput(objects);
+        BENCHMARK("postprocess, " + std::to_string(objects) + " objects") {
+            return engine.postprocess(output.data(), kCandidates, 0.5f, 0.45f, 1.0f, 0.0f, 0.0f,
+                                      640, 640, all);
+        };
+        BENCHMARK("postprocess, " + std::to_string(objects) + " objects, filtered") {
+            return engine.postprocess(output.data(), kCandidates, 0.5f, 0.45f, 1.0f, 0.0f, 0.0f,
+                                      640, 640, filter);
+        };
+    }
+}
+
+TEST_CASE("DetectionEngine NMS", "[engine][nms]") {
+    for (int n : {50, 300, 1000}) {
+        auto boxes = makeBoxes(n);
+        BENCHMARK("nms, " + std::to_string(n) + " boxes") {
+            return DetectionEngine::nms(boxes, 0.45f);
+        };
+    }
+}
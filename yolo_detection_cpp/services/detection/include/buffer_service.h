@@ -3,11 +3,19 @@
 #include "camera_buffer.h"
 #include "detection_engine.h"
 #include "detection_worker.h"
+#include "engine_pool.h"
+#include "event_executor.h"
 #include "frame_data.h"
+#include "inference_scheduler.h"
+#include "packet_ring.h"
+#include "pipeline_config.h"
 #include "rtsp_capture.h"
 #include "config_manager.h"
 
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
 
@@ -22,16 +30,23 @@ public:
         size_t buffer_size = 0;
         size_t max_frames = 0;
         uint64_t frames_captured = 0;
+        uint64_t frames_converted = 0;  // decoded frames a consumer needed as BGR
         uint64_t reconnect_count = 0;
         uint64_t consecutive_failures = 0;
         bool is_connected = false;
         bool is_healthy = false;
         int frame_width = 0;
         int frame_height = 0;
+        bool hw_decode = false;
+        uint64_t hw_fallbacks = 0;
+        uint64_t replay_loops = 0;      // replay mode: passes through the file
         SteadyClock::time_point last_frame_time;
+        FramePool::Stats pool;
+        std::optional<PixelArena::Stats> arena;  // unset when pool frames use the heap
+        std::optional<RtspCapture::Stats> record_stream;  // dual-stream: the main stream (packets only)
     };
 
-    explicit BufferService(const hms::AppConfig& config);
+    explicit BufferService(const hms::AppConfig& config, const PipelineConfig& pipeline = {});
     ~BufferService();
 
     BufferService(const BufferService&) = delete;
@@ -42,11 +57,14 @@ public:
 
     // --- Detection ---
 
-    /// Load the ONNX model without starting continuous workers
+    /// Load the ONNX model without starting continuous workers: sessions are
+    /// built in parallel, then warmed up (pipeline.engine.warmup). Safe to run
+    /// off the main thread; the getters below return null until it is done.
     void loadDetectionModel();
 
-    /// Start continuous detection workers for all cameras
-    void startDetection();
+    /// Start continuous detection workers for all cameras (pipeline.sampling).
+    /// `on_motion` receives each worker's in-process motion edges.
+    void startDetection(DetectionWorker::MotionHandler on_motion = nullptr);
 
     /// Stop all detection workers
     void stopDetection();
@@ -54,6 +72,16 @@ public:
     /// Get the shared detection engine (may be null if model not loaded)
     std::shared_ptr<DetectionEngine> getDetectionEngine() const;
 
+    /// All detection sessions; the engine above is its primary (null if model not loaded)
+    std::shared_ptr<EnginePool> getEnginePool() const;
+
+    /// Get the cross-camera inference scheduler (null if model not loaded)
+    std::shared_ptr<InferenceScheduler> getInferenceScheduler() const;
+
+    /// Compiled class filter for a camera: its own `classes` if set, otherwise the
+    /// global detection classes. Null when unfiltered or the model is not loaded.
+    std::shared_ptr<const ClassMask> getClassFilter(const std::string& camera_id) const;
+
     /// Get latest detection result for a camera
     std::optional<DetectionResult> getDetectionResult(const std::string& camera_id) const;
 
@@ -68,6 +96,27 @@ public:
     /// Get the ring buffer for a camera (for future pre-roll access).
     std::shared_ptr<CameraBuffer> getCameraBuffer(const std::string& camera_id) const;
 
+    /// Compressed packet ring for a camera (null in transcode-only recording mode).
+    /// Dual-stream cameras: the main stream's.
+    std::shared_ptr<PacketRing> getPacketRing(const std::string& camera_id) const;
+
+    /// True if the camera records a separate main stream (pipeline.streams)
+    bool isDualStream(const std::string& camera_id) const;
+
+    /// Dual-stream camera: its main-stream picture at `at` (a substream
+    /// frame's timestamp), decoded on demand from the packet ring. Null for
+    /// single-stream cameras or when nothing decodes.
+    std::shared_ptr<FrameData> decodeMainStream(const std::string& camera_id,
+                                                SteadyClock::time_point at) const;
+
+    /// decodeMainStream() on the service's decode workers (a few, with a
+    /// short queue), then `done` there with the result. False, without
+    /// calling `done`, when the queue is full or after stopAll().
+    bool decodeMainStreamAsync(const std::string& camera_id, SteadyClock::time_point at,
+                               std::function<void(std::shared_ptr<FrameData>)> done);
+
+    const PipelineConfig& pipelineConfig() const { return pipeline_; }
+
     /// Get stats for all cameras.
     std::vector<CameraStats> getAllStats() const;
 
@@ -82,15 +131,27 @@ private:
         std::string name;
         std::shared_ptr<FramePool> pool;
         std::shared_ptr<CameraBuffer> buffer;
+        std::shared_ptr<PacketRing> packets;
         std::unique_ptr<RtspCapture> capture;
+        std::unique_ptr<RtspCapture> record_capture;  // dual-stream: main stream, packets only
     };
 
     hms::AppConfig config_;
+    PipelineConfig pipeline_;
     std::unordered_map<std::string, CameraState> cameras_;
 
-    // Detection
-    std::shared_ptr<DetectionEngine> detection_engine_;
+    // Detection. Loaded off the main thread at startup, so guarded.
+    mutable std::mutex detection_mutex_;
+    std::shared_ptr<DetectionEngine> detection_engine_;  // engine_pool_'s primary
+    std::shared_ptr<EnginePool> engine_pool_;
+    std::shared_ptr<InferenceScheduler> scheduler_;
+    // Built once per model load; cameras without their own list share the global one
+    std::unordered_map<std::string, std::shared_ptr<const ClassMask>> class_filters_;
+    std::shared_ptr<const ClassMask> default_class_filter_;
     std::unordered_map<std::string, std::unique_ptr<DetectionWorker>> detection_workers_;
+
+    // Dual-stream cameras only: on-demand main-stream decodes, drained by stopAll()
+    std::unique_ptr<EventExecutor> main_decoder_;
 };
 
 }  // namespace hms
@@ -2,66 +2,194 @@
 
 #include "frame_data.h"
 
-#include <shared_mutex>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace hms {
 
 /// Fixed-size ring buffer for frames from a single camera.
-/// Writer (capture thread) takes exclusive lock; readers (HTTP handlers) take shared lock.
+///
+/// Single writer (capture thread), any number of readers, no mutex and no
+/// allocation on push or read. Every frame gets a sequence number; each slot
+/// records the sequence it holds and readers re-check it after loading the
+/// frame (a per-slot seqlock), so a slot being overwritten is detected
+/// instead of read torn. Access to a slot's frame pointer is at most a short
+/// spin while another thread copies the same pointer (see Slot); nobody
+/// sleeps except in waitForFrame(), which waits for a newer sequence.
 class CameraBuffer {
 public:
+    /// A frame together with its buffer sequence number
+    struct Sequenced {
+        std::shared_ptr<FrameData> frame;  // nullptr on timeout
+        uint64_t seq = 0;
+    };
+
+    /// Window of buffered frames fixed at the time of snapshot(). Holds no
+    /// frame references and allocates nothing: each access pins just that
+    /// frame. Frames the writer overwrites after the snapshot read as null.
+    class View {
+    public:
+        size_t size() const { return static_cast<size_t>(end_ - begin_); }
+        bool empty() const { return begin_ == end_; }
+
+        /// Sequence of the newest frame in the window; resume waitForFrame() from here
+        uint64_t lastSeq() const { return end_ - 1; }
+
+        /// i-th frame, oldest first; nullptr if it has since been overwritten
+        std::shared_ptr<FrameData> operator[](size_t i) const {
+            return buffer_->load(begin_ + i);
+        }
+
+        /// Call fn(const std::shared_ptr<FrameData>&) for each frame still held, oldest first
+        template <typename Fn>
+        void forEach(Fn&& fn) const {
+            for (uint64_t seq = begin_; seq < end_; ++seq) {
+                if (auto frame = buffer_->load(seq)) fn(frame);
+            }
+        }
+
+    private:
+        friend class CameraBuffer;
+        View(const CameraBuffer* buffer, uint64_t begin, uint64_t end)
+            : buffer_(buffer), begin_(begin), end_(end) {}
+
+        const CameraBuffer* buffer_;
+        uint64_t begin_;  // first sequence in the window
+        uint64_t end_;    // one past the newest
+    };
+
     explicit CameraBuffer(size_t capacity)
-        : capacity_(capacity), buffer_(capacity), head_(0), count_(0) {}
+        : capacity_(std::max<size_t>(capacity, 1))
+        , slots_(std::make_unique<Slot[]>(capacity_)) {}
 
-    /// Push a frame, overwriting the oldest if full. Called from capture thread.
+    CameraBuffer(const CameraBuffer&) = delete;
+    CameraBuffer& operator=(const CameraBuffer&) = delete;
+
+    /// Push a frame, overwriting the oldest if full. Capture thread only.
     void push(std::shared_ptr<FrameData> frame) {
-        std::unique_lock lock(mutex_);
-        buffer_[head_] = std::move(frame);
-        head_ = (head_ + 1) % capacity_;
-        if (count_ < capacity_) ++count_;
+        uint64_t seq = head_.load(std::memory_order_relaxed) + 1;
+        Slot& slot = slots_[seq % capacity_];
+        slot.seq.store(0);                  // readers of the old frame now back off
+        slot.frame.store(std::move(frame)); // old frame goes back to its pool here
+        slot.seq.store(seq);
+        head_.store(seq);
+        if (waiters_.load() > 0) {
+            // Taking the lock orders this push after a waiter's check of head_
+            { std::lock_guard lock(wait_mutex_); }
+            wait_cv_.notify_all();
+        }
     }
 
     /// Get the most recent frame, or nullptr if empty.
     std::shared_ptr<FrameData> getLatestFrame() const {
-        std::shared_lock lock(mutex_);
-        if (count_ == 0) return nullptr;
-        size_t idx = (head_ + capacity_ - 1) % capacity_;
-        return buffer_[idx];
+        for (;;) {
+            uint64_t head = head_.load();
+            if (head <= base_.load()) return nullptr;
+            if (auto frame = load(head)) return frame;
+            // Lapped by the writer (capacity frames pushed meanwhile): retry on the new head
+        }
+    }
+
+    /// Sequence of the newest frame pushed; 0 before the first
+    uint64_t latestSeq() const { return head_.load(); }
+
+    /// Block until a frame newer than `after_seq` is pushed or `deadline`
+    /// passes. With `every_frame` it returns the oldest still-buffered frame
+    /// after `after_seq` (so a consumer that keeps up sees each frame once),
+    /// otherwise the newest. Returns a null frame on timeout.
+    Sequenced waitForFrame(uint64_t after_seq, SteadyClock::time_point deadline,
+                           bool every_frame = false) const {
+        for (;;) {
+            uint64_t head = head_.load();
+            if (head <= after_seq) {
+                waiters_.fetch_add(1);
+                {
+                    std::unique_lock lock(wait_mutex_);
+                    wait_cv_.wait_until(lock, deadline, [&] { return head_.load() > after_seq; });
+                }
+                waiters_.fetch_sub(1);
+                head = head_.load();
+                if (head <= after_seq) return {};
+            }
+            if (!every_frame) {
+                if (auto frame = load(head)) return {frame, head};
+            } else {
+                // Skip frames cleared or already overwritten (consumer fell a lap behind)
+                uint64_t oldest = std::max(base_.load(), head >= capacity_ ? head - capacity_ : 0);
+                for (uint64_t seq = std::max(after_seq, oldest) + 1; seq <= head; ++seq) {
+                    if (auto frame = load(seq)) return {frame, seq};
+                }
+            }
+            if (SteadyClock::now() >= deadline) return {};
+            after_seq = std::max(after_seq, base_.load());  // cleared meanwhile: wait for the next push
+        }
+    }
+
+    /// Zero-allocation view of the frames currently buffered
+    View snapshot() const {
+        uint64_t head = head_.load();
+        uint64_t base = base_.load();
+        uint64_t first = std::max(base + 1, head >= capacity_ ? head - capacity_ + 1 : 1);
+        return head < first ? View(this, first, first) : View(this, first, head + 1);
     }
 
     /// Get all buffered frames in order from oldest to newest.
     std::vector<std::shared_ptr<FrameData>> getBuffer() const {
-        std::shared_lock lock(mutex_);
+        auto view = snapshot();
         std::vector<std::shared_ptr<FrameData>> result;
-        result.reserve(count_);
-        size_t start = (head_ + capacity_ - count_) % capacity_;
-        for (size_t i = 0; i < count_; ++i) {
-            result.push_back(buffer_[(start + i) % capacity_]);
-        }
+        result.reserve(view.size());
+        view.forEach([&](const std::shared_ptr<FrameData>& f) { result.push_back(f); });
         return result;
     }
 
     size_t size() const {
-        std::shared_lock lock(mutex_);
-        return count_;
+        uint64_t held = head_.load() - base_.load();
+        return static_cast<size_t>(std::min<uint64_t>(held, capacity_));
     }
 
     size_t capacity() const { return capacity_; }
 
+    /// Drop all frames. Writer side only (capture thread, or while capture is stopped).
     void clear() {
-        std::unique_lock lock(mutex_);
-        for (auto& f : buffer_) f.reset();
-        head_ = 0;
-        count_ = 0;
+        base_.store(head_.load());
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].seq.store(0);
+            slots_[i].frame.store(nullptr);
+        }
     }
 
 private:
-    size_t capacity_;
-    std::vector<std::shared_ptr<FrameData>> buffer_;
-    size_t head_;   // next write position
-    size_t count_;  // number of valid frames
-    mutable std::shared_mutex mutex_;
+    struct Slot {
+        std::atomic<uint64_t> seq{0};  // sequence of the frame held; 0 = empty or being written
+        // Not lock-free on libstdc++ (is_always_lock_free is false): loads and
+        // stores take a spin-lock bit in the control-block pointer, held only
+        // for the pointer copy and refcount update
+        std::atomic<std::shared_ptr<FrameData>> frame;
+    };
+
+    /// Frame with sequence `seq`, or nullptr if that slot no longer holds it
+    std::shared_ptr<FrameData> load(uint64_t seq) const {
+        if (seq <= base_.load()) return nullptr;
+        const Slot& slot = slots_[seq % capacity_];
+        if (slot.seq.load() != seq) return nullptr;
+        auto frame = slot.frame.load();
+        if (slot.seq.load() != seq) return nullptr;  // overwritten while we loaded it
+        return frame;
+    }
+
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_{0};  // sequence of the newest frame; 0 = none yet
+    std::atomic<uint64_t> base_{0};  // frames at or below this were cleared
+
+    // waitForFrame() support; push() only touches these while someone waits
+    mutable std::atomic<int> waiters_{0};
+    mutable std::mutex wait_mutex_;
+    mutable std::condition_variable wait_cv_;
 };
 
 }  // namespace hms
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace hms {
+
+/// Class id of a detection whose model id is outside the name table
+inline constexpr uint16_t kUnknownClass = 0xFFFF;
+
+/// Interned class-name table for one model. Each distinct name list is
+/// interned once and lives for the rest of the process, so detections can
+/// point at it without refcounting and resolve names only when serialized.
+class ClassNames {
+public:
+    /// Shared table for `names`, created on first use and never freed
+    static const ClassNames* intern(const std::vector<std::string>& names);
+
+    /// Name for an id, "unknown" when out of range
+    std::string_view name(int id) const;
+
+    /// Id for a name, -1 when the model has no such class
+    int id(std::string_view name) const;
+
+    size_t size() const { return names_.size(); }
+    const std::vector<std::string>& names() const { return names_; }
+
+    ClassNames(const ClassNames&) = delete;
+    ClassNames& operator=(const ClassNames&) = delete;
+
+private:
+    explicit ClassNames(std::vector<std::string> names);
+
+    std::vector<std::string> names_;
+    std::unordered_map<std::string_view, int> ids_;  // views into names_
+};
+
+/// Allowed class ids as a bitmask, so the per-candidate filter is one bit test.
+/// An inactive mask (no filter configured) allows every class.
+struct ClassMask {
+    bool active = false;
+    std::vector<uint64_t> words;
+
+    void set(int id) {
+        if (id < 0) return;
+        size_t w = static_cast<size_t>(id) / 64;
+        if (w >= words.size()) words.resize(w + 1, 0);
+        words[w] |= uint64_t{1} << (id % 64);
+    }
+    bool allows(int id) const {
+        if (!active) return true;
+        if (id < 0 || static_cast<size_t>(id) / 64 >= words.size()) return false;
+        return (words[static_cast<size_t>(id) / 64] >> (id % 64)) & 1;
+    }
+
+    /// Compile a list of class names against a table (unknown names match nothing).
+    /// An empty list gives an inactive mask.
+    static ClassMask compile(const ClassNames& table, const std::vector<std::string>& names);
+};
+
+}  // namespace hms
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "snapshot_cache.h"
+
 #include <drogon/HttpController.h>
 #include <memory>
 
@@ -26,8 +28,12 @@ public:
 
     static void setBufferService(std::shared_ptr<BufferService> svc);
 
+    static SnapshotCache::Stats snapshotCacheStats() { return snapshot_cache_.stats(); }
+
 private:
     static inline std::shared_ptr<BufferService> buffer_service_;
+    /// Encoded JPEGs and detect JSON for each camera's latest frame
+    static inline SnapshotCache snapshot_cache_;
 };
 
 }  // namespace hms
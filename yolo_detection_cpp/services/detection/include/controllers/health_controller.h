@@ -8,25 +8,39 @@ namespace hms { class MqttClient; }
 namespace hms {
 
 class BufferService;
+class DbWriter;
 class EventManager;
+class FileWriter;
+class Readiness;
 
 class HealthController : public drogon::HttpController<HealthController> {
 public:
     METHOD_LIST_BEGIN
     ADD_METHOD_TO(HealthController::getHealth, "/health", drogon::Get);
+    ADD_METHOD_TO(HealthController::getReady, "/ready", drogon::Get);
     METHOD_LIST_END
 
     void getHealth(const drogon::HttpRequestPtr& req,
                    std::function<void(const drogon::HttpResponsePtr&)>&& callback);
 
+    /// 200 once startup is done (required subsystems up), else 503
+    void getReady(const drogon::HttpRequestPtr& req,
+                  std::function<void(const drogon::HttpResponsePtr&)>&& callback);
+
     static void setBufferService(std::shared_ptr<BufferService> svc);
     static void setMqttClient(std::shared_ptr<hms::MqttClient> mqtt);
     static void setEventManager(std::shared_ptr<EventManager> em);
+    static void setDbWriter(std::shared_ptr<DbWriter> writer);
+    static void setFileWriter(std::shared_ptr<FileWriter> writer);
+    static void setReadiness(std::shared_ptr<const Readiness> readiness);
 
 private:
     static inline std::shared_ptr<BufferService> buffer_service_;
     static inline std::shared_ptr<hms::MqttClient> mqtt_client_;
     static inline std::shared_ptr<EventManager> event_manager_;
+    static inline std::shared_ptr<DbWriter> db_writer_;
+    static inline std::shared_ptr<FileWriter> file_writer_;
+    static inline std::shared_ptr<const Readiness> readiness_;
 };
 
 }  // namespace hms
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+
+namespace hms {
+
+/// Prometheus scrape endpoint for the pipeline latency histograms (Metrics).
+/// The first scrape switches timing on.
+class MetricsController : public drogon::HttpController<MetricsController> {
+public:
+    METHOD_LIST_BEGIN
+    ADD_METHOD_TO(MetricsController::getMetrics, "/metrics", drogon::Get);
+    METHOD_LIST_END
+
+    void getMetrics(const drogon::HttpRequestPtr& req,
+                    std::function<void(const drogon::HttpResponsePtr&)>&& callback);
+};
+
+}  // namespace hms
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "live_stream.h"
+
+#include <drogon/HttpController.h>
+#include <memory>
+
+namespace hms {
+
+/// Live view: `GET /api/cameras/{camera_id}/stream` keeps the response open
+/// and streams the camera through the shared LiveStream hub.
+///   format=mjpeg (default)  multipart JPEGs; quality=1-100, annotate=true
+///   format=mp4              fragmented MP4 remuxed from the packet ring
+class StreamController : public drogon::HttpController<StreamController> {
+public:
+    METHOD_LIST_BEGIN
+    ADD_METHOD_TO(StreamController::stream,
+                  "/api/cameras/{camera_id}/stream", drogon::Get);
+    METHOD_LIST_END
+
+    void stream(const drogon::HttpRequestPtr& req,
+                std::function<void(const drogon::HttpResponsePtr&)>&& callback,
+                const std::string& camera_id);
+
+    /// Null (live view disabled) answers 503
+    static void setLiveStream(std::shared_ptr<LiveStream> live);
+
+    static LiveStream::Stats liveStats() { return live_stream_ ? live_stream_->stats() : LiveStream::Stats{}; }
+
+private:
+    static inline std::shared_ptr<LiveStream> live_stream_;
+};
+
+}  // namespace hms
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "db_pool.h"
+#include "event_logger.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace hms {
+
+/// Write-behind queue for the detection service's database rows.
+///
+/// Events and periodic snapshots submit() rows and move on; one writer thread
+/// applies them in submission order, a batch per wakeup (once `batch` rows are
+/// queued or the oldest has waited `flush_ms`). A failed row stays at the head
+/// and is retried with exponential backoff; nothing behind it is written
+/// first, so an event's rows keep their order. A slow or unreachable Postgres
+/// holds up only this thread, never event completion or the GPU release.
+/// While the database is down, rows beyond `queue` spill to an append-only
+/// JSON-lines journal (bounded by `journal_max_bytes`; rows that don't fit
+/// are dropped and counted) that is replayed, oldest first, once writes
+/// succeed again — also after a restart.
+class DbWriter {
+public:
+    struct CreateEvent {
+        std::string event_id, camera_id, recording, snapshot;
+    };
+    struct LogDetections {
+        std::string event_id;
+        std::vector<EventLogger::DetectionRecord> detections;
+    };
+    struct CompleteEvent {
+        std::string event_id;
+        double duration_seconds = 0;
+        int frames = 0;
+        int detections = 0;
+    };
+    struct LogAiContext {
+        std::string event_id, camera_id;
+        EventLogger::AiContext context;
+    };
+    struct PeriodicSnapshot {
+        std::string camera_id, filename, thumbnail, context;
+        std::vector<float> embedding;
+        std::string model;
+        bool is_valid = false;
+    };
+    using Row = std::variant<CreateEvent, LogDetections, CompleteEvent, LogAiContext, PeriodicSnapshot>;
+
+    /// Applies one row; throws on failure. The default runs the hms-shared query.
+    using Sink = std::function<void(const Row&)>;
+    /// The pool to write through; throws while there is none yet (a database
+    /// still being connected), which retries like any other failed write
+    using PoolSource = std::function<std::shared_ptr<DbPool>()>;
+
+    struct Options {
+        int queue = 1024;               // rows held in memory while the DB is down
+        int batch = 64;                 // rows per flush
+        int flush_ms = 200;             // how long the oldest row may wait for company
+        std::string journal_path;       // spill file; empty = no journal (drop beyond `queue`)
+        size_t journal_max_bytes = 16u << 20;
+        int max_attempts = 20;          // after this many failures a row is dropped if the next one succeeds
+        int retry_min_ms = 500;         // backoff after a failed flush, doubling...
+        int retry_max_ms = 30000;       // ...up to this
+    };
+
+    struct Stats {
+        size_t queued = 0;              // in memory
+        size_t journaled = 0;           // rows in the journal
+        size_t journal_bytes = 0;
+        uint64_t written = 0;
+        uint64_t failures = 0;          // failed attempts
+        uint64_t dropped = 0;           // journal full, or a row the DB kept rejecting
+        bool healthy = true;            // last attempt succeeded
+        double avg_flush_ms = 0;        // per successful batch
+        double max_flush_ms = 0;
+    };
+
+    DbWriter(std::shared_ptr<DbPool> db, Options options);
+    DbWriter(PoolSource db, Options options);
+    DbWriter(Sink sink, Options options);  // tests
+    ~DbWriter();
+
+    DbWriter(const DbWriter&) = delete;
+    DbWriter& operator=(const DbWriter&) = delete;
+
+    /// Queue a row. Never blocks on the database.
+    void submit(Row row);
+
+    /// Write what's queued (or journal it if the DB is failing), then stop. Idempotent.
+    void stop();
+
+    Stats stats() const;
+
+    /// JSON-lines form used by the journal
+    static std::string serialize(const Row& row);
+    static bool deserialize(const std::string& line, Row& row);
+
+private:
+    struct Pending {
+        Row row;
+        int attempts = 0;
+    };
+
+    void run();
+    bool apply(const Row& row, std::string& error);  // sink_ without throwing
+    void spillLocked(size_t keep);  // journal all but the newest `keep` rows
+    void loadJournalLocked();       // next batch from the journal into journal_batch_
+
+    Sink sink_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Pending> pending_;
+    std::chrono::steady_clock::time_point oldest_queued_;
+    bool stopping_ = false;
+    size_t journaled_ = 0;
+    size_t journal_bytes_ = 0;
+    size_t journal_offset_ = 0;     // bytes already written to the DB
+    int journal_head_attempts_ = 0;
+    std::vector<Pending> journal_batch_;
+    std::vector<size_t> journal_line_bytes_;
+    Stats stats_;
+    int64_t flush_ns_total_ = 0;
+    uint64_t flushes_ = 0;
+    std::thread writer_;
+};
+
+}  // namespace hms
@@ -1,26 +1,86 @@
 #pragma once
 
+#include "class_names.h"
 #include "frame_data.h"
+#include "gpu_letterbox.h"
+#include "letterbox.h"
+#include "pipeline_config.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include <onnxruntime/onnxruntime_cxx_api.h>
 
 namespace hms {
 
+/// One detection, as plain data: the class is an id into the model's interned
+/// ClassNames table and is only turned into a string at the JSON/MQTT/DB edges.
 struct Detection {
-    std::string class_name;
-    int class_id = -1;
+    uint16_t class_id = kUnknownClass;
     float confidence = 0.0f;
     float x1 = 0, y1 = 0, x2 = 0, y2 = 0;  // bbox in original image coordinates
+    const ClassNames* classes = nullptr;   // table class_id indexes into
+
+    std::string_view name() const { return classes ? classes->name(class_id) : "unknown"; }
+};
+
+static_assert(std::is_trivially_copyable_v<Detection>);
+
+/// Per-request thresholds, so frames from different cameras can share one batch.
+/// `classes` is compiled once per camera; null allows every class.
+/// `regions`: infer on these crops (ROI / tiles, see tileRegions()) instead of
+/// the whole frame; each is letterboxed into its own batch slot and the
+/// results are merged with cross-region NMS. Null or empty = whole frame.
+struct DetectParams {
+    float conf_threshold = 0.5f;
+    float iou_threshold = 0.45f;
+    std::shared_ptr<const ClassMask> classes;
+    std::shared_ptr<const std::vector<Region>> regions;
+};
+
+/// Structure-of-arrays candidate boxes for NMS. Buffers are reused between
+/// calls, so steady-state NMS does not allocate.
+struct NmsBoxes {
+    std::vector<float> x1, y1, x2, y2, area, score;
+    std::vector<int> class_id;
+
+    size_t size() const { return score.size(); }
+    void clear();
+    void push(float x1, float y1, float x2, float y2, float score, int class_id);
+
+    /// Greedy class-aware NMS in descending score order. `keep` receives the
+    /// surviving indices, highest score first.
+    void nms(float iou_threshold, std::vector<int>& keep);
+
+private:
+    std::vector<int> order;
+    std::vector<uint8_t> suppressed;
 };
 
 class DetectionEngine {
 public:
-    explicit DetectionEngine(const std::string& model_path, int num_classes = 80, bool gpu_enabled = false);
+    /// `optimized_model_path`: where ORT serializes the optimized graph on first load;
+    /// later loads read it back with graph optimization skipped. Empty disables the cache.
+    /// `session`: device, intra-op threads, execution provider and precision of
+    /// this engine's session. CUDA and TensorRT fall back to CPU when `gpu_enabled`
+    /// is off. `provider_cache_dir`: root of the TensorRT engine/timing and OpenVINO
+    /// blob caches, keyed below it by engineCacheKey(); empty = the model's directory.
+    /// TensorRT and OpenVINO sessions compile the graph themselves and skip the
+    /// optimized model cache.
+    explicit DetectionEngine(const std::string& model_path, int num_classes = 80, bool gpu_enabled = false,
+                             const std::string& optimized_model_path = "",
+                             const SessionConfig& session = SessionConfig{},
+                             const std::string& provider_cache_dir = "");
+    ~DetectionEngine();
 
     /// Load the ONNX session onto GPU/CPU. Safe to call multiple times.
     void load();
@@ -28,15 +88,111 @@ public:
     /// Unload the ONNX session, releasing GPU memory. Safe to call multiple times.
     void unload();
 
+    // --- Residency ---
+    // Events acquire() the session and release() it when done. A released session
+    // stays resident for the idle TTL so the next event skips the cold start;
+    // GpuCoordinator can evict() it earlier when another model needs the VRAM.
+
+    /// How long a released session stays loaded. Zero unloads on release (old behavior).
+    void setIdleTtl(std::chrono::seconds ttl) { idle_ttl_.store(ttl.count()); }
+    std::chrono::seconds idleTtl() const { return std::chrono::seconds(idle_ttl_.load()); }
+
+    /// Pin the session for the caller, loading it if necessary.
+    void acquire();
+
+    /// Drop the caller's pin. Unloads immediately only when the idle TTL is zero.
+    void release();
+
+    /// Unload if unpinned and idle for longer than the TTL. Returns true if it unloaded.
+    bool unloadIfIdle();
+
+    /// Unload now unless pinned. Returns true if VRAM was freed.
+    bool evict();
+
+    struct ResidencyStats {
+        bool loaded = false;
+        int active_users = 0;
+        uint64_t loads = 0;         // Ort::Session constructions
+        uint64_t cache_hits = 0;    // loads served from the optimized model file
+        uint64_t evictions = 0;     // unloads requested by GpuCoordinator
+        uint64_t idle_unloads = 0;  // unloads after the idle TTL expired
+        double last_load_ms = 0;
+    };
+
+    ResidencyStats residencyStats() const;
+
     /// Run inference on a single BGR24 frame
     std::vector<Detection> detect(const FrameData& frame,
                                   float conf_threshold = 0.5f,
                                   float iou_threshold = 0.45f,
                                   const std::vector<std::string>& filter_classes = {});
 
-    const std::vector<std::string>& classNames() const { return class_names_; }
+    /// Run inference on N frames: prepareBatch/runBatch/finishBatch back to back
+    /// on the caller's thread; one Session::Run when the batch dim is dynamic.
+    /// Returns one detection list per input frame (empty lists if not loaded).
+    std::vector<std::vector<Detection>> detectBatch(const std::vector<const FrameData*>& frames,
+                                                    const std::vector<DetectParams>& params);
+
+    // --- Staged detection ---
+    // detectBatch() split into its three stages so consecutive batches overlap
+    // (InferenceScheduler): prepareBatch() converts and letterboxes on the
+    // caller's thread into a free binding slot, runBatch() holds the session
+    // only for Session::Run, finishBatch() decodes + NMS and frees the slot.
+    // Each loaded session has pipelineDepth() slots (input and output buffers);
+    // prepareBatch() blocks while all of them are in flight, which bounds the
+    // pipeline. The session is not unloaded while a job holds a slot.
+
+    struct Letterbox {
+        float scale = 1.0f, pad_x = 0.0f, pad_y = 0.0f;
+    };
+
+    /// One batch in flight (defined after the class)
+    class BatchJob;
+
+    /// `frames` must stay alive until finishBatch()
+    BatchJob prepareBatch(const std::vector<const FrameData*>& frames,
+                          const std::vector<DetectParams>& params);
+    void runBatch(BatchJob& job);
+    /// One detection list per frame given to prepareBatch()
+    std::vector<std::vector<Detection>> finishBatch(BatchJob& job);
+
+    /// Binding slots per session, applied at the next load (1 = no overlap)
+    void setPipelineDepth(int depth) { pipeline_depth_.store(std::max(1, depth)); }
+    int pipelineDepth() const { return pipeline_depth_.load(); }
+
+    /// Letterbox sampling. Nearest by default; Bilinear matches Ultralytics' letterbox.
+    void setResizeMode(ResizeMode mode) { resize_mode_.store(mode); }
+    ResizeMode resizeMode() const { return resize_mode_.load(); }
+
+    /// Letterbox on the session's CUDA device (GpuLetterbox), writing the
+    /// input tensor in device memory, applied at the next load. Needs a GPU
+    /// session and a HMS_CUDA_PREPROCESS build, else the CPU path stays.
+    void setGpuPreprocess(bool on) { gpu_preprocess_.store(on); }
+    bool gpuPreprocess() const { return gpu_preprocess_.load(); }
+    /// The loaded session's inputs are letterboxed on the GPU
+    bool gpuPreprocessActive() const { return gpu_preprocess_active_.load(); }
+
+    const std::vector<std::string>& classNames() const { return class_table_->names(); }
+
+    /// Interned name table that this engine's detections point at
+    const ClassNames& classTable() const { return *class_table_; }
     bool isLoaded() const { std::lock_guard lock(session_mutex_); return session_ != nullptr; }
     bool isModelValid() const { return model_valid_; }
+    /// CUDA device the session runs on, -1 for CPU/OpenVINO
+    int device() const { return gpu_enabled_ ? session_config_.device : -1; }
+    int threads() const { return session_config_.threads; }
+    /// Provider and precision requested for the session after fallbacks to the
+    /// build (no GPU: CPU; FP16/INT8 on CUDA/CPU: FP32)
+    ExecutionProvider provider() const { return session_config_.provider; }
+    Precision precision() const { return session_config_.precision; }
+    /// Provider the loaded session actually runs on, after EP registration fallbacks
+    ExecutionProvider activeProvider() const { return active_provider_.load(); }
+
+    /// Subdirectory name of the provider caches: "<model stem>-<16 hex of the
+    /// model file's FNV-1a hash>", so a re-exported model never reads stale
+    /// engines. Empty if the model file can't be read.
+    static std::string engineCacheKey(const std::string& model_path);
+    bool supportsBatching() const { std::lock_guard lock(session_mutex_); return dynamic_batch_; }
     int inputWidth() const { return input_width_; }
     int inputHeight() const { return input_height_; }
 
@@ -44,12 +200,27 @@ public:
     std::vector<float> preprocess(const FrameData& frame,
                                   float& scale, float& pad_x, float& pad_y) const;
 
+    /// Letterbox one frame into a caller-owned [3, H, W] tensor slice
+    void preprocessInto(const FrameData& frame, float* tensor,
+                        float& scale, float& pad_x, float& pad_y) const;
+
+    /// Same for a crop of the frame; `region` must lie inside it
+    void preprocessInto(const FrameData& frame, const Region& region, float* tensor,
+                        float& scale, float& pad_x, float& pad_y) const;
+
     std::vector<Detection> postprocess(const float* output, int num_candidates,
                                        float conf_threshold, float iou_threshold,
                                        float scale, float pad_x, float pad_y,
                                        int orig_width, int orig_height,
                                        const std::vector<std::string>& filter_classes) const;
 
+    /// Same as postprocess() with a precomputed class mask
+    std::vector<Detection> postprocessMasked(const float* output, int num_candidates,
+                                             float conf_threshold, float iou_threshold,
+                                             float scale, float pad_x, float pad_y,
+                                             int orig_width, int orig_height,
+                                             const ClassMask& mask) const;
+
     /// Post-process end-to-end model output [1, N, 6] where each row is [x1, y1, x2, y2, conf, class_id]
     std::vector<Detection> postprocessE2E(const float* output, int num_detections,
                                           float conf_threshold,
@@ -57,25 +228,145 @@ public:
                                           int orig_width, int orig_height,
                                           const std::vector<std::string>& filter_classes) const;
 
+    std::vector<Detection> postprocessE2EMasked(const float* output, int num_detections,
+                                                float conf_threshold,
+                                                float scale, float pad_x, float pad_y,
+                                                int orig_width, int orig_height,
+                                                const ClassMask& mask) const;
+
+    /// Bitmask for a list of class names (unknown names match nothing)
+    ClassMask classMask(const std::vector<std::string>& filter_classes) const;
+
     static std::vector<int> nms(const std::vector<Detection>& dets, float iou_threshold);
+
+    /// Cross-region NMS: drop duplicates of an object seen by overlapping
+    /// tiles. Survivors are sorted by confidence descending.
+    static void mergeRegions(std::vector<Detection>& dets, float iou_threshold);
     static float iou(const Detection& a, const Detection& b);
 
 private:
     void initClassNames();
 
+    /// Drop the session, its slots and cached names. Caller holds session_mutex_.
+    /// While jobs hold slots the unload is deferred to the last finishBatch()
+    /// and this returns false.
+    bool unloadLocked();
+
+    /// Float buffer in pinned (CUDA) or pageable host memory that only ever grows
+    struct HostBuffer {
+        float* data = nullptr;
+        size_t capacity = 0;  // floats
+        std::vector<float> host;
+        std::optional<Ort::MemoryAllocation> pinned;
+        void reserve(size_t floats, Ort::Allocator* allocator);
+    };
+
+    /// Persistent IoBinding slot of the current session: input/output tensors
+    /// are wrapped around long-lived buffers and rebound only when the view
+    /// (first input, count) changes
+    struct Binding {
+        std::unique_ptr<Ort::IoBinding> io;
+        std::unique_ptr<Ort::Allocator> pinned;  // null: pageable host memory
+        Ort::MemoryInfo memory_info{nullptr};
+        HostBuffer input;                  // CPU letterbox only
+        std::unique_ptr<GpuLetterbox> gpu; // set: input lives in device memory
+        Ort::MemoryInfo device_info{nullptr};
+        void* device_input = nullptr;      // gpu->reserveTensor()
+        HostBuffer output;
+        std::vector<int64_t> output_dims;  // model output shape (dim0 may be -1)
+        bool static_output = false;        // dims 1/2 known: output preallocated
+        Ort::Value input_value{nullptr};
+        Ort::Value output_value{nullptr};
+        size_t bound_offset = 0;
+        size_t bound_batch = 0;            // 0 = needs (re)binding
+    };
+
+    /// Binding slots for the session just created. Caller holds session_mutex_.
+    void createSlots();
+
+    /// Grow a slot's buffers for `inputs` letterboxed inputs. Caller holds the slot.
+    void reserveSlot(Binding& binding, size_t inputs);
+
+    /// Bind [n, 3, H, W] input and [n, ...] output views starting at input
+    /// `offset`. Caller holds session_mutex_.
+    void bindBatch(Binding& binding, size_t offset, size_t n);
+
+    /// prepareBatch() for a GPU slot: every input letterboxed into the
+    /// device tensor, from YUV planes while the frame is still unconverted
+    bool letterboxOnGpu(Binding& binding, BatchJob& job, const std::vector<const FrameData*>& frames);
+
+    /// Return a job's slot; completes a deferred unload when it was the last one
+    void releaseSlot(BatchJob& job);
+
+    /// Cached index tables for this source resolution + current mode/input size
+    std::shared_ptr<const LetterboxPlan> letterboxPlan(int src_w, int src_h) const;
+
+    /// Validate output shape and dispatch to postprocess/postprocessE2E for
+    /// the batch item at `index`.
+    std::vector<Detection> decodeOutput(const float* output_data,
+                                        const std::vector<int64_t>& output_shape,
+                                        size_t index, const Region& region,
+                                        const Letterbox& lb, const DetectParams& params);
+
     Ort::Env env_;
     mutable std::mutex session_mutex_;
     std::unique_ptr<Ort::Session> session_;
     Ort::AllocatorWithDefaultOptions allocator_;
 
+    /// Session options for `provider` with the cache mode's graph settings
+    Ort::SessionOptions makeSessionOptions(ExecutionProvider provider, bool read_cache, bool write_cache);
+
+    /// Append TensorRT (+CUDA for unsupported nodes) / OpenVINO; throws Ort::Exception
+    void appendTensorRt(Ort::SessionOptions& options);
+    void appendOpenVino(Ort::SessionOptions& options);
+
+    /// <provider_cache_dir>/<engineCacheKey>, created on first use; empty on error
+    std::string providerCachePath();
+
     std::string model_path_;
     bool gpu_enabled_ = false;
+    SessionConfig session_config_;
+    std::string provider_cache_dir_;
+    std::string provider_cache_path_;  // resolved once, under session_mutex_
+    std::atomic<ExecutionProvider> active_provider_{ExecutionProvider::Cpu};
     bool model_valid_ = false;  // true if model file exists and loaded successfully at least once
+    std::string optimized_model_path_;
+
+    // Residency (last_release_ guarded by session_mutex_)
+    std::atomic<int> active_users_{0};
+    std::atomic<int64_t> idle_ttl_{0};
+    SteadyClock::time_point last_release_{};
+    std::atomic<uint64_t> loads_{0};
+    std::atomic<uint64_t> cache_hits_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> idle_unloads_{0};
+    std::atomic<double> last_load_ms_{0};
 
-    std::vector<std::string> class_names_;
+    const ClassNames* class_table_ = nullptr;
     int num_classes_;
     int input_width_ = 640;
     int input_height_ = 640;
+    bool dynamic_batch_ = false;  // model input dim0 is symbolic (-1)
+    bool input_fp16_ = false;     // model input is float16 (GPU letterbox writes halves)
+
+    // Preprocessing: per-resolution tables (one per camera size)
+    std::atomic<ResizeMode> resize_mode_{ResizeMode::Nearest};
+    std::atomic<bool> gpu_preprocess_{false};
+    std::atomic<bool> gpu_preprocess_active_{false};
+    std::atomic<bool> gpu_error_logged_{false};
+    mutable std::mutex plan_mutex_;
+    mutable std::vector<std::shared_ptr<const LetterboxPlan>> plans_;
+
+    // Binding slots, created with session_ and reset together with it. The
+    // vector changes under session_mutex_ + slot_mutex_; free_slots_ and
+    // in_flight_ under slot_mutex_ (lock order: session_mutex_, slot_mutex_).
+    std::vector<std::unique_ptr<Binding>> slots_;
+    std::mutex slot_mutex_;
+    std::condition_variable slot_cv_;
+    std::vector<Binding*> free_slots_;
+    size_t in_flight_ = 0;
+    bool unload_pending_ = false;
+    std::atomic<int> pipeline_depth_{1};
 
     // Cached input/output names
     std::vector<std::string> input_names_str_;
@@ -84,9 +375,36 @@ private:
     std::vector<const char*> output_names_;
 
     // Log output format once on first detection
-    mutable bool e2e_logged_ = false;
-    mutable bool raw_logged_ = false;
-    mutable bool format_error_logged_ = false;
+    std::atomic<bool> e2e_logged_{false};
+    std::atomic<bool> raw_logged_{false};
+    std::atomic<bool> format_error_logged_{false};
+};
+
+/// One DetectionEngine batch in flight. Move-only; frees its slot when destroyed.
+class DetectionEngine::BatchJob {
+public:
+    BatchJob() = default;
+    BatchJob(BatchJob&& other) noexcept { *this = std::move(other); }
+    BatchJob& operator=(BatchJob&& other) noexcept;
+    ~BatchJob();
+
+    /// Nothing to run: no usable frames, or the session is not loaded
+    bool empty() const { return slot_ == nullptr; }
+
+private:
+    friend class DetectionEngine;
+    struct Input {
+        size_t frame;
+        Region region;
+        Letterbox lb;
+    };
+    DetectionEngine* engine_ = nullptr;
+    Binding* slot_ = nullptr;
+    std::vector<DetectParams> params_;
+    std::vector<Input> inputs_;
+    std::vector<uint8_t> tiled_;
+    std::vector<Ort::Value> outputs_;  // ORT-allocated outputs, one per Run
+    bool ran_ = false;
 };
 
 }  // namespace hms
@@ -2,9 +2,14 @@
 
 #include "camera_buffer.h"
 #include "detection_engine.h"
+#include "inference_scheduler.h"
+#include "motion_detector.h"
+#include "pipeline_config.h"
+#include "tiling.h"
 #include "config_manager.h"
 
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <shared_mutex>
@@ -20,13 +25,25 @@ struct DetectionResult {
     uint64_t frame_number = 0;
 };
 
+/// Continuous detection for one camera. With motion gating, every frame goes
+/// through a cheap MotionDetector and inference runs at the burst rate while
+/// the scene changes, at the idle rate while it is static. With tiling,
+/// a changing scene is inferred only on the tiles that changed.
 class DetectionWorker {
 public:
+    /// Called on the worker thread when in-process motion starts (true) or ends
+    using MotionHandler = std::function<void(const std::string& camera_id, bool active)>;
+
+    /// `class_filter`: this camera's compiled class filter (null: all classes)
     DetectionWorker(const std::string& camera_id,
                     std::shared_ptr<CameraBuffer> buffer,
-                    std::shared_ptr<DetectionEngine> engine,
+                    std::shared_ptr<InferenceScheduler> scheduler,
                     const hms::CameraConfig& camera_config,
-                    const hms::DetectionConfig& detection_config);
+                    const hms::DetectionConfig& detection_config,
+                    std::shared_ptr<const ClassMask> class_filter = nullptr,
+                    const SamplingConfig& sampling = SamplingConfig{},
+                    const TilingConfig& tiling = TilingConfig{},
+                    MotionHandler on_motion = nullptr);
 
     ~DetectionWorker();
 
@@ -44,6 +61,10 @@ public:
         uint64_t detections_found = 0;
         double avg_inference_ms = 0;
         bool is_running = false;
+        uint64_t frames_skipped = 0;  // frames seen but not inferred (rate limit / static scene)
+        bool motion_active = false;   // sampling at the burst rate
+        double motion_score = 0;      // changed fraction of the last frame
+        uint64_t regions_inferred = 0; // ROI crops / tiles sent to the model (tiling only)
     };
 
     Stats stats() const;
@@ -51,13 +72,23 @@ public:
 private:
     void detectionLoop();
 
+    /// Regions to infer on for this frame (null: whole frame); consumes pending_cells_
+    std::shared_ptr<const std::vector<Region>> regionsFor(const FrameData& frame);
+
     std::string camera_id_;
     std::shared_ptr<CameraBuffer> buffer_;
-    std::shared_ptr<DetectionEngine> engine_;
-    std::vector<std::string> filter_classes_;
-    float confidence_threshold_;
-    float iou_threshold_;
-    int sample_interval_ms_;
+    std::shared_ptr<InferenceScheduler> scheduler_;
+    DetectParams params_;
+    SamplingConfig sampling_;
+    MotionDetector motion_;
+    MotionHandler on_motion_;
+
+    // Tiling (worker thread only)
+    TilingConfig tiling_;
+    std::shared_ptr<const std::vector<Region>> tiles_;  // for tiles_width_ x tiles_height_
+    int tiles_width_ = 0;
+    int tiles_height_ = 0;
+    MotionDetector::CellMask pending_cells_;  // changed since the last inference
 
     mutable std::shared_mutex result_mutex_;
     std::optional<DetectionResult> latest_result_;
@@ -69,6 +100,10 @@ private:
     std::atomic<uint64_t> frames_processed_{0};
     std::atomic<uint64_t> detections_found_{0};
     std::atomic<double> avg_inference_ms_{0};
+    std::atomic<uint64_t> frames_skipped_{0};
+    std::atomic<bool> motion_active_{false};
+    std::atomic<double> motion_score_{0};
+    std::atomic<uint64_t> regions_inferred_{0};
 };
 
 }  // namespace hms
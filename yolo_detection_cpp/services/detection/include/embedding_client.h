@@ -1,23 +1,96 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace hms {
 
-/// Synchronous client for Ollama's /api/embed endpoint.
-/// Uses libcurl — safe to call from any thread.
+/// Client for Ollama's /api/embed endpoint, meant to be long-lived and shared.
+///
+/// embed() is synchronous and safe to call from any thread. Calls that arrive
+/// within `batch_window_ms` of each other (e.g. periodic snapshots from
+/// several cameras) are coalesced into one /api/embed request with an array
+/// input. Requests go out from one sender thread over one reused curl handle,
+/// so the TCP connection to Ollama stays open between calls. Recent results
+/// are kept in an LRU cache keyed by a hash of the text, so a recurring scene
+/// description is embedded once.
 class EmbeddingClient {
 public:
+    /// Texts -> one embedding per text (same order), or empty on error
+    using Transport = std::function<std::vector<std::vector<float>>(const std::vector<std::string>&)>;
+
+    struct Options {
+        int batch_window_ms = 20;   // how long the first queued text waits for company
+        int max_batch = 16;         // texts per request
+        int cache_entries = 256;    // LRU size; 0 = no cache
+        Transport transport;        // replaces the HTTP call (tests); empty = Ollama
+    };
+
+    struct Stats {
+        uint64_t requests = 0;      // embed() calls with text
+        uint64_t cache_hits = 0;
+        uint64_t batches = 0;       // /api/embed calls
+        uint64_t batched_texts = 0; // texts sent in them
+        uint64_t failures = 0;      // batches that returned nothing
+    };
+
     explicit EmbeddingClient(const std::string& ollama_url = "http://localhost:11434",
-                             const std::string& model = "nomic-embed-text");
+                             const std::string& model = "nomic-embed-text")
+        : EmbeddingClient(ollama_url, model, Options{}) {}
+    EmbeddingClient(const std::string& ollama_url, const std::string& model, Options options);
+    ~EmbeddingClient();
+
+    EmbeddingClient(const EmbeddingClient&) = delete;
+    EmbeddingClient& operator=(const EmbeddingClient&) = delete;
 
     /// Generate a 768-dim embedding for text. Returns empty vector on error.
     std::vector<float> embed(const std::string& text);
 
+    Stats stats() const;
+
 private:
+    struct Request {
+        std::string text;
+        std::promise<std::vector<float>> promise;
+    };
+
+    struct CacheEntry {
+        std::string text;  // checked on lookup; the key is only a hash
+        std::vector<float> embedding;
+    };
+
+    void senderLoop();
+    void dispatch(std::vector<Request>& batch);
+    std::vector<std::vector<float>> post(const std::vector<std::string>& texts);
+
+    bool cacheGet(const std::string& text, std::vector<float>& out);
+    void cachePut(const std::string& text, const std::vector<float>& embedding);
+
     std::string url_;
     std::string model_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Request> queue_;
+    bool stopping_ = false;
+    Stats stats_;
+
+    // Most recently used first
+    std::list<std::pair<size_t, CacheEntry>> lru_;
+    std::unordered_map<size_t, std::list<std::pair<size_t, CacheEntry>>::iterator> cache_;
+
+    void* curl_ = nullptr;  // CURL*, sender thread only
+    std::thread sender_;
 };
 
 }  // namespace hms
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "detection_engine.h"
+
+#include <memory>
+#include <vector>
+
+namespace hms {
+
+/// The ONNX sessions detection runs on: one DetectionEngine per configured
+/// GPU or CPU thread group (pipeline.engine.sessions). The InferenceScheduler
+/// hands each batch to whichever session is idle; residency calls fan out to
+/// every session, so an event that acquires the pool warms all of them.
+/// Session 0 is the primary: class table, input size and load state.
+class EnginePool {
+public:
+    /// `engines` must not be empty
+    explicit EnginePool(std::vector<std::shared_ptr<DetectionEngine>> engines);
+
+    size_t size() const { return engines_.size(); }
+    const std::shared_ptr<DetectionEngine>& engine(size_t i) const { return engines_[i]; }
+    const std::shared_ptr<DetectionEngine>& primary() const { return engines_.front(); }
+
+    /// Pin every session, loading them in parallel
+    void acquire();
+    void release();
+
+    /// Load every session and run one inference on each (in parallel), then
+    /// release them: first-run allocations and kernel/engine builds happen
+    /// now instead of in the first event. Sessions stay resident for the idle TTL.
+    void warmUp();
+
+    /// Evict every unpinned session. True if any VRAM was freed.
+    bool evict();
+
+    /// True if any session is loaded
+    bool isLoaded() const;
+
+    void setIdleTtl(std::chrono::seconds ttl);
+    void setResizeMode(ResizeMode mode);
+    void setGpuPreprocess(bool on);
+    void setPipelineDepth(int depth);
+
+private:
+    std::vector<std::shared_ptr<DetectionEngine>> engines_;
+};
+
+}  // namespace hms
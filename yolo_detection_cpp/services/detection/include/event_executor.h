@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace hms {
+
+/// Fixed worker threads for motion-event processing, one bounded queue per
+/// stage of an event.
+///
+/// Each stage has its own workers so a slow stage (LLaVA) can't starve a fast
+/// one (DB rows). Tasks carry a key, the camera id: tasks of one key run one
+/// at a time and in submission order within a stage, tasks of different keys
+/// run in parallel. A full queue rejects the task — the caller decides whether
+/// to run it inline, skip it or drop the event — so a motion storm queues a
+/// bounded amount of work instead of spawning threads.
+class EventExecutor {
+public:
+    enum class Stage : uint8_t {
+        Record,    // recording + detection sampling for the event's duration
+        Snapshot,  // snapshot JPEG + early MQTT notification
+        Vision,    // LLaVA context
+        Publish,   // DB rows + context MQTT message
+    };
+    static constexpr size_t kStages = 4;
+
+    static const char* stageName(Stage stage);  // "record" | "snapshot" | "vision" | "publish"
+
+    struct StageOptions {
+        int workers = 1;
+        int queue = 16;  // tasks waiting for a worker; more are rejected
+    };
+
+    using Options = std::array<StageOptions, kStages>;  // indexed by Stage
+
+    struct StageStats {
+        const char* name = "";
+        int workers = 0;
+        int capacity = 0;
+        size_t queued = 0;       // waiting for a worker (or for their key)
+        size_t running = 0;
+        uint64_t completed = 0;
+        uint64_t rejected = 0;   // queue full or stopping
+        double avg_wait_ms = 0;  // submit → start
+        double max_wait_ms = 0;
+        double avg_run_ms = 0;
+        double max_run_ms = 0;
+    };
+
+    explicit EventExecutor(const Options& options);
+    ~EventExecutor();
+
+    EventExecutor(const EventExecutor&) = delete;
+    EventExecutor& operator=(const EventExecutor&) = delete;
+
+    /// Queue `task` on `stage`. False if the queue is full or the executor
+    /// is stopping; the task is then not run.
+    bool submit(Stage stage, const std::string& key, std::function<void()> task);
+
+    /// Stop accepting work, run what is already queued and join the workers.
+    /// Stages drain in pipeline order, so a task may still hand work to a
+    /// later stage while earlier ones wind down. Idempotent.
+    void stop();
+
+    std::vector<StageStats> stats() const;
+
+private:
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct Task {
+        std::string key;
+        std::function<void()> fn;
+        SteadyClock::time_point queued;
+    };
+
+    struct Queue {
+        StageOptions options;
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Task> tasks;
+        std::unordered_set<std::string> busy_keys;  // keys with a running task
+        std::vector<std::thread> workers;
+        bool stopping = false;
+
+        uint64_t completed = 0;
+        uint64_t rejected = 0;
+        int64_t wait_ns = 0, max_wait_ns = 0;
+        int64_t run_ns = 0, max_run_ns = 0;
+    };
+
+    void workerLoop(Queue& queue);
+
+    std::array<Queue, kStages> queues_;
+    std::mutex stop_mutex_;
+    bool stopped_ = false;
+};
+
+}  // namespace hms
@@ -1,32 +1,37 @@
 #pragma once
 
 #include "buffer_service.h"
+#include "event_executor.h"
 #include "event_recorder.h"
+#include "file_writer.h"
 #include "snapshot_writer.h"
 #include "vision_client.h"
 #include "gpu_coordinator.h"
 #include "mqtt_client.h"
-#include "db_pool.h"
+#include "db_writer.h"
+#include "mqtt_publisher.h"
 #include "config_manager.h"
 
 #include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace hms {
 
 /// Full event orchestration: MQTT trigger → detect → record → snapshot → publish.
-/// Subscribes to MQTT motion events, manages one event thread per camera.
+/// Subscribes to MQTT motion events, runs at most one event per camera on the
+/// stage workers of an EventExecutor.
 class EventManager {
 public:
     EventManager(std::shared_ptr<BufferService> buffer_service,
                  std::shared_ptr<hms::MqttClient> mqtt,
-                 std::shared_ptr<hms::DbPool> db,
+                 std::shared_ptr<DbWriter> db,
                  std::shared_ptr<GpuCoordinator> gpu_coord,
-                 const hms::AppConfig& config);
+                 const hms::AppConfig& config,
+                 std::shared_ptr<FileWriter> files = nullptr);  // null: recordings and snapshots written inline
     ~EventManager();
 
     EventManager(const EventManager&) = delete;
@@ -38,9 +43,15 @@ public:
     /// Stop all active events and cleanup
     void stop();
 
-    /// Number of currently active events
+    /// Number of currently active events (running or waiting for a worker)
     size_t activeEventCount() const;
 
+    /// Queue depth, throughput and latency of each event stage
+    std::vector<EventExecutor::StageStats> executorStats() const;
+
+    /// Outgoing MQTT queue (all zero without an MQTT client)
+    MqttPublisher::Stats publisherStats() const;
+
     /// Pause/resume detection for a specific camera (runtime toggle, not config)
     void setPaused(const std::string& camera_id, bool paused);
 
@@ -50,6 +61,10 @@ public:
     /// Get pause state for all cameras
     std::unordered_map<std::string, bool> getAllPausedStates() const;
 
+    /// In-process motion from a detection worker (pipeline.sampling.trigger_events):
+    /// starts or stops an event like the camera's MQTT motion messages
+    void onLocalMotion(const std::string& camera_id, bool active);
+
 private:
     /// Called when motion start MQTT message arrives
     void onMotionStart(const std::string& camera_id, int post_roll_seconds);
@@ -57,36 +72,47 @@ private:
     /// Called when motion stop MQTT message arrives
     void onMotionStop(const std::string& camera_id);
 
-    /// Full event processing thread (one per camera, per event)
-    void processEvent(const std::string& camera_id, int post_roll_seconds,
-                      const std::string& event_id);
-
-    /// Generate UUID-like event ID
-    static std::string generateEventId();
-
     struct ActiveEvent {
-        std::thread thread;
         std::atomic<bool> stop_requested{false};
-        std::atomic<bool> running{true};
         std::string event_id;  // to detect if a newer event replaced us
+        SteadyClock::time_point motion_at = SteadyClock::now();
     };
 
+    /// Record-stage task of one event: record + detect, then hand snapshot,
+    /// vision and publish work to the later stages
+    void processEvent(const std::string& camera_id, int post_roll_seconds,
+                      const std::shared_ptr<ActiveEvent>& event);
+
+    /// Queue `task` on `stage`, or run it on the calling thread when the
+    /// stage is full (work that must not be lost: snapshots, DB rows)
+    void runOnStage(EventExecutor::Stage stage, const std::string& camera_id,
+                    std::function<void()> task);
+
+    /// Event snapshot of `frame`, or for a dual-stream camera with
+    /// pipeline.streams.full_res_snapshots, of its main stream at that moment
+    SnapshotWriter::Encoded encodeSnapshot(const std::string& camera_id, const FrameData& frame,
+                                           const std::vector<Detection>& detections) const;
+
+    /// Generate UUID-like event ID
+    static std::string generateEventId();
+
     std::shared_ptr<BufferService> buffer_service_;
     std::shared_ptr<hms::MqttClient> mqtt_;
-    std::shared_ptr<hms::DbPool> db_;
+    std::shared_ptr<DbWriter> db_;
     std::shared_ptr<GpuCoordinator> gpu_coord_;
+    std::shared_ptr<FileWriter> files_;
     hms::AppConfig config_;
 
     mutable std::mutex events_mutex_;
-    std::unordered_map<std::string, std::unique_ptr<ActiveEvent>> active_events_;
-    std::vector<std::thread> orphaned_threads_;
+    std::unordered_map<std::string, std::shared_ptr<ActiveEvent>> active_events_;
 
     mutable std::mutex paused_mutex_;
     std::unordered_map<std::string, bool> paused_cameras_;
 
-    void joinOrphanedThreads();
-
     std::atomic<bool> running_{false};
+
+    std::unique_ptr<MqttPublisher> publisher_;  // null without MQTT
+    std::unique_ptr<EventExecutor> executor_;  // stopped first: its tasks use the members above
 };
 
 }  // namespace hms
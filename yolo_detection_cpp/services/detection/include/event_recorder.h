@@ -1,6 +1,9 @@
 #pragma once
 
+#include "file_writer.h"
 #include "frame_data.h"
+#include "metrics.h"
+#include "packet_ring.h"
 
 #include <memory>
 #include <string>
@@ -16,11 +19,27 @@ extern "C" {
 
 namespace hms {
 
-/// Records BGR24 frames to H.264 MP4 using libavcodec/libavformat.
-/// Supports pre-roll frames, post-roll timer, and max duration cap.
+/// Records an event to MP4, either by remuxing the camera's compressed packets
+/// (passthrough: no decode, no encode, camera quality) or by encoding BGR24
+/// frames with libx264 (transcode: needed when frames are modified, e.g.
+/// burned-in boxes). Supports pre-roll, post-roll timer, and max duration cap.
+///
+/// Fragmented MP4 (the default) writes a fragment per keyframe, so the file
+/// is playable while it grows and finalize() only appends the last fragment.
+/// Given a FileWriter, the muxer's output is queued to it instead of written
+/// inline, optionally under a staging directory it is moved out of once closed.
 class EventRecorder {
 public:
+    enum class Mode { Transcode, Passthrough };
+
+    struct Output {
+        std::shared_ptr<FileWriter> files;  // null: the muxer writes inline
+        bool fragmented = true;             // false: faststart (moov rewritten at the end, always inline)
+        std::string staging_dir;            // with `files`: written here, moved to output_dir when done
+    };
+
     EventRecorder();
+    explicit EventRecorder(Output output);
     ~EventRecorder();
 
     EventRecorder(const EventRecorder&) = delete;
@@ -33,15 +52,38 @@ public:
                int width, int height, int fps = 10,
                const std::string& output_dir = "/mnt/ssd/events");
 
-    /// Write a single BGR24 frame
+    /// Start a passthrough recording of `stream`, remuxing `preroll` (which must
+    /// begin on a keyframe) immediately. Fails if the codec can't go into MP4
+    /// as-is; the caller then falls back to start().
+    bool startPassthrough(const std::string& camera_id,
+                          const PacketRing::StreamInfo& stream,
+                          const std::vector<PacketRing::Entry>& preroll,
+                          const std::string& output_dir = "/mnt/ssd/events");
+
+    /// Whether packets of this stream can be remuxed into MP4 unchanged
+    static bool canRemux(const PacketRing::StreamInfo& stream);
+
+    /// Write a single BGR24 frame (transcode mode)
     bool writeFrame(const FrameData& frame);
 
+    /// Remux one compressed packet (passthrough mode). Packets from another
+    /// connection generation are rejected: the file's codec parameters are fixed.
+    bool writePacket(const PacketRing::Entry& entry);
+
+    /// Last packet sequence written (passthrough mode)
+    uint64_t lastSeq() const { return last_seq_; }
+
+    Mode mode() const { return mode_; }
+
     /// Request stop with post-roll seconds. Recording continues for duration.
     void requestStop(int post_roll_seconds = 5);
 
     /// Flush encoder, write trailer, close file. Returns true on success.
     bool finalize();
 
+    /// Delete the finalized file; with a FileWriter, queued behind its writes
+    bool discard();
+
     /// Full file path of the recording
     std::string filePath() const { return file_path_; }
 
@@ -57,7 +99,7 @@ public:
     /// Whether recording is active
     bool isRecording() const { return recording_; }
 
-    /// Number of frames written so far
+    /// Number of frames (or packets, in passthrough mode) written so far
     int framesWritten() const { return frames_written_; }
 
     /// Maximum recording duration in seconds
@@ -67,7 +109,22 @@ public:
     bool isMaxDurationReached() const;
 
 private:
-    void cleanup();
+    bool openOutput(const std::string& camera_id, const std::string& output_dir);
+    bool writeHeader();
+    /// Free the muxer and encoder and close the output. Only a finalized
+    /// recording is `publish`ed to file_path_; otherwise the partial file
+    /// (no header, or no frames) is deleted.
+    void cleanup(bool publish = false);
+    bool async() const { return output_.files && output_.fragmented; }
+    /// Where the muxer writes: the staging directory when set, else file_path_
+    std::string writePath() const;
+
+    /// AVIOContext write callback: queue the muxer's bytes to the FileWriter
+    static int queueWrite(void* opaque, const uint8_t* buf, int size);
+
+    Output output_;
+    FileWriter::FileId file_id_ = 0;  // open in output_.files, else 0
+    int64_t write_offset_ = 0;
 
     AVFormatContext* fmt_ctx_ = nullptr;
     AVCodecContext* enc_ctx_ = nullptr;
@@ -78,6 +135,7 @@ private:
 
     std::string file_path_;
     std::string camera_id_;
+    Metrics::Histogram* write_metric_ = nullptr;  // set with camera_id_
     int width_ = 0, height_ = 0, fps_ = 10;
     int frames_written_ = 0;
     int64_t pts_ = 0;
@@ -85,6 +143,17 @@ private:
     bool stop_requested_ = false;
     SteadyClock::time_point stop_requested_time_;
     int post_roll_seconds_ = 5;
+
+    // Passthrough state
+    Mode mode_ = Mode::Transcode;
+    AVRational src_time_base_{1, 90000};
+    uint64_t generation_ = 0;
+    uint64_t last_seq_ = 0;
+    int64_t ts_offset_ = AV_NOPTS_VALUE;   // first packet's dts, rebased to 0
+    int64_t last_dts_ = AV_NOPTS_VALUE;    // in stream_->time_base
+    SteadyClock::time_point first_arrival_{};
+    double written_seconds_ = 0;
+    bool generation_warned_ = false;
 };
 
 }  // namespace hms
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+
+namespace hms {
+
+/// Write-behind file I/O for event recordings and snapshots.
+///
+/// Producers queue opens, positioned writes, closes and whole-file writes and
+/// move on; one writer thread applies them in submission order with plain
+/// pwrite(2), so a slow disk or NAS mount holds up only this thread. A file
+/// may be written under a staging path (e.g. on tmpfs) and moved to its final
+/// path when it is closed; across filesystems the move is a copy to
+/// `<final>.part`, a rename and an unlink. Whole-file writes go through
+/// `<path>.part` too, so readers never see half a JPEG.
+///
+/// Producers only wait when `queue_bytes` of data is already in flight, i.e.
+/// when storage has been slower than the cameras for a while. A file whose
+/// open or write fails is logged once; its remaining writes are dropped.
+/// Stop it after everything that writes through it.
+class FileWriter {
+public:
+    using FileId = uint64_t;
+
+    struct Options {
+        size_t queue_bytes = 64u << 20;  // data in flight before producers wait
+    };
+
+    struct Stats {
+        size_t queued_bytes = 0;
+        size_t queued_ops = 0;
+        uint64_t bytes_written = 0;
+        uint64_t files_closed = 0;       // incl. whole-file writes
+        uint64_t moves = 0;              // staged files moved to their final path
+        uint64_t failures = 0;           // failed opens, writes, closes and moves
+        uint64_t producer_waits = 0;     // times a producer found the queue full
+        double max_op_ms = 0;            // slowest single operation
+    };
+
+    FileWriter();
+    explicit FileWriter(Options options);
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /// Create (truncate) `path` for writing. Returns the id for write()/close().
+    FileId open(std::string path);
+
+    /// Write `data` at `offset` of an open file
+    void write(FileId file, int64_t offset, std::string data);
+
+    /// Close the file; if `final_path` is set, move it there afterwards
+    void close(FileId file, std::string final_path = {});
+
+    /// Write a whole file from memory; visible at `path` once complete
+    void writeFile(std::string path, std::shared_ptr<const std::string> data);
+
+    /// Delete `path` after everything queued before it
+    void remove(std::string path);
+
+    /// Contents of a whole-file write to `path` not yet on disk, else null
+    std::shared_ptr<const std::string> pending(const std::string& path) const;
+
+    /// Where the file that closes into `final_path` is while its move is
+    /// queued (its staging path), else `final_path`
+    std::string locate(const std::string& final_path) const;
+
+    /// Wait until everything queued so far is done
+    void flush();
+
+    /// Finish what's queued, then stop. Idempotent.
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Open { FileId file; std::string path; };
+    struct Write { FileId file; int64_t offset; std::string data; };
+    struct Close { FileId file; std::string final_path; };
+    struct WriteFile { std::string path; std::shared_ptr<const std::string> data; };
+    struct Remove { std::string path; };
+    using Op = std::variant<Open, Write, Close, WriteFile, Remove>;
+
+    struct Handle {
+        int fd = -1;
+        std::string path;
+        bool failed = false;
+    };
+
+    void submit(Op op, size_t bytes);
+    void run();
+    void apply(Op& op);
+    bool move(const std::string& from, const std::string& to);
+
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;        // writer: work queued or stopping
+    std::condition_variable space_cv_;  // producers: bytes freed; flush(): done_ advanced
+    std::deque<std::pair<Op, size_t>> queue_;
+    size_t queued_bytes_ = 0;
+    uint64_t submitted_ = 0, done_ = 0;
+    FileId next_file_ = 1;
+    bool stopping_ = false;
+    bool exited_ = false;               // writer thread done
+    std::unordered_map<std::string, std::shared_ptr<const std::string>> pending_files_;
+    std::unordered_map<std::string, std::string> staged_;  // final path -> staging path
+    std::unordered_map<FileId, std::string> open_paths_;    // until the close is done
+    Stats stats_;
+
+    std::unordered_map<FileId, Handle> handles_;  // writer thread only
+    std::thread writer_;
+};
+
+}  // namespace hms
@@ -1,84 +1,425 @@
 #pragma once
 
+#include "pixel_arena.h"
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <utility>
 #include <vector>
 
 namespace hms {
 
 using SteadyClock = std::chrono::steady_clock;
 
+/// Planes of a YUV 4:2:0 picture, for consumers that convert it themselves
+/// (GPU letterbox). Chroma planes are half size in both axes.
+struct YuvPlanes {
+    enum class Layout { I420, Nv12 };
+    Layout layout = Layout::I420;
+    const uint8_t* data[3] = {};  // Y, then U and V (I420) or interleaved UV (NV12)
+    int stride[3] = {};
+    bool full_range = false;      // JPEG range (yuvj420p); else BT.601 limited, like sws
+};
+
+/// Decoder output held in its native format (e.g. a YUV/NV12 AVFrame ref)
+/// until a consumer needs BGR pixels. Implemented by RtspCapture.
+class NativeFrame {
+public:
+    virtual ~NativeFrame() = default;
+
+    /// Convert into a BGR24 buffer of the frame's size
+    virtual bool toBgr(uint8_t* dst, int stride) = 0;
+
+    /// Drop the reference to the decoder's buffer
+    virtual void release() = 0;
+
+    /// Luma plane of the picture, if the native format has one (planar or
+    /// semi-planar YUV); valid until release(). Sets `stride` in bytes.
+    virtual const uint8_t* luma(int& stride) {
+        (void)stride;
+        return nullptr;
+    }
+
+    /// All planes, if the picture is 4:2:0 (I420 or NV12) in host memory;
+    /// valid until release()
+    virtual bool yuv420(YuvPlanes& planes) {
+        (void)planes;
+        return false;
+    }
+};
+
+/// Pixel storage with a vector-like interface. Pool frames keep their bytes
+/// in the pool's PixelArena slot; copies, and frames the arena can't serve,
+/// own a heap buffer. Contents are not preserved when resize() has to move
+/// to a different storage.
+class PixelBuffer {
+public:
+    PixelBuffer() = default;
+    PixelBuffer(const PixelBuffer& other) { *this = other; }
+    PixelBuffer(PixelBuffer&& other) noexcept { *this = std::move(other); }
+
+    /// Copies always land in this buffer's own storage (heap for non-pool frames)
+    PixelBuffer& operator=(const PixelBuffer& other) {
+        if (this != &other) {
+            resize(other.size_);
+            std::copy(other.begin(), other.end(), begin());
+        }
+        return *this;
+    }
+    PixelBuffer& operator=(PixelBuffer&& other) noexcept {
+        if (this != &other) {
+            heap_ = std::move(other.heap_);
+            arena_ = std::exchange(other.arena_, nullptr);
+            slot_ = other.slot_;
+            external_ = std::exchange(other.external_, nullptr);
+            external_bytes_ = std::exchange(other.external_bytes_, 0);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    /// Serve this buffer from `arena` slot `slot` (pool construction only)
+    void useArena(PixelArena* arena, size_t slot) {
+        arena_ = arena;
+        slot_ = slot;
+    }
+
+    void resize(size_t n) {
+        if (!external_ && arena_ && n > 0) {
+            external_ = arena_->slot(slot_, n);
+            external_bytes_ = external_ ? arena_->slotBytes() : 0;
+            if (!external_) arena_ = nullptr;  // don't ask again
+        }
+        if (external_ && n > external_bytes_) {
+            external_ = nullptr;  // outgrew the slot: heap from now on
+            arena_ = nullptr;
+        }
+        if (!external_) heap_.resize(n);
+        size_ = n;
+    }
+
+    void clear() { size_ = 0; }
+
+    uint8_t* data() { return external_ ? external_ : heap_.data(); }
+    const uint8_t* data() const { return external_ ? external_ : heap_.data(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool inArena() const { return external_ != nullptr; }
+
+    uint8_t& operator[](size_t i) { return data()[i]; }
+    const uint8_t& operator[](size_t i) const { return data()[i]; }
+    uint8_t* begin() { return data(); }
+    uint8_t* end() { return data() + size_; }
+    const uint8_t* begin() const { return data(); }
+    const uint8_t* end() const { return data() + size_; }
+
+private:
+    std::vector<uint8_t> heap_;
+    PixelArena* arena_ = nullptr;
+    size_t slot_ = 0;
+    uint8_t* external_ = nullptr;  // arena storage, not owned
+    size_t external_bytes_ = 0;
+    size_t size_ = 0;
+};
+
 struct FrameData {
-    std::vector<uint8_t> pixels;  // BGR24 interleaved
+    PixelBuffer pixels;           // BGR24 interleaved; call ensureBgr() before reading
     int width = 0;
     int height = 0;
-    int stride = 0;               // bytes per row (width * 3 for BGR24)
+    int stride = 0;               // bytes per row (width * 3 for BGR24, rounded up to row_alignment)
+    int row_alignment = 1;        // pool frames in an arena: PixelArena::kRowAlignment
     SteadyClock::time_point timestamp;
     uint64_t frame_number = 0;
 
+    static int alignedStride(int w, int alignment) {
+        int bytes = w * 3;
+        return alignment > 1 ? (bytes + alignment - 1) / alignment * alignment : bytes;
+    }
+
     void resize(int w, int h) {
         width = w;
         height = h;
-        stride = w * 3;
+        stride = alignedStride(w, row_alignment);
         pixels.resize(static_cast<size_t>(stride) * h);
     }
+
+    // --- Decode-on-demand ---
+    // Capture stores the decoded frame natively and marks `pixels` stale;
+    // the first consumer that needs BGR converts it, everyone else reuses it.
+
+    /// Adapter kept across pool reuse so capture can refill it without allocating
+    NativeFrame* native() const { return lazy_ ? lazy_->native.get() : nullptr; }
+
+    /// Take ownership of a native-frame adapter (once per pooled frame)
+    void attachNative(std::unique_ptr<NativeFrame> native) {
+        if (!lazy_) lazy_ = std::make_unique<Lazy>();
+        lazy_->native = std::move(native);
+    }
+
+    /// The attached adapter now holds a w x h picture; `pixels` is stale until ensureBgr()
+    void markNative(int w, int h) {
+        width = w;
+        height = h;
+        stride = alignedStride(w, row_alignment);
+        if (lazy_) lazy_->pending.store(true, std::memory_order_release);
+    }
+
+    /// Make `pixels` valid, converting from the native frame at most once.
+    /// Safe to call from several consumer threads. False if there are no pixels.
+    bool ensureBgr() const {
+        if (lazy_ && lazy_->pending.load(std::memory_order_acquire)) {
+            std::lock_guard lock(lazy_->mutex);
+            if (lazy_->pending.load(std::memory_order_relaxed)) {
+                auto& out = const_cast<PixelBuffer&>(pixels);
+                out.resize(static_cast<size_t>(stride) * height);
+                bool ok = lazy_->native && lazy_->native->toBgr(out.data(), stride);
+                if (!ok) out.clear();
+                if (lazy_->native) lazy_->native->release();  // BGR is all anyone needs now
+                lazy_->pending.store(false, std::memory_order_release);
+            }
+        }
+        return !pixels.empty() && width > 0 && height > 0;
+    }
+
+    /// Call fn(const uint8_t* y, int stride) on the decoder's luma plane,
+    /// without converting. False (fn not called) once BGR has been produced,
+    /// or if the native format has no Y plane.
+    template <typename Fn>
+    bool withLuma(Fn&& fn) const {
+        if (!isPendingBgr()) return false;
+        std::lock_guard lock(lazy_->mutex);  // ensureBgr() releases the native ref
+        if (!lazy_->pending.load(std::memory_order_relaxed) || !lazy_->native) return false;
+        int y_stride = 0;
+        const uint8_t* y = lazy_->native->luma(y_stride);
+        if (!y) return false;
+        fn(y, y_stride);
+        return true;
+    }
+
+    /// Call fn(const YuvPlanes&) on the decoder's 4:2:0 planes, without
+    /// converting. Same conditions as withLuma().
+    template <typename Fn>
+    bool withYuv420(Fn&& fn) const {
+        if (!isPendingBgr()) return false;
+        std::lock_guard lock(lazy_->mutex);
+        if (!lazy_->pending.load(std::memory_order_relaxed) || !lazy_->native) return false;
+        YuvPlanes planes;
+        if (!lazy_->native->yuv420(planes)) return false;
+        fn(planes);
+        return true;
+    }
+
+    /// True while the BGR conversion has not happened yet
+    bool isPendingBgr() const {
+        return lazy_ && lazy_->pending.load(std::memory_order_acquire);
+    }
+
+    /// Drop any native reference (frame returned to the pool)
+    void releaseNative() {
+        if (!lazy_) return;
+        std::lock_guard lock(lazy_->mutex);
+        if (lazy_->native) lazy_->native->release();
+        lazy_->pending.store(false, std::memory_order_release);
+    }
+
+private:
+    struct Lazy {
+        std::mutex mutex;
+        std::atomic<bool> pending{false};
+        std::unique_ptr<NativeFrame> native;
+    };
+    std::unique_ptr<Lazy> lazy_;  // null for frames that only ever hold BGR
 };
 
 /// Pre-allocates N FrameData objects and recycles them via shared_ptr custom deleter.
 /// Avoids malloc/free churn during steady-state capture.
+///
+/// Lock-free: free frames sit on a Treiber stack (tagged index, ABA-safe).
+/// Each slot also embeds the storage for its shared_ptr control block, handed
+/// out through a slot allocator, so acquire() never touches the heap; the
+/// slot goes back on the stack when the control block is freed.
+///
+/// With a PixelArena, the pooled frames' pixels are carved out of one
+/// mapping (huge pages, 64-byte rows) instead of separate heap buffers.
+///
+/// `capacity` is a soft limit: when it's exhausted the pool may lend up to
+/// `max_spill` extra heap-allocated frames so consumers can hold on to
+/// buffered frames (an event keeping its preroll and best frame) without
+/// starving capture. Spilled frames are freed when they come back.
 class FramePool {
 public:
-    explicit FramePool(size_t capacity)
-        : capacity_(capacity) {
+    struct Stats {
+        size_t capacity = 0;
+        size_t available = 0;
+        size_t in_use = 0;
+        size_t spilled = 0;        // frames currently lent beyond capacity
+        size_t peak_in_use = 0;    // high-water mark, spill included
+        uint64_t spill_allocs = 0; // lifetime count of frames lent beyond capacity
+        uint64_t exhausted = 0;    // acquire() calls that returned nullptr
+    };
+
+    explicit FramePool(size_t capacity, size_t max_spill = 0,
+                       std::unique_ptr<PixelArena> arena = nullptr)
+        : capacity_(capacity)
+        , max_spill_(max_spill)
+        , arena_(std::move(arena))
+        , slots_(std::make_unique<Slot[]>(capacity)) {
         for (size_t i = 0; i < capacity_; ++i) {
-            free_list_.push(std::make_unique<FrameData>());
+            slots_[i].index = static_cast<uint32_t>(i);
+            if (arena_) {
+                slots_[i].frame.pixels.useArena(arena_.get(), i);
+                slots_[i].frame.row_alignment = PixelArena::kRowAlignment;
+            }
+            push(&slots_[i]);
         }
     }
 
-    /// Acquire a frame from the pool. Returns nullptr if exhausted.
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /// Acquire a frame from the pool. Returns nullptr if exhausted (spill included).
     /// The returned shared_ptr automatically recycles back to the pool on destruction.
     std::shared_ptr<FrameData> acquire() {
-        std::unique_ptr<FrameData> frame;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (free_list_.empty()) return nullptr;
-            frame = std::move(free_list_.front());
-            free_list_.pop();
+        Slot* slot = pop();
+        if (!slot) {
+            if (spilled_.fetch_add(1) >= max_spill_) {
+                spilled_.fetch_sub(1);
+                exhausted_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            spill_allocs_.fetch_add(1, std::memory_order_relaxed);
+            slot = new Slot();  // only when over capacity
         }
 
-        // Custom deleter recycles frame back to pool
-        auto* pool = this;
-        auto* raw = frame.release();
-        return std::shared_ptr<FrameData>(raw, [pool](FrameData* f) {
-            pool->recycle(std::unique_ptr<FrameData>(f));
-        });
+        size_t in_use = in_use_.fetch_add(1) + 1;
+        size_t peak = peak_in_use_.load(std::memory_order_relaxed);
+        while (in_use > peak && !peak_in_use_.compare_exchange_weak(peak, in_use)) {}
+
+        return std::shared_ptr<FrameData>(&slot->frame, Recycle{}, SlotAllocator<FrameData>{this, slot});
     }
 
     size_t capacity() const { return capacity_; }
 
+    /// Pixel arena of the pooled frames, null if they use the heap
+    const PixelArena* arena() const { return arena_.get(); }
+
     size_t available() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return free_list_.size();
+        size_t used = in_use_.load();
+        size_t spilled = spilled_.load();
+        size_t fixed_in_use = used > spilled ? used - spilled : 0;
+        return fixed_in_use >= capacity_ ? 0 : capacity_ - fixed_in_use;
     }
 
-    size_t in_use() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return capacity_ - free_list_.size();
+    size_t in_use() const { return in_use_.load(); }
+
+    Stats stats() const {
+        return Stats{
+            .capacity = capacity_,
+            .available = available(),
+            .in_use = in_use_.load(),
+            .spilled = spilled_.load(),
+            .peak_in_use = peak_in_use_.load(),
+            .spill_allocs = spill_allocs_.load(),
+            .exhausted = exhausted_.load(),
+        };
     }
 
 private:
-    void recycle(std::unique_ptr<FrameData> frame) {
-        frame->frame_number = 0;
-        std::lock_guard<std::mutex> lock(mutex_);
-        free_list_.push(std::move(frame));
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr uint32_t kSpill = UINT32_MAX - 1;
+    static constexpr size_t kControlBlockBytes = 64;
+
+    struct Slot {
+        FrameData frame;
+        alignas(std::max_align_t) unsigned char control[kControlBlockBytes];
+        uint32_t index = kSpill;             // position in slots_, kSpill for heap frames
+        std::atomic<uint32_t> next{kNil};    // free-stack link
+    };
+
+    /// Runs when the last reference drops: reset what the next user must not see
+    struct Recycle {
+        void operator()(FrameData* f) const {
+            f->frame_number = 0;
+            f->releaseNative();
+        }
+    };
+
+    /// Places the control block inside the slot; freeing it returns the slot
+    template <typename T>
+    struct SlotAllocator {
+        using value_type = T;
+
+        FramePool* pool;
+        Slot* slot;
+
+        SlotAllocator(FramePool* p, Slot* s) : pool(p), slot(s) {}
+        template <typename U>
+        SlotAllocator(const SlotAllocator<U>& other) : pool(other.pool), slot(other.slot) {}
+
+        T* allocate(size_t n) {
+            static_assert(sizeof(T) <= kControlBlockBytes, "control block does not fit its slot");
+            static_assert(alignof(T) <= alignof(std::max_align_t));
+            (void)n;  // shared_ptr always allocates exactly one control block
+            return reinterpret_cast<T*>(slot->control);
+        }
+
+        // Called after the control block is destroyed: nothing touches the slot after this
+        void deallocate(T*, size_t) { pool->release(slot); }
+
+        template <typename U>
+        bool operator==(const SlotAllocator<U>& other) const { return slot == other.slot; }
+    };
+
+    void release(Slot* slot) {
+        in_use_.fetch_sub(1);
+        if (slot->index == kSpill) {
+            delete slot;
+            spilled_.fetch_sub(1);
+            return;
+        }
+        push(slot);
+    }
+
+    // Treiber stack over slot indices; the high 32 bits of head_ are an ABA tag
+    void push(Slot* slot) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            slot->next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | slot->index;
+        } while (!head_.compare_exchange_weak(head, next, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    Slot* pop() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        for (;;) {
+            auto index = static_cast<uint32_t>(head);
+            if (index == kNil) return nullptr;
+            uint32_t after = slots_[index].next.load(std::memory_order_relaxed);
+            uint64_t next = ((head >> 32) + 1) << 32 | after;
+            if (head_.compare_exchange_weak(head, next, std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return &slots_[index];
+            }
+        }
     }
 
-    size_t capacity_;
-    mutable std::mutex mutex_;
-    std::queue<std::unique_ptr<FrameData>> free_list_;
+    const size_t capacity_;
+    const size_t max_spill_;
+    std::unique_ptr<PixelArena> arena_;  // declared first: outlives the frames using it
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_{kNil};
+    std::atomic<size_t> in_use_{0};
+    std::atomic<size_t> spilled_{0};
+    std::atomic<size_t> peak_in_use_{0};
+    std::atomic<uint64_t> spill_allocs_{0};
+    std::atomic<uint64_t> exhausted_{0};
 };
 
 }  // namespace hms
@@ -4,6 +4,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <functional>
 
 namespace hms {
 
@@ -13,8 +14,34 @@ namespace hms {
 /// Design: Events always have priority. When an event starts, periodic
 /// LLaVA/moondream inference should abort quickly so Ollama can evict
 /// moondream and load LLaVA for event context.
+///
+/// The YOLO session stays resident between events; it is only evicted when
+/// someone calls requestVram() before loading a model that needs the space.
 class GpuCoordinator {
 public:
+    /// Installed by main once the detection model is loaded. Returns true if
+    /// the handler actually freed VRAM (false if the session was pinned or absent).
+    void setEvictionHandler(std::function<bool()> handler) {
+        std::lock_guard lock(handler_mutex_);
+        eviction_handler_ = std::move(handler);
+    }
+
+    /// Ask resident models to give up VRAM, e.g. before LLaVA loads.
+    /// Returns true if anything was evicted.
+    bool requestVram() {
+        std::function<bool()> handler;
+        {
+            std::lock_guard lock(handler_mutex_);
+            handler = eviction_handler_;
+        }
+        vram_requests_.fetch_add(1, std::memory_order_relaxed);
+        return handler && handler();
+    }
+
+    uint64_t vramRequests() const {
+        return vram_requests_.load(std::memory_order_relaxed);
+    }
+
     /// Called by EventManager when a motion event begins processing.
     /// Periodic snapshot LLaVA calls should check abort flag and bail out.
     void eventStarted() {
@@ -49,6 +76,10 @@ public:
 private:
     std::atomic<bool> event_active_{false};
     std::atomic<bool> abort_periodic_{false};
+    std::atomic<uint64_t> vram_requests_{0};
+
+    std::mutex handler_mutex_;
+    std::function<bool()> eviction_handler_;
 };
 
 }  // namespace hms
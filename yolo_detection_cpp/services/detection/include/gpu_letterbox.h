@@ -0,0 +1,58 @@
+#pragma once
+
+#include "frame_data.h"
+#include "letterbox.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace hms {
+
+/// letterboxToTensor() on a CUDA device. The source picture (YUV 4:2:0
+/// planes straight from the decoder, or BGR24) is uploaded once and a kernel
+/// resizes, pads, converts to RGB, normalizes and writes the NCHW tensor
+/// (FP32 or FP16) into device memory an ORT session binds as its input.
+/// Sampling uses the plan's own index tables, so BGR sources give the same
+/// tensor as the CPU path; YUV sources take chroma from the nearest sample.
+///
+/// Work is queued on the instance's own stream; synchronize() before the
+/// session reads the tensor. One instance per binding slot: not thread-safe.
+/// Built only with HMS_CUDA_PREPROCESS; otherwise available() is false.
+class GpuLetterbox {
+public:
+    /// A usable device `device` in this build
+    static bool available(int device);
+
+    /// Throws std::runtime_error if the device or stream can't be set up
+    explicit GpuLetterbox(int device);
+    ~GpuLetterbox();
+
+    GpuLetterbox(const GpuLetterbox&) = delete;
+    GpuLetterbox& operator=(const GpuLetterbox&) = delete;
+
+    /// Device tensor of at least `bytes`; moves (and loses its contents) when it grows
+    void* reserveTensor(size_t bytes);
+
+    /// Letterbox `region` of a 4:2:0 picture into `dst` (device memory,
+    /// [3, dst_h, dst_w]). `plan` is for the region's size.
+    bool fromYuv(const std::shared_ptr<const LetterboxPlan>& plan, const YuvPlanes& src,
+                 const Region& region, void* dst, bool fp16);
+
+    /// Same for a BGR24 picture
+    bool fromBgr(const std::shared_ptr<const LetterboxPlan>& plan, const uint8_t* src, int stride,
+                 const Region& region, void* dst, bool fp16);
+
+    /// Gray padding only, for an input whose picture went away
+    bool fill(int dst_w, int dst_h, void* dst, bool fp16);
+
+    /// Wait for everything queued; false if any of it failed
+    bool synchronize();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace hms
@@ -0,0 +1,40 @@
+#pragma once
+
+// Launchers for the GpuLetterbox kernels (src/gpu_letterbox_kernels.cu).
+// Only included by CUDA builds (HMS_CUDA_PREPROCESS).
+
+#include <cuda_runtime_api.h>
+
+#include <cstdint>
+
+namespace hms::cuda {
+
+/// A LetterboxPlan's geometry with its index tables in device memory
+struct DevicePlan {
+    int dst_w = 0, dst_h = 0;
+    int new_w = 0, new_h = 0;
+    int pad_left = 0, pad_top = 0;
+    bool bilinear = false;
+    const int32_t* x0 = nullptr;  // BGR byte offsets (column * 3), as on the host
+    const int32_t* x1 = nullptr;
+    const int32_t* y0 = nullptr;
+    const int32_t* y1 = nullptr;
+    const int16_t* wx = nullptr;  // Q11, bilinear only
+    const int16_t* wy = nullptr;
+};
+
+/// Source picture in device memory, cropped to the region
+struct DeviceSource {
+    enum class Format { Bgr, I420, Nv12 };
+    Format format = Format::Bgr;
+    const uint8_t* data[3] = {};
+    int stride[3] = {};
+    int chroma_x = 0, chroma_y = 0;  // region origin parity: luma (x, y) has chroma ((x + cx) / 2, ...)
+    bool full_range = false;
+};
+
+/// Write the whole [3, dst_h, dst_w] tensor: picture inside, 114 gray around
+cudaError_t letterbox(const DevicePlan& plan, const DeviceSource& src, void* dst, bool fp16,
+                      cudaStream_t stream);
+
+}  // namespace hms::cuda
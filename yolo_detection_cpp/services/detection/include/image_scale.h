@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hms {
+
+/// Size of a width-`max_width` rendition of a w x h image, keeping the aspect
+/// ratio. Never upscales: max_width <= 0 or >= w gives w x h.
+void scaledSize(int w, int h, int max_width, int& out_w, int& out_h);
+
+/// Area (box) downscale of a BGR24 image: each destination pixel is the
+/// rounded mean of the source pixels it covers, so fine detail averages out
+/// instead of aliasing. One pass over the source, integer arithmetic only.
+/// dst_w/dst_h must not exceed src_w/src_h.
+void downscaleArea(const uint8_t* src, int src_w, int src_h, int src_stride,
+                   uint8_t* dst, int dst_w, int dst_h, int dst_stride);
+
+}  // namespace hms
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "detection_engine.h"
+#include "engine_pool.h"
+#include "frame_data.h"
+#include "pipeline_config.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hms {
+
+/// Collects detection requests from every camera and dispatches them to the
+/// shared engines in batches, so N cameras cost one Session::Run instead of
+/// N serialized ones.
+///
+/// A batch is dispatched when it reaches max_batch_size or when its oldest
+/// request has waited max_wait_ms. Event requests jump the queue and are
+/// dispatched without waiting for the deadline.
+///
+/// There is one dispatch thread per session of the EnginePool, all pulling
+/// from the same queues: a batch goes to whichever session is free, so load
+/// spreads across devices without any explicit assignment. Each dispatch
+/// thread also drives its engine's idle-TTL unload.
+///
+/// With pipeline_depth > 1 each session is a three-stage pipeline: the
+/// dispatch thread preprocesses a batch into one of the engine's binding
+/// slots, an inference thread runs it, and a postprocess thread decodes it
+/// and resolves the futures. Consecutive batches overlap, so a session's
+/// throughput is bound by its slowest stage rather than the sum of all three.
+/// The engine's slot count bounds the pipeline.
+class InferenceScheduler {
+public:
+    enum class Priority { Event, Continuous };
+
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t batches = 0;
+        uint64_t event_requests = 0;
+        double avg_batch_size = 0;
+        size_t max_batch_size = 0;
+        size_t queue_depth = 0;
+
+        struct Session {
+            int device = -1;          // CUDA device, -1 = CPU
+            int threads = 0;
+            ExecutionProvider provider = ExecutionProvider::Cpu;  // active when loaded
+            Precision precision = Precision::Fp32;
+            bool loaded = false;
+            bool gpu_preprocess = false;  // inputs letterboxed on the device
+            uint64_t batches = 0;
+            uint64_t frames = 0;
+            double preprocess_ms = 0;   // total per stage
+            double busy_ms = 0;         // Session::Run
+            double postprocess_ms = 0;
+            double utilization = 0;     // Run-busy fraction over the last second
+        };
+        std::vector<Session> sessions;
+    };
+
+    InferenceScheduler(std::shared_ptr<EnginePool> engines, const SchedulerConfig& config);
+
+    /// Single-session convenience
+    InferenceScheduler(std::shared_ptr<DetectionEngine> engine, const SchedulerConfig& config);
+    ~InferenceScheduler();
+
+    InferenceScheduler(const InferenceScheduler&) = delete;
+    InferenceScheduler& operator=(const InferenceScheduler&) = delete;
+
+    void start();
+
+    /// Stop the dispatch threads. Requests still queued resolve to empty results.
+    void stop();
+
+    /// Queue a frame for detection. The frame is kept alive until the result is ready.
+    /// When the scheduler is not running the frame is detected inline.
+    std::future<std::vector<Detection>> submit(std::shared_ptr<FrameData> frame,
+                                               DetectParams params,
+                                               Priority priority = Priority::Continuous);
+
+    /// Callback form for callers that must not block (HTTP handlers): `done`
+    /// runs on a scheduler thread once the result is ready, inline when the
+    /// scheduler is not running. Keep it short; it delays the next batch.
+    void submit(std::shared_ptr<FrameData> frame, DetectParams params, Priority priority,
+                std::function<void(std::vector<Detection>)> done);
+
+    /// Primary engine (class table, input size)
+    std::shared_ptr<DetectionEngine> engine() const { return engines_ ? engines_->primary() : nullptr; }
+    std::shared_ptr<EnginePool> engines() const { return engines_; }
+    bool isRunning() const { return running_.load(); }
+    Stats stats() const;
+
+private:
+    static constexpr auto kResidencyCheckInterval = std::chrono::seconds(1);
+
+    struct Request {
+        std::shared_ptr<FrameData> frame;
+        DetectParams params;
+        std::promise<std::vector<Detection>> promise;
+        std::function<void(std::vector<Detection>)> done;  // replaces the promise when set
+        SteadyClock::time_point enqueued;
+
+        void resolve(std::vector<Detection> result) {
+            if (done) done(std::move(result));
+            else promise.set_value(std::move(result));
+        }
+    };
+
+    void enqueue(Request req, Priority priority);
+
+    /// A batch between pipeline stages, holding an engine binding slot
+    struct InFlight {
+        std::vector<Request> batch;
+        DetectionEngine::BatchJob job;
+    };
+
+    /// Hand-off between two stages; bounded by the engine's slots
+    class StageQueue {
+    public:
+        void push(InFlight item);
+        /// False once closed and drained
+        bool pop(InFlight& item);
+        void close();
+        void reopen();
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<InFlight> items_;
+        bool closed_ = false;
+    };
+
+    /// Per-session counters and pipeline; busy_ns is sampled into utilization once a second
+    struct SessionState {
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> preprocess_ns{0};
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<uint64_t> postprocess_ns{0};
+        std::atomic<double> utilization{0};
+
+        StageQueue to_infer;
+        StageQueue to_finish;
+        std::thread infer_thread;
+        std::thread finish_thread;
+    };
+
+    std::vector<Stats::Session> sessionStats() const;
+    void dispatchLoop(size_t session);
+    void inferLoop(size_t session);
+    void finishLoop(size_t session);
+
+    /// The three stages of one batch on `session`
+    InFlight prepare(std::vector<Request>& batch, size_t session);
+    void infer(InFlight& work, size_t session);
+    void finish(InFlight& work, size_t session);
+
+    /// All three stages on the calling thread
+    void runBatch(std::vector<Request>& batch, size_t session);
+
+    std::shared_ptr<EnginePool> engines_;
+    std::unique_ptr<SessionState[]> sessions_;
+    size_t max_batch_size_;
+    std::chrono::milliseconds max_wait_;
+    bool pipelined_;
+
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Request> event_queue_;
+    std::deque<Request> continuous_queue_;
+
+    std::atomic<bool> running_{false};
+    std::vector<std::thread> threads_;
+
+    // Stats
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> event_requests_{0};
+    std::atomic<uint64_t> frames_batched_{0};
+    std::atomic<size_t> largest_batch_{0};
+};
+
+}  // namespace hms
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace hms {
+
+/// BGR24 → JPEG for snapshots, the HTTP snapshot endpoint and periodic
+/// snapshots.
+///
+/// Built with libjpeg-turbo (HMS_HAVE_TURBOJPEG), BGR rows are compressed
+/// directly with no separate colour-conversion pass. Otherwise FFmpeg's MJPEG
+/// encoder is used behind a BGR→YUV420 swscale. Either way the encoder state
+/// is kept per thread and reused: a compressor handle and output buffer for
+/// libjpeg-turbo, or a few opened codec contexts with their scaler, YUV frame
+/// and packet, keyed by resolution and quality, for FFmpeg. A repeat encode at
+/// the same size allocates nothing but the caller's output growth.
+class JpegEncoder {
+public:
+    static constexpr int kDefaultQuality = 90;
+
+    struct Stats {
+        const char* backend = "";     // "turbojpeg" | "ffmpeg"
+        uint64_t encodes = 0;
+        uint64_t failures = 0;
+        uint64_t contexts_created = 0;  // encoder setups; stays flat in steady state
+        double avg_encode_ms = 0;
+    };
+
+    /// Encode into `out`, reusing its capacity. quality: 1-100. False on error.
+    static bool encode(const uint8_t* bgr, int width, int height, int stride,
+                       int quality, std::string& out);
+
+    /// Encoded bytes, or empty on error
+    static std::string encode(const uint8_t* bgr, int width, int height, int stride,
+                              int quality = kDefaultQuality);
+
+    /// One rendition of a multi-output encode
+    struct Output {
+        int max_width = 0;             // box-downscale to at most this width; 0 = full size
+        int quality = kDefaultQuality;
+        std::string jpeg;              // result; empty on error
+        int width = 0, height = 0;     // encoded size
+    };
+
+    /// Encode several renditions of one frame (e.g. full size + thumbnail) in
+    /// one pass: largest first, each smaller one downscaled from the previous
+    /// rendition rather than from the full frame. Scratch images are per
+    /// thread. True if every output was encoded.
+    static bool encode(const uint8_t* bgr, int width, int height, int stride,
+                       std::span<Output> outputs);
+
+    static Stats stats();
+};
+
+}  // namespace hms
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hms {
+
+enum class ResizeMode {
+    Nearest,   // fastest; matches the original scalar preprocess
+    Bilinear,  // half-pixel centers, same sampling as cv2.INTER_LINEAR (Ultralytics letterbox)
+};
+
+/// Rectangle of a source frame, in pixels
+struct Region {
+    int x = 0, y = 0, w = 0, h = 0;
+
+    bool operator==(const Region&) const = default;
+};
+
+/// Precomputed geometry and source index tables for letterboxing one source
+/// resolution into the model input. Built once per (source size, mode) and
+/// reused for every frame, so the per-pixel loop does no divides or rounding.
+struct LetterboxPlan {
+    int src_w = 0, src_h = 0;
+    int dst_w = 0, dst_h = 0;     // model input
+    int new_w = 0, new_h = 0;     // resized image inside the padding
+    int pad_left = 0, pad_top = 0;
+    float scale = 1.0f;
+    float pad_x = 0.0f, pad_y = 0.0f;
+    ResizeMode mode = ResizeMode::Nearest;
+
+    // Per destination column: byte offset of the left (and right) source pixel
+    std::vector<int32_t> x0, x1;
+    // Per destination row: top (and bottom) source row
+    std::vector<int32_t> y0, y1;
+    // Bilinear only: Q11 weight of the right/bottom neighbour
+    std::vector<int16_t> wx, wy;
+
+    static LetterboxPlan make(int src_w, int src_h, int dst_w, int dst_h, ResizeMode mode);
+};
+
+/// Letterbox a BGR24 image into an RGB NCHW float tensor [3, dst_h, dst_w],
+/// normalized to [0, 1] with 114 gray padding. Only padding cells are filled,
+/// the image area is written once.
+void letterboxToTensor(const LetterboxPlan& plan, const uint8_t* src, int src_stride, float* tensor);
+
+/// dst[i] = src[i] / 255 — AVX2 / SSE2 / NEON with scalar tail
+void normalizeU8(const uint8_t* src, float* dst, size_t n);
+
+}  // namespace hms
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "frame_data.h"
+#include "packet_ring.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace hms {
+
+class BufferService;
+
+/// Live view fan-out: one encode per camera frame per stream variant, shared
+/// by every viewer of that variant.
+///
+/// A variant is a multipart MJPEG stream at some JPEG quality, optionally with
+/// the latest DetectionResult's boxes drawn in, or fragmented MP4 remuxed from
+/// the camera's packet ring (the camera's own H.264/HEVC, never re-encoded).
+/// Each variant with viewers has one thread that waits for frames, encodes or
+/// muxes them once into a refcounted chunk and hands the same chunk to every
+/// subscriber. Its thread exits when the last viewer leaves.
+///
+/// Subscribers never block the stream: one whose client has `max_backlog`
+/// bytes still unsent misses frames until it catches up. MJPEG viewers just
+/// skip pictures. fMP4 viewers resume at the next keyframe, since the frames
+/// in between don't decode without the ones dropped. When nobody can take a
+/// frame it is not encoded at all.
+class LiveStream {
+public:
+    enum class Format { Mjpeg, Fmp4 };
+
+    struct Variant {
+        Format format = Format::Mjpeg;
+        int quality = 75;       // MJPEG only
+        bool annotate = false;  // MJPEG only: boxes from the camera's latest detection
+
+        auto key() const { return std::tie(format, quality, annotate); }
+        bool operator<(const Variant& other) const { return key() < other.key(); }
+    };
+
+    using Chunk = std::shared_ptr<const std::string>;
+
+    /// One viewer's connection. Called on the stream's thread; must not block.
+    class Subscriber {
+    public:
+        virtual ~Subscriber() = default;
+        /// Queue `chunk` for the client; false once the client has gone away
+        virtual bool send(const Chunk& chunk) = 0;
+        /// Bytes handed to send() that have not reached the socket yet
+        virtual size_t backlog() const = 0;
+        /// False once the client has gone away, even if no send() has failed
+        /// yet (a viewer too far behind is not sent to)
+        virtual bool connected() const = 0;
+    };
+
+    struct Options {
+        int quality = 75;                 // MJPEG quality when a viewer asks for none
+        int max_fps = 0;                  // MJPEG frame rate cap; 0 = every captured frame
+        size_t max_backlog = 1u << 20;    // unsent bytes before a viewer drops frames
+    };
+
+    struct Stats {
+        size_t streams = 0;           // variants being encoded
+        size_t subscribers = 0;
+        uint64_t frames_encoded = 0;  // JPEG encodes, or fMP4 fragments
+        uint64_t bytes_encoded = 0;
+        uint64_t chunks_sent = 0;     // chunks handed to viewers
+        uint64_t frames_dropped = 0;  // chunks a viewer missed for being behind
+        uint64_t frames_skipped = 0;  // frames nobody could take, never encoded
+    };
+
+    static constexpr const char* kBoundary = "hmsframe";
+
+    LiveStream(std::shared_ptr<BufferService> buffer_service, Options options);
+    ~LiveStream();
+
+    LiveStream(const LiveStream&) = delete;
+    LiveStream& operator=(const LiveStream&) = delete;
+
+    /// Camera is known and, for fMP4, keeps a packet ring
+    bool canServe(const std::string& camera_id, Format format) const;
+
+    /// Start sending `variant` of the camera to `subscriber`. False if the
+    /// camera can't be served or after stop().
+    bool subscribe(const std::string& camera_id, const Variant& variant,
+                   std::shared_ptr<Subscriber> subscriber);
+
+    /// Content-Type of a variant's HTTP response
+    static std::string contentType(const Variant& variant);
+
+    /// One multipart MJPEG part: boundary, headers, the JPEG and its CRLF
+    static std::string mjpegPart(const std::string& jpeg);
+
+    /// Drop every viewer and stop the streams. Idempotent.
+    void stop();
+
+    Stats stats() const;
+    const Options& options() const { return options_; }
+
+private:
+    /// Flags are touched only by the stream's thread
+    struct Viewer {
+        std::shared_ptr<Subscriber> subscriber;
+        bool gone = false;      // client went away; pruned on the next round
+        bool has_init = false;  // fMP4: init segment sent for the current muxer
+        bool synced = false;    // fMP4: receiving fragments since a keyframe
+    };
+
+    struct Stream {
+        std::string camera_id;
+        Variant variant;
+        std::vector<std::shared_ptr<Viewer>> viewers;  // guarded by LiveStream::mutex_
+        bool finished = false;  // thread is exiting; subscribe() replaces it
+        std::thread thread;
+    };
+
+    using Key = std::pair<std::string, Variant>;
+
+    void runMjpeg(Stream& stream);
+    void runFmp4(Stream& stream);
+
+    /// Prune departed or disconnected viewers and snapshot the rest. Empty
+    /// (and the stream marked finished) when none remain or the hub is stopping.
+    std::vector<std::shared_ptr<Viewer>> viewers(Stream& stream);
+
+    /// Send `chunk` to `viewer`; false (and marks it gone) if its client left
+    bool deliver(Viewer& viewer, const Chunk& chunk);
+
+    /// Has more than max_backlog bytes waiting to reach its client
+    bool behind(const Viewer& viewer) const;
+
+    std::shared_ptr<BufferService> buffer_service_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::map<Key, std::unique_ptr<Stream>> streams_;
+    bool stopping_ = false;
+    Stats stats_;
+};
+
+}  // namespace hms
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace hms {
+
+/// Process-wide latency histograms and counters for the pipeline's hot
+/// paths, rendered in Prometheus text format by /metrics.
+///
+/// A histogram is a fixed set of power-of-two buckets (8 µs .. 67 s) of
+/// relaxed atomic counters, so observe() is a bit_width and three
+/// fetch_adds with no lock. Timing starts with the first scrape (enabled()):
+/// until something reads /metrics, a timed site costs one relaxed load.
+/// Look a metric up once (it lives for the whole process) and keep the
+/// reference; the lookup itself takes a lock.
+class Metrics {
+public:
+    enum class Stage {
+        Decode,             // avcodec send_packet + receive_frame, per frame
+        Convert,            // YUV -> BGR24 sws_scale
+        BufferPush,         // handing a decoded frame to the camera buffer
+        Preprocess,         // letterbox into a binding slot, per batch
+        Inference,          // Session::Run, per batch
+        Postprocess,        // output decode + NMS, per batch
+        Nms,                // NMS of one frame's candidates
+        RecordWrite,        // EventRecorder::writeFrame
+        JpegEncode,
+        Vision,             // one LLaVA / moondream request
+        DbWrite,            // one DbWriter row
+        FileWrite,          // one FileWriter operation (write, close/move, whole file)
+        MotionToDetection,  // motion start -> first event detection
+        Count
+    };
+
+    enum class CounterId {
+        Events,             // motion events started
+        FramesDropped,      // decoded frames lost to an exhausted frame pool
+        Count
+    };
+
+    class Histogram {
+    public:
+        static constexpr int kBuckets = 24;  // upper bound of bucket k: 8 µs << k
+
+        void observe(std::chrono::nanoseconds elapsed);
+
+        /// Upper bound of bucket k in seconds
+        static double bound(int k) { return 8e-6 * static_cast<double>(uint64_t{1} << k); }
+
+        struct Snapshot {
+            std::array<uint64_t, kBuckets + 1> buckets{};  // per bucket (not cumulative); last = +Inf
+            double sum_seconds = 0;
+            uint64_t count = 0;
+
+            /// Add another histogram's counts (e.g. the same stage on every camera)
+            void merge(const Snapshot& other);
+            double meanSeconds() const { return count > 0 ? sum_seconds / static_cast<double>(count) : 0.0; }
+            /// Estimated q-quantile (0..1) in seconds, interpolated inside its
+            /// bucket; the +Inf bucket reports the last finite bound
+            double quantileSeconds(double q) const;
+        };
+        Snapshot snapshot() const;
+
+    private:
+        std::array<std::atomic<uint64_t>, kBuckets + 1> buckets_{};
+        std::atomic<uint64_t> sum_ns_{0};
+    };
+
+    class Counter {
+    public:
+        void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    /// Times a scope into `histogram` while metrics are enabled
+    class Timer {
+    public:
+        explicit Timer(Histogram& histogram) : histogram_(histogram), start_(Metrics::start()) {}
+        ~Timer() { Metrics::observe(histogram_, start_); }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Histogram& histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    /// `stage` for one camera; an empty camera means no label
+    static Histogram& histogram(Stage stage, const std::string& camera = "");
+    static Counter& counter(CounterId id, const std::string& camera = "");
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void enable() { enabled_.store(true, std::memory_order_relaxed); }
+
+    /// Start of a timed span: now, or a null time point while disabled
+    static std::chrono::steady_clock::time_point start() {
+        return enabled() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    }
+
+    /// Record the span begun at `since` (nothing if it began while disabled)
+    static void observe(Histogram& histogram, std::chrono::steady_clock::time_point since) {
+        if (since != std::chrono::steady_clock::time_point{}) {
+            histogram.observe(std::chrono::steady_clock::now() - since);
+        }
+    }
+
+    /// Every metric in Prometheus text exposition format 0.0.4. Enables timing.
+    static std::string render();
+
+    static const char* stageName(Stage stage);  // e.g. "hms_decode_seconds"
+
+private:
+    static inline std::atomic<bool> enabled_{false};
+};
+
+}  // namespace hms
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "frame_data.h"
+#include "letterbox.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+namespace hms {
+
+/// Cheap in-process scene-change detector, used to gate inference on
+/// static cameras.
+///
+/// Each frame is reduced to a coarse grid of mean luma values (a sparse
+/// sample per cell), read straight from the decoder's Y plane while the
+/// frame is still native, or from the BGR pixels otherwise. A frame counts
+/// as motion when enough cells differ by more than a luma threshold from a
+/// slowly-updated background of the scene, after removing the global
+/// brightness shift (auto-exposure, IR switch-over).
+class MotionDetector {
+public:
+    static constexpr int kCols = 32;
+    static constexpr int kRows = 18;
+
+    using CellMask = std::bitset<kCols * kRows>;
+
+    struct Options {
+        int cell_threshold = 12;    // mean-luma change (0-255) for a cell to count as changed
+        double min_changed = 0.01;  // fraction of cells that must change for motion
+    };
+
+    struct Result {
+        bool motion = false;
+        double changed = 0;  // fraction of cells that differ from the background
+    };
+
+    MotionDetector() = default;
+    explicit MotionDetector(Options options) : options_(options) {}
+
+    /// Compare `frame` with the background and fold it in. The first
+    /// frame, and the first after a resolution change, only seeds the
+    /// background. Frames without pixels are ignored.
+    Result update(const FrameData& frame);
+
+    /// Grid cells that differed from the background in the last update()
+    const CellMask& changedCells() const { return changed_; }
+
+    /// True if a set cell of `cells` overlaps `region` of a width x height frame
+    static bool touches(const CellMask& cells, const Region& region, int width, int height);
+
+    /// Mean-luma grid of `frame`, row-major; false if the frame has no pixels
+    static bool lumaGrid(const FrameData& frame, std::array<uint8_t, kCols * kRows>& grid);
+
+private:
+    Options options_;
+    std::array<uint16_t, kCols * kRows> background_{};  // mean luma x 16
+    CellMask changed_;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+}  // namespace hms
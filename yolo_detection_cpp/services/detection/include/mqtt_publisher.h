@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mqtt_client.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace hms {
+
+/// Outgoing MQTT queue with one sender thread.
+///
+/// publish() only queues the JSON message; serialization (into one buffer
+/// the sender reuses) and the broker call (which can stall on QoS 1 flow
+/// control or a reconnect) happen on the sender, never on an event thread. State messages published with
+/// `coalesce` replace a still-queued message on the same topic, so under
+/// backpressure only the latest per-camera result goes out. At most `queue`
+/// messages wait; beyond that the oldest is dropped and counted.
+class MqttPublisher {
+public:
+    /// Sends one message; may throw
+    using Transport = std::function<void(const std::string& topic, const std::string& payload,
+                                         int qos, bool retain)>;
+
+    struct Options {
+        int queue = 256;
+    };
+
+    struct Stats {
+        size_t queued = 0;
+        uint64_t published = 0;
+        uint64_t coalesced = 0;         // replaced before they were sent
+        uint64_t dropped = 0;           // queue full, or published after stop()
+        uint64_t failures = 0;          // transport threw
+        double avg_latency_ms = 0;      // publish() to broker ack
+        double max_latency_ms = 0;
+    };
+
+    MqttPublisher(std::shared_ptr<MqttClient> mqtt, Options options);
+    MqttPublisher(Transport transport, Options options);  // tests
+    ~MqttPublisher();
+
+    MqttPublisher(const MqttPublisher&) = delete;
+    MqttPublisher& operator=(const MqttPublisher&) = delete;
+
+    /// Queue a message. Never blocks on the broker.
+    void publish(std::string topic, nlohmann::json payload, bool coalesce = false,
+                 int qos = 1, bool retain = false);
+
+    /// Send what's queued, then stop. Idempotent.
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Message {
+        std::string topic;
+        nlohmann::json payload;
+        bool coalesce = false;
+        int qos = 1;
+        bool retain = false;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    void senderLoop();
+
+    Transport transport_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Message> queue_;
+    bool stopping_ = false;
+    Stats stats_;
+    int64_t latency_ns_total_ = 0;
+
+    std::thread sender_;
+};
+
+}  // namespace hms
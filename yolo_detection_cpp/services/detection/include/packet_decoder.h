@@ -0,0 +1,29 @@
+#pragma once
+
+#include "detection_engine.h"
+#include "frame_data.h"
+#include "packet_ring.h"
+
+#include <memory>
+#include <vector>
+
+namespace hms {
+
+/// One-off decodes out of a PacketRing. A dual-stream camera's main stream
+/// is kept compressed only (pipeline.streams); this is how a full-resolution
+/// picture is produced when something asks for one.
+class PacketDecoder {
+public:
+    /// The picture that arrived at `at` (see PacketRing::gopUntil) as BGR24,
+    /// decoded from its GOP's keyframe by a throwaway software decoder.
+    /// Null when the ring is empty or the stream doesn't decode.
+    static std::shared_ptr<FrameData> decodeAt(const PacketRing& ring, SteadyClock::time_point at);
+};
+
+/// Boxes from a from_w x from_h frame mapped onto a to_w x to_h frame of the
+/// same view, e.g. substream detections onto the main stream. Axes scale
+/// independently: some cameras squash 16:9 into a 4:3 substream.
+std::vector<Detection> scaleDetections(std::vector<Detection> detections,
+                                       int from_w, int from_h, int to_w, int to_h);
+
+}  // namespace hms
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "frame_data.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace hms {
+
+/// Compressed video packets from one camera, kept alongside the decoded
+/// frames so recordings can be remuxed without re-encoding.
+///
+/// The ring always starts on a keyframe and holds at least `window` of
+/// stream, so a preroll of that length can be cut at a GOP boundary.
+/// Packets are refcounted AVPackets: the ring, recorders and snapshots
+/// share one payload, nothing is copied.
+class PacketRing {
+public:
+    struct Entry {
+        std::shared_ptr<const AVPacket> packet;
+        uint64_t seq = 0;          // monotonically increasing, never reused
+        uint64_t generation = 0;   // stream (connection) the packet belongs to
+        SteadyClock::time_point arrival;
+        bool keyframe = false;
+    };
+
+    /// Codec parameters of the current connection. Packets from a different
+    /// generation cannot be muxed into the same file.
+    struct StreamInfo {
+        std::shared_ptr<const AVCodecParameters> codecpar;  // null until connected
+        AVRational time_base{1, 90000};
+        uint64_t generation = 0;
+    };
+
+    struct Stats {
+        size_t packets = 0;
+        size_t bytes = 0;
+        uint64_t pushed = 0;
+        uint64_t dropped_gops = 0;  // trimmed early by the byte cap
+    };
+
+    static constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+
+    explicit PacketRing(std::chrono::milliseconds window, size_t max_bytes = kDefaultMaxBytes);
+
+    PacketRing(const PacketRing&) = delete;
+    PacketRing& operator=(const PacketRing&) = delete;
+
+    /// New connection: record its codec parameters and drop packets of the old one.
+    void setStream(const AVCodecParameters* codecpar, AVRational time_base);
+
+    /// Append a packet (payload is referenced, not copied). Packets before the
+    /// first keyframe of a connection are dropped.
+    void push(const AVPacket* packet, SteadyClock::time_point arrival = SteadyClock::now());
+
+    StreamInfo stream() const;
+
+    /// Packets from the last keyframe at least `preroll` older than the newest
+    /// packet (or the oldest keyframe held) through the newest packet.
+    std::vector<Entry> preroll(std::chrono::milliseconds preroll) const;
+
+    /// What it takes to decode the picture that arrived at `at`: the first
+    /// packet at or after `at` (the newest if none is), preceded by the rest
+    /// of its GOP from the keyframe. Empty when the ring is.
+    std::vector<Entry> gopUntil(SteadyClock::time_point at) const;
+
+    /// Packets newer than `after_seq`, oldest first
+    std::vector<Entry> since(uint64_t after_seq) const;
+
+    /// Sequence number of the newest packet (0 when empty)
+    uint64_t lastSeq() const;
+
+    Stats stats() const;
+
+private:
+    void trimLocked();
+    void popGopLocked();
+
+    const std::chrono::milliseconds window_;
+    const size_t max_bytes_;
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;    // contiguous seqs, front is always a keyframe
+    std::deque<uint64_t> keyframes_;  // seqs of keyframes in entries_
+    StreamInfo stream_;
+    uint64_t next_seq_ = 1;
+    size_t bytes_ = 0;
+    uint64_t pushed_ = 0;
+    uint64_t dropped_gops_ = 0;
+};
+
+}  // namespace hms
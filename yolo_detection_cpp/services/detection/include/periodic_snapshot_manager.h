@@ -2,11 +2,14 @@
 
 #include "buffer_service.h"
 #include "config_manager.h"
-#include "db_pool.h"
+#include "db_writer.h"
+#include "embedding_client.h"
+#include "file_writer.h"
 #include "gpu_coordinator.h"
 
 #include <atomic>
 #include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -18,9 +21,10 @@ namespace hms {
 class PeriodicSnapshotManager {
 public:
     PeriodicSnapshotManager(std::shared_ptr<BufferService> buffer_service,
-                            std::shared_ptr<hms::DbPool> db,
+                            std::shared_ptr<DbWriter> db,
                             std::shared_ptr<GpuCoordinator> gpu_coord,
-                            const hms::AppConfig& config);
+                            const hms::AppConfig& config,
+                            std::shared_ptr<FileWriter> files = nullptr);  // null: files written inline
     ~PeriodicSnapshotManager();
 
     PeriodicSnapshotManager(const PeriodicSnapshotManager&) = delete;
@@ -29,21 +33,38 @@ public:
     void start();
     void stop();
 
+    /// Make room on the GPU before moondream runs: the coordinator's eviction
+    /// handler, or the detection sessions directly without a coordinator.
+    /// Pinned sessions (an event is running) stay. Exposed for testing.
+    void freeGpuForVision();
+
 private:
     void cameraLoop(const std::string& camera_id, int interval_seconds);
 
-    /// Save a JPEG from raw frame data, returns filename or empty on error
-    std::string saveSnapshot(const FrameData& frame, const std::string& camera_id,
-                             const std::string& snapshots_dir);
+    /// One periodic snapshot's renditions, encoded in one pass
+    struct EncodedSnapshot {
+        std::string filename;            // {camera_id}_periodic_{YYYYMMDD}_{HHMMSS}.jpg
+        std::string thumbnail_filename;
+        std::shared_ptr<const std::string> jpeg;    // null on error
+        std::string thumbnail;                      // empty if the thumbnail failed
+        std::shared_ptr<const std::string> vision;  // for moondream: downscaled, or = jpeg
+    };
+
+    /// Encode the full JPEG, the thumbnail and the vision image from one frame
+    EncodedSnapshot encodeSnapshot(const FrameData& frame, const std::string& camera_id);
 
-    /// Generate a smaller thumbnail JPEG, returns filename or empty on error
-    std::string saveThumbnail(const FrameData& frame, const std::string& camera_id,
-                              const std::string& snapshots_dir);
+    /// Write the JPEG and thumbnail. False if the JPEG couldn't be written;
+    /// clears thumbnail_filename if only the thumbnail failed. With `files`
+    /// both are queued and this returns true.
+    static bool writeSnapshot(EncodedSnapshot& snapshot, const std::string& camera_id,
+                              const std::string& snapshots_dir, FileWriter* files);
 
     std::shared_ptr<BufferService> buffer_service_;
-    std::shared_ptr<hms::DbPool> db_;
+    std::shared_ptr<DbWriter> db_;
     std::shared_ptr<GpuCoordinator> gpu_coord_;
+    std::shared_ptr<FileWriter> files_;
     hms::AppConfig config_;
+    std::unique_ptr<EmbeddingClient> embedding_;  // shared by the camera threads
     std::atomic<bool> running_{false};
     std::vector<std::thread> threads_;
 };
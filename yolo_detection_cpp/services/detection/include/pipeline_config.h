@@ -0,0 +1,244 @@
+#pragma once
+
+#include "letterbox.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hms {
+
+/// Inference scheduler tuning (pipeline.scheduler)
+struct SchedulerConfig {
+    int max_batch_size = 8;   // frames per Session::Run
+    int max_wait_ms = 10;     // how long the first queued frame may wait for company
+    int pipeline_depth = 3;   // batches in flight per session (preprocess | Run | postprocess); 1 = sequential
+};
+
+/// ONNX Runtime execution provider of a session
+enum class ExecutionProvider { Cpu, Cuda, TensorRt, OpenVino };
+
+/// Inference precision. TensorRT builds FP16/INT8 engines and OpenVINO picks
+/// its FP16 path; CUDA and CPU always run the model as exported.
+enum class Precision { Fp32, Fp16, Int8 };
+
+const char* providerName(ExecutionProvider provider);   // "cpu" | "cuda" | "tensorrt" | "openvino"
+const char* precisionName(Precision precision);         // "fp32" | "fp16" | "int8"
+
+/// Placement of one ONNX session (pipeline.engine.sessions[])
+struct SessionConfig {
+    int device = 0;    // CUDA device id; -1 = CPU (also when detection.gpu_enabled is off)
+    int threads = 2;   // intra-op threads: the CPU thread group this session runs on
+    ExecutionProvider provider = ExecutionProvider::Cuda;  // CUDA/TensorRT need a device, else CPU
+    Precision precision = Precision::Fp32;
+    std::string openvino_device = "AUTO:GPU,CPU";          // OpenVINO device_type
+};
+
+/// ONNX session residency and placement (pipeline.engine)
+struct EngineConfig {
+    int idle_ttl_seconds = 300;          // keep the session warm this long after an event; 0 = unload at once
+    bool warmup = true;                  // one inference per session at startup (needs idle_ttl_seconds > 0)
+    bool cache_optimized_model = true;   // serialize ORT's optimized graph next to the model
+    std::string optimized_model_path;    // override for the cache file; empty = derive from model path
+    std::string provider_cache_dir;      // TensorRT engines and OpenVINO blobs; empty = next to the model
+    std::vector<SessionConfig> sessions{SessionConfig{}};  // batches go to whichever session is idle
+};
+
+/// Frame → tensor preprocessing (pipeline.preprocess)
+struct PreprocessConfig {
+    ResizeMode resize = ResizeMode::Nearest;  // "nearest" | "bilinear"
+    bool gpu = false;  // letterbox on GPU sessions' CUDA device (HMS_CUDA_PREPROCESS builds)
+};
+
+/// Event recording (pipeline.recording)
+struct RecordingConfig {
+    enum class Mode { Passthrough, Transcode };
+    Mode mode = Mode::Passthrough;   // "passthrough": remux camera packets; "transcode": libx264
+    bool burn_in_boxes = false;      // draw detection boxes into the video (forces transcode)
+    bool fragmented = true;          // fragmented MP4 (O(1) finalize); false = faststart
+    std::string staging_dir;         // e.g. a tmpfs: written here, moved to events_dir when closed
+};
+
+/// RTSP decode (pipeline.decode)
+struct DecodeConfig {
+    std::string hwaccel = "none";   // "none" | "auto" | "cuda" (NVDEC) | "vaapi" | "qsv"
+    std::string device;             // e.g. "/dev/dri/renderD128"; empty = driver default
+    int threads = 1;                // software decoder threads per camera
+    std::unordered_map<std::string, std::string> camera_hwaccel;  // camera id -> hwaccel override
+
+    const std::string& hwaccelFor(const std::string& camera_id) const {
+        auto it = camera_hwaccel.find(camera_id);
+        return it != camera_hwaccel.end() ? it->second : hwaccel;
+    }
+};
+
+/// Dual-stream cameras (pipeline.streams). Such a camera's rtsp_url is its
+/// substream, decoded for detection, motion and snapshots; the main stream is
+/// only read as packets, to record from and to decode a full-resolution
+/// picture from when one is asked for.
+struct StreamsConfig {
+    std::unordered_map<std::string, std::string> record_urls;  // camera id -> main-stream URL
+    bool full_res_snapshots = false;  // event snapshots decoded from the main stream
+
+    const std::string& recordUrlFor(const std::string& camera_id) const {
+        static const std::string none;
+        auto it = record_urls.find(camera_id);
+        return it != record_urls.end() ? it->second : none;
+    }
+};
+
+/// Frame pixel memory (pipeline.memory)
+struct MemoryConfig {
+    bool arena = true;        // one mapping per camera pool instead of per-frame heap buffers
+    bool huge_pages = true;   // MAP_HUGETLB if reserved, else transparent huge pages
+    int numa_node = -1;       // bind pool memory to this node; -1 = first touch
+};
+
+/// Continuous per-camera detection (pipeline.sampling)
+struct SamplingConfig {
+    bool continuous = false;       // run detection workers; false = YOLO only during motion events
+    bool motion_gating = true;     // pick the rate from in-process scene change
+    int idle_interval_ms = 2000;   // inference spacing while the scene is static
+    int burst_interval_ms = 333;   // spacing while it changes (always, without gating)
+    int burst_hold_ms = 3000;      // stay at the burst rate this long after the last change
+    int cell_threshold = 12;       // mean-luma change (0-255) for a grid cell to count
+    double min_changed = 0.01;     // fraction of grid cells that must change
+    bool trigger_events = false;   // in-process motion also starts/stops events, like camera MQTT
+};
+
+/// Region of interest and tiled inference (pipeline.tiling). Geometry is in
+/// fractions of the frame so it survives resolution changes.
+struct TilingConfig {
+    float roi_x = 0.0f, roi_y = 0.0f, roi_w = 1.0f, roi_h = 1.0f;  // crop before inference
+    int cols = 1, rows = 1;       // tile grid over the ROI; 1x1 = the ROI as one input
+    float overlap = 0.2f;         // fraction of a tile shared with its neighbour
+    bool full_frame = false;      // with tiles: also infer on the whole ROI (large objects)
+    bool motion_tiles = true;     // motion-gated workers infer only on tiles that changed
+
+    bool cropped() const { return roi_x > 0 || roi_y > 0 || roi_w < 1 || roi_h < 1; }
+    bool tiled() const { return cols * rows > 1; }
+    bool enabled() const { return cropped() || tiled(); }
+};
+
+/// Workers and queue bound of one event stage (pipeline.events.<stage>)
+struct EventStageConfig {
+    int workers = 1;  // 0 = one per configured camera
+    int queue = 16;   // waiting tasks; a full queue degrades the event (see EventManager)
+};
+
+/// Motion-event processing stages (pipeline.events)
+struct EventsConfig {
+    EventStageConfig record{0, 8};     // concurrent events: recording + detection sampling
+    EventStageConfig snapshot{2, 16};  // snapshot JPEG + early notification
+    EventStageConfig vision{1, 8};     // LLaVA calls (one GPU model: keep 1)
+    EventStageConfig publish{2, 64};   // LLaVA context rows + messages
+    int mqtt_queue = 256;              // outgoing MQTT messages awaiting the sender
+};
+
+/// Object tracking across a motion event's inferences (pipeline.tracking)
+struct TrackingConfig {
+    bool enabled = true;              // false = every inference stands alone, deduped per class
+    int detect_interval = 3;          // frames between event inferences; tracks fill the gaps
+    float iou_threshold = 0.3f;       // least IoU of a detection with a track's predicted box
+    int min_hits = 2;                 // matches before a track is confirmed
+    int max_age_ms = 1500;            // a track unmatched this long is dropped
+    float stationary_speed = 0.1f;    // box heights per second below which a track is stationary
+    int stationary_recheck_ms = 2000; // every confirmed track stationary: infer only this often
+};
+
+/// Periodic (ambient) snapshot renditions
+struct SnapshotConfig {
+    int thumbnail_width = 320;     // box-downscaled from the full frame
+    int thumbnail_quality = 75;
+};
+
+/// Shared periodic-snapshot embedding client
+struct EmbeddingConfig {
+    int batch_window_ms = 20;   // coalesce texts from all cameras into one /api/embed call
+    int max_batch = 16;
+    int cache_entries = 256;    // LRU of recent texts; 0 = off
+};
+
+/// Write-behind queue for event and periodic-snapshot rows
+struct DbWriterConfig {
+    int queue = 1024;           // rows held in memory while the database is down
+    int batch = 64;             // rows per flush
+    int flush_ms = 200;         // longest a row waits for a batch to fill
+    std::string journal_path;   // spill file; empty = db_journal.jsonl next to snapshots_dir
+    int journal_max_mb = 16;
+    int max_attempts = 20;      // then a row is dropped if the one behind it succeeds
+};
+
+/// Write-behind file I/O for recordings and snapshots
+struct FileWriterConfig {
+    bool enabled = true;        // false: the event threads write files themselves
+    int queue_mb = 64;          // data in flight before producers wait
+};
+
+/// Live view endpoint (/api/cameras/{id}/stream)
+struct LiveConfig {
+    bool enabled = true;
+    int quality = 75;           // MJPEG quality when the viewer asks for none
+    int max_fps = 0;            // MJPEG frame rate cap; 0 = every captured frame
+    int max_backlog_kb = 1024;  // unsent data before a slow viewer starts missing frames
+};
+
+/// Offline replay / load generation: a recorded file fanned out to synthetic
+/// cameras in place of the configured RTSP ones, with synthetic motion events
+/// and a throughput/latency report at the end
+struct ReplayConfig {
+    std::string file;                  // MP4 / H.264 / anything FFmpeg opens; empty = live cameras
+    int cameras = 1;                   // synthetic cameras decoding the file independently
+    bool realtime = true;              // pace by the file's timestamps; false = as fast as decode runs
+    bool loop = true;                  // restart at EOF
+    int duration_seconds = 60;         // then write the report and exit; 0 = until SIGINT/SIGTERM
+    int motion_interval_seconds = 30;  // one synthetic motion event per camera this often; 0 = none
+    int motion_seconds = 5;            // motion length (post-roll follows)
+    bool database = false;             // write event rows; off so a replay never fills the real DB
+    std::string report_path = "replay_report.json";
+
+    bool enabled() const { return !file.empty(); }
+};
+
+/// Image handed to the vision models, in memory from the snapshot encoder
+struct VisionImageConfig {
+    int event_width = 0;      // LLaVA on motion events: downscale to this width; 0 = the snapshot itself
+    int periodic_width = 0;   // moondream on periodic snapshots
+};
+
+/// Detection-service performance settings, read from the optional `pipeline:`
+/// section of config.yaml. Lives here rather than in hms-shared's AppConfig
+/// because none of it is shared with other services.
+/// Every field has a default, so a config without the section behaves as before.
+struct PipelineConfig {
+    SchedulerConfig scheduler;
+    EngineConfig engine;
+    PreprocessConfig preprocess;
+    RecordingConfig recording;
+    DecodeConfig decode;
+    StreamsConfig streams;
+    MemoryConfig memory;
+    SamplingConfig sampling;
+    EventsConfig events;
+    TrackingConfig tracking;
+    SnapshotConfig snapshots;
+    VisionImageConfig vision;
+    EmbeddingConfig embedding;
+    DbWriterConfig db_writer;
+    FileWriterConfig file_writer;
+    LiveConfig live;
+    ReplayConfig replay;
+    TilingConfig tiling;                                          // all cameras
+    std::unordered_map<std::string, TilingConfig> camera_tiling;  // camera id -> override
+
+    const TilingConfig& tilingFor(const std::string& camera_id) const {
+        auto it = camera_tiling.find(camera_id);
+        return it != camera_tiling.end() ? it->second : tiling;
+    }
+
+    /// Parse the `pipeline:` section of a YAML config file.
+    /// Missing file, section or keys fall back to defaults; never throws.
+    static PipelineConfig load(const std::string& config_path);
+};
+
+}  // namespace hms
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace hms {
+
+/// One contiguous mapping holding the pixel buffers of a FramePool.
+///
+/// The mapping is created on the first request, once the camera's frame size
+/// is known: `slots` equal, page-aligned slots sized for that frame. It is
+/// backed by explicit huge pages (MAP_HUGETLB) when the system has them
+/// reserved, otherwise by regular pages with a transparent-huge-page hint,
+/// and can be bound to one NUMA node. Frames that outgrow their slot (the
+/// camera changed resolution upward) fall back to the heap.
+class PixelArena {
+public:
+    struct Options {
+        bool huge_pages = true;  // try MAP_HUGETLB, then MADV_HUGEPAGE
+        int numa_node = -1;      // preferred NUMA node; -1 = kernel default (first touch)
+    };
+
+    struct Stats {
+        size_t reserved_bytes = 0;  // 0 until the first frame is sized
+        size_t slot_bytes = 0;
+        bool hugetlb = false;       // explicit huge pages
+        bool thp = false;           // transparent huge pages requested
+        int numa_node = -1;         // node the mapping is bound to, -1 = none
+        uint64_t heap_fallbacks = 0;
+    };
+
+    /// Row alignment for frames stored in the arena (cache line / SIMD width)
+    static constexpr int kRowAlignment = 64;
+
+    PixelArena(size_t slots, Options options);
+    ~PixelArena();
+
+    PixelArena(const PixelArena&) = delete;
+    PixelArena& operator=(const PixelArena&) = delete;
+
+    /// Storage of at least `bytes` for slot `index`, or nullptr if the arena
+    /// can't serve it (mapping failed, too large) — the caller uses the heap.
+    uint8_t* slot(size_t index, size_t bytes);
+
+    size_t slotBytes() const { return slot_bytes_.load(std::memory_order_acquire); }
+
+    Stats stats() const;
+
+private:
+    bool mapLocked(size_t slot_bytes);
+
+    const size_t slots_;
+    const Options options_;
+
+    mutable std::mutex mutex_;  // guards creating the mapping
+    uint8_t* base_ = nullptr;
+    size_t length_ = 0;
+    std::atomic<size_t> slot_bytes_{0};
+    bool map_failed_ = false;
+    bool hugetlb_ = false;
+    bool thp_ = false;
+    int bound_node_ = -1;
+    std::atomic<uint64_t> heap_fallbacks_{0};
+};
+
+}  // namespace hms
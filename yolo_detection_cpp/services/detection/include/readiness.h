@@ -0,0 +1,49 @@
+#pragma once
+
+#include "frame_data.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hms {
+
+/// Startup state of each subsystem (model, MQTT, database, events, ...),
+/// reported by /health and /ready while they come up in parallel behind the
+/// already-running HTTP server. Thread-safe.
+class Readiness {
+public:
+    enum class State { Pending, Ready, Failed, Disabled };
+
+    struct Entry {
+        std::string name;
+        State state = State::Pending;
+        std::string detail;       // e.g. the error, or what runs without it
+        bool required = true;     // Failed blocks ready(); optional ones only degrade
+        double ms = 0;            // add() to the last set(); so far while pending
+    };
+
+    /// Register a subsystem as pending; its clock starts now
+    void add(const std::string& name, bool required = true);
+
+    /// Move a registered subsystem to `state`
+    void set(const std::string& name, State state, std::string detail = {});
+
+    std::vector<Entry> entries() const;
+
+    /// Nothing pending and no required subsystem failed
+    bool ready() const;
+
+    static const char* name(State state);
+
+private:
+    struct Tracked {
+        Entry entry;
+        SteadyClock::time_point started;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Tracked> tracked_;  // registration order
+};
+
+}  // namespace hms
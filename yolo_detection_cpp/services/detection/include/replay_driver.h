@@ -0,0 +1,83 @@
+#pragma once
+
+#include "buffer_service.h"
+#include "config_manager.h"
+#include "event_manager.h"
+#include "metrics.h"
+#include "pipeline_config.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace hms {
+
+/// Offline load generator (pipeline.replay). The configured cameras are
+/// replaced by synthetic ones that all decode the same recorded file, at
+/// real time or as fast as possible; the driver fires synthetic motion events
+/// into EventManager on a staggered schedule, and at the end reports
+/// throughput and latency per stage (capture, detection, events and
+/// recording, publish) from Metrics and the services' own stats.
+class ReplayDriver {
+public:
+    ReplayDriver(ReplayConfig config,
+                 std::shared_ptr<BufferService> buffer_service,
+                 std::shared_ptr<EventManager> event_manager);
+    ~ReplayDriver();
+
+    ReplayDriver(const ReplayDriver&) = delete;
+    ReplayDriver& operator=(const ReplayDriver&) = delete;
+
+    /// Replace `config`'s cameras with `replay.cameras` synthetic ones
+    /// ("replay_1", ...) whose URL is the file. They inherit the first
+    /// enabled camera's settings (classes, thresholds) if there is one.
+    static void addCameras(AppConfig& config, const ReplayConfig& replay);
+
+    /// Whether camera `index` of `cameras` is in synthetic motion `elapsed`
+    /// into the run. Each camera moves for motion_seconds every
+    /// motion_interval_seconds, phase-shifted so events don't all start together.
+    static bool motionActive(const ReplayConfig& replay, int index, int cameras,
+                             std::chrono::milliseconds elapsed);
+
+    /// count, mean and p50/p95/p99 in ms of one stage's latency
+    static nlohmann::json summarize(const Metrics::Histogram::Snapshot& snapshot);
+
+    /// Start timing and the motion schedule. `on_finished` runs on the driver
+    /// thread after duration_seconds (never when that is 0).
+    void start(std::function<void()> on_finished = nullptr);
+
+    /// End the schedule, stopping any synthetic motion in progress
+    void stop();
+
+    /// Report of the run so far
+    nlohmann::json report() const;
+
+    /// Write report() to report_path and log a one-line summary per stage
+    bool writeReport() const;
+
+private:
+    void run(std::function<void()> on_finished);
+
+    ReplayConfig config_;
+    std::shared_ptr<BufferService> buffer_service_;
+    std::shared_ptr<EventManager> event_manager_;
+    std::vector<std::string> camera_ids_;
+
+    SteadyClock::time_point started_at_{};
+    SteadyClock::time_point stopped_at_{};  // report() measures up to here once stopped
+    uint64_t frames_at_start_ = 0;     // captured during model load / warm-up
+    uint64_t requests_at_start_ = 0;   // detection requests likewise
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+}  // namespace hms
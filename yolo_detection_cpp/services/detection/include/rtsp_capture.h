@@ -1,6 +1,8 @@
 #pragma once
 
 #include "frame_data.h"
+#include "metrics.h"
+#include "packet_ring.h"
 
 #include <atomic>
 #include <chrono>
@@ -10,32 +12,68 @@
 
 // Forward-declare FFmpeg types to keep header clean
 struct AVFormatContext;
+struct AVCodec;
 struct AVCodecContext;
+struct AVCodecParameters;
 struct AVFrame;
 struct AVPacket;
 struct SwsContext;
 
 namespace hms {
 
+class BgrConverter;
+
+/// Decoder selection for one camera
+struct DecodeOptions {
+    std::string hwaccel = "none";  // "none" | "auto" | FFmpeg device type ("cuda", "vaapi", "qsv")
+    std::string device;            // device path / index; empty = default
+    int threads = 1;               // software decoder threads
+    bool packets_only = false;     // no decoder: only the PacketRing is fed (a record-only main stream)
+};
+
+/// Recorded file standing in for a live stream (pipeline.replay)
+struct ReplayOptions {
+    bool enabled = false;  // the URL is a file: no RTSP options, EOF is not a failure
+    bool realtime = true;  // pace packets by their timestamps; false = as fast as decode runs
+    bool loop = true;      // reopen the file at EOF; otherwise the capture idles there
+};
+
 /// Per-camera RTSP capture using FFmpeg libav*.
-/// Runs a dedicated thread that decodes H.264 → BGR24 and delivers frames via callback.
+/// Runs a dedicated thread that decodes H.264 and delivers frames via callback.
+/// Frames carry a reference to the decoder's native picture; the BGR24
+/// conversion runs on first FrameData::ensureBgr(), so frames nobody looks
+/// at are never converted.
+/// With a PacketRing attached, the compressed packets are kept too, for
+/// passthrough recording. A packets-only capture skips decoding altogether;
+/// frames_captured then counts video packets.
+///
+/// Decoding runs on a hardware device (VAAPI / NVDEC / QSV) when configured.
+/// If the device can't be opened, or fails mid-stream, the capture reconnects
+/// with the software decoder and stays on it.
 class RtspCapture {
 public:
     using FrameCallback = std::function<void(std::shared_ptr<FrameData>)>;
 
     struct Stats {
         uint64_t frames_captured = 0;
+        uint64_t frames_converted = 0;  // frames a consumer actually needed in BGR
         uint64_t reconnect_count = 0;
         uint64_t consecutive_failures = 0;
         bool is_connected = false;
         SteadyClock::time_point last_frame_time;
         int frame_width = 0;
         int frame_height = 0;
+        bool hw_decode = false;         // current connection decodes on a hw device
+        uint64_t hw_fallbacks = 0;      // times the hw decoder was abandoned for software
+        uint64_t replay_loops = 0;      // replay: times the file was played to the end
     };
 
     RtspCapture(std::string camera_id, std::string rtsp_url,
                 std::shared_ptr<FramePool> frame_pool,
-                FrameCallback on_frame);
+                FrameCallback on_frame,
+                std::shared_ptr<PacketRing> packet_ring = nullptr,
+                DecodeOptions decode = {},
+                ReplayOptions replay = {});
     ~RtspCapture();
 
     RtspCapture(const RtspCapture&) = delete;
@@ -50,11 +88,18 @@ private:
     void captureLoop();
     bool openStream();
     void closeStream();
+    bool openDecoder(const AVCodec* codec, const AVCodecParameters* codecpar);
+    bool attachHwDevice(const AVCodec* codec);
+    void fallBackToSoftware(const char* reason);
+    void paceReplay(const AVPacket* packet);
 
     std::string camera_id_;
     std::string rtsp_url_;
     std::shared_ptr<FramePool> frame_pool_;
     FrameCallback on_frame_;
+    std::shared_ptr<PacketRing> packet_ring_;
+    DecodeOptions decode_;
+    ReplayOptions replay_;
 
     std::thread thread_;
     std::atomic<bool> running_{false};
@@ -63,11 +108,27 @@ private:
     AVFormatContext* fmt_ctx_ = nullptr;
     AVCodecContext* codec_ctx_ = nullptr;
     AVFrame* av_frame_ = nullptr;
-    AVFrame* bgr_frame_ = nullptr;
     AVPacket* packet_ = nullptr;
-    SwsContext* sws_ctx_ = nullptr;
+    std::shared_ptr<BgrConverter> converter_;  // shared with in-flight frames
     int video_stream_idx_ = -1;
 
+    Metrics::Histogram& decode_metric_;
+    Metrics::Histogram& push_metric_;
+    Metrics::Counter& dropped_metric_;
+
+    // Hardware decode (capture thread only, except the atomics)
+    int hw_pix_fmt_ = -1;           // AVPixelFormat the decoder outputs on the device
+    bool hw_disabled_ = false;      // set once the device failed; software from then on
+    int hw_errors_ = 0;             // consecutive decode errors on the device
+    std::atomic<bool> hw_active_{false};
+    std::atomic<uint64_t> hw_fallbacks_{0};
+    static constexpr int kMaxHwErrors = 10;
+
+    // Replay pacing (capture thread only): wall time of timestamp 0 of this pass
+    SteadyClock::time_point replay_epoch_{};
+    uint64_t replay_packets_ = 0;   // this pass, for files without timestamps
+    std::atomic<uint64_t> replay_loops_{0};
+
     // Stats (atomic for lock-free reads from HTTP threads)
     std::atomic<uint64_t> frames_captured_{0};
     std::atomic<uint64_t> reconnect_count_{0};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hms {
+
+/// Encoded responses for each camera's latest frame, keyed by camera and
+/// frame_number, for the HTTP snapshot/detect endpoints.
+///
+/// Dashboards poll from several clients at once and mostly see the same
+/// frame. The first request for a frame produces the value (encodes, or
+/// detects) and later ones get the cached bytes; requests arriving while it
+/// is being produced queue behind it instead of producing it again. A request
+/// for a different frame replaces the camera's entry. Failures (null bytes)
+/// are handed to the waiters but not cached.
+class SnapshotCache {
+public:
+    enum class Slot : uint8_t {
+        Plain,       // JPEG of the frame
+        Annotated,   // JPEG with detection boxes (= Plain when nothing was detected)
+        Detections,  // detect endpoint JSON
+        Main,            // dual-stream camera: JPEG of the main stream at the frame's time
+        MainAnnotated,   // the same with the boxes scaled onto it
+    };
+    static constexpr size_t kSlots = 5;
+
+    using Bytes = std::shared_ptr<const std::string>;
+    using Done = std::function<void(Bytes)>;
+    using Producer = std::function<void(Done)>;  // calls its Done exactly once, on any thread
+
+    struct Stats {
+        uint64_t hits = 0;       // served from the cache
+        uint64_t misses = 0;     // produced
+        uint64_t coalesced = 0;  // waited for a production already underway
+    };
+
+    /// Hand the value of `slot` for the camera's frame `frame_number` to
+    /// `done`: cached, after a production underway, or by running `produce`.
+    /// `done` runs on whichever thread completes the production.
+    void get(const std::string& camera_id, uint64_t frame_number, Slot slot,
+             const Producer& produce, Done done);
+
+    Stats stats() const;
+
+private:
+    /// One production and the requests waiting on it
+    struct Pending {
+        std::vector<Done> waiters;
+    };
+
+    struct Value {
+        Bytes bytes;                       // set once produced
+        std::shared_ptr<Pending> pending;  // set while producing
+    };
+
+    struct Entry {
+        uint64_t frame_number = 0;
+        std::array<Value, kSlots> values;
+    };
+
+    void complete(const std::string& camera_id, uint64_t frame_number, Slot slot,
+                  const std::shared_ptr<Pending>& pending, Bytes bytes);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    Stats stats_;
+};
+
+}  // namespace hms
@@ -2,24 +2,45 @@
 
 #include "frame_data.h"
 #include "detection_engine.h"
+#include "file_writer.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace hms {
 
 /// Save annotated JPEG snapshots to disk.
-/// Reuses drawBoundingBoxes + encodeJpeg patterns from detection_controller.
 struct SnapshotWriter {
     /// Draw bounding boxes on BGR24 pixel data (modifies in place)
-    static void drawBoundingBoxes(std::vector<uint8_t>& pixels,
+    static void drawBoundingBoxes(uint8_t* pixels,
                                    int width, int height, int stride,
                                    const std::vector<Detection>& detections);
 
-    /// Encode BGR24 frame to JPEG bytes using FFmpeg MJPEG encoder
+    /// Encode BGR24 frame to JPEG bytes (JpegEncoder, default quality)
     static std::string encodeJpeg(const uint8_t* pixels,
                                    int width, int height, int stride);
 
+    /// An annotated snapshot encoded but not yet on disk
+    struct Encoded {
+        std::string path;                         // where write() puts it
+        std::shared_ptr<const std::string> jpeg;  // null on error
+        std::shared_ptr<const std::string> vision_jpeg;  // downscaled for the vision model, else = jpeg
+    };
+
+    /// Draw the boxes and encode, plus a rendition of at most vision_width
+    /// (0 = none) for the vision model, from the same annotated pixels
+    static Encoded encode(const FrameData& frame,
+                          const std::vector<Detection>& detections,
+                          const std::string& camera_id,
+                          const std::string& output_dir,
+                          int vision_width = 0);
+
+    /// Write an encoded snapshot to its path. False on error. With `files`
+    /// the write is queued (true once queued; errors are the FileWriter's).
+    static bool write(const Encoded& snapshot, const std::string& camera_id,
+                      FileWriter* files = nullptr);
+
     /// Save annotated snapshot to disk. Returns the full file path, or empty on error.
     /// output_dir: e.g. /mnt/ssd/snapshots
     static std::string save(const FrameData& frame,
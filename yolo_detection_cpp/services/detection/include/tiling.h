@@ -0,0 +1,15 @@
+#pragma once
+
+#include "letterbox.h"
+#include "pipeline_config.h"
+
+#include <vector>
+
+namespace hms {
+
+/// Inference regions of a width x height frame: the ROI split into
+/// cols x rows equal, overlapping tiles, preceded by the whole ROI when
+/// full_frame is set. Empty when tiling is disabled (infer on the whole frame).
+std::vector<Region> tileRegions(const TilingConfig& config, int width, int height);
+
+}  // namespace hms
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "detection_engine.h"
+#include "frame_data.h"
+#include "pipeline_config.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace hms {
+
+/// SORT-style multi-object tracker for one motion event.
+///
+/// Each track runs a constant-velocity Kalman filter on its box (centre x/y,
+/// width and height filtered independently, noise scaled by box height).
+/// Detections are associated with the tracks' predicted boxes greedily by
+/// IoU, within a class. Between inferences, predict() extrapolates the boxes,
+/// so inference can run at a fraction of the frame rate.
+class Tracker {
+public:
+    struct Track {
+        uint32_t id = 0;
+        Detection box;       // current estimate; confidence of the last match
+        Detection best;      // highest-confidence detection matched to it
+        int hits = 0;        // detections matched
+        bool confirmed = false;
+        SteadyClock::time_point last_seen;
+
+        /// Centre speed in box heights per second
+        float speed() const;
+
+    private:
+        friend class Tracker;
+        /// Constant-velocity filter over one box coordinate
+        struct Axis {
+            float x = 0, v = 0;
+            float p00 = 0, p01 = 0, p11 = 0;  // covariance of (x, v)
+            void predict(float dt, float q);
+            void update(float z, float r);
+        };
+        std::array<Axis, 4> axes_;  // cx, cy, w, h
+        SteadyClock::time_point updated_at_;  // time the filters describe
+    };
+
+    explicit Tracker(TrackingConfig config = {});
+
+    /// Fold in one inference's detections at frame time `t`: predict every
+    /// track to `t`, match, start tracks for unmatched detections and drop
+    /// tracks unseen for max_age_ms. Returns the track id of each detection.
+    std::vector<uint32_t> update(const std::vector<Detection>& detections, SteadyClock::time_point t);
+
+    /// Live tracks' boxes extrapolated to `t`: overlay between inferences
+    std::vector<Detection> predict(SteadyClock::time_point t) const;
+
+    /// Live track with this id, or null
+    const Track* find(uint32_t id) const;
+
+    /// At least one live track, and every one of them confirmed and slower
+    /// than stationary_speed: new frames would only repeat the same boxes
+    bool allStationary() const;
+
+    /// One detection per object of the event (dropped tracks included): each
+    /// confirmed track's best, or every track's when none was confirmed.
+    /// Highest confidence first.
+    std::vector<Detection> objects() const;
+
+    const std::vector<Track>& tracks() const { return tracks_; }
+
+private:
+    Track start(const Detection& det, SteadyClock::time_point t);
+    void correct(Track& track, const Detection& det, SteadyClock::time_point t);
+
+    TrackingConfig config_;
+    std::vector<Track> tracks_;     // live
+    std::vector<Track> finished_;   // dropped, kept for objects()
+    uint32_t next_id_ = 1;
+};
+
+}  // namespace hms
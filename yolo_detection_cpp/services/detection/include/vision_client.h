@@ -4,6 +4,7 @@
 #include "llm_client.h"
 
 #include <atomic>
+#include <memory>
 #include <string>
 
 namespace hms {
@@ -30,6 +31,14 @@ public:
                    const std::string& detected_class,
                    const std::atomic<bool>* abort_flag = nullptr);
 
+    /// Same, for a JPEG already in memory (straight from the snapshot encoder,
+    /// e.g. downscaled to the model's input): no file round-trip, so the
+    /// caller can write the snapshot to disk in parallel.
+    Result analyze(std::shared_ptr<const std::string> jpeg,
+                   const std::string& camera_id,
+                   const std::string& detected_class,
+                   const std::atomic<bool>* abort_flag = nullptr);
+
     /// The prompt used in the last analyze() call
     const std::string& lastPrompt() const { return last_prompt_; }
 
@@ -1,13 +1,17 @@
 #include "buffer_service.h"
+#include "packet_decoder.h"
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <future>
 
 namespace hms {
 
-BufferService::BufferService(const hms::AppConfig& config)
+BufferService::BufferService(const hms::AppConfig& config, const PipelineConfig& pipeline)
     : config_(config)
+    , pipeline_(pipeline)
 {
     for (const auto& [id, cam_cfg] : config.cameras) {
         if (!cam_cfg.enabled) {
@@ -19,26 +23,80 @@ BufferService::BufferService(const hms::AppConfig& config)
             config.buffer.preroll_seconds * config.buffer.fps);
         if (buffer_capacity == 0) buffer_capacity = 75;  // fallback
 
-        // Pool: buffer + headroom for RTSP decode, event reads, detection
+        // Pool: buffer + headroom for RTSP decode, event reads, detection.
+        // Events hold preroll frames by reference, so allow spilling by up to
+        // one more buffer's worth while they do.
         size_t pool_size = buffer_capacity + 30;
 
-        auto pool = std::make_shared<FramePool>(pool_size);
+        std::unique_ptr<PixelArena> arena;
+        if (pipeline_.memory.arena) {
+            arena = std::make_unique<PixelArena>(pool_size, PixelArena::Options{
+                .huge_pages = pipeline_.memory.huge_pages,
+                .numa_node = pipeline_.memory.numa_node,
+            });
+        }
+        auto pool = std::make_shared<FramePool>(pool_size, buffer_capacity, std::move(arena));
         auto buffer = std::make_shared<CameraBuffer>(buffer_capacity);
 
+        // Compressed packets for passthrough recording: same preroll as the frame ring.
+        // Dual-stream cameras always keep the main stream's; it is all they keep of it
+        const auto& record_url = pipeline_.streams.recordUrlFor(id);
+        std::shared_ptr<PacketRing> packets;
+        if (!record_url.empty()
+            || (pipeline_.recording.mode == RecordingConfig::Mode::Passthrough
+                && !pipeline_.recording.burn_in_boxes)) {
+            packets = std::make_shared<PacketRing>(
+                std::chrono::seconds(std::max(config.buffer.preroll_seconds, 1)));
+        }
+
+        DecodeOptions decode{
+            .hwaccel = pipeline_.decode.hwaccelFor(id),
+            .device = pipeline_.decode.device,
+            .threads = pipeline_.decode.threads,
+        };
+
+        // Replay: the camera's URL is the recorded file (ReplayDriver::addCameras)
+        ReplayOptions replay{
+            .enabled = pipeline_.replay.enabled(),
+            .realtime = pipeline_.replay.realtime,
+            .loop = pipeline_.replay.loop,
+        };
+
         auto capture = std::make_unique<RtspCapture>(
             id, cam_cfg.rtsp_url, pool,
             [buf = buffer](std::shared_ptr<FrameData> frame) {
                 buf->push(std::move(frame));
-            });
+            },
+            record_url.empty() ? packets : nullptr, std::move(decode), replay);
+
+        std::unique_ptr<RtspCapture> record_capture;
+        if (!record_url.empty()) {
+            record_capture = std::make_unique<RtspCapture>(
+                id, record_url, nullptr, nullptr, packets, DecodeOptions{.packets_only = true});
+        }
 
         cameras_[id] = CameraState{
             .name = cam_cfg.name,
             .pool = std::move(pool),
             .buffer = std::move(buffer),
+            .packets = std::move(packets),
             .capture = std::move(capture),
+            .record_capture = std::move(record_capture),
         };
 
-        spdlog::info("[{}] Configured: pool={}, buffer={}", id, pool_size, buffer_capacity);
+        spdlog::info("[{}] Configured: pool={}, buffer={}{}", id, pool_size, buffer_capacity,
+                     record_url.empty() ? "" : ", dual-stream (recording the main stream)");
+    }
+
+    // Full-resolution snapshots decode a GOP each: a couple at a time, one
+    // per camera, and a burst of requests beyond the queue is turned away
+    bool dual_stream = std::any_of(cameras_.begin(), cameras_.end(),
+                                   [](const auto& cam) { return cam.second.record_capture != nullptr; });
+    if (dual_stream) {
+        EventExecutor::Options decode{};
+        for (auto& stage : decode) stage = {.workers = 1, .queue = 0};
+        decode[static_cast<size_t>(EventExecutor::Stage::Snapshot)] = {.workers = 2, .queue = 4};
+        main_decoder_ = std::make_unique<EventExecutor>(decode);
     }
 }
 
@@ -51,6 +109,7 @@ void BufferService::startAll() {
     spdlog::info("Starting capture for {} camera(s)", cameras_.size());
     for (auto& [id, state] : cameras_) {
         state.capture->start();
+        if (state.record_capture) state.record_capture->start();
     }
 }
 
@@ -58,7 +117,9 @@ void BufferService::stopAll() {
     spdlog::info("Stopping all captures");
     for (auto& [id, state] : cameras_) {
         state.capture->stop();
+        if (state.record_capture) state.record_capture->stop();
     }
+    if (main_decoder_) main_decoder_->stop();  // queued decodes finish first
 }
 
 // --- Detection ---
@@ -71,57 +132,167 @@ void BufferService::loadDetectionModel() {
         return;
     }
 
-    // Constructor validates model (loads + unloads), GPU stays free until motion events
-    detection_engine_ = std::make_shared<DetectionEngine>(model_path, 80, config_.detection.gpu_enabled);
-    if (!detection_engine_->isModelValid()) {
-        spdlog::error("Failed to validate detection model, detection disabled");
-        detection_engine_.reset();
-        return;
+    // One engine per configured session (GPU device or CPU thread group). Optimized
+    // graph cache per EP, e.g. yolo26m.onnx -> yolo26m.cuda.opt.onnx: the serialized
+    // graph can contain provider-specific layout changes. TensorRT and OpenVINO
+    // sessions use their own engine caches under provider_cache_dir instead.
+    auto build = [this, &model_path](const SessionConfig& session) {
+        bool gpu = config_.detection.gpu_enabled && session.device >= 0 &&
+                   session.provider != ExecutionProvider::Cpu &&
+                   session.provider != ExecutionProvider::OpenVino;
+        std::string optimized_path;
+        if (pipeline_.engine.cache_optimized_model) {
+            optimized_path = pipeline_.engine.optimized_model_path;
+            if (optimized_path.empty()) {
+                std::filesystem::path p(model_path);
+                p.replace_extension(gpu ? ".cuda.opt.onnx" : ".cpu.opt.onnx");
+                optimized_path = p.string();
+            }
+        }
+
+        // Constructor validates model (loads + unloads), GPU stays free until motion events
+        return std::make_shared<DetectionEngine>(
+            model_path, 80, config_.detection.gpu_enabled, optimized_path, session,
+            pipeline_.engine.provider_cache_dir);
+    };
+
+    // Sessions compile on their own devices: build them side by side
+    const auto& sessions = pipeline_.engine.sessions;
+    std::vector<std::future<std::shared_ptr<DetectionEngine>>> builders;
+    for (size_t i = 1; i < sessions.size(); ++i) {
+        builders.push_back(std::async(std::launch::async, build, std::cref(sessions[i])));
+    }
+    std::vector<std::shared_ptr<DetectionEngine>> engines{build(sessions.front())};
+    for (auto& b : builders) engines.push_back(b.get());
+    for (const auto& engine : engines) {
+        if (!engine->isModelValid()) {
+            spdlog::error("Failed to validate detection model, detection disabled");
+            return;
+        }
+    }
+
+    auto pool = std::make_shared<EnginePool>(std::move(engines));
+    pool->setIdleTtl(std::chrono::seconds(pipeline_.engine.idle_ttl_seconds));
+    pool->setResizeMode(pipeline_.preprocess.resize);
+    pool->setGpuPreprocess(pipeline_.preprocess.gpu);
+    pool->setPipelineDepth(pipeline_.scheduler.pipeline_depth);
+    auto primary = pool->primary();
+
+    // Class filters compiled once per camera into id bitmasks
+    auto compile = [&primary](const std::vector<std::string>& names) -> std::shared_ptr<const ClassMask> {
+        if (names.empty()) return nullptr;
+        return std::make_shared<const ClassMask>(primary->classMask(names));
+    };
+    auto default_filter = compile(config_.detection.classes);
+    std::unordered_map<std::string, std::shared_ptr<const ClassMask>> filters;
+    for (const auto& [id, cam] : config_.cameras) {
+        filters[id] = cam.classes.empty() ? default_filter : compile(cam.classes);
+    }
+
+    // First inference before anyone waits on it; the session then idles out as usual
+    bool warm = pipeline_.engine.warmup && pipeline_.engine.idle_ttl_seconds > 0;
+    if (warm) {
+        auto t0 = SteadyClock::now();
+        pool->warmUp();
+        spdlog::info("Detection model warmed up in {:.0f} ms",
+                     std::chrono::duration<double, std::milli>(SteadyClock::now() - t0).count());
     }
 
-    spdlog::info("Detection model validated: '{}' (GPU idle until motion event)", model_path);
+    // All detect calls (continuous workers + events) go through one scheduler
+    auto scheduler = std::make_shared<InferenceScheduler>(pool, pipeline_.scheduler);
+    scheduler->start();
+
+    {
+        std::lock_guard lock(detection_mutex_);
+        engine_pool_ = pool;
+        detection_engine_ = std::move(primary);
+        default_class_filter_ = std::move(default_filter);
+        class_filters_ = std::move(filters);
+        scheduler_ = std::move(scheduler);
+    }
+
+    spdlog::info("Detection model validated: '{}' ({} session(s), {}, idle TTL {}s)",
+                 model_path, pool->size(), warm ? "warm" : "GPU idle until motion event",
+                 pipeline_.engine.idle_ttl_seconds);
 }
 
-void BufferService::startDetection() {
-    if (!detection_engine_) loadDetectionModel();
-    if (!detection_engine_) return;
+void BufferService::startDetection(DetectionWorker::MotionHandler on_motion) {
+    if (!getDetectionEngine()) loadDetectionModel();
+    auto scheduler = getInferenceScheduler();
+    if (!scheduler) return;
 
     // Create per-camera workers
+    std::unordered_map<std::string, std::unique_ptr<DetectionWorker>> workers;
     for (const auto& [id, state] : cameras_) {
         auto cam_it = config_.cameras.find(id);
         if (cam_it == config_.cameras.end()) continue;
 
         auto worker = std::make_unique<DetectionWorker>(
-            id, state.buffer, detection_engine_,
-            cam_it->second, config_.detection);
+            id, state.buffer, scheduler,
+            cam_it->second, config_.detection, getClassFilter(id),
+            pipeline_.sampling, pipeline_.tilingFor(id), on_motion);
         worker->start();
-        detection_workers_[id] = std::move(worker);
+        workers[id] = std::move(worker);
     }
 
+    std::lock_guard lock(detection_mutex_);
+    for (auto& [id, worker] : workers) detection_workers_[id] = std::move(worker);
     spdlog::info("Detection started for {} camera(s)", detection_workers_.size());
 }
 
 void BufferService::stopDetection() {
-    if (detection_workers_.empty()) return;
+    std::unordered_map<std::string, std::unique_ptr<DetectionWorker>> workers;
+    std::shared_ptr<InferenceScheduler> scheduler;
+    {
+        std::lock_guard lock(detection_mutex_);
+        if (detection_workers_.empty()) return;
+        workers = std::move(detection_workers_);
+        detection_workers_.clear();
+        scheduler = std::move(scheduler_);
+        class_filters_.clear();
+        default_class_filter_.reset();
+        detection_engine_.reset();
+        engine_pool_.reset();
+    }
     spdlog::info("Stopping detection workers");
-    for (auto& [id, worker] : detection_workers_) {
+    for (auto& [id, worker] : workers) {
         worker->stop();
     }
-    detection_workers_.clear();
-    detection_engine_.reset();
+    workers.clear();
+    if (scheduler) scheduler->stop();
 }
 
 std::shared_ptr<DetectionEngine> BufferService::getDetectionEngine() const {
+    std::lock_guard lock(detection_mutex_);
     return detection_engine_;
 }
 
+std::shared_ptr<EnginePool> BufferService::getEnginePool() const {
+    std::lock_guard lock(detection_mutex_);
+    return engine_pool_;
+}
+
+std::shared_ptr<InferenceScheduler> BufferService::getInferenceScheduler() const {
+    std::lock_guard lock(detection_mutex_);
+    return scheduler_;
+}
+
+std::shared_ptr<const ClassMask> BufferService::getClassFilter(const std::string& camera_id) const {
+    std::lock_guard lock(detection_mutex_);
+    if (!detection_engine_) return nullptr;
+    auto it = class_filters_.find(camera_id);
+    return it != class_filters_.end() ? it->second : default_class_filter_;
+}
+
 std::optional<DetectionResult> BufferService::getDetectionResult(const std::string& camera_id) const {
+    std::lock_guard lock(detection_mutex_);
     auto it = detection_workers_.find(camera_id);
     if (it == detection_workers_.end()) return std::nullopt;
     return it->second->getLatestResult();
 }
 
 std::unordered_map<std::string, DetectionWorker::Stats> BufferService::getDetectionStats() const {
+    std::lock_guard lock(detection_mutex_);
     std::unordered_map<std::string, DetectionWorker::Stats> result;
     for (const auto& [id, worker] : detection_workers_) {
         result[id] = worker->stats();
@@ -143,6 +314,31 @@ std::shared_ptr<CameraBuffer> BufferService::getCameraBuffer(const std::string&
     return it->second.buffer;
 }
 
+std::shared_ptr<PacketRing> BufferService::getPacketRing(const std::string& camera_id) const {
+    auto it = cameras_.find(camera_id);
+    if (it == cameras_.end()) return nullptr;
+    return it->second.packets;
+}
+
+bool BufferService::isDualStream(const std::string& camera_id) const {
+    auto it = cameras_.find(camera_id);
+    return it != cameras_.end() && it->second.record_capture;
+}
+
+std::shared_ptr<FrameData> BufferService::decodeMainStream(const std::string& camera_id,
+                                                           SteadyClock::time_point at) const {
+    auto it = cameras_.find(camera_id);
+    if (it == cameras_.end() || !it->second.record_capture) return nullptr;
+    return PacketDecoder::decodeAt(*it->second.packets, at);
+}
+
+bool BufferService::decodeMainStreamAsync(const std::string& camera_id, SteadyClock::time_point at,
+                                          std::function<void(std::shared_ptr<FrameData>)> done) {
+    if (!main_decoder_) return false;
+    return main_decoder_->submit(EventExecutor::Stage::Snapshot, camera_id,
+        [this, camera_id, at, done = std::move(done)] { done(decodeMainStream(camera_id, at)); });
+}
+
 std::vector<BufferService::CameraStats> BufferService::getAllStats() const {
     std::vector<CameraStats> result;
     result.reserve(cameras_.size());
@@ -157,13 +353,22 @@ std::vector<BufferService::CameraStats> BufferService::getAllStats() const {
             .buffer_size = buf_size,
             .max_frames = state.buffer->capacity(),
             .frames_captured = capture_stats.frames_captured,
+            .frames_converted = capture_stats.frames_converted,
             .reconnect_count = capture_stats.reconnect_count,
             .consecutive_failures = capture_stats.consecutive_failures,
             .is_connected = capture_stats.is_connected,
             .is_healthy = capture_stats.is_connected && buf_size > 0,
             .frame_width = capture_stats.frame_width,
             .frame_height = capture_stats.frame_height,
+            .hw_decode = capture_stats.hw_decode,
+            .hw_fallbacks = capture_stats.hw_fallbacks,
+            .replay_loops = capture_stats.replay_loops,
             .last_frame_time = capture_stats.last_frame_time,
+            .pool = state.pool->stats(),
+            .arena = state.pool->arena()
+                ? std::optional(state.pool->arena()->stats()) : std::nullopt,
+            .record_stream = state.record_capture
+                ? std::optional(state.record_capture->stats()) : std::nullopt,
         });
     }
 
@@ -0,0 +1,50 @@
+#include "class_names.h"
+
+#include <memory>
+#include <mutex>
+
+namespace hms {
+
+ClassNames::ClassNames(std::vector<std::string> names)
+    : names_(std::move(names))
+{
+    ids_.reserve(names_.size());
+    for (int i = 0; i < static_cast<int>(names_.size()); ++i) {
+        ids_.emplace(names_[i], i);
+    }
+}
+
+const ClassNames* ClassNames::intern(const std::vector<std::string>& names) {
+    // Leaked on purpose: detections may outlive any engine, even at shutdown
+    static std::mutex mutex;
+    static auto* tables = new std::vector<std::unique_ptr<ClassNames>>();
+
+    std::lock_guard lock(mutex);
+    for (const auto& t : *tables) {
+        if (t->names_ == names) return t.get();
+    }
+    tables->push_back(std::unique_ptr<ClassNames>(new ClassNames(names)));
+    return tables->back().get();
+}
+
+std::string_view ClassNames::name(int id) const {
+    if (id < 0 || id >= static_cast<int>(names_.size())) return "unknown";
+    return names_[id];
+}
+
+int ClassNames::id(std::string_view name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? -1 : it->second;
+}
+
+ClassMask ClassMask::compile(const ClassNames& table, const std::vector<std::string>& names) {
+    ClassMask mask;
+    if (names.empty()) return mask;
+
+    mask.active = true;
+    mask.words.assign((table.size() + 63) / 64, 0);
+    for (const auto& name : names) mask.set(table.id(name));
+    return mask;
+}
+
+}  // namespace hms
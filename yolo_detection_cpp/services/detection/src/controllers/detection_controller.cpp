@@ -1,105 +1,69 @@
 #include "controllers/detection_controller.h"
 #include "buffer_service.h"
 #include "detection_engine.h"
+#include "jpeg_encoder.h"
+#include "packet_decoder.h"
 #include "time_utils.h"
 
 #include <drogon/HttpResponse.h>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
+#include <trantor/net/EventLoop.h>
 
 #include <chrono>
-
-extern "C" {
-#include <libavcodec/avcodec.h>
-#include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
-}
+#include <memory>
 
 namespace hms {
 
-void DetectionController::setBufferService(std::shared_ptr<BufferService> svc) {
-    buffer_service_ = std::move(svc);
-}
+namespace {
 
-void DetectionController::detect(
-    const drogon::HttpRequestPtr& /*req*/,
-    std::function<void(const drogon::HttpResponsePtr&)>&& callback,
-    const std::string& camera_id)
-{
-    using json = nlohmann::json;
+using Callback = std::function<void(const drogon::HttpResponsePtr&)>;
 
-    if (!buffer_service_) {
+void respondJsonError(const Callback& callback, drogon::HttpStatusCode code, std::string body) {
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(code);
+    resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    resp->setBody(std::move(body));
+    callback(resp);
+}
+
+/// Answers with the produced detect JSON
+SnapshotCache::Done jsonResponder(Callback callback) {
+    return [callback = std::move(callback)](SnapshotCache::Bytes body) {
         auto resp = drogon::HttpResponse::newHttpResponse();
-        resp->setStatusCode(drogon::k500InternalServerError);
+        resp->setStatusCode(drogon::k200OK);
         resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-        resp->setBody(R"({"error":"Service not initialized"})");
+        resp->setBody(*body);
         callback(resp);
-        return;
-    }
-
-    // Get latest detection result from the worker
-    auto result = buffer_service_->getDetectionResult(camera_id);
-    if (!result) {
-        // Try on-demand detection from latest frame
-        auto frame = buffer_service_->getLatestFrame(camera_id);
-        if (!frame) {
-            auto resp = drogon::HttpResponse::newHttpResponse();
-            resp->setStatusCode(drogon::k404NotFound);
-            resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-            resp->setBody(R"({"error":"No frame available for camera: )" + camera_id + R"("})");
-            callback(resp);
-            return;
-        }
+    };
+}
 
-        auto engine = buffer_service_->getDetectionEngine();
-        if (!engine || !engine->isLoaded()) {
-            auto resp = drogon::HttpResponse::newHttpResponse();
-            resp->setStatusCode(drogon::k503ServiceUnavailable);
-            resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-            resp->setBody(R"({"error":"Detection model not loaded"})");
-            callback(resp);
+/// Answers with the produced JPEG, or a 500 when encoding failed
+SnapshotCache::Done jpegResponder(Callback callback) {
+    return [callback = std::move(callback)](SnapshotCache::Bytes jpeg) {
+        if (!jpeg) {
+            respondJsonError(callback, drogon::k500InternalServerError,
+                             R"({"error":"JPEG encoding failed"})");
             return;
         }
-
-        auto start = std::chrono::steady_clock::now();
-        auto detections = engine->detect(*frame);
-        auto elapsed = std::chrono::steady_clock::now() - start;
-        double inference_ms = std::chrono::duration<double, std::milli>(elapsed).count();
-
-        json dets_json = json::array();
-        for (const auto& d : detections) {
-            dets_json.push_back({
-                {"class", d.class_name},
-                {"class_id", d.class_id},
-                {"confidence", std::round(d.confidence * 1000) / 1000},
-                {"bbox", {{"x1", static_cast<int>(d.x1)},
-                          {"y1", static_cast<int>(d.y1)},
-                          {"x2", static_cast<int>(d.x2)},
-                          {"y2", static_cast<int>(d.y2)}}},
-            });
-        }
-
-        json response = {
-            {"camera_id", camera_id},
-            {"timestamp", hms::time_utils::now_iso8601()},
-            {"frame_number", frame->frame_number},
-            {"inference_ms", std::round(inference_ms * 10) / 10},
-            {"detections", dets_json},
-        };
-
         auto resp = drogon::HttpResponse::newHttpResponse();
         resp->setStatusCode(drogon::k200OK);
-        resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-        resp->setBody(response.dump());
+        resp->setContentTypeCode(drogon::CT_NONE);
+        resp->addHeader("Content-Type", "image/jpeg");
+        resp->setBody(*jpeg);
         callback(resp);
-        return;
-    }
+    };
+}
+
+/// Detect endpoint body for one frame's detections
+SnapshotCache::Bytes detectionsJson(const std::string& camera_id, uint64_t frame_number,
+                                    double inference_ms, const std::vector<Detection>& detections) {
+    using json = nlohmann::json;
 
-    // Return cached worker result
     json dets_json = json::array();
-    for (const auto& d : result->detections) {
+    for (const auto& d : detections) {
         dets_json.push_back({
-            {"class", d.class_name},
+            {"class", d.name()},
             {"class_id", d.class_id},
             {"confidence", std::round(d.confidence * 1000) / 1000},
             {"bbox", {{"x1", static_cast<int>(d.x1)},
@@ -109,30 +73,19 @@ void DetectionController::detect(
         });
     }
 
-    auto stats = buffer_service_->getDetectionStats();
-    double inference_ms = 0;
-    for (const auto& [id, s] : stats) {
-        if (id == camera_id) { inference_ms = s.avg_inference_ms; break; }
-    }
-
     json response = {
         {"camera_id", camera_id},
         {"timestamp", hms::time_utils::now_iso8601()},
-        {"frame_number", result->frame_number},
+        {"frame_number", frame_number},
         {"inference_ms", std::round(inference_ms * 10) / 10},
         {"detections", dets_json},
     };
-
-    auto resp = drogon::HttpResponse::newHttpResponse();
-    resp->setStatusCode(drogon::k200OK);
-    resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-    resp->setBody(response.dump());
-    callback(resp);
+    return std::make_shared<const std::string>(response.dump());
 }
 
 /// Draw bounding box rectangles on BGR24 frame data
-static void drawBoundingBoxes(std::vector<uint8_t>& pixels, int width, int height, int stride,
-                               const std::vector<Detection>& detections) {
+void drawBoundingBoxes(uint8_t* pixels, int width, int height, int stride,
+                        const std::vector<Detection>& detections) {
     // Simple color palette (BGR)
     static const uint8_t colors[][3] = {
         {0, 255, 0},     // green
@@ -159,13 +112,13 @@ static void drawBoundingBoxes(std::vector<uint8_t>& pixels, int width, int heigh
             int bot_y = y2 - t;
             if (top_y >= 0 && top_y < height) {
                 for (int x = x1; x <= x2; ++x) {
-                    uint8_t* px = pixels.data() + top_y * stride + x * 3;
+                    uint8_t* px = pixels + top_y * stride + x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
             if (bot_y >= 0 && bot_y < height && bot_y != top_y) {
                 for (int x = x1; x <= x2; ++x) {
-                    uint8_t* px = pixels.data() + bot_y * stride + x * 3;
+                    uint8_t* px = pixels + bot_y * stride + x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
@@ -177,13 +130,13 @@ static void drawBoundingBoxes(std::vector<uint8_t>& pixels, int width, int heigh
             int right_x = x2 - t;
             if (left_x >= 0 && left_x < width) {
                 for (int y = y1; y <= y2; ++y) {
-                    uint8_t* px = pixels.data() + y * stride + left_x * 3;
+                    uint8_t* px = pixels + y * stride + left_x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
             if (right_x >= 0 && right_x < width && right_x != left_x) {
                 for (int y = y1; y <= y2; ++y) {
-                    uint8_t* px = pixels.data() + y * stride + right_x * 3;
+                    uint8_t* px = pixels + y * stride + right_x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
@@ -191,55 +144,92 @@ static void drawBoundingBoxes(std::vector<uint8_t>& pixels, int width, int heigh
     }
 }
 
-/// Encode BGR24 frame to JPEG using FFmpeg MJPEG encoder
-static std::string encodeJpeg(const uint8_t* pixels, int width, int height, int stride) {
-    const AVCodec* mjpeg_codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
-    if (!mjpeg_codec) return {};
-
-    AVCodecContext* enc_ctx = avcodec_alloc_context3(mjpeg_codec);
-    enc_ctx->width = width;
-    enc_ctx->height = height;
-    enc_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
-    enc_ctx->time_base = {1, 25};
-    enc_ctx->flags |= AV_CODEC_FLAG_QSCALE;
-    enc_ctx->qmin = 2;
-    enc_ctx->qmax = 5;
-
-    if (avcodec_open2(enc_ctx, mjpeg_codec, nullptr) < 0) {
-        avcodec_free_context(&enc_ctx);
-        return {};
+/// JPEG of the frame, with boxes drawn on a copy when there are detections. Null on failure.
+SnapshotCache::Bytes encodeSnapshot(const FrameData& frame, const std::vector<Detection>& detections) {
+    std::string jpeg;
+    if (detections.empty()) {
+        JpegEncoder::encode(frame.pixels.data(), frame.width, frame.height, frame.stride,
+                            JpegEncoder::kDefaultQuality, jpeg);
+    } else {
+        // Copy pixels so we don't modify the shared frame
+        auto annotated_pixels = frame.pixels;
+        drawBoundingBoxes(annotated_pixels.data(), frame.width, frame.height,
+                          frame.stride, detections);
+        JpegEncoder::encode(annotated_pixels.data(), frame.width, frame.height, frame.stride,
+                            JpegEncoder::kDefaultQuality, jpeg);
     }
+    if (jpeg.empty()) return nullptr;
+    return std::make_shared<const std::string>(std::move(jpeg));
+}
 
-    SwsContext* sws = sws_getContext(
-        width, height, AV_PIX_FMT_BGR24,
-        width, height, AV_PIX_FMT_YUVJ420P,
-        SWS_BILINEAR, nullptr, nullptr, nullptr);
+}  // namespace
 
-    AVFrame* yuv_frame = av_frame_alloc();
-    yuv_frame->format = AV_PIX_FMT_YUVJ420P;
-    yuv_frame->width = width;
-    yuv_frame->height = height;
-    av_frame_get_buffer(yuv_frame, 0);
+void DetectionController::setBufferService(std::shared_ptr<BufferService> svc) {
+    buffer_service_ = std::move(svc);
+}
 
-    const uint8_t* src_data[1] = {pixels};
-    int src_linesize[1] = {stride};
-    sws_scale(sws, src_data, src_linesize, 0, height,
-              yuv_frame->data, yuv_frame->linesize);
+void DetectionController::detect(
+    const drogon::HttpRequestPtr& /*req*/,
+    std::function<void(const drogon::HttpResponsePtr&)>&& callback,
+    const std::string& camera_id)
+{
+    if (!buffer_service_) {
+        respondJsonError(callback, drogon::k500InternalServerError,
+                         R"({"error":"Service not initialized"})");
+        return;
+    }
 
-    AVPacket* pkt = av_packet_alloc();
-    avcodec_send_frame(enc_ctx, yuv_frame);
+    // Get latest detection result from the worker
+    auto result = buffer_service_->getDetectionResult(camera_id);
+    if (result) {
+        auto svc = buffer_service_;
+        snapshot_cache_.get(camera_id, result->frame_number, SnapshotCache::Slot::Detections,
+            [svc, result, camera_id](SnapshotCache::Done done) {
+                double inference_ms = 0;
+                for (const auto& [id, s] : svc->getDetectionStats()) {
+                    if (id == camera_id) { inference_ms = s.avg_inference_ms; break; }
+                }
+                done(detectionsJson(camera_id, result->frame_number, inference_ms,
+                                    result->detections));
+            },
+            jsonResponder(std::move(callback)));
+        return;
+    }
 
-    std::string result;
-    if (avcodec_receive_packet(enc_ctx, pkt) == 0) {
-        result.assign(reinterpret_cast<const char*>(pkt->data), pkt->size);
+    // Try on-demand detection from latest frame
+    auto frame = buffer_service_->getLatestFrame(camera_id);
+    if (!frame) {
+        respondJsonError(callback, drogon::k404NotFound,
+                         R"({"error":"No frame available for camera: )" + camera_id + R"("})");
+        return;
     }
 
-    av_packet_free(&pkt);
-    av_frame_free(&yuv_frame);
-    sws_freeContext(sws);
-    avcodec_free_context(&enc_ctx);
+    auto engine = buffer_service_->getDetectionEngine();
+    if (!engine || !engine->isLoaded()) {
+        respondJsonError(callback, drogon::k503ServiceUnavailable,
+                         R"({"error":"Detection model not loaded"})");
+        return;
+    }
 
-    return result;
+    // On-demand request: rides the shared scheduler with event priority and
+    // answers from its completion, so this event-loop thread isn't held
+    auto scheduler = buffer_service_->getInferenceScheduler();
+    snapshot_cache_.get(camera_id, frame->frame_number, SnapshotCache::Slot::Detections,
+        [scheduler, engine, frame, camera_id](SnapshotCache::Done done) {
+            auto start = std::chrono::steady_clock::now();
+            auto finish = [start, frame, camera_id, done](const std::vector<Detection>& detections) {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                double inference_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+                done(detectionsJson(camera_id, frame->frame_number, inference_ms, detections));
+            };
+            if (scheduler) {
+                scheduler->submit(frame, DetectParams{}, InferenceScheduler::Priority::Event,
+                                  [finish](std::vector<Detection> detections) { finish(detections); });
+            } else {
+                finish(engine->detect(*frame));
+            }
+        },
+        jsonResponder(std::move(callback)));
 }
 
 void DetectionController::annotatedSnapshot(
@@ -248,78 +238,99 @@ void DetectionController::annotatedSnapshot(
     const std::string& camera_id)
 {
     if (!buffer_service_) {
-        auto resp = drogon::HttpResponse::newHttpResponse();
-        resp->setStatusCode(drogon::k500InternalServerError);
-        resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-        resp->setBody(R"({"error":"Service not initialized"})");
-        callback(resp);
+        respondJsonError(callback, drogon::k500InternalServerError,
+                         R"({"error":"Service not initialized"})");
         return;
     }
 
     auto frame = buffer_service_->getLatestFrame(camera_id);
-    if (!frame) {
-        auto resp = drogon::HttpResponse::newHttpResponse();
-        resp->setStatusCode(drogon::k404NotFound);
-        resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-        resp->setBody(R"({"error":"No frame available for camera: )" + camera_id + R"("})");
-        callback(resp);
+    bool main_stream = req->getParameter("stream") == "main";
+    if (!frame || (!main_stream && !frame->ensureBgr())) {
+        respondJsonError(callback, drogon::k404NotFound,
+                         R"({"error":"No frame available for camera: )" + camera_id + R"("})");
         return;
     }
 
-    bool annotate = req->getParameter("annotate") == "true";
-
-    if (annotate) {
-        // Get detections and draw bounding boxes on a copy of the frame
-        std::vector<Detection> detections;
-
-        auto result = buffer_service_->getDetectionResult(camera_id);
-        if (result) {
-            detections = result->detections;
-        } else {
-            auto engine = buffer_service_->getDetectionEngine();
-            if (engine && engine->isLoaded()) {
-                detections = engine->detect(*frame);
-            }
-        }
-
-        if (!detections.empty()) {
-            // Copy pixels so we don't modify the shared frame
-            auto annotated_pixels = frame->pixels;
-            drawBoundingBoxes(annotated_pixels, frame->width, frame->height,
-                              frame->stride, detections);
-
-            auto jpeg = encodeJpeg(annotated_pixels.data(), frame->width,
-                                   frame->height, frame->stride);
-            if (!jpeg.empty()) {
-                auto resp = drogon::HttpResponse::newHttpResponse();
-                resp->setStatusCode(drogon::k200OK);
-                resp->setContentTypeCode(drogon::CT_NONE);
-                resp->addHeader("Content-Type", "image/jpeg");
-                resp->setBody(std::move(jpeg));
-                callback(resp);
-                return;
-            }
+    // Full resolution from a dual-stream camera's main stream, at the latest
+    // substream frame's time; boxes are the continuous worker's, scaled up
+    if (main_stream) {
+        if (!buffer_service_->isDualStream(camera_id)) {
+            respondJsonError(callback, drogon::k404NotFound,
+                             R"({"error":"No main stream for camera: )" + camera_id + R"("})");
+            return;
         }
+        bool annotate = req->getParameter("annotate") == "true";
+        auto result = annotate ? buffer_service_->getDetectionResult(camera_id) : std::nullopt;
+        auto svc = buffer_service_;
+        snapshot_cache_.get(camera_id, frame->frame_number,
+            annotate ? SnapshotCache::Slot::MainAnnotated : SnapshotCache::Slot::Main,
+            [svc, camera_id, frame, result](SnapshotCache::Done done) {
+                // A GOP decode at full resolution: on the service's decode
+                // workers, not the event loop
+                auto finish = std::make_shared<SnapshotCache::Done>(std::move(done));
+                bool queued = svc->decodeMainStreamAsync(camera_id, frame->timestamp,
+                    [frame, result, finish](std::shared_ptr<FrameData> full) {
+                        if (!full) {
+                            (*finish)(nullptr);
+                            return;
+                        }
+                        std::vector<Detection> detections;
+                        if (result) {
+                            detections = scaleDetections(result->detections, frame->width, frame->height,
+                                                         full->width, full->height);
+                        }
+                        (*finish)(encodeSnapshot(*full, detections));
+                    });
+                if (!queued) (*finish)(nullptr);  // decoders busy or shutting down
+            },
+            jpegResponder(std::move(callback)));
+        return;
     }
 
-    // Plain snapshot (no annotation, or annotation failed)
-    auto jpeg = encodeJpeg(frame->pixels.data(), frame->width,
-                           frame->height, frame->stride);
-    if (jpeg.empty()) {
-        auto resp = drogon::HttpResponse::newHttpResponse();
-        resp->setStatusCode(drogon::k500InternalServerError);
-        resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
-        resp->setBody(R"({"error":"JPEG encoding failed"})");
-        callback(resp);
+    auto plain = [frame](SnapshotCache::Done done) { done(encodeSnapshot(*frame, {})); };
+
+    if (req->getParameter("annotate") != "true") {
+        snapshot_cache_.get(camera_id, frame->frame_number, SnapshotCache::Slot::Plain,
+                            plain, jpegResponder(std::move(callback)));
         return;
     }
 
-    auto resp = drogon::HttpResponse::newHttpResponse();
-    resp->setStatusCode(drogon::k200OK);
-    resp->setContentTypeCode(drogon::CT_NONE);
-    resp->addHeader("Content-Type", "image/jpeg");
-    resp->setBody(std::move(jpeg));
-    callback(resp);
+    // Annotated: without detections it is the plain snapshot, so share that slot
+    auto annotate = [camera_id, frame, plain](std::vector<Detection> detections,
+                                              SnapshotCache::Done done) {
+        if (detections.empty()) {
+            snapshot_cache_.get(camera_id, frame->frame_number, SnapshotCache::Slot::Plain,
+                                plain, std::move(done));
+        } else {
+            done(encodeSnapshot(*frame, detections));
+        }
+    };
+
+    auto result = buffer_service_->getDetectionResult(camera_id);
+    auto engine = buffer_service_->getDetectionEngine();
+    auto scheduler = buffer_service_->getInferenceScheduler();
+    snapshot_cache_.get(camera_id, frame->frame_number, SnapshotCache::Slot::Annotated,
+        [result, engine, scheduler, frame, annotate](SnapshotCache::Done done) {
+            if (result) {
+                annotate(result->detections, std::move(done));
+            } else if (!engine || !engine->isLoaded()) {
+                annotate({}, std::move(done));
+            } else if (!scheduler) {
+                annotate(engine->detect(*frame), std::move(done));
+            } else {
+                // Encode back on this request's event loop, not the scheduler thread
+                auto* loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+                scheduler->submit(frame, DetectParams{}, InferenceScheduler::Priority::Event,
+                    [loop, annotate, done](std::vector<Detection> detections) {
+                        auto encode = [annotate, done, detections = std::move(detections)] {
+                            annotate(detections, done);
+                        };
+                        if (loop) loop->queueInLoop(std::move(encode));
+                        else encode();
+                    });
+            }
+        },
+        jpegResponder(std::move(callback)));
 }
 
 }  // namespace hms
@@ -1,13 +1,22 @@
 #include "controllers/health_controller.h"
+#include "controllers/detection_controller.h"
+#include "controllers/stream_controller.h"
 #include "buffer_service.h"
+#include "db_writer.h"
 #include "event_manager.h"
+#include "file_writer.h"
+#include "jpeg_encoder.h"
 #include "mqtt_client.h"
+#include "readiness.h"
 #include "time_utils.h"
 
 #include <drogon/HttpResponse.h>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace hms {
 
 void HealthController::setBufferService(std::shared_ptr<BufferService> svc) {
@@ -22,6 +31,47 @@ void HealthController::setEventManager(std::shared_ptr<EventManager> em) {
     event_manager_ = std::move(em);
 }
 
+void HealthController::setDbWriter(std::shared_ptr<DbWriter> writer) {
+    db_writer_ = std::move(writer);
+}
+
+void HealthController::setFileWriter(std::shared_ptr<FileWriter> writer) {
+    file_writer_ = std::move(writer);
+}
+
+void HealthController::setReadiness(std::shared_ptr<const Readiness> readiness) {
+    readiness_ = std::move(readiness);
+}
+
+namespace {
+
+/// Subsystems still coming up (or failed) and how many cameras are in so far
+nlohmann::json startupJson(const Readiness* readiness,
+                           const std::vector<BufferService::CameraStats>& cameras) {
+    using json = nlohmann::json;
+    size_t connected = std::count_if(cameras.begin(), cameras.end(),
+                                     [](const auto& s) { return s.is_connected; });
+    json subsystems = json::object();
+    if (readiness) {
+        for (const auto& e : readiness->entries()) {
+            json entry = {
+                {"state", Readiness::name(e.state)},
+                {"required", e.required},
+                {"ms", std::round(e.ms)},
+            };
+            if (!e.detail.empty()) entry["detail"] = e.detail;
+            subsystems[e.name] = std::move(entry);
+        }
+    }
+    return {
+        {"ready", !readiness || readiness->ready()},
+        {"subsystems", subsystems},
+        {"cameras", {{"connected", connected}, {"total", cameras.size()}}},
+    };
+}
+
+}  // namespace
+
 void HealthController::getHealth(
     const drogon::HttpRequestPtr& /*req*/,
     std::function<void(const drogon::HttpResponsePtr&)>&& callback)
@@ -41,13 +91,41 @@ void HealthController::getHealth(
             {"buffer_size", s.buffer_size},
             {"max_frames", s.max_frames},
             {"frames_captured", s.frames_captured},
+            {"frames_converted", s.frames_converted},
             {"reconnect_count", s.reconnect_count},
             {"consecutive_failures", s.consecutive_failures},
             {"is_connected", s.is_connected},
             {"is_healthy", s.is_healthy},
             {"frame_width", s.frame_width},
             {"frame_height", s.frame_height},
+            {"hw_decode", s.hw_decode},
+            {"hw_fallbacks", s.hw_fallbacks},
+            {"replay_loops", s.replay_loops},
             {"last_frame_ms_ago", s.frames_captured > 0 ? elapsed_ms : -1},
+            {"frame_pool", {
+                {"capacity", s.pool.capacity},
+                {"available", s.pool.available},
+                {"in_use", s.pool.in_use},
+                {"spilled", s.pool.spilled},
+                {"peak_in_use", s.pool.peak_in_use},
+                {"spill_allocs", s.pool.spill_allocs},
+                {"exhausted", s.pool.exhausted},
+            }},
+            {"pixel_arena", s.arena ? json{
+                {"reserved_mb", s.arena->reserved_bytes >> 20},
+                {"slot_kb", s.arena->slot_bytes >> 10},
+                {"hugetlb", s.arena->hugetlb},
+                {"thp", s.arena->thp},
+                {"numa_node", s.arena->numa_node},
+                {"heap_fallbacks", s.arena->heap_fallbacks},
+            } : json(nullptr)},
+            {"record_stream", s.record_stream ? json{
+                {"is_connected", s.record_stream->is_connected},
+                {"frame_width", s.record_stream->frame_width},
+                {"frame_height", s.record_stream->frame_height},
+                {"packets", s.record_stream->frames_captured},
+                {"reconnect_count", s.record_stream->reconnect_count},
+            } : json(nullptr)},
         };
     }
 
@@ -59,6 +137,47 @@ void HealthController::getHealth(
         detection_json["input_size"] = std::to_string(engine->inputWidth()) + "x"
                                        + std::to_string(engine->inputHeight());
     }
+    if (engine) {
+        auto rs = engine->residencyStats();
+        detection_json["residency"] = {
+            {"active_users", rs.active_users},
+            {"idle_ttl_seconds", engine->idleTtl().count()},
+            {"loads", rs.loads},
+            {"cache_hits", rs.cache_hits},
+            {"evictions", rs.evictions},
+            {"idle_unloads", rs.idle_unloads},
+            {"last_load_ms", rs.last_load_ms},
+        };
+    }
+    if (auto scheduler = buffer_service_->getInferenceScheduler()) {
+        auto ss = scheduler->stats();
+        detection_json["scheduler"] = {
+            {"requests", ss.requests},
+            {"batches", ss.batches},
+            {"event_requests", ss.event_requests},
+            {"avg_batch_size", ss.avg_batch_size},
+            {"max_batch_size", ss.max_batch_size},
+            {"queue_depth", ss.queue_depth},
+        };
+        json sessions = json::array();
+        for (const auto& session : ss.sessions) {
+            sessions.push_back({
+                {"device", session.device >= 0 ? "cuda:" + std::to_string(session.device) : "cpu"},
+                {"threads", session.threads},
+                {"provider", providerName(session.provider)},
+                {"precision", precisionName(session.precision)},
+                {"loaded", session.loaded},
+                {"preprocess", session.gpu_preprocess ? "cuda" : "cpu"},
+                {"batches", session.batches},
+                {"frames", session.frames},
+                {"preprocess_ms", session.preprocess_ms},
+                {"busy_ms", session.busy_ms},
+                {"postprocess_ms", session.postprocess_ms},
+                {"utilization", session.utilization},
+            });
+        }
+        detection_json["scheduler"]["sessions"] = std::move(sessions);
+    }
 
     auto det_stats = buffer_service_->getDetectionStats();
     for (const auto& [cam_id, ds] : det_stats) {
@@ -67,6 +186,10 @@ void HealthController::getHealth(
             {"detections_found", ds.detections_found},
             {"avg_inference_ms", std::round(ds.avg_inference_ms * 10) / 10},
             {"is_running", ds.is_running},
+            {"frames_skipped", ds.frames_skipped},
+            {"motion_active", ds.motion_active},
+            {"motion_score", std::round(ds.motion_score * 1000) / 1000},
+            {"regions_inferred", ds.regions_inferred},
         };
 
         // Include last detection class names
@@ -74,7 +197,7 @@ void HealthController::getHealth(
         if (result && !result->detections.empty()) {
             json last_classes = json::array();
             for (const auto& d : result->detections) {
-                last_classes.push_back(d.class_name);
+                last_classes.push_back(d.name());
             }
             cam_det["last_detections"] = last_classes;
         }
@@ -90,10 +213,25 @@ void HealthController::getHealth(
         mqtt_json["connected"] = false;
         mqtt_json["note"] = "MQTT client not configured";
     }
+    if (mqtt_client_ && event_manager_) {
+        auto ps = event_manager_->publisherStats();
+        mqtt_json["publish"] = {
+            {"queued", ps.queued},
+            {"published", ps.published},
+            {"coalesced", ps.coalesced},
+            {"dropped", ps.dropped},
+            {"failures", ps.failures},
+            {"avg_latency_ms", std::round(ps.avg_latency_ms * 10) / 10},
+            {"max_latency_ms", std::round(ps.max_latency_ms * 10) / 10},
+        };
+    }
 
-    // Overall status: degraded if cameras unhealthy OR mqtt disconnected
+    // Overall status: starting until the startup thread is done, then
+    // degraded if cameras unhealthy OR mqtt disconnected
     std::string status = "healthy";
-    if (!healthy) {
+    if (readiness_ && !readiness_->ready()) {
+        status = "starting";
+    } else if (!healthy) {
         status = "degraded";
     } else if (mqtt_client_ && !mqtt_client_->isConnected()) {
         status = "degraded";
@@ -107,14 +245,104 @@ void HealthController::getHealth(
         }
     }
 
+    // Event stage executor: queue depths and latencies
+    json events_json = json::object();
+    if (event_manager_) {
+        events_json["active"] = event_manager_->activeEventCount();
+        for (const auto& stage : event_manager_->executorStats()) {
+            events_json[stage.name] = {
+                {"workers", stage.workers},
+                {"capacity", stage.capacity},
+                {"queued", stage.queued},
+                {"running", stage.running},
+                {"completed", stage.completed},
+                {"rejected", stage.rejected},
+                {"avg_wait_ms", std::round(stage.avg_wait_ms * 10) / 10},
+                {"max_wait_ms", std::round(stage.max_wait_ms * 10) / 10},
+                {"avg_run_ms", std::round(stage.avg_run_ms * 10) / 10},
+                {"max_run_ms", std::round(stage.max_run_ms * 10) / 10},
+            };
+        }
+    }
+
+    auto js = JpegEncoder::stats();
+    json jpeg_json = {
+        {"backend", js.backend},
+        {"encodes", js.encodes},
+        {"failures", js.failures},
+        {"contexts_created", js.contexts_created},
+        {"avg_encode_ms", std::round(js.avg_encode_ms * 10) / 10},
+    };
+
+    auto cs = DetectionController::snapshotCacheStats();
+    json snapshot_cache_json = {
+        {"hits", cs.hits},
+        {"misses", cs.misses},
+        {"coalesced", cs.coalesced},
+    };
+
+    // Live view fan-out; frames_dropped are chunks slow viewers missed
+    auto ls = StreamController::liveStats();
+    json live_json = {
+        {"streams", ls.streams},
+        {"subscribers", ls.subscribers},
+        {"frames_encoded", ls.frames_encoded},
+        {"bytes_encoded", ls.bytes_encoded},
+        {"chunks_sent", ls.chunks_sent},
+        {"frames_dropped", ls.frames_dropped},
+        {"frames_skipped", ls.frames_skipped},
+    };
+
+    // Write-behind DB queue (a DB outage shows here, not in `status`:
+    // detection keeps working and rows are kept for later)
+    json db_writer_json = json::object();
+    if (db_writer_) {
+        auto ds = db_writer_->stats();
+        db_writer_json = {
+            {"healthy", ds.healthy},
+            {"queued", ds.queued},
+            {"journaled", ds.journaled},
+            {"journal_bytes", ds.journal_bytes},
+            {"written", ds.written},
+            {"failures", ds.failures},
+            {"dropped", ds.dropped},
+            {"avg_flush_ms", std::round(ds.avg_flush_ms * 10) / 10},
+            {"max_flush_ms", std::round(ds.max_flush_ms * 10) / 10},
+        };
+    }
+
+    // Write-behind recording/snapshot I/O; producer_waits climbing means the
+    // disk is slower than the cameras
+    json file_writer_json = json::object();
+    if (file_writer_) {
+        auto fw = file_writer_->stats();
+        file_writer_json = {
+            {"queued_bytes", fw.queued_bytes},
+            {"queued_ops", fw.queued_ops},
+            {"bytes_written", fw.bytes_written},
+            {"files_closed", fw.files_closed},
+            {"moves", fw.moves},
+            {"failures", fw.failures},
+            {"producer_waits", fw.producer_waits},
+            {"max_op_ms", std::round(fw.max_op_ms * 10) / 10},
+        };
+    }
+
     json result = {
         {"service", "hms-detection"},
         {"status", status},
         {"timestamp", hms::time_utils::now_iso8601()},
+        {"startup", startupJson(readiness_.get(), stats)},
         {"cameras", cameras_json},
         {"detection", detection_json},
         {"mqtt", mqtt_json},
         {"paused_cameras", paused_json},
+        {"events", events_json},
+        {"jpeg", jpeg_json},
+        {"snapshot_cache", snapshot_cache_json},
+        {"live", live_json},
+        {"db_writer", db_writer_json},
+        {"file_writer", file_writer_json},
     };
 
     auto resp = drogon::HttpResponse::newHttpResponse();
@@ -124,4 +352,18 @@ void HealthController::getHealth(
     callback(resp);
 }
 
+void HealthController::getReady(
+    const drogon::HttpRequestPtr& /*req*/,
+    std::function<void(const drogon::HttpResponsePtr&)>&& callback)
+{
+    auto startup = startupJson(readiness_.get(), buffer_service_->getAllStats());
+    bool ready = startup["ready"].get<bool>();
+
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(ready ? drogon::k200OK : drogon::k503ServiceUnavailable);
+    resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    resp->setBody(startup.dump());
+    callback(resp);
+}
+
 }  // namespace hms
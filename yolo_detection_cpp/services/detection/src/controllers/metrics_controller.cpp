@@ -0,0 +1,19 @@
+#include "controllers/metrics_controller.h"
+#include "metrics.h"
+
+#include <drogon/HttpResponse.h>
+
+namespace hms {
+
+void MetricsController::getMetrics(
+    const drogon::HttpRequestPtr& /*req*/,
+    std::function<void(const drogon::HttpResponsePtr&)>&& callback)
+{
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(drogon::k200OK);
+    resp->setContentTypeString("text/plain; version=0.0.4; charset=utf-8");
+    resp->setBody(Metrics::render());
+    callback(resp);
+}
+
+}  // namespace hms
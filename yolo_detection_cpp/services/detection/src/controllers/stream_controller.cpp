@@ -0,0 +1,138 @@
+#include "controllers/stream_controller.h"
+
+#include <drogon/HttpResponse.h>
+#include <spdlog/spdlog.h>
+#include <trantor/net/TcpConnection.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+
+namespace hms {
+
+namespace {
+
+using Callback = std::function<void(const drogon::HttpResponsePtr&)>;
+
+void respondJsonError(const Callback& callback, drogon::HttpStatusCode code, std::string body) {
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(code);
+    resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    resp->setBody(std::move(body));
+    callback(resp);
+}
+
+/// A viewer's open HTTP response. Drogon queues whatever send() is given in
+/// the connection's write buffer, so the backlog is what went in minus what
+/// the socket took, sampled on the connection's loop (bytesSent() is not
+/// thread-safe).
+class HttpSubscriber : public LiveStream::Subscriber,
+                       public std::enable_shared_from_this<HttpSubscriber> {
+public:
+    HttpSubscriber(drogon::ResponseStreamPtr stream, std::weak_ptr<trantor::TcpConnection> conn)
+        : stream_(std::move(stream)), conn_(std::move(conn)) {}
+
+    ~HttpSubscriber() override { stream_->close(); }
+
+    bool send(const LiveStream::Chunk& chunk) override {
+        if (!stream_->send(*chunk)) return false;
+        queued_ += chunk->size();
+        sample();
+        return true;
+    }
+
+    bool connected() const override {
+        auto conn = conn_.lock();
+        return conn && conn->connected();
+    }
+
+    size_t backlog() const override {
+        sample();
+        size_t queued = queued_.load();
+        size_t sent = sent_.load();
+        return queued > sent ? queued - sent : 0;
+    }
+
+private:
+    void sample() const {
+        auto conn = conn_.lock();
+        if (!conn || sampling_.exchange(true)) return;
+        conn->getLoop()->queueInLoop([self = weak_from_this(), conn] {
+            auto s = self.lock();
+            if (!s) return;
+            size_t total = conn->bytesSent();
+            size_t queued = s->queued_.load();
+            // Caught up: whatever is left over is response headers and chunk framing
+            if (total - s->overhead_ >= queued) s->overhead_ = total - queued;
+            s->sent_ = total - s->overhead_;
+            s->sampling_ = false;
+        });
+    }
+
+    drogon::ResponseStreamPtr stream_;
+    std::weak_ptr<trantor::TcpConnection> conn_;
+    std::atomic<size_t> queued_{0};           // bytes given to send()
+    mutable std::atomic<size_t> sent_{0};     // of those, bytes the socket took (last sample)
+    mutable std::atomic<bool> sampling_{false};
+    mutable size_t overhead_ = 0;             // loop thread only
+};
+
+}  // namespace
+
+void StreamController::setLiveStream(std::shared_ptr<LiveStream> live) {
+    live_stream_ = std::move(live);
+}
+
+void StreamController::stream(
+    const drogon::HttpRequestPtr& req,
+    std::function<void(const drogon::HttpResponsePtr&)>&& callback,
+    const std::string& camera_id)
+{
+    auto live = live_stream_;
+    if (!live) {
+        respondJsonError(callback, drogon::k503ServiceUnavailable,
+                         R"({"error":"Live streaming disabled"})");
+        return;
+    }
+
+    LiveStream::Variant variant;
+    auto format = req->getParameter("format");
+    if (format == "mp4") {
+        variant.format = LiveStream::Format::Fmp4;
+        variant.quality = 0;  // remuxed, not encoded: every viewer shares one stream
+    } else if (format.empty() || format == "mjpeg") {
+        int quality = live->options().quality;
+        auto q = req->getParameter("quality");
+        if (!q.empty()) std::from_chars(q.data(), q.data() + q.size(), quality);
+        // Round to steps of 5 so near-identical requests share an encode
+        variant.quality = std::clamp((quality + 2) / 5 * 5, 5, 100);
+        variant.annotate = req->getParameter("annotate") == "true";
+    } else {
+        respondJsonError(callback, drogon::k400BadRequest,
+                         R"({"error":"format must be mjpeg or mp4"})");
+        return;
+    }
+
+    if (!live->canServe(camera_id, variant.format)) {
+        respondJsonError(callback, drogon::k404NotFound,
+                         R"({"error":"Camera not found or has no stream to serve"})");
+        return;
+    }
+
+    auto conn = req->getConnectionPtr();
+    auto resp = drogon::HttpResponse::newAsyncStreamResponse(
+        [live, camera_id, variant, conn](drogon::ResponseStreamPtr stream) {
+            auto subscriber = std::make_shared<HttpSubscriber>(std::move(stream), conn);
+            if (!live->subscribe(camera_id, variant, subscriber)) {
+                spdlog::debug("StreamController: [{}] live stream refused", camera_id);
+            }
+        },
+        true);  // no kickoff timeout: the response stays open as long as the viewer
+    resp->setStatusCode(drogon::k200OK);
+    resp->setContentTypeCode(drogon::CT_NONE);
+    resp->addHeader("Content-Type", LiveStream::contentType(variant));
+    resp->addHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    callback(resp);
+}
+
+}  // namespace hms
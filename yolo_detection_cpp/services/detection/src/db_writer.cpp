@@ -0,0 +1,415 @@
+#include "db_writer.h"
+#include "api_queries.h"
+#include "metrics.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace hms {
+
+namespace {
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+template <typename... Fs>
+struct Overloaded : Fs... { using Fs::operator()...; };
+template <typename... Fs>
+Overloaded(Fs...) -> Overloaded<Fs...>;
+
+json detectionsJson(const std::vector<EventLogger::DetectionRecord>& detections) {
+    json out = json::array();
+    for (const auto& d : detections) {
+        out.push_back({{"class", d.class_name}, {"confidence", d.confidence},
+                       {"bbox", {d.x1, d.y1, d.x2, d.y2}}});
+    }
+    return out;
+}
+
+std::vector<EventLogger::DetectionRecord> detectionsFrom(const json& j) {
+    std::vector<EventLogger::DetectionRecord> out;
+    for (const auto& d : j) {
+        const auto& b = d.at("bbox");
+        out.push_back({d.at("class").get<std::string>(), d.at("confidence").get<float>(),
+                       b.at(0).get<float>(), b.at(1).get<float>(),
+                       b.at(2).get<float>(), b.at(3).get<float>()});
+    }
+    return out;
+}
+
+}  // namespace
+
+DbWriter::DbWriter(std::shared_ptr<DbPool> db, Options options)
+    : DbWriter(PoolSource([db] { return db; }), std::move(options))
+{
+}
+
+DbWriter::DbWriter(PoolSource source, Options options)
+    : DbWriter([source = std::move(source)](const Row& row) {
+          auto db = source();
+          if (!db) throw std::runtime_error("database not connected");
+          std::visit(Overloaded{
+              [&](const CreateEvent& r) {
+                  EventLogger::create_event(*db, r.event_id, r.camera_id, r.recording, r.snapshot);
+              },
+              [&](const LogDetections& r) {
+                  EventLogger::log_detections(*db, r.event_id, r.detections);
+              },
+              [&](const CompleteEvent& r) {
+                  EventLogger::complete_event(*db, r.event_id, r.duration_seconds, r.frames, r.detections);
+              },
+              [&](const LogAiContext& r) {
+                  EventLogger::log_ai_context(*db, r.event_id, r.camera_id, r.context);
+              },
+              [&](const PeriodicSnapshot& r) {
+                  api_queries::insert_periodic_snapshot(*db, r.camera_id, r.filename, r.thumbnail,
+                                                        r.context, r.embedding, r.model, r.is_valid);
+              },
+          }, row);
+      }, std::move(options))
+{
+}
+
+DbWriter::DbWriter(Sink sink, Options options)
+    : sink_(std::move(sink)), options_(std::move(options))
+{
+    options_.queue = std::max(1, options_.queue);
+    options_.batch = std::max(1, options_.batch);
+    options_.flush_ms = std::max(0, options_.flush_ms);
+    options_.max_attempts = std::max(1, options_.max_attempts);
+    options_.retry_min_ms = std::max(1, options_.retry_min_ms);
+    options_.retry_max_ms = std::max(options_.retry_min_ms, options_.retry_max_ms);
+
+    // A journal left by the previous run goes out before anything new
+    if (!options_.journal_path.empty()) {
+        std::ifstream in(options_.journal_path);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) journaled_++;
+            journal_bytes_ += line.size() + 1;
+        }
+        if (journaled_ > 0) {
+            spdlog::info("DbWriter: replaying {} journaled rows from {}", journaled_, options_.journal_path);
+        }
+    }
+
+    writer_ = std::thread(&DbWriter::run, this);
+}
+
+DbWriter::~DbWriter() {
+    stop();
+}
+
+void DbWriter::submit(Row row) {
+    {
+        std::lock_guard lock(mutex_);
+        if (pending_.empty()) oldest_queued_ = Clock::now();
+        pending_.push_back(Pending{.row = std::move(row), .attempts = 0});
+    }
+    cv_.notify_one();
+}
+
+void DbWriter::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        if (stopping_ && !writer_.joinable()) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+}
+
+DbWriter::Stats DbWriter::stats() const {
+    std::lock_guard lock(mutex_);
+    Stats s = stats_;
+    s.queued = pending_.size();
+    s.journaled = journaled_;
+    s.journal_bytes = journal_bytes_;
+    s.avg_flush_ms = flushes_ > 0 ? flush_ns_total_ / 1e6 / flushes_ : 0.0;
+    return s;
+}
+
+void DbWriter::run() {
+    std::unique_lock lock(mutex_);
+    int backoff_ms = 0;                 // > 0 while writes are failing
+    Clock::time_point retry_at;
+
+    while (true) {
+        if (pending_.empty() && journaled_ == 0) {
+            if (stopping_) break;
+            cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            continue;
+        }
+
+        if (backoff_ms > 0 && !stopping_) {
+            // Failing: keep memory bounded and wait out the backoff
+            if (pending_.size() > static_cast<size_t>(options_.queue)) spillLocked(options_.queue);
+            if (Clock::now() < retry_at) {
+                cv_.wait_until(lock, retry_at);
+                continue;
+            }
+        } else if (backoff_ms == 0 && !stopping_ && journaled_ == 0
+                   && pending_.size() < static_cast<size_t>(options_.batch)) {
+            // Give more rows a moment to join the batch
+            auto deadline = oldest_queued_ + std::chrono::milliseconds(options_.flush_ms);
+            if (Clock::now() < deadline) {
+                cv_.wait_until(lock, deadline, [this] {
+                    return stopping_ || pending_.size() >= static_cast<size_t>(options_.batch);
+                });
+                continue;
+            }
+        }
+
+        // Next batch: journaled rows are older than anything in memory
+        std::vector<Pending> batch;
+        std::vector<size_t> line_bytes;
+        bool from_journal = journaled_ > 0;
+        if (from_journal) {
+            loadJournalLocked();  // fills journal_batch_ with its line sizes
+            batch = std::move(journal_batch_);
+            line_bytes = std::move(journal_line_bytes_);
+        } else {
+            size_t n = std::min(pending_.size(), static_cast<size_t>(options_.batch));
+            batch.assign(std::make_move_iterator(pending_.begin()),
+                         std::make_move_iterator(pending_.begin() + n));
+            pending_.erase(pending_.begin(), pending_.begin() + n);
+        }
+
+        lock.unlock();
+        auto start = Clock::now();
+        size_t done = 0;        // rows off the front: written, or dropped as poison
+        uint64_t written = 0, failures = 0, poisoned = 0;
+        std::string error;
+        while (done < batch.size()) {
+            if (apply(batch[done].row, error)) {
+                ++done;
+                ++written;
+                continue;
+            }
+            ++failures;
+            // A row failing max_attempts times is dropped only if the row behind
+            // it goes through, so an outage on its own never loses anything
+            std::string next_error;
+            if (++batch[done].attempts >= options_.max_attempts && done + 1 < batch.size()
+                && apply(batch[done + 1].row, next_error)) {
+                spdlog::error("DbWriter: dropping row after {} failed attempts: {}",
+                              batch[done].attempts, error);
+                done += 2;
+                ++written;
+                ++poisoned;
+                continue;
+            }
+            break;
+        }
+        auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        lock.lock();
+
+        stats_.written += written;
+        stats_.failures += failures;
+        stats_.dropped += poisoned;
+        bool failed = done < batch.size();
+
+        if (from_journal) {
+            // Consumed lines are skipped; the file goes once it's all written
+            for (size_t i = 0; i < done; ++i) journal_offset_ += line_bytes[i];
+            journaled_ -= done;
+            journal_head_attempts_ = failed ? batch[done].attempts : 0;
+            if (journaled_ == 0) {
+                std::error_code ec;
+                fs::remove(options_.journal_path, ec);
+                journal_offset_ = 0;
+                journal_bytes_ = 0;
+            }
+        } else {
+            pending_.insert(pending_.begin(), std::make_move_iterator(batch.begin() + done),
+                            std::make_move_iterator(batch.end()));
+        }
+
+        if (!failed) {
+            if (backoff_ms > 0) {
+                spdlog::info("DbWriter: database writes recovered ({} rows queued, {} journaled)",
+                             pending_.size(), journaled_);
+            }
+            backoff_ms = 0;
+            stats_.healthy = true;
+            flushes_++;
+            flush_ns_total_ += elapsed_ns;
+            stats_.max_flush_ms = std::max(stats_.max_flush_ms, elapsed_ns / 1e6);
+            continue;
+        }
+
+        if (backoff_ms == 0) {
+            spdlog::warn("DbWriter: database write failed ({}), queueing rows", error);
+        }
+        stats_.healthy = false;
+        backoff_ms = backoff_ms == 0 ? options_.retry_min_ms
+                                     : std::min(backoff_ms * 2, options_.retry_max_ms);
+        retry_at = Clock::now() + std::chrono::milliseconds(backoff_ms);
+        if (stopping_) {
+            // Last attempt at shutdown failed: keep the rest for the next run
+            spillLocked(0);
+            if (!pending_.empty()) {
+                spdlog::error("DbWriter: {} rows lost at shutdown (no journal)", pending_.size());
+            }
+            break;
+        }
+    }
+}
+
+bool DbWriter::apply(const Row& row, std::string& error) {
+    static auto& metric = Metrics::histogram(Metrics::Stage::DbWrite);
+    Metrics::Timer timer(metric);
+    try {
+        sink_(row);
+        return true;
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "unknown error";
+    }
+    return false;
+}
+
+void DbWriter::spillLocked(size_t keep) {
+    if (pending_.size() <= keep) return;
+
+    std::ofstream out;
+    if (!options_.journal_path.empty()) {
+        std::error_code ec;
+        fs::create_directories(fs::path(options_.journal_path).parent_path(), ec);
+        out.open(options_.journal_path, std::ios::app);
+    }
+
+    size_t spilled = 0, dropped = 0;
+    while (pending_.size() > keep) {
+        auto line = out ? serialize(pending_.front().row) : std::string{};
+        if (out && journal_bytes_ + line.size() + 1 <= options_.journal_max_bytes) {
+            out << line << '\n';
+            journal_bytes_ += line.size() + 1;
+            journaled_++;
+            spilled++;
+        } else {
+            dropped++;
+        }
+        pending_.pop_front();
+    }
+    out.flush();
+
+    if (spilled > 0) spdlog::warn("DbWriter: journaled {} rows ({} KB on disk)", spilled, journal_bytes_ / 1024);
+    if (dropped > 0) {
+        stats_.dropped += dropped;
+        spdlog::error("DbWriter: dropped {} rows ({})", dropped,
+                      options_.journal_path.empty() ? "no journal" : "journal full");
+    }
+}
+
+void DbWriter::loadJournalLocked() {
+    journal_batch_.clear();
+    journal_line_bytes_.clear();
+
+    std::ifstream in(options_.journal_path);
+    if (in) in.seekg(static_cast<std::streamoff>(journal_offset_));
+    std::string line;
+    while (journal_batch_.size() < static_cast<size_t>(options_.batch) && std::getline(in, line)) {
+        Row row;
+        if (!deserialize(line, row)) {
+            // Unreadable line (e.g. torn by a crash): skip it
+            spdlog::warn("DbWriter: skipping corrupt journal line");
+            journal_offset_ += line.size() + 1;
+            if (!line.empty()) {
+                journaled_--;
+                stats_.dropped++;
+            }
+            continue;
+        }
+        journal_batch_.push_back(Pending{
+            .row = std::move(row),
+            .attempts = journal_batch_.empty() ? journal_head_attempts_ : 0,
+        });
+        journal_line_bytes_.push_back(line.size() + 1);
+    }
+
+    if (journal_batch_.empty() && journaled_ > 0) {
+        // The file is gone or shorter than counted
+        spdlog::warn("DbWriter: journal {} ended early, {} rows lost", options_.journal_path, journaled_);
+        stats_.dropped += journaled_;
+        journaled_ = 0;
+        journal_offset_ = 0;
+        journal_bytes_ = 0;
+    }
+}
+
+std::string DbWriter::serialize(const Row& row) {
+    json j = std::visit(Overloaded{
+        [](const CreateEvent& r) -> json {
+            return {{"type", "create_event"}, {"event_id", r.event_id}, {"camera_id", r.camera_id},
+                    {"recording", r.recording}, {"snapshot", r.snapshot}};
+        },
+        [](const LogDetections& r) -> json {
+            return {{"type", "log_detections"}, {"event_id", r.event_id},
+                    {"detections", detectionsJson(r.detections)}};
+        },
+        [](const CompleteEvent& r) -> json {
+            return {{"type", "complete_event"}, {"event_id", r.event_id},
+                    {"duration_seconds", r.duration_seconds}, {"frames", r.frames},
+                    {"detections", r.detections}};
+        },
+        [](const LogAiContext& r) -> json {
+            const auto& c = r.context;
+            return {{"type", "log_ai_context"}, {"event_id", r.event_id}, {"camera_id", r.camera_id},
+                    {"context_text", c.context_text}, {"detected_classes", c.detected_classes},
+                    {"source_model", c.source_model}, {"prompt_used", c.prompt_used},
+                    {"response_time_seconds", c.response_time_seconds}, {"is_valid", c.is_valid}};
+        },
+        [](const PeriodicSnapshot& r) -> json {
+            return {{"type", "periodic_snapshot"}, {"camera_id", r.camera_id},
+                    {"filename", r.filename}, {"thumbnail", r.thumbnail}, {"context", r.context},
+                    {"embedding", r.embedding}, {"model", r.model}, {"is_valid", r.is_valid}};
+        },
+    }, row);
+    return j.dump();
+}
+
+bool DbWriter::deserialize(const std::string& line, Row& row) {
+    try {
+        auto j = json::parse(line);
+        auto type = j.at("type").get<std::string>();
+        auto str = [&](const char* key) { return j.at(key).get<std::string>(); };
+        if (type == "create_event") {
+            row = CreateEvent{str("event_id"), str("camera_id"), str("recording"), str("snapshot")};
+        } else if (type == "log_detections") {
+            row = LogDetections{str("event_id"), detectionsFrom(j.at("detections"))};
+        } else if (type == "complete_event") {
+            row = CompleteEvent{str("event_id"), j.at("duration_seconds").get<double>(),
+                                j.at("frames").get<int>(), j.at("detections").get<int>()};
+        } else if (type == "log_ai_context") {
+            row = LogAiContext{str("event_id"), str("camera_id"), {
+                .context_text = str("context_text"),
+                .detected_classes = j.at("detected_classes").get<std::vector<std::string>>(),
+                .source_model = str("source_model"),
+                .prompt_used = str("prompt_used"),
+                .response_time_seconds = j.at("response_time_seconds").get<double>(),
+                .is_valid = j.at("is_valid").get<bool>(),
+            }};
+        } else if (type == "periodic_snapshot") {
+            row = PeriodicSnapshot{str("camera_id"), str("filename"), str("thumbnail"), str("context"),
+                                   j.at("embedding").get<std::vector<float>>(), str("model"),
+                                   j.at("is_valid").get<bool>()};
+        } else {
+            return false;
+        }
+        return true;
+    } catch (const json::exception&) {
+        return false;
+    }
+}
+
+}  // namespace hms
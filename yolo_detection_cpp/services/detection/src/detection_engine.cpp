@@ -1,12 +1,18 @@
 #include "detection_engine.h"
+#include "metrics.h"
 
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
 #include <numeric>
-#include <unordered_set>
+#include <utility>
 
 namespace hms {
 
@@ -26,15 +32,49 @@ static const char* COCO_NAMES[] = {
     "hair drier", "toothbrush"
 };
 
-DetectionEngine::DetectionEngine(const std::string& model_path, int num_classes, bool gpu_enabled)
+namespace {
+
+bool needsGpu(ExecutionProvider provider) {
+    return provider == ExecutionProvider::Cuda || provider == ExecutionProvider::TensorRt;
+}
+
+/// Provider and precision this build/config can actually run
+SessionConfig resolveSession(SessionConfig session, bool gpu_enabled) {
+    if (needsGpu(session.provider) && (!gpu_enabled || session.device < 0)) {
+        session.provider = ExecutionProvider::Cpu;
+    }
+    if (session.precision != Precision::Fp32 && (session.provider == ExecutionProvider::Cpu ||
+                                                 session.provider == ExecutionProvider::Cuda)) {
+        spdlog::warn("DetectionEngine: {} needs the tensorrt or openvino provider, {} runs fp32",
+                     precisionName(session.precision), providerName(session.provider));
+        session.precision = Precision::Fp32;
+    }
+    return session;
+}
+
+}  // namespace
+
+DetectionEngine::DetectionEngine(const std::string& model_path, int num_classes, bool gpu_enabled,
+                                 const std::string& optimized_model_path,
+                                 const SessionConfig& session,
+                                 const std::string& provider_cache_dir)
     : env_(ORT_LOGGING_LEVEL_WARNING, "hms-detection")
     , model_path_(model_path)
-    , gpu_enabled_(gpu_enabled)
+    , session_config_(resolveSession(session, gpu_enabled))
+    , provider_cache_dir_(provider_cache_dir)
+    , optimized_model_path_(optimized_model_path)
     , num_classes_(num_classes)
 {
+    gpu_enabled_ = needsGpu(session_config_.provider);
+    // TensorRT/OpenVINO graphs hold compiled nodes ORT can't serialize; they have their own caches
+    if (session_config_.provider == ExecutionProvider::TensorRt ||
+        session_config_.provider == ExecutionProvider::OpenVino) {
+        optimized_model_path_.clear();
+    }
     initClassNames();
 
-    // Validate model by loading once, then immediately unload to free GPU
+    // Validate model by loading once, then immediately unload to free GPU.
+    // With a cache enabled this also writes the optimized graph / built engine.
     load();
     if (session_) {
         model_valid_ = true;
@@ -42,27 +82,193 @@ DetectionEngine::DetectionEngine(const std::string& model_path, int num_classes,
     }
 }
 
-void DetectionEngine::load() {
-    std::lock_guard lock(session_mutex_);
-    if (session_) return;  // already loaded
+DetectionEngine::~DetectionEngine() {
+    unload();
+}
+
+std::string DetectionEngine::engineCacheKey(const std::string& model_path) {
+    std::ifstream in(model_path, std::ios::binary);
+    if (!in) return {};
+    uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a
+    std::array<char, 1 << 16> chunk;
+    while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+        for (std::streamsize i = 0; i < in.gcount(); ++i) {
+            hash = (hash ^ static_cast<uint8_t>(chunk[i])) * 0x100000001b3ULL;
+        }
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return std::filesystem::path(model_path).stem().string() + "-" + hex;
+}
+
+std::string DetectionEngine::providerCachePath() {
+    if (!provider_cache_path_.empty()) return provider_cache_path_;
+    auto key = engineCacheKey(model_path_);
+    if (key.empty()) return {};
+    std::filesystem::path root = provider_cache_dir_.empty()
+        ? std::filesystem::path(model_path_).parent_path() / "engine_cache"
+        : std::filesystem::path(provider_cache_dir_);
+    auto dir = root / key;
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        spdlog::warn("DetectionEngine: cannot create provider cache '{}': {} (engines rebuilt every load)",
+                     dir.string(), ec.message());
+        return {};
+    }
+    provider_cache_path_ = dir.string();
+    return provider_cache_path_;
+}
+
+void DetectionEngine::appendTensorRt(Ort::SessionOptions& options) {
+    const auto& api = Ort::GetApi();
+    OrtTensorRTProviderOptionsV2* trt = nullptr;
+    Ort::ThrowOnError(api.CreateTensorRTProviderOptions(&trt));
+    std::unique_ptr<OrtTensorRTProviderOptionsV2, void (*)(OrtTensorRTProviderOptionsV2*)> guard(
+        trt, api.ReleaseTensorRTProviderOptions);
+
+    // Engines and timing caches persist per model hash; ORT names the files by the
+    // GPU's compute capability and TensorRT version, the prefix adds device + precision
+    std::vector<std::pair<std::string, std::string>> kv = {
+        {"device_id", std::to_string(session_config_.device)},
+        {"trt_fp16_enable", session_config_.precision != Precision::Fp32 ? "1" : "0"},
+        {"trt_int8_enable", session_config_.precision == Precision::Int8 ? "1" : "0"},
+    };
+    if (auto dir = providerCachePath(); !dir.empty()) {
+        kv.insert(kv.end(), {
+            {"trt_engine_cache_enable", "1"},
+            {"trt_engine_cache_path", dir},
+            {"trt_engine_cache_prefix", "gpu" + std::to_string(session_config_.device) + "_" +
+                                            precisionName(session_config_.precision)},
+            {"trt_timing_cache_enable", "1"},
+            {"trt_timing_cache_path", dir},
+        });
+        // INT8 without a QDQ model needs calibration scales next to the engines
+        if (session_config_.precision == Precision::Int8 &&
+            std::filesystem::exists(std::filesystem::path(dir) / "calibration.flatbuffers")) {
+            kv.emplace_back("trt_int8_calibration_table_name", "calibration.flatbuffers");
+        }
+    }
+    std::vector<const char*> keys, values;
+    for (const auto& [k, v] : kv) {
+        keys.push_back(k.c_str());
+        values.push_back(v.c_str());
+    }
+    Ort::ThrowOnError(api.UpdateTensorRTProviderOptions(trt, keys.data(), values.data(), keys.size()));
+    options.AppendExecutionProvider_TensorRT_V2(*trt);
+}
 
+void DetectionEngine::appendOpenVino(Ort::SessionOptions& options) {
+    std::unordered_map<std::string, std::string> ov = {
+        {"device_type", session_config_.openvino_device},
+        {"num_of_threads", std::to_string(session_config_.threads)},
+    };
+    if (session_config_.precision == Precision::Fp16) ov["precision"] = "FP16";
+    else if (session_config_.precision == Precision::Fp32) ov["precision"] = "FP32";
+    // INT8: OpenVINO runs the quantized ops of a QDQ model as they are
+    if (auto dir = providerCachePath(); !dir.empty()) ov["cache_dir"] = dir;
+    options.AppendExecutionProvider_OpenVINO_V2(ov);
+}
+
+Ort::SessionOptions DetectionEngine::makeSessionOptions(ExecutionProvider provider, bool read_cache,
+                                                        bool write_cache) {
     Ort::SessionOptions session_options;
-    session_options.SetIntraOpNumThreads(2);
-    session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+    session_options.SetIntraOpNumThreads(session_config_.threads);
+    // The cached graph is already optimized — skip straight to EP setup
+    session_options.SetGraphOptimizationLevel(read_cache
+        ? GraphOptimizationLevel::ORT_DISABLE_ALL
+        : GraphOptimizationLevel::ORT_ENABLE_ALL);
+    if (write_cache) {
+        session_options.SetOptimizedModelFilePath(optimized_model_path_.c_str());
+    }
 
-    if (gpu_enabled_) {
+    // Each provider falls back to the next one down: TensorRT -> CUDA -> CPU, OpenVINO -> CPU
+    ExecutionProvider active = ExecutionProvider::Cpu;
+    if (provider == ExecutionProvider::TensorRt) {
+        try {
+            appendTensorRt(session_options);
+            active = ExecutionProvider::TensorRt;
+            spdlog::info("TensorRT Execution Provider registered (GPU {}, {})",
+                         session_config_.device, precisionName(session_config_.precision));
+        } catch (const Ort::Exception& e) {
+            spdlog::warn("TensorRT EP unavailable, falling back to CUDA: {}", e.what());
+        }
+    }
+    if (needsGpu(provider)) {
+        // With TensorRT registered, CUDA takes the nodes TensorRT doesn't support
         OrtCUDAProviderOptions cuda_options{};
-        cuda_options.device_id = 0;
+        cuda_options.device_id = session_config_.device;
         try {
             session_options.AppendExecutionProvider_CUDA(cuda_options);
-            spdlog::info("CUDA Execution Provider registered (GPU)");
+            if (active == ExecutionProvider::Cpu) active = ExecutionProvider::Cuda;
+            spdlog::info("CUDA Execution Provider registered (GPU {})", session_config_.device);
         } catch (const Ort::Exception& e) {
             spdlog::warn("CUDA EP unavailable, falling back to CPU: {}", e.what());
         }
     }
+    if (provider == ExecutionProvider::OpenVino) {
+        try {
+            appendOpenVino(session_options);
+            active = ExecutionProvider::OpenVino;
+            spdlog::info("OpenVINO Execution Provider registered ({}, {})",
+                         session_config_.openvino_device, precisionName(session_config_.precision));
+        } catch (const Ort::Exception& e) {
+            spdlog::warn("OpenVINO EP unavailable, falling back to CPU: {}", e.what());
+        }
+    }
+    active_provider_.store(active);
+    return session_options;
+}
+
+void DetectionEngine::load() {
+    std::lock_guard lock(session_mutex_);
+    if (session_) return;  // already loaded
+
+    auto t_load = SteadyClock::now();
+
+    // Optimized model cache: reuse the serialized graph if it is newer than the
+    // source model, otherwise optimize from scratch and write it out.
+    enum class Cache { None, Read, Write };
+    Cache cache = Cache::None;
+    if (!optimized_model_path_.empty()) {
+        std::error_code cache_ec, model_ec;
+        auto cache_time = std::filesystem::last_write_time(optimized_model_path_, cache_ec);
+        auto model_time = std::filesystem::last_write_time(model_path_, model_ec);
+        cache = (!cache_ec && !model_ec && cache_time >= model_time) ? Cache::Read : Cache::Write;
+    }
+
+    auto makeOptions = [this](Cache mode, ExecutionProvider provider) {
+        return makeSessionOptions(provider, mode == Cache::Read, mode == Cache::Write);
+    };
 
     try {
-        session_ = std::make_unique<Ort::Session>(env_, model_path_.c_str(), session_options);
+        auto provider = session_config_.provider;
+        try {
+            const auto& path = cache == Cache::Read ? optimized_model_path_ : model_path_;
+            session_ = std::make_unique<Ort::Session>(env_, path.c_str(), makeOptions(cache, provider));
+        } catch (const Ort::Exception& e) {
+            auto active = active_provider_.load();
+            bool compiled = active == ExecutionProvider::TensorRt || active == ExecutionProvider::OpenVino;
+            if (cache == Cache::None && !compiled) throw;
+            if (cache != Cache::None) {
+                // Stale/incompatible cache (ORT upgrade, different EP) or unwritable
+                // cache dir — load the source model directly; a bad cache is rebuilt next load
+                spdlog::warn("Optimized model cache '{}' unusable ({}), loading source model",
+                             optimized_model_path_, e.what());
+                if (cache == Cache::Read) {
+                    std::error_code ec;
+                    std::filesystem::remove(optimized_model_path_, ec);
+                }
+                cache = Cache::None;
+            } else {
+                // Engine build failed (unsupported op, INT8 without calibration, out of memory)
+                provider = needsGpu(provider) ? ExecutionProvider::Cuda : ExecutionProvider::Cpu;
+                spdlog::warn("{} session failed ({}), retrying on {}",
+                             providerName(active), e.what(), providerName(provider));
+            }
+            session_ = std::make_unique<Ort::Session>(env_, model_path_.c_str(), makeOptions(cache, provider));
+        }
+        bool from_cache = cache == Cache::Read;
 
         // Cache input/output names
         input_names_str_.clear();
@@ -91,23 +297,61 @@ void DetectionEngine::load() {
                                .GetTensorTypeAndShapeInfo()
                                .GetShape();
         if (input_shape.size() == 4) {
+            dynamic_batch_ = input_shape[0] < 0;
             input_height_ = static_cast<int>(input_shape[2]);
             input_width_ = static_cast<int>(input_shape[3]);
         }
-
-        spdlog::info("ONNX model loaded: {} (input {}x{}, {} classes, gpu={})",
-                      model_path_, input_width_, input_height_, num_classes_, gpu_enabled_);
+        input_fp16_ = session_->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetElementType()
+                      == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
+        createSlots();
+
+        double load_ms = std::chrono::duration<double, std::milli>(SteadyClock::now() - t_load).count();
+        loads_.fetch_add(1);
+        if (from_cache) cache_hits_.fetch_add(1);
+        last_load_ms_.store(load_ms);
+
+        auto active = active_provider_.load();
+        spdlog::info("ONNX model loaded: {} (input {}x{}, {} classes, device={}, provider={} {}, threads={}, batch={}, {:.0f}ms{})",
+                      model_path_, input_width_, input_height_, num_classes_,
+                      gpu_enabled_ ? "cuda:" + std::to_string(session_config_.device) : "cpu",
+                      providerName(active),
+                      precisionName(active == ExecutionProvider::TensorRt ||
+                                    active == ExecutionProvider::OpenVino
+                                        ? session_config_.precision : Precision::Fp32),
+                      session_config_.threads, dynamic_batch_ ? "dynamic" : "1", load_ms,
+                      from_cache ? ", cached graph" : "");
 
     } catch (const Ort::Exception& e) {
         spdlog::error("Failed to load ONNX model '{}': {}", model_path_, e.what());
+        {
+            std::lock_guard slot_lock(slot_mutex_);
+            free_slots_.clear();
+            slots_.clear();
+        }
         session_.reset();
     }
 }
 
 void DetectionEngine::unload() {
     std::lock_guard lock(session_mutex_);
-    if (!session_) return;
+    unloadLocked();
+}
 
+bool DetectionEngine::unloadLocked() {
+    if (!session_) return false;
+
+    {
+        std::lock_guard slot_lock(slot_mutex_);
+        if (in_flight_ > 0) {
+            unload_pending_ = true;
+            return false;
+        }
+        unload_pending_ = false;
+        free_slots_.clear();
+        slots_.clear();  // reference the session and its allocators
+    }
+    gpu_preprocess_active_.store(false);
+    slot_cv_.notify_all();  // waiting prepareBatch() calls see the session gone
     session_.reset();
     input_names_str_.clear();
     output_names_str_.clear();
@@ -115,75 +359,209 @@ void DetectionEngine::unload() {
     output_names_.clear();
 
     spdlog::info("ONNX model unloaded, GPU memory released");
+    return true;
+}
+
+void DetectionEngine::acquire() {
+    active_users_.fetch_add(1);
+    load();
+}
+
+void DetectionEngine::release() {
+    std::lock_guard lock(session_mutex_);
+    if (active_users_.load() > 0 && active_users_.fetch_sub(1) == 1) {
+        last_release_ = SteadyClock::now();
+        if (idle_ttl_.load() == 0) unloadLocked();
+    }
+}
+
+bool DetectionEngine::unloadIfIdle() {
+    std::lock_guard lock(session_mutex_);
+    auto ttl = idle_ttl_.load();
+    if (!session_ || ttl <= 0 || active_users_.load() > 0) return false;
+    if (SteadyClock::now() - last_release_ < std::chrono::seconds(ttl)) return false;
+
+    if (!unloadLocked()) return false;
+    spdlog::info("ONNX session idle for {}s, unloaded", ttl);
+    idle_unloads_.fetch_add(1);
+    return true;
+}
+
+bool DetectionEngine::evict() {
+    std::lock_guard lock(session_mutex_);
+    if (!session_ || active_users_.load() > 0) return false;
+
+    // Batches in flight finish first; the VRAM is freed when the last one does
+    if (!unloadLocked()) return false;
+    spdlog::info("ONNX session evicted to free VRAM");
+    evictions_.fetch_add(1);
+    return true;
+}
+
+DetectionEngine::ResidencyStats DetectionEngine::residencyStats() const {
+    std::lock_guard lock(session_mutex_);
+    return ResidencyStats{
+        .loaded = session_ != nullptr,
+        .active_users = active_users_.load(),
+        .loads = loads_.load(),
+        .cache_hits = cache_hits_.load(),
+        .evictions = evictions_.load(),
+        .idle_unloads = idle_unloads_.load(),
+        .last_load_ms = last_load_ms_.load(),
+    };
 }
 
 void DetectionEngine::initClassNames() {
-    class_names_.clear();
+    std::vector<std::string> names;
     int count = std::min(num_classes_, static_cast<int>(sizeof(COCO_NAMES) / sizeof(COCO_NAMES[0])));
     for (int i = 0; i < count; ++i) {
-        class_names_.push_back(COCO_NAMES[i]);
+        names.push_back(COCO_NAMES[i]);
     }
     // Pad with "classN" if num_classes > 80
     for (int i = count; i < num_classes_; ++i) {
-        class_names_.push_back("class" + std::to_string(i));
+        names.push_back("class" + std::to_string(i));
     }
+    class_table_ = ClassNames::intern(names);
 }
 
 std::vector<float> DetectionEngine::preprocess(const FrameData& frame,
                                                float& scale, float& pad_x, float& pad_y) const {
-    int img_w = frame.width;
-    int img_h = frame.height;
+    // Allocate NCHW tensor: [1, 3, input_height_, input_width_]
+    std::vector<float> tensor(static_cast<size_t>(3) * input_height_ * input_width_);
+    preprocessInto(frame, tensor.data(), scale, pad_x, pad_y);
+    return tensor;
+}
 
-    // Letterbox: scale to fit input_width_ x input_height_ maintaining aspect ratio
-    float scale_x = static_cast<float>(input_width_) / img_w;
-    float scale_y = static_cast<float>(input_height_) / img_h;
-    scale = std::min(scale_x, scale_y);
+void DetectionEngine::preprocessInto(const FrameData& frame, float* tensor,
+                                     float& scale, float& pad_x, float& pad_y) const {
+    preprocessInto(frame, Region{0, 0, frame.width, frame.height}, tensor, scale, pad_x, pad_y);
+}
 
-    int new_w = static_cast<int>(std::round(img_w * scale));
-    int new_h = static_cast<int>(std::round(img_h * scale));
+void DetectionEngine::preprocessInto(const FrameData& frame, const Region& region, float* tensor,
+                                     float& scale, float& pad_x, float& pad_y) const {
+    auto plan = letterboxPlan(region.w, region.h);
+    scale = plan->scale;
+    pad_x = plan->pad_x;
+    pad_y = plan->pad_y;
+
+    // Resize + BGR→RGB + normalize + gray padding into tensor; a crop is just
+    // an offset into the frame with the frame's stride
+    frame.ensureBgr();
+    const uint8_t* origin = frame.pixels.data()
+        + static_cast<size_t>(region.y) * frame.stride + static_cast<size_t>(region.x) * 3;
+    letterboxToTensor(*plan, origin, frame.stride, tensor);
+}
 
-    pad_x = (input_width_ - new_w) / 2.0f;
-    pad_y = (input_height_ - new_h) / 2.0f;
+std::shared_ptr<const LetterboxPlan> DetectionEngine::letterboxPlan(int src_w, int src_h) const {
+    auto mode = resize_mode_.load();
+    std::lock_guard lock(plan_mutex_);
+    for (const auto& p : plans_) {
+        if (p->src_w == src_w && p->src_h == src_h && p->mode == mode
+            && p->dst_w == input_width_ && p->dst_h == input_height_) {
+            return p;
+        }
+    }
 
-    int pad_left = static_cast<int>(std::round(pad_x));
-    int pad_top = static_cast<int>(std::round(pad_y));
+    // One plan per camera resolution, plus one per ROI / tile size; bound the
+    // cache for cameras that change resolution
+    constexpr size_t kMaxPlans = 32;
+    if (plans_.size() >= kMaxPlans) plans_.erase(plans_.begin());
 
-    // Allocate NCHW tensor: [1, 3, input_height_, input_width_]
-    size_t tensor_size = static_cast<size_t>(3) * input_height_ * input_width_;
-    std::vector<float> tensor(tensor_size, 114.0f / 255.0f);  // Fill with gray (normalized)
-
-    // Resize + BGR→RGB + normalize into tensor
-    for (int dst_y = 0; dst_y < new_h; ++dst_y) {
-        float src_yf = dst_y / scale;
-        int src_y = static_cast<int>(src_yf);
-        if (src_y >= img_h) src_y = img_h - 1;
-
-        int out_y = dst_y + pad_top;
-        if (out_y < 0 || out_y >= input_height_) continue;
-
-        for (int dst_x = 0; dst_x < new_w; ++dst_x) {
-            float src_xf = dst_x / scale;
-            int src_x = static_cast<int>(src_xf);
-            if (src_x >= img_w) src_x = img_w - 1;
-
-            int out_x = dst_x + pad_left;
-            if (out_x < 0 || out_x >= input_width_) continue;
-
-            // Source BGR24 pixel
-            const uint8_t* px = frame.pixels.data() + src_y * frame.stride + src_x * 3;
-            uint8_t b = px[0];
-            uint8_t g = px[1];
-            uint8_t r = px[2];
-
-            // NCHW layout: channel * H * W + y * W + x
-            size_t offset = static_cast<size_t>(out_y) * input_width_ + out_x;
-            tensor[0 * input_height_ * input_width_ + offset] = r / 255.0f;  // R channel
-            tensor[1 * input_height_ * input_width_ + offset] = g / 255.0f;  // G channel
-            tensor[2 * input_height_ * input_width_ + offset] = b / 255.0f;  // B channel
-        }
+    auto plan = std::make_shared<const LetterboxPlan>(
+        LetterboxPlan::make(src_w, src_h, input_width_, input_height_, mode));
+    plans_.push_back(plan);
+    return plan;
+}
+
+ClassMask DetectionEngine::classMask(const std::vector<std::string>& filter_classes) const {
+    return ClassMask::compile(*class_table_, filter_classes);
+}
+
+namespace {
+
+const ClassMask kAllClasses;
+
+/// Reusable per-thread buffers so steady-state postprocess does not allocate
+struct PostprocessScratch {
+    std::vector<float> best_score;
+    std::vector<int32_t> best_class;
+    NmsBoxes boxes;
+    std::vector<int> keep;
+};
+
+PostprocessScratch& scratch() {
+    thread_local PostprocessScratch s;
+    return s;
+}
+
+/// Shift boxes from region to frame coordinates
+std::vector<Detection> toFrame(std::vector<Detection> dets, const Region& region) {
+    if (region.x == 0 && region.y == 0) return dets;
+    auto dx = static_cast<float>(region.x), dy = static_cast<float>(region.y);
+    for (auto& d : dets) {
+        d.x1 += dx; d.x2 += dx;
+        d.y1 += dy; d.y2 += dy;
     }
+    return dets;
+}
 
-    return tensor;
+/// Reverse letterbox + clamp. Returns false for degenerate boxes.
+inline bool unletterbox(float& x1, float& y1, float& x2, float& y2,
+                        float scale, float pad_x, float pad_y, int orig_width, int orig_height) {
+    float inv = 1.0f / scale;
+    float w = static_cast<float>(orig_width);
+    float h = static_cast<float>(orig_height);
+    x1 = std::clamp((x1 - pad_x) * inv, 0.0f, w);
+    y1 = std::clamp((y1 - pad_y) * inv, 0.0f, h);
+    x2 = std::clamp((x2 - pad_x) * inv, 0.0f, w);
+    y2 = std::clamp((y2 - pad_y) * inv, 0.0f, h);
+    return x2 - x1 >= 1.0f && y2 - y1 >= 1.0f;
+}
+
+}  // namespace
+
+void NmsBoxes::clear() {
+    x1.clear(); y1.clear(); x2.clear(); y2.clear();
+    area.clear(); score.clear(); class_id.clear();
+}
+
+void NmsBoxes::push(float bx1, float by1, float bx2, float by2, float s, int cls) {
+    x1.push_back(bx1); y1.push_back(by1); x2.push_back(bx2); y2.push_back(by2);
+    area.push_back((bx2 - bx1) * (by2 - by1));
+    score.push_back(s);
+    class_id.push_back(cls);
+}
+
+void NmsBoxes::nms(float iou_threshold, std::vector<int>& keep) {
+    const size_t n = size();
+    keep.clear();
+
+    // Visit by descending score (index breaks ties so the result is deterministic)
+    order.resize(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return score[a] > score[b] || (score[a] == score[b] && a < b);
+    });
+    suppressed.assign(n, 0);
+
+    for (size_t oi = 0; oi < n; ++oi) {
+        int i = order[oi];
+        if (suppressed[i]) continue;
+        keep.push_back(i);
+
+        const float ix1 = x1[i], iy1 = y1[i], ix2 = x2[i], iy2 = y2[i], ia = area[i];
+        const int icls = class_id[i];
+        for (size_t oj = oi + 1; oj < n; ++oj) {
+            int j = order[oj];
+            if (suppressed[j] || class_id[j] != icls) continue;
+            float iw = std::max(0.0f, std::min(ix2, x2[j]) - std::max(ix1, x1[j]));
+            float ih = std::max(0.0f, std::min(iy2, y2[j]) - std::max(iy1, y1[j]));
+            float inter = iw * ih;
+            float uni = ia + area[j] - inter;
+            // inter / uni > thr without the divide
+            if (uni > 0.0f && inter > iou_threshold * uni) suppressed[j] = 1;
+        }
+    }
 }
 
 std::vector<Detection> DetectionEngine::postprocess(const float* output, int num_candidates,
@@ -191,88 +569,75 @@ std::vector<Detection> DetectionEngine::postprocess(const float* output, int num
                                                     float scale, float pad_x, float pad_y,
                                                     int orig_width, int orig_height,
                                                     const std::vector<std::string>& filter_classes) const {
-    // Output is [1, 84, 8400] = [batch, 4+num_classes, candidates]
-    // We need to iterate over candidates (columns)
-    int num_values = 4 + num_classes_;
-
-    // Build filter set
-    std::unordered_set<std::string> filter_set(filter_classes.begin(), filter_classes.end());
-    bool has_filter = !filter_set.empty();
-
-    std::vector<Detection> detections;
-
-    for (int i = 0; i < num_candidates; ++i) {
-        // Each candidate is a column: output[row * num_candidates + i]
-        float cx = output[0 * num_candidates + i];
-        float cy = output[1 * num_candidates + i];
-        float w  = output[2 * num_candidates + i];
-        float h  = output[3 * num_candidates + i];
-
-        // Find max class score
-        int best_class = -1;
-        float best_score = 0.0f;
-        for (int c = 0; c < num_classes_; ++c) {
-            float score = output[(4 + c) * num_candidates + i];
-            if (score > best_score) {
-                best_score = score;
-                best_class = c;
-            }
-        }
-
-        if (best_score < conf_threshold) continue;
+    return postprocessMasked(output, num_candidates, conf_threshold, iou_threshold,
+                             scale, pad_x, pad_y, orig_width, orig_height, classMask(filter_classes));
+}
 
-        // Class filter
-        if (has_filter && best_class >= 0 && best_class < static_cast<int>(class_names_.size())) {
-            if (filter_set.find(class_names_[best_class]) == filter_set.end()) continue;
+std::vector<Detection> DetectionEngine::postprocessMasked(const float* output, int num_candidates,
+                                                          float conf_threshold, float iou_threshold,
+                                                          float scale, float pad_x, float pad_y,
+                                                          int orig_width, int orig_height,
+                                                          const ClassMask& mask) const {
+    // Output is [1, 84, 8400] = [batch, 4+num_classes, candidates]: each row is
+    // one value for every candidate, so scan rows (contiguous) not columns.
+    const size_t n = static_cast<size_t>(num_candidates);
+    auto& sc = scratch();
+
+    // Max class score per candidate, one contiguous class row at a time.
+    // Branchless select so the compiler vectorizes the inner loop.
+    sc.best_score.assign(n, 0.0f);
+    sc.best_class.assign(n, -1);
+    float* best = sc.best_score.data();
+    int32_t* best_cls = sc.best_class.data();
+    for (int c = 0; c < num_classes_; ++c) {
+        const float* row = output + static_cast<size_t>(4 + c) * n;
+        for (size_t i = 0; i < n; ++i) {
+            bool gt = row[i] > best[i];
+            best[i] = gt ? row[i] : best[i];
+            best_cls[i] = gt ? c : best_cls[i];
         }
+    }
+
+    // Early confidence reject, then class filter, then box decode for survivors only
+    const float* cx_row = output;
+    const float* cy_row = output + n;
+    const float* w_row  = output + 2 * n;
+    const float* h_row  = output + 3 * n;
+    auto& boxes = sc.boxes;
+    boxes.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (best[i] < conf_threshold) continue;
+        int cls = best_cls[i];
+        if (!mask.allows(cls)) continue;
 
         // Convert cx,cy,w,h → x1,y1,x2,y2 in 640x640 space
-        float x1 = cx - w / 2.0f;
-        float y1 = cy - h / 2.0f;
-        float x2 = cx + w / 2.0f;
-        float y2 = cy + h / 2.0f;
-
-        // Reverse letterbox: subtract padding, divide by scale
-        x1 = (x1 - pad_x) / scale;
-        y1 = (y1 - pad_y) / scale;
-        x2 = (x2 - pad_x) / scale;
-        y2 = (y2 - pad_y) / scale;
-
-        // Clamp to image bounds
-        x1 = std::max(0.0f, std::min(x1, static_cast<float>(orig_width)));
-        y1 = std::max(0.0f, std::min(y1, static_cast<float>(orig_height)));
-        x2 = std::max(0.0f, std::min(x2, static_cast<float>(orig_width)));
-        y2 = std::max(0.0f, std::min(y2, static_cast<float>(orig_height)));
-
-        // Skip degenerate boxes
-        if (x2 - x1 < 1.0f || y2 - y1 < 1.0f) continue;
-
-        Detection det;
-        det.class_id = best_class;
-        det.class_name = (best_class >= 0 && best_class < static_cast<int>(class_names_.size()))
-                         ? class_names_[best_class] : "unknown";
-        det.confidence = best_score;
-        det.x1 = x1;
-        det.y1 = y1;
-        det.x2 = x2;
-        det.y2 = y2;
-        detections.push_back(det);
-    }
-
-    // NMS per class
-    auto keep = nms(detections, iou_threshold);
-    std::vector<Detection> result;
-    result.reserve(keep.size());
-    for (int idx : keep) {
-        result.push_back(std::move(detections[idx]));
+        float hw = w_row[i] * 0.5f;
+        float hh = h_row[i] * 0.5f;
+        float x1 = cx_row[i] - hw, y1 = cy_row[i] - hh;
+        float x2 = cx_row[i] + hw, y2 = cy_row[i] + hh;
+        if (!unletterbox(x1, y1, x2, y2, scale, pad_x, pad_y, orig_width, orig_height)) continue;
+
+        boxes.push(x1, y1, x2, y2, best[i], cls);
     }
 
-    // Sort by confidence descending
-    std::sort(result.begin(), result.end(),
-              [](const Detection& a, const Detection& b) {
-                  return a.confidence > b.confidence;
-              });
+    // NMS per class; survivors come out sorted by confidence descending
+    {
+        static auto& metric = Metrics::histogram(Metrics::Stage::Nms);
+        Metrics::Timer timer(metric);
+        boxes.nms(iou_threshold, sc.keep);
+    }
 
+    std::vector<Detection> result;
+    result.reserve(sc.keep.size());
+    for (int idx : sc.keep) {
+        result.push_back(Detection{
+            .class_id = static_cast<uint16_t>(boxes.class_id[idx]),
+            .confidence = boxes.score[idx],
+            .x1 = boxes.x1[idx], .y1 = boxes.y1[idx],
+            .x2 = boxes.x2[idx], .y2 = boxes.y2[idx],
+            .classes = class_table_,
+        });
+    }
     return result;
 }
 
@@ -281,46 +646,33 @@ std::vector<Detection> DetectionEngine::postprocessE2E(const float* output, int
                                                        float scale, float pad_x, float pad_y,
                                                        int orig_width, int orig_height,
                                                        const std::vector<std::string>& filter_classes) const {
+    return postprocessE2EMasked(output, num_detections, conf_threshold,
+                                scale, pad_x, pad_y, orig_width, orig_height, classMask(filter_classes));
+}
+
+std::vector<Detection> DetectionEngine::postprocessE2EMasked(const float* output, int num_detections,
+                                                             float conf_threshold,
+                                                             float scale, float pad_x, float pad_y,
+                                                             int orig_width, int orig_height,
+                                                             const ClassMask& mask) const {
     // Output is [1, N, 6] where each row is [x1, y1, x2, y2, confidence, class_id]
     // Already post-NMS — no need for our own NMS pass
-
-    std::unordered_set<std::string> filter_set(filter_classes.begin(), filter_classes.end());
-    bool has_filter = !filter_set.empty();
-
     std::vector<Detection> result;
 
     for (int i = 0; i < num_detections; ++i) {
         const float* row = output + i * 6;
-        float x1   = row[0];
-        float y1   = row[1];
-        float x2   = row[2];
-        float y2   = row[3];
         float conf = row[4];
-        int cls_id = static_cast<int>(row[5]);
-
         if (conf < conf_threshold) continue;
 
-        // Class filter
-        std::string cls_name = (cls_id >= 0 && cls_id < static_cast<int>(class_names_.size()))
-                               ? class_names_[cls_id] : "unknown";
-        if (has_filter && filter_set.find(cls_name) == filter_set.end()) continue;
-
-        // Reverse letterbox: subtract padding, divide by scale
-        x1 = (x1 - pad_x) / scale;
-        y1 = (y1 - pad_y) / scale;
-        x2 = (x2 - pad_x) / scale;
-        y2 = (y2 - pad_y) / scale;
-
-        // Clamp to image bounds
-        x1 = std::max(0.0f, std::min(x1, static_cast<float>(orig_width)));
-        y1 = std::max(0.0f, std::min(y1, static_cast<float>(orig_height)));
-        x2 = std::max(0.0f, std::min(x2, static_cast<float>(orig_width)));
-        y2 = std::max(0.0f, std::min(y2, static_cast<float>(orig_height)));
+        int cls_id = static_cast<int>(row[5]);
+        if (!mask.allows(cls_id)) continue;
 
-        // Skip degenerate boxes
-        if (x2 - x1 < 1.0f || y2 - y1 < 1.0f) continue;
+        float x1 = row[0], y1 = row[1], x2 = row[2], y2 = row[3];
+        if (!unletterbox(x1, y1, x2, y2, scale, pad_x, pad_y, orig_width, orig_height)) continue;
 
-        result.push_back({cls_name, cls_id, conf, x1, y1, x2, y2});
+        uint16_t id = cls_id >= 0 && cls_id < static_cast<int>(class_table_->size())
+                      ? static_cast<uint16_t>(cls_id) : kUnknownClass;
+        result.push_back({id, conf, x1, y1, x2, y2, class_table_});
     }
 
     // Sort by confidence descending
@@ -353,129 +705,440 @@ float DetectionEngine::iou(const Detection& a, const Detection& b) {
 std::vector<int> DetectionEngine::nms(const std::vector<Detection>& dets, float iou_threshold) {
     if (dets.empty()) return {};
 
-    // Group by class
-    std::unordered_map<int, std::vector<int>> class_indices;
-    for (int i = 0; i < static_cast<int>(dets.size()); ++i) {
-        class_indices[dets[i].class_id].push_back(i);
-    }
+    NmsBoxes boxes;
+    for (const auto& d : dets) boxes.push(d.x1, d.y1, d.x2, d.y2, d.confidence, d.class_id);
 
     std::vector<int> keep;
+    boxes.nms(iou_threshold, keep);
+    return keep;
+}
 
-    for (auto& [cls, indices] : class_indices) {
-        // Sort indices by confidence descending
-        std::sort(indices.begin(), indices.end(),
-                  [&dets](int a, int b) {
-                      return dets[a].confidence > dets[b].confidence;
-                  });
+void DetectionEngine::mergeRegions(std::vector<Detection>& dets, float iou_threshold) {
+    auto keep = nms(dets, iou_threshold);
+    std::vector<Detection> merged;
+    merged.reserve(keep.size());
+    for (int idx : keep) merged.push_back(dets[idx]);
+    dets = std::move(merged);
+}
 
-        std::vector<bool> suppressed(indices.size(), false);
+std::vector<Detection> DetectionEngine::detect(const FrameData& frame,
+                                               float conf_threshold,
+                                               float iou_threshold,
+                                               const std::vector<std::string>& filter_classes) {
+    std::shared_ptr<const ClassMask> classes;
+    if (!filter_classes.empty()) classes = std::make_shared<const ClassMask>(classMask(filter_classes));
+    auto results = detectBatch({&frame}, {DetectParams{conf_threshold, iou_threshold, std::move(classes)}});
+    return results.empty() ? std::vector<Detection>{} : std::move(results.front());
+}
 
-        for (size_t i = 0; i < indices.size(); ++i) {
-            if (suppressed[i]) continue;
-            keep.push_back(indices[i]);
+void DetectionEngine::HostBuffer::reserve(size_t floats, Ort::Allocator* allocator) {
+    if (floats <= capacity) return;
+    if (allocator) {
+        pinned.emplace(allocator->GetAllocation(floats * sizeof(float)));
+        data = static_cast<float*>(pinned->get());
+    } else {
+        host.resize(floats);
+        data = host.data();
+    }
+    capacity = floats;
+}
 
-            for (size_t j = i + 1; j < indices.size(); ++j) {
-                if (suppressed[j]) continue;
-                if (iou(dets[indices[i]], dets[indices[j]]) > iou_threshold) {
-                    suppressed[j] = true;
-                }
+void DetectionEngine::createSlots() {
+    std::vector<std::unique_ptr<Binding>> slots;
+    bool pinned = false;
+
+    // GPU letterbox: the tensor is written in device memory, so only the
+    // source picture crosses the bus. Needs the session on a CUDA device.
+    auto active = active_provider_.load();
+    bool gpu = gpu_preprocess_.load() && gpu_enabled_
+               && (active == ExecutionProvider::Cuda || active == ExecutionProvider::TensorRt);
+    if (gpu_preprocess_.load() && (!gpu || !GpuLetterbox::available(session_config_.device))) {
+        spdlog::warn("GPU preprocessing unavailable ({}), letterboxing on the CPU",
+                     gpu ? "no CUDA device in this build" : "session is not on a CUDA device");
+        gpu = false;
+    }
+    for (int i = 0; i < pipeline_depth_.load(); ++i) {
+        auto binding = std::make_unique<Binding>();
+        binding->io = std::make_unique<Ort::IoBinding>(*session_);
+
+        // Pinned host memory makes the CUDA EP's H2D/D2H copies DMA transfers.
+        // Not available on CPU-only sessions (or if the CUDA EP failed to register).
+        if (gpu_enabled_) {
+            try {
+                Ort::MemoryInfo pinned_info("CudaPinned", OrtDeviceAllocator, session_config_.device,
+                                            OrtMemTypeCPUOutput);
+                binding->pinned = std::make_unique<Ort::Allocator>(*session_, pinned_info);
+                binding->memory_info = std::move(pinned_info);
+            } catch (const Ort::Exception& e) {
+                spdlog::debug("CUDA pinned allocator unavailable, binding host memory: {}", e.what());
+            }
+        }
+        if (!binding->pinned) {
+            binding->memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        }
+        pinned = binding->pinned != nullptr;
+
+        if (gpu) {
+            try {
+                binding->gpu = std::make_unique<GpuLetterbox>(session_config_.device);
+                binding->device_info = Ort::MemoryInfo("Cuda", OrtDeviceAllocator, session_config_.device,
+                                                       OrtMemTypeDefault);
+            } catch (const std::exception& e) {
+                spdlog::warn("GPU preprocessing unavailable ({}), letterboxing on the CPU", e.what());
+                for (auto& slot : slots) slot->gpu.reset();
+                binding->gpu.reset();
+                gpu = false;
             }
         }
+
+        // Static output dims ([N, 84, 8400] / [N, 300, 6]) let us preallocate the output too
+        binding->output_dims = session_->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        binding->static_output = binding->output_dims.size() == 3
+            && binding->output_dims[1] > 0 && binding->output_dims[2] > 0;
+        slots.push_back(std::move(binding));
     }
 
-    return keep;
+    if (input_fp16_ && !gpu) {
+        spdlog::warn("Model input is float16: only the GPU letterbox (preprocess.gpu) writes it");
+    }
+    spdlog::info("IoBinding: {} slot(s), {} host buffers, input {}, output {}", slots.size(),
+                 pinned ? "pinned" : "pageable",
+                 gpu ? (input_fp16_ ? "on device (GPU letterbox, fp16)" : "on device (GPU letterbox)") : "host",
+                 slots.front()->static_output ? "preallocated" : "ORT-allocated");
+    gpu_preprocess_active_.store(gpu);
+
+    std::lock_guard slot_lock(slot_mutex_);
+    slots_ = std::move(slots);
+    free_slots_.clear();
+    for (const auto& slot : slots_) free_slots_.push_back(slot.get());
 }
 
-std::vector<Detection> DetectionEngine::detect(const FrameData& frame,
-                                               float conf_threshold,
-                                               float iou_threshold,
-                                               const std::vector<std::string>& filter_classes) {
+void DetectionEngine::reserveSlot(Binding& binding, size_t inputs) {
+    const size_t plane = static_cast<size_t>(3) * input_height_ * input_width_;
+    auto* allocator = binding.pinned.get();
+    if (binding.gpu) {
+        void* tensor = binding.gpu->reserveTensor(plane * inputs * (input_fp16_ ? 2 : sizeof(float)));
+        if (tensor != binding.device_input) binding.bound_batch = 0;
+        binding.device_input = tensor;  // null if the device is out of memory
+    } else if (plane * inputs > binding.input.capacity) {
+        binding.input.reserve(plane * inputs, allocator);
+        binding.bound_batch = 0;  // buffer moved: rebind
+    }
+    if (binding.static_output) {
+        size_t out = static_cast<size_t>(binding.output_dims[1]) * binding.output_dims[2] * inputs;
+        if (out > binding.output.capacity) {
+            binding.output.reserve(out, allocator);
+            binding.bound_batch = 0;
+        }
+    }
+}
+
+void DetectionEngine::bindBatch(Binding& binding, size_t offset, size_t n) {
+    // Same buffers, same view — nothing to do
+    if (binding.bound_batch == n && binding.bound_offset == offset) return;
+
+    binding.io->ClearBoundInputs();
+    binding.io->ClearBoundOutputs();
+
+    const size_t plane = static_cast<size_t>(3) * input_height_ * input_width_;
+    std::array<int64_t, 4> input_shape = {static_cast<int64_t>(n), 3, input_height_, input_width_};
+    if (binding.gpu) {
+        size_t bytes = plane * (input_fp16_ ? 2 : sizeof(float));
+        binding.input_value = Ort::Value::CreateTensor(
+            binding.device_info, static_cast<uint8_t*>(binding.device_input) + offset * bytes, bytes * n,
+            input_shape.data(), input_shape.size(),
+            input_fp16_ ? ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 : ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+    } else {
+        binding.input_value = Ort::Value::CreateTensor<float>(
+            binding.memory_info, binding.input.data + offset * plane, plane * n,
+            input_shape.data(), input_shape.size());
+    }
+    binding.io->BindInput(input_names_[0], binding.input_value);
+
+    // Only output 0 is consumed; leaving the rest unbound skips fetching them
+    if (binding.static_output) {
+        std::array<int64_t, 3> output_shape = {static_cast<int64_t>(n),
+                                               binding.output_dims[1], binding.output_dims[2]};
+        size_t item = static_cast<size_t>(output_shape[1]) * output_shape[2];
+        binding.output_value = Ort::Value::CreateTensor<float>(
+            binding.memory_info, binding.output.data + offset * item, item * n,
+            output_shape.data(), output_shape.size());
+        binding.io->BindOutput(output_names_[0], binding.output_value);
+    } else {
+        binding.io->BindOutput(output_names_[0], binding.memory_info);
+    }
+    binding.bound_offset = offset;
+    binding.bound_batch = n;
+}
+
+DetectionEngine::BatchJob& DetectionEngine::BatchJob::operator=(BatchJob&& other) noexcept {
+    if (this == &other) return *this;
+    if (engine_ && slot_) engine_->releaseSlot(*this);
+    engine_ = std::exchange(other.engine_, nullptr);
+    slot_ = std::exchange(other.slot_, nullptr);
+    params_ = std::move(other.params_);
+    inputs_ = std::move(other.inputs_);
+    tiled_ = std::move(other.tiled_);
+    outputs_ = std::move(other.outputs_);
+    ran_ = std::exchange(other.ran_, false);
+    return *this;
+}
+
+DetectionEngine::BatchJob::~BatchJob() {
+    if (engine_ && slot_) engine_->releaseSlot(*this);
+}
+
+void DetectionEngine::releaseSlot(BatchJob& job) {
+    job.outputs_.clear();  // ORT-allocated: free before the session can go
+    bool unload = false;
+    {
+        std::lock_guard slot_lock(slot_mutex_);
+        free_slots_.push_back(std::exchange(job.slot_, nullptr));
+        unload = --in_flight_ == 0 && unload_pending_;
+    }
+    slot_cv_.notify_one();
+    if (unload) {
+        // Deferred release()/evict(): only if nobody pinned the session since
+        std::lock_guard lock(session_mutex_);
+        if (active_users_.load() == 0) {
+            unloadLocked();
+        } else {
+            std::lock_guard slot_lock(slot_mutex_);
+            unload_pending_ = false;
+        }
+    }
+}
+
+DetectionEngine::BatchJob DetectionEngine::prepareBatch(const std::vector<const FrameData*>& frames,
+                                                        const std::vector<DetectParams>& params) {
+    assert(frames.size() == params.size());
+    BatchJob job;
+    job.params_ = params;
+    job.tiled_.assign(frames.size(), 0);
+
+    // Skip frames with no pixels; they keep an empty result. Conversion from the
+    // decoder's format happens here, outside the session lock (the GPU
+    // letterbox reads unconverted frames' planes itself).
+    // Each frame contributes one input per region (ROI / tile), or one for the whole frame
+    const bool gpu = gpu_preprocess_active_.load();
+    job.inputs_.reserve(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const auto* f = frames[i];
+        if (!f || (!(gpu && f->isPendingBgr()) && !f->ensureBgr())) continue;
+        const auto* regions = params[i].regions.get();
+        if (!regions || regions->empty()) {
+            job.inputs_.push_back({i, Region{0, 0, f->width, f->height}, {}});
+            continue;
+        }
+        for (const auto& r : *regions) {
+            // Regions computed for another resolution are clipped to this frame
+            int x = std::clamp(r.x, 0, f->width), y = std::clamp(r.y, 0, f->height);
+            Region clipped{x, y, std::min(r.w, f->width - x), std::min(r.h, f->height - y)};
+            if (clipped.w > 0 && clipped.h > 0) job.inputs_.push_back({i, clipped, {}});
+        }
+        job.tiled_[i] = regions->size() > 1;
+    }
+    if (job.inputs_.empty()) return job;
+
+    // A free slot of the loaded session; waits while every slot is in flight
+    {
+        std::unique_lock slot_lock(slot_mutex_);
+        slot_cv_.wait(slot_lock, [this] { return !free_slots_.empty() || slots_.empty(); });
+        if (slots_.empty()) return job;  // not loaded
+        job.slot_ = free_slots_.back();
+        free_slots_.pop_back();
+        ++in_flight_;
+    }
+    job.engine_ = this;
+
+    // Letterbox every input straight into the slot's input buffer
+    auto& binding = *job.slot_;
+    reserveSlot(binding, job.inputs_.size());
+    if (binding.gpu) {
+        if (!letterboxOnGpu(binding, job, frames)) job = BatchJob{};  // frames get no detections
+        return job;
+    }
+    const size_t plane = static_cast<size_t>(3) * input_height_ * input_width_;
+    for (size_t k = 0; k < job.inputs_.size(); ++k) {
+        auto& in = job.inputs_[k];
+        preprocessInto(*frames[in.frame], in.region, binding.input.data + k * plane,
+                       in.lb.scale, in.lb.pad_x, in.lb.pad_y);
+    }
+    return job;
+}
+
+bool DetectionEngine::letterboxOnGpu(Binding& binding, BatchJob& job,
+                                     const std::vector<const FrameData*>& frames) {
+    const size_t bytes = static_cast<size_t>(3) * input_height_ * input_width_ * (input_fp16_ ? 2 : sizeof(float));
+    auto* tensor = static_cast<uint8_t*>(binding.device_input);
+    bool ok = tensor != nullptr;
+    for (size_t k = 0; ok && k < job.inputs_.size(); ++k) {
+        auto& in = job.inputs_[k];
+        const auto& frame = *frames[in.frame];
+        auto plan = letterboxPlan(in.region.w, in.region.h);
+        in.lb = {plan->scale, plan->pad_x, plan->pad_y};
+        void* dst = tensor + k * bytes;
+
+        // Decoder planes while nobody has needed BGR yet: the frame may never
+        // be converted at all. Otherwise the BGR pixels.
+        bool native = frame.withYuv420([&](const YuvPlanes& yuv) {
+            ok = binding.gpu->fromYuv(plan, yuv, in.region, dst, input_fp16_);
+        });
+        if (!native) {
+            ok = frame.ensureBgr()
+                ? binding.gpu->fromBgr(plan, frame.pixels.data(), frame.stride, in.region, dst, input_fp16_)
+                : binding.gpu->fill(input_width_, input_height_, dst, input_fp16_);
+        }
+    }
+    ok = binding.gpu->synchronize() && ok;  // the session reads on its own stream
+    if (!ok && !gpu_error_logged_.exchange(true)) {
+        spdlog::error("GPU letterbox failed for {} input(s); those frames get no detections",
+                      job.inputs_.size());
+    }
+    return ok;
+}
+
+void DetectionEngine::runBatch(BatchJob& job) {
+    if (job.empty()) return;
+    auto& binding = *job.slot_;
+
     std::lock_guard lock(session_mutex_);
-    if (!session_) return {};
-    if (frame.pixels.empty() || frame.width <= 0 || frame.height <= 0) return {};
-
-    // Preprocess
-    float scale, pad_x, pad_y;
-    auto tensor_data = preprocess(frame, scale, pad_x, pad_y);
-
-    // Create input tensor
-    std::array<int64_t, 4> input_shape = {1, 3, input_height_, input_width_};
-    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-    auto input_tensor = Ort::Value::CreateTensor<float>(
-        memory_info, tensor_data.data(), tensor_data.size(),
-        input_shape.data(), input_shape.size());
-
-    // Run inference
-    auto output_tensors = session_->Run(
-        Ort::RunOptions{nullptr},
-        input_names_.data(), &input_tensor, 1,
-        output_names_.data(), output_names_.size());
-
-    // Get output tensor
-    auto& output_tensor = output_tensors[0];
-    auto output_shape = output_tensor.GetTensorTypeAndShapeInfo().GetShape();
-    const float* output_data = output_tensor.GetTensorMutableData<float>();
-
-    // Validate output tensor shape — must be 3D: [1, ?, ?]
-    if (output_shape.size() != 3 || output_shape[0] != 1) {
-        if (!format_error_logged_) {
-            spdlog::error("Unsupported ONNX output shape: [{}]. "
-                          "Expected [1, C, N] (YOLOv8/v9/v11) or [1, N, 6] (YOLO26). "
-                          "Supported models: YOLOv8, YOLOv9, YOLO11, YOLO26 (Ultralytics). "
-                          "Export with: yolo export model=<model>.pt format=onnx imgsz=640",
-                          fmt::join(output_shape, ", "));
-            format_error_logged_ = true;
+    // Fixed-batch models get one Run per input; dynamic-batch models one Run total
+    size_t total = job.inputs_.size();
+    size_t chunk = dynamic_batch_ ? total : 1;
+    for (size_t begin = 0; begin < total; begin += chunk) {
+        size_t n = std::min(chunk, total - begin);
+        bindBatch(binding, begin, n);
+        session_->Run(Ort::RunOptions{nullptr}, *binding.io);
+        // Preallocated outputs land in the slot; otherwise keep ORT's tensor
+        if (!binding.static_output) job.outputs_.push_back(std::move(binding.io->GetOutputValues()[0]));
+    }
+    job.ran_ = true;
+}
+
+std::vector<std::vector<Detection>> DetectionEngine::finishBatch(BatchJob& job) {
+    std::vector<std::vector<Detection>> results(job.params_.size());
+    if (job.empty() || !job.ran_) {
+        job = BatchJob{};
+        return results;
+    }
+    auto& binding = *job.slot_;
+
+    size_t total = job.inputs_.size();
+    size_t chunk = binding.static_output ? total : total / std::max<size_t>(1, job.outputs_.size());
+    for (size_t begin = 0, run = 0; begin < total; begin += chunk, ++run) {
+        size_t n = std::min(chunk, total - begin);
+
+        // Preallocated output: shape is known up front. Otherwise ORT allocated it.
+        std::vector<int64_t> output_shape;
+        const float* output_data = nullptr;
+        size_t first = 0;  // index of input `begin` within output_data
+        if (binding.static_output) {
+            output_shape = {static_cast<int64_t>(total), binding.output_dims[1], binding.output_dims[2]};
+            output_data = binding.output.data;
+            first = begin;
+        } else {
+            output_shape = job.outputs_[run].GetTensorTypeAndShapeInfo().GetShape();
+            output_data = job.outputs_[run].GetTensorMutableData<float>();
+        }
+
+        // Validate output tensor shape — must be 3D: [N, ?, ?]
+        if (output_shape.size() != 3 || output_shape[0] != static_cast<int64_t>(binding.static_output ? total : n)) {
+            if (!format_error_logged_.exchange(true)) {
+                spdlog::error("Unsupported ONNX output shape: [{}]. "
+                              "Expected [N, C, K] (YOLOv8/v9/v11) or [N, K, 6] (YOLO26). "
+                              "Supported models: YOLOv8, YOLOv9, YOLO11, YOLO26 (Ultralytics). "
+                              "Export with: yolo export model=<model>.pt format=onnx imgsz=640",
+                              fmt::join(output_shape, ", "));
+            }
+            job = BatchJob{};
+            return results;
+        }
+
+        for (size_t k = 0; k < n; ++k) {
+            const auto& in = job.inputs_[begin + k];
+            auto dets = decodeOutput(output_data, output_shape, first + k, in.region,
+                                     in.lb, job.params_[in.frame]);
+            auto& out = results[in.frame];
+            if (out.empty()) {
+                out = std::move(dets);
+            } else {
+                out.insert(out.end(), dets.begin(), dets.end());
+            }
         }
-        return {};
     }
 
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (job.tiled_[i] && results[i].size() > 1) mergeRegions(results[i], job.params_[i].iou_threshold);
+    }
+    job = BatchJob{};  // slot back to the ring
+    return results;
+}
+
+std::vector<std::vector<Detection>> DetectionEngine::detectBatch(
+        const std::vector<const FrameData*>& frames,
+        const std::vector<DetectParams>& params) {
+    auto job = prepareBatch(frames, params);
+    runBatch(job);
+    return finishBatch(job);
+}
+
+std::vector<Detection> DetectionEngine::decodeOutput(const float* output_data,
+                                                     const std::vector<int64_t>& output_shape,
+                                                     size_t index, const Region& region,
+                                                     const Letterbox& lb, const DetectParams& params) {
+    const size_t item_stride = static_cast<size_t>(output_shape[1]) * output_shape[2];
+    const float* item = output_data + index * item_stride;
+
     // Detect output format:
-    //   YOLOv8/v9/v11 raw:  [1, 4+num_classes, num_candidates] e.g. [1, 84, 8400]
-    //   YOLO26 end-to-end:  [1, max_detections, 6]  e.g. [1, 300, 6]
+    //   YOLOv8/v9/v11 raw:  [N, 4+num_classes, num_candidates] e.g. [1, 84, 8400]
+    //   YOLO26 end-to-end:  [N, max_detections, 6]  e.g. [1, 300, 6]
     bool is_e2e = output_shape[2] == 6;
 
     if (is_e2e) {
         int num_detections = static_cast<int>(output_shape[1]);
-        if (!e2e_logged_) {
-            spdlog::info("Model output: end-to-end [1, {}, 6] — using postprocessE2E (no manual NMS)", num_detections);
-            e2e_logged_ = true;
+        if (!e2e_logged_.exchange(true)) {
+            spdlog::info("Model output: end-to-end [{}, {}, 6] — using postprocessE2E (no manual NMS)",
+                         output_shape[0], num_detections);
         }
         if (num_detections == 0) return {};
-        return postprocessE2E(output_data, num_detections,
-                              conf_threshold, scale, pad_x, pad_y,
-                              frame.width, frame.height, filter_classes);
+        return toFrame(postprocessE2EMasked(item, num_detections,
+                                            params.conf_threshold, lb.scale, lb.pad_x, lb.pad_y,
+                                            region.w, region.h,
+                                            params.classes ? *params.classes : kAllClasses),
+                       region);
     }
 
     // Validate raw format: dim1 should be 4+num_classes
     int expected_values = 4 + num_classes_;
     if (output_shape[1] != expected_values) {
-        if (!format_error_logged_) {
-            spdlog::error("Unexpected ONNX output shape [1, {}, {}]. "
+        if (!format_error_logged_.exchange(true)) {
+            spdlog::error("Unexpected ONNX output shape [{}, {}, {}]. "
                           "Expected dim1={} (4 + {} classes) for raw YOLO output. "
                           "Supported models: YOLOv8, YOLOv9, YOLO11, YOLO26 (Ultralytics). "
                           "If using a custom-trained model, set num_classes in config.",
-                          output_shape[1], output_shape[2], expected_values, num_classes_);
-            format_error_logged_ = true;
+                          output_shape[0], output_shape[1], output_shape[2],
+                          expected_values, num_classes_);
         }
         return {};
     }
 
-    if (!raw_logged_) {
-        spdlog::info("Model output: raw [1, {}, {}] — using postprocess with manual NMS",
-                     output_shape[1], output_shape[2]);
-        raw_logged_ = true;
+    if (!raw_logged_.exchange(true)) {
+        spdlog::info("Model output: raw [{}, {}, {}] — using postprocess with manual NMS",
+                     output_shape[0], output_shape[1], output_shape[2]);
     }
 
-    // Raw format [1, num_values, num_candidates] — YOLOv8, v9, v11
+    // Raw format [N, num_values, num_candidates] — YOLOv8, v9, v11
     int num_candidates = static_cast<int>(output_shape[2]);
 
     if (num_candidates == 0) return {};
 
-    return postprocess(output_data, num_candidates,
-                       conf_threshold, iou_threshold,
-                       scale, pad_x, pad_y,
-                       frame.width, frame.height,
-                       filter_classes);
+    return toFrame(postprocessMasked(item, num_candidates,
+                                     params.conf_threshold, params.iou_threshold,
+                                     lb.scale, lb.pad_x, lb.pad_y,
+                                     region.w, region.h,
+                                     params.classes ? *params.classes : kAllClasses),
+                   region);
 }
 
 }  // namespace hms
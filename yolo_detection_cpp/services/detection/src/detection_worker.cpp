@@ -3,30 +3,36 @@
 #include <spdlog/spdlog.h>
 
 #include <chrono>
+#include <utility>
 
 namespace hms {
 
 DetectionWorker::DetectionWorker(const std::string& camera_id,
                                  std::shared_ptr<CameraBuffer> buffer,
-                                 std::shared_ptr<DetectionEngine> engine,
+                                 std::shared_ptr<InferenceScheduler> scheduler,
                                  const hms::CameraConfig& camera_config,
-                                 const hms::DetectionConfig& detection_config)
+                                 const hms::DetectionConfig& detection_config,
+                                 std::shared_ptr<const ClassMask> class_filter,
+                                 const SamplingConfig& sampling,
+                                 const TilingConfig& tiling,
+                                 MotionHandler on_motion)
     : camera_id_(camera_id)
     , buffer_(std::move(buffer))
-    , engine_(std::move(engine))
-    , confidence_threshold_(static_cast<float>(
-          camera_config.confidence_threshold > 0
-              ? camera_config.confidence_threshold
-              : detection_config.confidence_threshold))
-    , iou_threshold_(static_cast<float>(detection_config.iou_threshold))
-    , sample_interval_ms_(333)  // ~3 fps sampling
+    , scheduler_(std::move(scheduler))
+    , sampling_(sampling)
+    , motion_(MotionDetector::Options{
+          .cell_threshold = sampling.cell_threshold,
+          .min_changed = sampling.min_changed,
+      })
+    , on_motion_(std::move(on_motion))
+    , tiling_(tiling)
 {
-    // Use camera-specific classes if set, otherwise global detection classes
-    if (!camera_config.classes.empty()) {
-        filter_classes_ = camera_config.classes;
-    } else {
-        filter_classes_ = detection_config.classes;
-    }
+    params_.conf_threshold = static_cast<float>(
+        camera_config.confidence_threshold > 0
+            ? camera_config.confidence_threshold
+            : detection_config.confidence_threshold);
+    params_.iou_threshold = static_cast<float>(detection_config.iou_threshold);
+    params_.classes = std::move(class_filter);
 }
 
 DetectionWorker::~DetectionWorker() {
@@ -36,8 +42,15 @@ DetectionWorker::~DetectionWorker() {
 void DetectionWorker::start() {
     if (running_.exchange(true)) return;
     thread_ = std::thread(&DetectionWorker::detectionLoop, this);
-    spdlog::info("[{}] Detection worker started (conf={:.2f}, iou={:.2f}, interval={}ms)",
-                 camera_id_, confidence_threshold_, iou_threshold_, sample_interval_ms_);
+    if (sampling_.motion_gating) {
+        spdlog::info("[{}] Detection worker started (conf={:.2f}, iou={:.2f}, interval={}ms idle / {}ms on motion)",
+                     camera_id_, params_.conf_threshold, params_.iou_threshold,
+                     sampling_.idle_interval_ms, sampling_.burst_interval_ms);
+    } else {
+        spdlog::info("[{}] Detection worker started (conf={:.2f}, iou={:.2f}, interval={}ms)",
+                     camera_id_, params_.conf_threshold, params_.iou_threshold,
+                     sampling_.burst_interval_ms);
+    }
 }
 
 void DetectionWorker::stop() {
@@ -57,25 +70,71 @@ DetectionWorker::Stats DetectionWorker::stats() const {
         .detections_found = detections_found_.load(),
         .avg_inference_ms = avg_inference_ms_.load(),
         .is_running = running_.load(),
+        .frames_skipped = frames_skipped_.load(),
+        .motion_active = motion_active_.load(),
+        .motion_score = motion_score_.load(),
+        .regions_inferred = regions_inferred_.load(),
     };
 }
 
 void DetectionWorker::detectionLoop() {
-    uint64_t last_frame_number = 0;
+    // Upper bound on one wait, so stop() is noticed without a frame arriving
+    constexpr auto kWaitSlice = std::chrono::milliseconds(100);
+    const auto burst_interval = std::chrono::milliseconds(sampling_.burst_interval_ms);
+    const auto idle_interval = std::chrono::milliseconds(sampling_.idle_interval_ms);
+    const auto burst_hold = std::chrono::milliseconds(sampling_.burst_hold_ms);
+
+    uint64_t last_seq = 0;
     double total_inference_ms = 0;
+    SteadyClock::time_point last_inference{};
+    SteadyClock::time_point burst_until{};
+
+    // Burst while the scene changed within burst_hold; report the edges
+    auto updateActivity = [&](SteadyClock::time_point now) {
+        bool active = !sampling_.motion_gating || now < burst_until;
+        if (active != motion_active_.exchange(active) && sampling_.motion_gating) {
+            spdlog::info("[{}] Scene {}", camera_id_, active ? "changing: burst sampling" : "static: idle sampling");
+            if (on_motion_) on_motion_(camera_id_, active);
+        }
+        return active;
+    };
 
     while (running_) {
-        auto frame = buffer_->getLatestFrame();
-        if (!frame || frame->frame_number == last_frame_number) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(sample_interval_ms_));
+        // Wakes as soon as capture pushes a frame newer than the last one seen
+        auto [frame, seq] = buffer_->waitForFrame(last_seq, SteadyClock::now() + kWaitSlice);
+        if (!frame) {
+            updateActivity(SteadyClock::now());  // camera stalled: let a burst run out
+            continue;
+        }
+        last_seq = seq;
+
+        // Every frame feeds the motion detector (a few thousand luma reads);
+        // only the sampled ones reach the scheduler
+        if (sampling_.motion_gating) {
+            auto motion = motion_.update(*frame);
+            motion_score_.store(motion.changed);
+            if (motion.motion) {
+                burst_until = SteadyClock::now() + burst_hold;
+                pending_cells_ |= motion_.changedCells();
+            }
+        }
+        auto now = SteadyClock::now();
+        bool active = updateActivity(now);
+        if (now - last_inference < (active ? burst_interval : idle_interval)) {
+            frames_skipped_.fetch_add(1);
             continue;
         }
+        last_inference = now;
 
-        last_frame_number = frame->frame_number;
         auto start = std::chrono::steady_clock::now();
 
-        auto detections = engine_->detect(*frame, confidence_threshold_,
-                                          iou_threshold_, filter_classes_);
+        DetectParams params = params_;
+        params.regions = regionsFor(*frame);
+        if (params.regions) regions_inferred_.fetch_add(params.regions->size());
+
+        // Batched with the other cameras by the scheduler; blocks until this frame's result
+        auto detections = scheduler_->submit(frame, params,
+                                             InferenceScheduler::Priority::Continuous).get();
 
         auto elapsed = std::chrono::steady_clock::now() - start;
         double ms = std::chrono::duration<double, std::milli>(elapsed).count();
@@ -96,14 +155,34 @@ void DetectionWorker::detectionLoop() {
 
         total_inference_ms += ms;
         avg_inference_ms_.store(total_inference_ms / count);
+    }
+}
+
+std::shared_ptr<const std::vector<Region>> DetectionWorker::regionsFor(const FrameData& frame) {
+    auto changed = std::exchange(pending_cells_, {});
+    if (!tiling_.enabled()) return nullptr;
+    if (!tiles_ || frame.width != tiles_width_ || frame.height != tiles_height_) {
+        tiles_ = std::make_shared<const std::vector<Region>>(
+            tileRegions(tiling_, frame.width, frame.height));
+        tiles_width_ = frame.width;
+        tiles_height_ = frame.height;
+    }
 
-        // Sleep for remaining interval time
-        auto process_time = std::chrono::steady_clock::now() - start;
-        auto remaining = std::chrono::milliseconds(sample_interval_ms_) - process_time;
-        if (remaining > std::chrono::milliseconds(0)) {
-            std::this_thread::sleep_for(remaining);
+    // Only the tiles that changed since the last inference. A static scene
+    // (and motion outside the ROI) still gets the full sweep at the idle rate.
+    if (!sampling_.motion_gating || !tiling_.motion_tiles || !tiling_.tiled() || changed.none()) {
+        return tiles_;
+    }
+    auto active = std::make_shared<std::vector<Region>>();
+    size_t first = tiling_.full_frame ? 1 : 0;  // the whole-ROI pass always runs
+    for (size_t i = 0; i < tiles_->size(); ++i) {
+        const auto& tile = (*tiles_)[i];
+        if (i < first || MotionDetector::touches(changed, tile, frame.width, frame.height)) {
+            active->push_back(tile);
         }
     }
+    if (active->size() == first) return tiles_;
+    return active;
 }
 
 }  // namespace hms
@@ -4,14 +4,121 @@
 #include <nlohmann/json.hpp>
 #include <curl/curl.h>
 
+#include <algorithm>
+#include <chrono>
+
 using json = nlohmann::json;
 
 namespace hms {
 
 EmbeddingClient::EmbeddingClient(const std::string& ollama_url,
-                                 const std::string& model)
-    : url_(ollama_url + "/api/embed"), model_(model)
+                                 const std::string& model,
+                                 Options options)
+    : url_(ollama_url + "/api/embed"), model_(model), options_(std::move(options))
 {
+    options_.batch_window_ms = std::max(0, options_.batch_window_ms);
+    options_.max_batch = std::max(1, options_.max_batch);
+    options_.cache_entries = std::max(0, options_.cache_entries);
+    sender_ = std::thread(&EmbeddingClient::senderLoop, this);
+}
+
+EmbeddingClient::~EmbeddingClient() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (sender_.joinable()) sender_.join();
+    if (curl_) curl_easy_cleanup(static_cast<CURL*>(curl_));
+}
+
+std::vector<float> EmbeddingClient::embed(const std::string& text) {
+    if (text.empty()) return {};
+
+    std::future<std::vector<float>> result;
+    {
+        std::lock_guard lock(mutex_);
+        stats_.requests++;
+        std::vector<float> cached;
+        if (cacheGet(text, cached)) {
+            stats_.cache_hits++;
+            return cached;
+        }
+        if (stopping_) return {};
+        Request req{.text = text, .promise = {}};
+        result = req.promise.get_future();
+        queue_.push_back(std::move(req));
+    }
+    cv_.notify_all();
+    return result.get();
+}
+
+EmbeddingClient::Stats EmbeddingClient::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+void EmbeddingClient::senderLoop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) break;  // stopping, nothing left
+
+        // Give other cameras a moment to join the batch
+        auto deadline = std::chrono::steady_clock::now()
+                      + std::chrono::milliseconds(options_.batch_window_ms);
+        cv_.wait_until(lock, deadline, [this] {
+            return stopping_ || static_cast<int>(queue_.size()) >= options_.max_batch;
+        });
+
+        size_t n = std::min(queue_.size(), static_cast<size_t>(options_.max_batch));
+        std::vector<Request> batch(std::make_move_iterator(queue_.begin()),
+                                   std::make_move_iterator(queue_.begin() + n));
+        queue_.erase(queue_.begin(), queue_.begin() + n);
+
+        lock.unlock();
+        dispatch(batch);
+        lock.lock();
+    }
+}
+
+void EmbeddingClient::dispatch(std::vector<Request>& batch) {
+    // Identical texts in one batch are sent once
+    std::vector<std::string> texts;
+    std::vector<size_t> index(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto it = std::find(texts.begin(), texts.end(), batch[i].text);
+        index[i] = static_cast<size_t>(it - texts.begin());
+        if (it == texts.end()) texts.push_back(batch[i].text);
+    }
+
+    std::vector<std::vector<float>> embeddings;
+    try {
+        embeddings = options_.transport ? options_.transport(texts) : post(texts);
+    } catch (const std::exception& e) {
+        spdlog::error("EmbeddingClient: {}", e.what());
+    }
+    bool ok = embeddings.size() == texts.size();
+    if (!ok && !embeddings.empty()) {
+        spdlog::error("EmbeddingClient: {} embeddings for {} inputs", embeddings.size(), texts.size());
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        stats_.batches++;
+        stats_.batched_texts += texts.size();
+        if (!ok) {
+            stats_.failures++;
+        } else {
+            for (size_t i = 0; i < texts.size(); ++i) {
+                if (!embeddings[i].empty()) cachePut(texts[i], embeddings[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].promise.set_value(ok ? embeddings[index[i]] : std::vector<float>{});
+    }
 }
 
 static size_t writeCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
@@ -20,22 +127,24 @@ static size_t writeCallback(char* ptr, size_t size, size_t nmemb, void* userdata
     return size * nmemb;
 }
 
-std::vector<float> EmbeddingClient::embed(const std::string& text) {
-    if (text.empty()) return {};
-
+std::vector<std::vector<float>> EmbeddingClient::post(const std::vector<std::string>& texts) {
     json body = {
         {"model", model_},
-        {"input", text},
+        {"input", texts},
         {"keep_alive", 0}
     };
     std::string body_str = body.dump();
     std::string response_body;
 
-    CURL* curl = curl_easy_init();
+    // One handle for the client's lifetime: curl keeps the connection open
+    // between requests
+    if (!curl_) curl_ = curl_easy_init();
+    CURL* curl = static_cast<CURL*>(curl_);
     if (!curl) {
         spdlog::error("EmbeddingClient: curl_easy_init failed");
         return {};
     }
+    curl_easy_reset(curl);
 
     struct curl_slist* headers = nullptr;
     headers = curl_slist_append(headers, "Content-Type: application/json");
@@ -50,21 +159,18 @@ std::vector<float> EmbeddingClient::embed(const std::string& text) {
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
     curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
     curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
 
     CURLcode res = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
 
     if (res != CURLE_OK) {
         spdlog::error("EmbeddingClient: curl error: {}", curl_easy_strerror(res));
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
         return {};
     }
 
     long http_code = 0;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
     if (http_code != 200) {
         spdlog::error("EmbeddingClient: HTTP {}", http_code);
         return {};
@@ -72,9 +178,9 @@ std::vector<float> EmbeddingClient::embed(const std::string& text) {
 
     try {
         auto j = json::parse(response_body);
-        // Ollama /api/embed returns {"embeddings": [[...]], "model": "..."}
+        // Ollama /api/embed returns {"embeddings": [[...], ...], "model": "..."}
         if (j.contains("embeddings") && !j["embeddings"].empty()) {
-            return j["embeddings"][0].get<std::vector<float>>();
+            return j["embeddings"].get<std::vector<std::vector<float>>>();
         }
         spdlog::error("EmbeddingClient: no embeddings in response");
     } catch (const json::exception& e) {
@@ -84,4 +190,30 @@ std::vector<float> EmbeddingClient::embed(const std::string& text) {
     return {};
 }
 
+bool EmbeddingClient::cacheGet(const std::string& text, std::vector<float>& out) {
+    if (options_.cache_entries == 0) return false;
+    auto it = cache_.find(std::hash<std::string>{}(text));
+    if (it == cache_.end() || it->second->second.text != text) return false;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    out = it->second->second.embedding;
+    return true;
+}
+
+void EmbeddingClient::cachePut(const std::string& text, const std::vector<float>& embedding) {
+    if (options_.cache_entries == 0) return;
+    size_t key = std::hash<std::string>{}(text);
+    if (auto it = cache_.find(key); it != cache_.end()) {
+        // Same text again, or a hash collision: the newer text wins
+        it->second->second = CacheEntry{.text = text, .embedding = embedding};
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    lru_.emplace_front(key, CacheEntry{.text = text, .embedding = embedding});
+    cache_[key] = lru_.begin();
+    if (static_cast<int>(lru_.size()) > options_.cache_entries) {
+        cache_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
 }  // namespace hms
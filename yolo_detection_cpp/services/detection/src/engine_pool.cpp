@@ -0,0 +1,86 @@
+#include "engine_pool.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace hms {
+
+EnginePool::EnginePool(std::vector<std::shared_ptr<DetectionEngine>> engines)
+    : engines_(std::move(engines)) {
+    assert(!engines_.empty());
+}
+
+void EnginePool::acquire() {
+    if (engines_.size() == 1) {
+        engines_.front()->acquire();
+        return;
+    }
+    // Cold starts are per device — don't pay them one after another
+    std::vector<std::thread> loaders;
+    loaders.reserve(engines_.size() - 1);
+    for (size_t i = 1; i < engines_.size(); ++i) {
+        loaders.emplace_back([engine = engines_[i]] { engine->acquire(); });
+    }
+    engines_.front()->acquire();
+    for (auto& t : loaders) t.join();
+}
+
+void EnginePool::release() {
+    for (const auto& engine : engines_) engine->release();
+}
+
+void EnginePool::warmUp() {
+    acquire();
+    auto run = [](DetectionEngine& engine) {
+        FrameData frame;
+        frame.resize(engine.inputWidth(), engine.inputHeight());
+        std::fill(frame.pixels.begin(), frame.pixels.end(), uint8_t{114});
+        try {
+            engine.detect(frame);
+        } catch (const std::exception& e) {
+            spdlog::warn("EnginePool: warm-up inference failed: {}", e.what());
+        }
+    };
+    std::vector<std::thread> runners;
+    runners.reserve(engines_.size() - 1);
+    for (size_t i = 1; i < engines_.size(); ++i) {
+        runners.emplace_back([&run, engine = engines_[i]] { run(*engine); });
+    }
+    run(*engines_.front());
+    for (auto& t : runners) t.join();
+    release();
+}
+
+bool EnginePool::evict() {
+    bool freed = false;
+    for (const auto& engine : engines_) freed = engine->evict() || freed;
+    return freed;
+}
+
+bool EnginePool::isLoaded() const {
+    for (const auto& engine : engines_) {
+        if (engine->isLoaded()) return true;
+    }
+    return false;
+}
+
+void EnginePool::setIdleTtl(std::chrono::seconds ttl) {
+    for (const auto& engine : engines_) engine->setIdleTtl(ttl);
+}
+
+void EnginePool::setResizeMode(ResizeMode mode) {
+    for (const auto& engine : engines_) engine->setResizeMode(mode);
+}
+
+void EnginePool::setGpuPreprocess(bool on) {
+    for (const auto& engine : engines_) engine->setGpuPreprocess(on);
+}
+
+void EnginePool::setPipelineDepth(int depth) {
+    for (const auto& engine : engines_) engine->setPipelineDepth(depth);
+}
+
+}  // namespace hms
@@ -0,0 +1,131 @@
+#include "event_executor.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace hms {
+
+const char* EventExecutor::stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Record: return "record";
+        case Stage::Snapshot: return "snapshot";
+        case Stage::Vision: return "vision";
+        case Stage::Publish: return "publish";
+    }
+    return "unknown";
+}
+
+EventExecutor::EventExecutor(const Options& options) {
+    for (size_t i = 0; i < kStages; ++i) {
+        auto& queue = queues_[i];
+        queue.options.workers = std::max(1, options[i].workers);
+        queue.options.queue = std::max(0, options[i].queue);
+        for (int w = 0; w < queue.options.workers; ++w) {
+            queue.workers.emplace_back([this, &queue] { workerLoop(queue); });
+        }
+    }
+}
+
+EventExecutor::~EventExecutor() {
+    stop();
+}
+
+bool EventExecutor::submit(Stage stage, const std::string& key, std::function<void()> task) {
+    auto& queue = queues_[static_cast<size_t>(stage)];
+    {
+        std::lock_guard lock(queue.mutex);
+        if (queue.stopping || queue.tasks.size() >= static_cast<size_t>(queue.options.queue)) {
+            queue.rejected++;
+            return false;
+        }
+        queue.tasks.push_back(Task{key, std::move(task), SteadyClock::now()});
+    }
+    // notify_all: the woken worker may find only tasks whose key is busy
+    queue.cv.notify_all();
+    return true;
+}
+
+void EventExecutor::stop() {
+    std::lock_guard stop_lock(stop_mutex_);
+    if (stopped_) return;
+    stopped_ = true;
+
+    for (auto& queue : queues_) {
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.stopping = true;
+        }
+        queue.cv.notify_all();
+        for (auto& worker : queue.workers) {
+            if (worker.joinable()) worker.join();
+        }
+        queue.workers.clear();
+    }
+}
+
+void EventExecutor::workerLoop(Queue& queue) {
+    std::unique_lock lock(queue.mutex);
+    while (true) {
+        // Oldest task whose key isn't already running on another worker
+        auto next = queue.tasks.end();
+        queue.cv.wait(lock, [&] {
+            next = std::find_if(queue.tasks.begin(), queue.tasks.end(), [&](const Task& t) {
+                return !queue.busy_keys.contains(t.key);
+            });
+            return next != queue.tasks.end() || (queue.stopping && queue.tasks.empty());
+        });
+        if (next == queue.tasks.end()) return;
+
+        Task task = std::move(*next);
+        queue.tasks.erase(next);
+        queue.busy_keys.insert(task.key);
+        auto started = SteadyClock::now();
+        lock.unlock();
+
+        try {
+            task.fn();
+        } catch (const std::exception& e) {
+            spdlog::error("EventExecutor: [{}] task failed: {}", task.key, e.what());
+        }
+
+        auto finished = SteadyClock::now();
+        lock.lock();
+        queue.busy_keys.erase(task.key);
+        int64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(started - task.queued).count();
+        int64_t run_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started).count();
+        queue.completed++;
+        queue.wait_ns += wait_ns;
+        queue.run_ns += run_ns;
+        queue.max_wait_ns = std::max(queue.max_wait_ns, wait_ns);
+        queue.max_run_ns = std::max(queue.max_run_ns, run_ns);
+        // The key is free again: a worker may have been waiting on it
+        queue.cv.notify_all();
+    }
+}
+
+std::vector<EventExecutor::StageStats> EventExecutor::stats() const {
+    std::vector<StageStats> out;
+    out.reserve(kStages);
+    for (size_t i = 0; i < kStages; ++i) {
+        const auto& queue = queues_[i];
+        std::lock_guard lock(queue.mutex);
+        double n = queue.completed > 0 ? static_cast<double>(queue.completed) : 1.0;
+        out.push_back(StageStats{
+            .name = stageName(static_cast<Stage>(i)),
+            .workers = queue.options.workers,
+            .capacity = queue.options.queue,
+            .queued = queue.tasks.size(),
+            .running = queue.busy_keys.size(),
+            .completed = queue.completed,
+            .rejected = queue.rejected,
+            .avg_wait_ms = queue.wait_ns / n / 1e6,
+            .max_wait_ms = queue.max_wait_ns / 1e6,
+            .avg_run_ms = queue.run_ns / n / 1e6,
+            .max_run_ms = queue.max_run_ns / 1e6,
+        });
+    }
+    return out;
+}
+
+}  // namespace hms
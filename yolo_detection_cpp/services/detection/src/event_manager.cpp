@@ -1,30 +1,118 @@
 #include "event_manager.h"
 #include "event_logger.h"
+#include "metrics.h"
+#include "packet_decoder.h"
+#include "tiling.h"
+#include "tracker.h"
 #include "vision_client.h"
 #include "time_utils.h"
 
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <future>
 #include <random>
 
 using json = nlohmann::json;
 
 namespace hms {
 
+namespace {
+
+constexpr int kDefaultPostRollSeconds = 5;  // motion start without post_roll_seconds
+
+using Stage = EventExecutor::Stage;
+
+/// LLaVA outcome of one event, handed from the vision stage to the event's
+/// publish step. Whichever side gets there second runs the continuation.
+class VisionHandoff {
+public:
+    struct Outcome {
+        VisionClient::Result result;
+        std::string prompt;
+    };
+
+    void complete(Outcome outcome) {
+        std::function<void(const Outcome&)> next;
+        {
+            std::lock_guard lock(mutex_);
+            outcome_ = std::move(outcome);
+            done_ = true;
+            next = std::move(next_);
+        }
+        if (next) next(outcome_);
+    }
+
+    void then(std::function<void(const Outcome&)> next) {
+        {
+            std::lock_guard lock(mutex_);
+            if (!done_) {
+                next_ = std::move(next);
+                return;
+            }
+        }
+        next(outcome_);
+    }
+
+private:
+    std::mutex mutex_;
+    bool done_ = false;
+    Outcome outcome_;
+    std::function<void(const Outcome&)> next_;
+};
+
+/// Queue a LLaVA call on the vision stage; a full queue skips it.
+/// The image goes over in memory, so it needn't be on disk yet.
+void launchVision(EventExecutor& executor, const hms::LlavaConfig& config,
+                  const std::shared_ptr<VisionHandoff>& handoff,
+                  std::shared_ptr<const std::string> image,
+                  const std::string& camera_id, const std::string& primary_class) {
+    bool queued = executor.submit(Stage::Vision, camera_id,
+                                  [config, handoff, image, camera_id, primary_class] {
+        VisionHandoff::Outcome outcome;
+        try {
+            VisionClient vision(config);
+            outcome.result = vision.analyze(image, camera_id, primary_class);
+            outcome.prompt = vision.lastPrompt();
+        } catch (const std::exception& e) {
+            spdlog::error("EventManager: LLaVA failed for {}: {}", camera_id, e.what());
+        }
+        handoff->complete(std::move(outcome));
+    });
+    if (!queued) {
+        spdlog::warn("EventManager: [{}] vision queue full, skipping LLaVA", camera_id);
+        handoff->complete({});
+    }
+}
+
+}  // namespace
+
 EventManager::EventManager(std::shared_ptr<BufferService> buffer_service,
                            std::shared_ptr<hms::MqttClient> mqtt,
-                           std::shared_ptr<hms::DbPool> db,
+                           std::shared_ptr<DbWriter> db,
                            std::shared_ptr<GpuCoordinator> gpu_coord,
-                           const hms::AppConfig& config)
+                           const hms::AppConfig& config,
+                           std::shared_ptr<FileWriter> files)
     : buffer_service_(std::move(buffer_service))
     , mqtt_(std::move(mqtt))
     , db_(std::move(db))
     , gpu_coord_(std::move(gpu_coord))
+    , files_(std::move(files))
     , config_(config)
 {
+    auto events = buffer_service_ ? buffer_service_->pipelineConfig().events : EventsConfig{};
+    int cameras = std::max(1, static_cast<int>(config_.cameras.size()));
+    auto stage = [cameras](const EventStageConfig& cfg) {
+        return EventExecutor::StageOptions{cfg.workers > 0 ? cfg.workers : cameras, cfg.queue};
+    };
+    executor_ = std::make_unique<EventExecutor>(EventExecutor::Options{
+        stage(events.record), stage(events.snapshot), stage(events.vision), stage(events.publish)});
+    if (mqtt_) {
+        publisher_ = std::make_unique<MqttPublisher>(mqtt_, MqttPublisher::Options{events.mqtt_queue});
+    }
 }
 
 EventManager::~EventManager() {
@@ -57,7 +145,7 @@ void EventManager::start() {
             }
 
             if (topic == "camera/event/motion/start") {
-                int post_roll = msg.value("post_roll_seconds", 5);
+                int post_roll = msg.value("post_roll_seconds", kDefaultPostRollSeconds);
                 onMotionStart(camera_id, post_roll);
             } else if (topic == "camera/event/motion/stop") {
                 onMotionStop(camera_id);
@@ -73,32 +161,20 @@ void EventManager::start() {
 void EventManager::stop() {
     running_ = false;
 
-    std::vector<std::thread> threads_to_join;
     {
         std::lock_guard lock(events_mutex_);
         for (auto& [cam_id, event] : active_events_) {
             event->stop_requested = true;
         }
-        // Move all threads out so we can join without holding the lock
-        for (auto& [cam_id, event] : active_events_) {
-            if (event->thread.joinable()) {
-                threads_to_join.push_back(std::move(event->thread));
-            }
-        }
-        active_events_.clear();
-
-        // Also collect orphaned threads
-        for (auto& t : orphaned_threads_) {
-            if (t.joinable()) {
-                threads_to_join.push_back(std::move(t));
-            }
-        }
-        orphaned_threads_.clear();
     }
 
-    // Join all threads without holding the mutex
-    for (auto& t : threads_to_join) {
-        t.join();
+    // Running events wind down through post-roll; queued ones exit at once.
+    // Their snapshot, DB and publish work still drains.
+    executor_->stop();
+    if (publisher_) publisher_->stop();  // after the stages: sends their last messages
+    {
+        std::lock_guard lock(events_mutex_);
+        active_events_.clear();
     }
     spdlog::info("EventManager: stopped");
 }
@@ -108,6 +184,21 @@ size_t EventManager::activeEventCount() const {
     return active_events_.size();
 }
 
+std::vector<EventExecutor::StageStats> EventManager::executorStats() const {
+    return executor_->stats();
+}
+
+MqttPublisher::Stats EventManager::publisherStats() const {
+    return publisher_ ? publisher_->stats() : MqttPublisher::Stats{};
+}
+
+void EventManager::runOnStage(Stage stage, const std::string& camera_id, std::function<void()> task) {
+    if (executor_->submit(stage, camera_id, task)) return;
+    spdlog::warn("EventManager: [{}] {} queue full, running inline",
+                 camera_id, EventExecutor::stageName(stage));
+    task();
+}
+
 void EventManager::setPaused(const std::string& camera_id, bool paused) {
     std::lock_guard lock(paused_mutex_);
     paused_cameras_[camera_id] = paused;
@@ -132,9 +223,6 @@ void EventManager::onMotionStart(const std::string& camera_id, int post_roll_sec
         return;
     }
 
-    // Join any previously orphaned threads (non-blocking if they've finished)
-    joinOrphanedThreads();
-
     {
         std::lock_guard lock(events_mutex_);
 
@@ -146,22 +234,35 @@ void EventManager::onMotionStart(const std::string& camera_id, int post_roll_sec
             return;
         }
 
-        // Spawn new event thread
-        auto event = std::make_unique<ActiveEvent>();
+        // Queue the event; per-camera ordering keeps it behind any
+        // previous event's tail still on the record stage
+        auto event = std::make_shared<ActiveEvent>();
         event->event_id = generateEventId();
-        auto* event_ptr = event.get();
-        auto eid = event->event_id;
-        event->thread = std::thread([this, camera_id, post_roll_seconds, event_ptr, eid]() {
-            processEvent(camera_id, post_roll_seconds, eid);
-            event_ptr->running = false;
+        bool queued = executor_->submit(Stage::Record, camera_id,
+                                        [this, camera_id, post_roll_seconds, event] {
+            processEvent(camera_id, post_roll_seconds, event);
         });
+        if (!queued) {
+            spdlog::warn("EventManager: event queue full, dropping motion start for {}", camera_id);
+            return;
+        }
 
         active_events_[camera_id] = std::move(event);
     }
 
+    Metrics::counter(Metrics::CounterId::Events, camera_id).add();
     spdlog::info("EventManager: motion start for {}", camera_id);
 }
 
+void EventManager::onLocalMotion(const std::string& camera_id, bool active) {
+    if (!running_) return;
+    if (active) {
+        onMotionStart(camera_id, kDefaultPostRollSeconds);
+    } else {
+        onMotionStop(camera_id);
+    }
+}
+
 void EventManager::onMotionStop(const std::string& camera_id) {
     std::lock_guard lock(events_mutex_);
 
@@ -172,56 +273,32 @@ void EventManager::onMotionStop(const std::string& camera_id) {
     }
 }
 
-void EventManager::joinOrphanedThreads() {
-    std::vector<std::thread> to_join;
-    {
-        std::lock_guard lock(events_mutex_);
-        // Collect only threads that have finished (non-blocking check)
-        std::vector<std::thread> still_running;
-        for (auto& t : orphaned_threads_) {
-            if (t.joinable()) {
-                // Try detaching instead of blocking — these threads have
-                // timeouts on all operations and will finish on their own.
-                t.detach();
-            }
-        }
-        orphaned_threads_.clear();
-    }
-}
-
 void EventManager::processEvent(const std::string& camera_id, int post_roll_seconds,
-                                const std::string& event_id) {
+                                const std::shared_ptr<ActiveEvent>& event) {
     auto prefix = mqtt_ ? mqtt_->topicPrefix() : "yolo_detection";
-
-    spdlog::info("EventManager: processing event {} for {}", event_id, camera_id);
-
-    // Find this event's stop flag
-    ActiveEvent* my_event = nullptr;
-    {
-        std::lock_guard lock(events_mutex_);
-        auto it = active_events_.find(camera_id);
-        if (it != active_events_.end()) {
-            my_event = it->second.get();
-        }
-    }
-    if (!my_event) return;
+    const std::string event_id = event->event_id;
+    ActiveEvent* my_event = event.get();
 
     // Scope guard: always remove ourselves from active_events_ on exit,
     // regardless of early returns, so the camera can accept new events.
     auto cleanup = std::shared_ptr<void>(nullptr, [&](void*) {
         std::lock_guard lock(events_mutex_);
         auto it = active_events_.find(camera_id);
-        if (it != active_events_.end() && it->second->event_id == event_id) {
-            if (it->second->thread.joinable()) {
-                it->second->thread.detach();
-            }
+        if (it != active_events_.end() && it->second == event) {
             active_events_.erase(it);
         }
     });
 
+    // Queued behind a full record stage when the service shut down
+    if (!running_) return;
+
+    spdlog::info("EventManager: processing event {} for {}", event_id, camera_id);
+
     // 1. Get camera buffer and detection engine
     auto buffer = buffer_service_->getCameraBuffer(camera_id);
     auto engine = buffer_service_->getDetectionEngine();
+    auto engines = buffer_service_->getEnginePool();
+    auto scheduler = buffer_service_->getInferenceScheduler();
     if (!buffer) {
         spdlog::error("EventManager: no buffer for camera {}", camera_id);
         return;
@@ -234,30 +311,55 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
         spdlog::debug("EventManager: [{}] GPU coordinator signaled — event started", camera_id);
     }
 
-    // Load YOLO onto GPU for this motion event
-    if (engine) {
-        engine->load();
-    }
+    // Pin YOLO for this motion event. Loads only if the session was evicted or
+    // idled out; otherwise the warm session is reused with no cold start.
+    // Every session of the pool is pinned. Unpinned when detection is done, or
+    // on any return path.
+    struct EngineLease {
+        std::shared_ptr<EnginePool> engines;
+        void release() {
+            if (engines) engines->release();
+            engines.reset();
+        }
+        ~EngineLease() { release(); }
+    } engine_lease;
+    if (engines) {
+        engines->acquire();
+        engine_lease.engines = engines;
+    }
+
+    // LLaVA needs the VRAM YOLO occupies: ask the coordinator (or the engine
+    // directly when running without one) to evict the unpinned sessions.
+    auto freeGpuForVision = [&]() {
+        if (gpu_coord_ && gpu_coord_->requestVram()) return;
+        if (engines) engines->evict();
+    };
 
-    // 3. Get preroll frames — deep-copy pixels and release pool references immediately
+    // Recording source: remux the camera's own H.264 packets when possible
+    // (no decode/encode, camera quality). Transcoding decoded frames remains
+    // for burned-in boxes and streams MP4 can't carry as-is.
+    const auto& rec_cfg = buffer_service_->pipelineConfig().recording;
+    auto packets = buffer_service_->getPacketRing(camera_id);
+    bool passthrough = packets && rec_cfg.mode == RecordingConfig::Mode::Passthrough
+                       && !rec_cfg.burn_in_boxes && EventRecorder::canRemux(packets->stream());
+
+    // 3. Get preroll frames — pool references, no pixel copies. The pool spills
+    //    past its capacity while we hold them, so capture never starves
+    //    (transcode only: passthrough preroll comes from the packet ring)
+    //    Live recording resumes right after the last preroll frame
     std::vector<std::shared_ptr<FrameData>> preroll_frames;
-    {
-        auto pool_frames = buffer->getBuffer();
-        preroll_frames.reserve(pool_frames.size());
-        for (const auto& pf : pool_frames) {
-            if (!pf) continue;
-            auto copy = std::make_shared<FrameData>();
-            copy->pixels = pf->pixels;  // deep copy
-            copy->width = pf->width;
-            copy->height = pf->height;
-            copy->stride = pf->stride;
-            copy->timestamp = pf->timestamp;
-            copy->frame_number = pf->frame_number;
-            preroll_frames.push_back(std::move(copy));
-        }
-        // pool_frames destroyed here — shared_ptrs returned to pool
-    }
-    spdlog::info("EventManager: {} preroll frames for {}", preroll_frames.size(), camera_id);
+    uint64_t frame_seq = buffer->latestSeq();
+    auto takePreroll = [&] {
+        auto view = buffer->snapshot();
+        preroll_frames.clear();
+        preroll_frames.reserve(view.size());
+        view.forEach([&](const std::shared_ptr<FrameData>& f) { preroll_frames.push_back(f); });
+        frame_seq = view.lastSeq();
+    };
+    if (!passthrough) {
+        takePreroll();
+        spdlog::info("EventManager: {} preroll frames for {}", preroll_frames.size(), camera_id);
+    }
 
     // 4. Determine frame dimensions from preroll or latest frame
     int width = 0, height = 0;
@@ -273,55 +375,99 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
         return;
     }
 
-    // 5. Start recorder with preroll
-    EventRecorder recorder;
+    // Dual-stream cameras record the main stream: boxes go out (MQTT, DB) in its pixels
+    int report_width = width, report_height = height;
+    if (packets && buffer_service_->isDualStream(camera_id)) {
+        if (auto par = packets->stream().codecpar; par && par->width > 0) {
+            report_width = par->width;
+            report_height = par->height;
+        }
+    }
+
+    // 5. Start recorder with preroll. With the FileWriter, the muxer's output
+    //    is queued and this thread never waits on the disk
+    EventRecorder recorder(EventRecorder::Output{
+        .files = files_, .fragmented = rec_cfg.fragmented, .staging_dir = rec_cfg.staging_dir});
     int fps = config_.buffer.fps > 0 ? config_.buffer.fps : 10;
     std::string events_dir = config_.timeline.events_dir;
-    if (!recorder.start(camera_id, preroll_frames, width, height, fps, events_dir)) {
+    if (passthrough) {
+        auto preroll_packets = packets->preroll(std::chrono::seconds(config_.buffer.preroll_seconds));
+        if (!recorder.startPassthrough(camera_id, packets->stream(), preroll_packets, events_dir)) {
+            spdlog::warn("EventManager: [{}] passthrough recording failed, transcoding", camera_id);
+            passthrough = false;
+            takePreroll();
+        }
+    }
+    if (!passthrough && !recorder.start(camera_id, preroll_frames, width, height, fps, events_dir)) {
         spdlog::error("EventManager: failed to start recorder for {}", camera_id);
         return;
     }
 
-    // Preroll written to recorder — release copies to free memory
+    // Preroll written to recorder — hand the frames back to the pool
     preroll_frames.clear();
 
+    // Live/post-roll recording: drain new packets (every packet, not just the
+    // sampled frames) or transcode the sampled frame, with boxes if configured
+    std::vector<Detection> overlay_detections;
+    FrameData overlay_frame;
+    auto recordFrame = [&](const FrameData& frame) {
+        if (recorder.mode() == EventRecorder::Mode::Passthrough) {
+            for (const auto& entry : packets->since(recorder.lastSeq())) {
+                if (!recorder.writePacket(entry)) break;
+            }
+            return;
+        }
+        if (!frame.ensureBgr()) return;
+        if (rec_cfg.burn_in_boxes && !overlay_detections.empty()) {
+            overlay_frame.resize(frame.width, frame.height);
+            for (int y = 0; y < frame.height; ++y) {
+                std::copy_n(frame.pixels.data() + static_cast<size_t>(y) * frame.stride,
+                            overlay_frame.stride,
+                            overlay_frame.pixels.data() + static_cast<size_t>(y) * overlay_frame.stride);
+            }
+            SnapshotWriter::drawBoundingBoxes(overlay_frame.pixels.data(), overlay_frame.width,
+                                              overlay_frame.height, overlay_frame.stride,
+                                              overlay_detections);
+            recorder.writeFrame(overlay_frame);
+            return;
+        }
+        recorder.writeFrame(frame);
+    };
+
     // 6. Run detection on preroll is already done via recorder.
     //    Now detect during live phase only.
     std::vector<Detection> all_detections;
-    std::unique_ptr<FrameData> best_frame;  // owned copy, not pool ref
+    std::shared_ptr<const FrameData> best_frame;  // pool ref, held for the event
     float best_confidence = 0.0f;
     std::vector<Detection> best_detections;
     bool early_notification_sent = false;  // track if we already sent immediate MQTT
-    std::string early_snapshot_path;       // snapshot saved at first detection (for LLaVA)
-    std::thread llava_thread;              // LLaVA runs in parallel with recording
-    std::string llava_context;             // result from LLaVA thread
-    bool llava_valid = false;
+    std::shared_future<std::string> early_snapshot;  // snapshot saved at the gate (for LLaVA)
+    std::shared_ptr<VisionHandoff> vision;           // set once LLaVA is queued
 
     // Get camera-specific config
     float conf_threshold = static_cast<float>(config_.detection.confidence_threshold);
     float iou_threshold = static_cast<float>(config_.detection.iou_threshold);
-    std::vector<std::string> filter_classes = config_.detection.classes;
 
     auto cam_it = config_.cameras.find(camera_id);
-    if (cam_it != config_.cameras.end()) {
-        if (cam_it->second.confidence_threshold > 0) {
-            conf_threshold = static_cast<float>(cam_it->second.confidence_threshold);
-        }
-        if (!cam_it->second.classes.empty()) {
-            filter_classes = cam_it->second.classes;
-        }
+    if (cam_it != config_.cameras.end() && cam_it->second.confidence_threshold > 0) {
+        conf_threshold = static_cast<float>(cam_it->second.confidence_threshold);
+    }
+
+    // Camera (or global) class filter, compiled once at model load
+    DetectParams params{conf_threshold, iou_threshold, buffer_service_->getClassFilter(camera_id)};
+
+    // ROI / tiles for this camera (all of them: an event wants full coverage)
+    if (auto tiles = tileRegions(buffer_service_->pipelineConfig().tilingFor(camera_id), width, height);
+        !tiles.empty()) {
+        params.regions = std::make_shared<const std::vector<Region>>(std::move(tiles));
     }
 
-    // Helper: deep-copy a frame (avoids pinning pool frames)
-    auto copyFrame = [](const FrameData& src) {
-        auto copy = std::make_unique<FrameData>();
-        copy->pixels = src.pixels;
-        copy->width = src.width;
-        copy->height = src.height;
-        copy->stride = src.stride;
-        copy->timestamp = src.timestamp;
-        copy->frame_number = src.frame_number;
-        return copy;
+    // Event frames jump ahead of continuous-worker frames in the shared scheduler
+    auto runDetection = [&](const std::shared_ptr<FrameData>& frame) {
+        if (scheduler) {
+            return scheduler->submit(frame, params, InferenceScheduler::Priority::Event).get();
+        }
+        return std::move(engine->detectBatch({frame.get()}, {params}).front());
     };
 
     // Compute base_url early (needed for snapshot URLs in early notifications)
@@ -333,134 +479,206 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
     // 7. Live phase: pull frames, write to recorder, sample detections
     auto start_time = SteadyClock::now();
     int frames_since_detection = 0;
-    constexpr int DETECTION_SAMPLE_INTERVAL = 3;  // detect every 3rd frame
     int inference_count = 0;
 
-    spdlog::info("EventManager: [{}] live phase started ({:.0f}ms after motion start)",
-                 camera_id,
-                 std::chrono::duration<double, std::milli>(SteadyClock::now() - start_time).count());
+    // Motion start -> first detection, once per event
+    bool detected = false;
+    auto noteDetections = [&](const std::vector<Detection>& dets) {
+        if (detected || dets.empty()) return;
+        detected = true;
+        if (Metrics::enabled()) {
+            Metrics::histogram(Metrics::Stage::MotionToDetection, camera_id)
+                .observe(SteadyClock::now() - my_event->motion_at);
+        }
+    };
 
-    while (!my_event->stop_requested && !recorder.isMaxDurationReached()) {
-        auto frame = buffer->getLatestFrame();
-        if (!frame || frame->width != width) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(30));
-            continue;
-        }
-
-        recorder.writeFrame(*frame);
-        frames_since_detection++;
-
-        // Sample detection — skip once notification sent (no need to keep inferring)
-        if (!early_notification_sent && engine && engine->isLoaded()
-            && frames_since_detection >= DETECTION_SAMPLE_INTERVAL) {
-            frames_since_detection = 0;
-            auto t_inf = SteadyClock::now();
-            auto dets = engine->detect(*frame, conf_threshold, iou_threshold, filter_classes);
-            auto inf_ms = std::chrono::duration<double, std::milli>(SteadyClock::now() - t_inf).count();
-            inference_count++;
-
-            if (inference_count <= 3 || !dets.empty()) {
-                spdlog::info("EventManager: [{}] YOLO inference #{}: {:.0f}ms, {} detections",
-                             camera_id, inference_count, inf_ms, dets.size());
+    // Early notification, once the best detection meets the camera's gate:
+    // YOLO is done, so the snapshot JPEG, the MQTT result and the LLaVA launch
+    // move to the snapshot stage while this worker keeps recording
+    auto notifyEarly = [&](const std::vector<Detection>& dets, float det_conf, const char* phase) {
+        auto first_det_ms = std::chrono::duration<double, std::milli>(
+            SteadyClock::now() - start_time).count();
+        early_notification_sent = true;
+
+        // Detection is done — unpin YOLO and free the GPU for LLaVA
+        engine_lease.release();
+        if (config_.llava.enabled) {
+            freeGpuForVision();
+            vision = std::make_shared<VisionHandoff>();
+        }
+
+        auto snapshot = std::make_shared<std::promise<std::string>>();
+        early_snapshot = snapshot->get_future().share();
+        runOnStage(Stage::Snapshot, camera_id,
+                   [this, snapshot, vision, frame = best_frame, best = best_detections, dets, det_conf,
+                    first_det_ms, phase, camera_id, prefix, base_url] {
+            // Encode the snapshot from the best-confidence frame. LLaVA gets the
+            // bytes straight away and runs while the file is written
+            SnapshotWriter::Encoded snap;
+            try {
+                snap = encodeSnapshot(camera_id, *frame, best);
+            } catch (const std::exception& e) {
+                spdlog::error("EventManager: [{}] snapshot failed: {}", camera_id, e.what());
             }
 
-            for (const auto& d : dets) {
-                all_detections.push_back(d);
-                if (d.confidence > best_confidence) {
-                    best_confidence = d.confidence;
-                    best_frame = copyFrame(*frame);
-                    best_detections = dets;
+            if (vision && !snap.jpeg) {
+                vision->complete({});
+            } else if (vision) {
+                std::vector<std::string> early_classes;
+                for (const auto& d : dets) {
+                    early_classes.emplace_back(d.name());
                 }
+                launchVision(*executor_, config_.llava, vision, snap.vision_jpeg, camera_id,
+                             VisionClient::selectPrimaryClass(early_classes));
+                spdlog::info("EventManager: [{}] LLaVA queued{} at {:.0f}ms", camera_id, phase, first_det_ms);
             }
 
-            // Early notification: save snapshot + publish result + launch LLaVA
-            // Only fires when best confidence so far meets the notification gate.
-            // Keeps re-checking on each detection frame until gate is met.
-            if (!dets.empty() && mqtt_) {
-                float det_conf = best_detections.front().confidence;
-                auto cam_conf_it2 = config_.cameras.find(camera_id);
-                double conf_gate = (cam_conf_it2 != config_.cameras.end())
-                    ? cam_conf_it2->second.immediate_notification_confidence : 0.70;
-
-                if (det_conf >= conf_gate) {
-                    auto first_det_ms = std::chrono::duration<double, std::milli>(
-                        SteadyClock::now() - start_time).count();
-
-                    // Save snapshot from best-confidence frame
-                    std::string snapshots_dir_early = config_.timeline.snapshots_dir;
-                    early_snapshot_path = SnapshotWriter::save(
-                        *best_frame, best_detections, camera_id, snapshots_dir_early);
-
-                    std::string early_snap_filename;
-                    if (!early_snapshot_path.empty()) {
-                        early_snap_filename = std::filesystem::path(early_snapshot_path).filename().string();
-                        spdlog::info("EventManager: [{}] snapshot saved at {:.0f}ms: {}",
-                                     camera_id, first_det_ms, early_snap_filename);
-                    }
-
-                    json early_dets = json::array();
-                    for (const auto& d : dets) {
-                        early_dets.push_back({
-                            {"class", d.class_name},
-                            {"confidence", std::round(d.confidence * 1000) / 1000},
-                        });
-                    }
-
-                    json early_msg = {
-                        {"camera_id", camera_id},
-                        {"timestamp", hms::time_utils::now_iso8601()},
-                        {"detections", early_dets},
-                        {"detection_count", static_cast<int>(dets.size())},
-                        {"detected_objects", dets[0].class_name},
-                        {"snapshot_url", early_snap_filename.empty() ? json(nullptr)
-                            : json(base_url + "/snapshots/" + early_snap_filename)},
-                    };
-                    mqtt_->publish(prefix + "/" + camera_id + "/result", early_msg.dump());
-
-                    spdlog::info("EventManager: [{}] EARLY notification at {:.0f}ms "
-                                 "({} @ {:.1f}%)",
-                                 camera_id, first_det_ms,
-                                 best_detections.front().class_name, det_conf * 100);
-
-                    early_notification_sent = true;
-
-                    // Unload YOLO from GPU — detection is done, free GPU for LLaVA
-                    if (engine) {
-                        engine->unload();
-                    }
-
-                    // Launch LLaVA in parallel with recording (non-blocking)
-                    if (config_.llava.enabled && !early_snapshot_path.empty()) {
-                        std::vector<std::string> early_classes;
-                        for (const auto& d : dets) {
-                            early_classes.push_back(d.class_name);
-                        }
-                        std::string primary_class = VisionClient::selectPrimaryClass(early_classes);
-                        auto llava_config = config_.llava;
-                        auto snap_path = early_snapshot_path;
-
-                        llava_thread = std::thread([&llava_context, &llava_valid,
-                                                    llava_config, snap_path, camera_id, primary_class]() {
-                            try {
-                                VisionClient vision(llava_config);
-                                auto vr = vision.analyze(snap_path, camera_id, primary_class);
-                                llava_context = vr.context;
-                                llava_valid = vr.is_valid;
-                            } catch (const std::exception& e) {
-                                spdlog::error("EventManager: LLaVA thread failed for {}: {}", camera_id, e.what());
-                            }
-                        });
-
-                        spdlog::info("EventManager: [{}] LLaVA launched in parallel at {:.0f}ms",
-                                     camera_id, first_det_ms);
-                    }
+            // Queued before the URL goes out; /snapshots serves it from memory until it lands
+            std::string path;
+            try {
+                if (SnapshotWriter::write(snap, camera_id, files_.get())) path = snap.path;
+            } catch (const std::exception& e) {
+                spdlog::error("EventManager: [{}] snapshot write failed: {}", camera_id, e.what());
+            }
+            snapshot->set_value(path);
+
+            std::string snap_filename;
+            if (!path.empty()) {
+                snap_filename = std::filesystem::path(path).filename().string();
+                spdlog::info("EventManager: [{}] snapshot saved{} at {:.0f}ms: {}",
+                             camera_id, phase, first_det_ms, snap_filename);
+            }
+
+            json early_dets = json::array();
+            for (const auto& d : dets) {
+                early_dets.push_back({
+                    {"class", d.name()},
+                    {"confidence", std::round(d.confidence * 1000) / 1000},
+                });
+            }
+
+            json early_msg = {
+                {"camera_id", camera_id},
+                {"timestamp", hms::time_utils::now_iso8601()},
+                {"detections", early_dets},
+                {"detection_count", static_cast<int>(dets.size())},
+                {"detected_objects", dets[0].name()},
+                {"snapshot_url", snap_filename.empty() ? json(nullptr)
+                    : json(base_url + "/snapshots/" + snap_filename)},
+            };
+            // Latest result per camera: a stale one still queued is replaced
+            publisher_->publish(prefix + "/" + camera_id + "/result", std::move(early_msg), true);
+
+            spdlog::info("EventManager: [{}] EARLY notification{} at {:.0f}ms ({} @ {:.1f}%)",
+                         camera_id, phase, first_det_ms, best.front().name(), det_conf * 100);
+        });
+    };
+
+    spdlog::info("EventManager: [{}] live phase started ({:.0f}ms after motion start)",
+                 camera_id,
+                 std::chrono::duration<double, std::milli>(SteadyClock::now() - start_time).count());
+
+    // Each captured frame is recorded once, as soon as it lands; the wait is
+    // bounded so a stop request is noticed even if the camera stalls
+    constexpr auto kFrameWait = std::chrono::milliseconds(100);
+    auto nextFrame = [&]() -> std::shared_ptr<FrameData> {
+        auto next = buffer->waitForFrame(frame_seq, SteadyClock::now() + kFrameWait, true);
+        if (!next.frame) return nullptr;
+        frame_seq = next.seq;
+        return next.frame->width == width ? std::move(next.frame) : nullptr;
+    };
+
+    // Detection sampling, shared by the live phase and post-roll. Tracking
+    // links detections across inferences: the overlay follows each object's
+    // predicted box between them, inference backs off while every object
+    // stands still, and the event reports one detection per object
+    const auto& track_cfg = buffer_service_->pipelineConfig().tracking;
+    Tracker tracker(track_cfg);
+    int stationary_skips = 0;
+    float best_score = 0.0f;       // best_frame's claim to be the event's snapshot
+    bool scored_confirmed = false;  // best_score counts confirmed tracks only
+    SteadyClock::time_point last_inference{};
+    auto sampleDetection = [&](const std::shared_ptr<FrameData>& frame, const char* phase) {
+        // Skip once notification sent (no need to keep inferring)
+        if (early_notification_sent || !engines || !engines->isLoaded()) return;
+        if (++frames_since_detection < track_cfg.detect_interval) return;
+        if (track_cfg.enabled && tracker.allStationary()
+            && frame->timestamp - last_inference < std::chrono::milliseconds(track_cfg.stationary_recheck_ms)) {
+            ++stationary_skips;
+            return;
+        }
+        frames_since_detection = 0;
+        last_inference = frame->timestamp;
+
+        auto t_inf = SteadyClock::now();
+        auto dets = runDetection(frame);
+        auto inf_ms = std::chrono::duration<double, std::milli>(SteadyClock::now() - t_inf).count();
+        inference_count++;
+        overlay_detections = dets;
+
+        if (inference_count <= 3 || !dets.empty()) {
+            spdlog::info("EventManager: [{}] YOLO inference #{}{}: {:.0f}ms, {} detections",
+                         camera_id, inference_count, phase, inf_ms, dets.size());
+        }
+
+        // Best frame: the most confident single detection, or with tracking
+        // the most confidence on confirmed objects, so a frame showing both
+        // people beats one showing either (and a one-frame false positive
+        // loses to a real object once one is confirmed)
+        float score = 0.0f, confirmed_score = 0.0f;
+        if (track_cfg.enabled) {
+            auto ids = tracker.update(dets, frame->timestamp);
+            for (size_t i = 0; i < dets.size(); ++i) {
+                if (const auto* track = tracker.find(ids[i]); track && track->confirmed) {
+                    confirmed_score += dets[i].confidence;
                 }
             }
+            if (confirmed_score > 0 && !scored_confirmed) {
+                scored_confirmed = true;
+                best_score = 0.0f;
+            }
+        }
+        for (const auto& d : dets) {
+            all_detections.push_back(d);
+            best_confidence = std::max(best_confidence, d.confidence);
+            score = std::max(score, d.confidence);
         }
+        if (scored_confirmed) score = confirmed_score;
+        if (!dets.empty() && score > best_score) {
+            best_score = score;
+            best_frame = frame;
+            best_detections = dets;
+        }
+        noteDetections(dets);
+
+        // Early notification: save snapshot + publish result + launch LLaVA
+        // Only fires when best confidence so far meets the notification gate.
+        // Keeps re-checking on each detection frame until gate is met.
+        if (!dets.empty() && mqtt_) {
+            auto cam_conf_it2 = config_.cameras.find(camera_id);
+            double conf_gate = (cam_conf_it2 != config_.cameras.end())
+                ? cam_conf_it2->second.immediate_notification_confidence : 0.70;
+
+            if (best_confidence >= conf_gate) notifyEarly(dets, best_confidence, phase);
+        }
+    };
 
-        // Release pool ref before sleeping
-        frame.reset();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / fps));
+    // Between inferences the burned-in boxes follow the tracks; once
+    // inference stops they stay where they were last seen
+    auto trackOverlay = [&](const FrameData& frame) {
+        if (track_cfg.enabled && rec_cfg.burn_in_boxes && !early_notification_sent
+            && !tracker.tracks().empty()) {
+            overlay_detections = tracker.predict(frame.timestamp);
+        }
+    };
+
+    while (!my_event->stop_requested && !recorder.isMaxDurationReached()) {
+        auto frame = nextFrame();
+        if (!frame) continue;
+
+        trackOverlay(*frame);
+        recordFrame(*frame);
+        sampleDetection(frame, "");
     }
 
     // 8. Post-roll: continue recording for post_roll_seconds
@@ -470,114 +688,14 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
 
     recorder.requestStop(post_roll_seconds);
     while (!my_event->stop_requested && !recorder.isPostRollComplete() && !recorder.isMaxDurationReached()) {
-        auto frame = buffer->getLatestFrame();
-        if (frame && frame->width == width) {
-            recorder.writeFrame(*frame);
+        auto frame = nextFrame();
+        if (frame) {
+            trackOverlay(*frame);
+            recordFrame(*frame);
 
             // Continue detection sampling during post-roll (skip if already notified)
-            frames_since_detection++;
-            if (!early_notification_sent && engine && engine->isLoaded()
-                && frames_since_detection >= DETECTION_SAMPLE_INTERVAL) {
-                frames_since_detection = 0;
-                auto t_inf = SteadyClock::now();
-                auto dets = engine->detect(*frame, conf_threshold, iou_threshold, filter_classes);
-                auto inf_ms = std::chrono::duration<double, std::milli>(SteadyClock::now() - t_inf).count();
-                inference_count++;
-
-                for (const auto& d : dets) {
-                    all_detections.push_back(d);
-                    if (d.confidence > best_confidence) {
-                        best_confidence = d.confidence;
-                        best_frame = copyFrame(*frame);
-                        best_detections = dets;
-                    }
-                }
-
-                // Send notification if best detection during post-roll meets gate
-                if (!dets.empty() && !early_notification_sent && mqtt_) {
-                    float det_conf = best_detections.front().confidence;
-                    auto cam_conf_it2 = config_.cameras.find(camera_id);
-                    double conf_gate = (cam_conf_it2 != config_.cameras.end())
-                        ? cam_conf_it2->second.immediate_notification_confidence : 0.70;
-
-                    if (det_conf >= conf_gate) {
-                        auto first_det_ms = std::chrono::duration<double, std::milli>(
-                            SteadyClock::now() - start_time).count();
-
-                        // Save snapshot from best-confidence frame
-                        std::string snapshots_dir_early = config_.timeline.snapshots_dir;
-                        early_snapshot_path = SnapshotWriter::save(
-                            *best_frame, best_detections, camera_id, snapshots_dir_early);
-
-                        std::string early_snap_filename;
-                        if (!early_snapshot_path.empty()) {
-                            early_snap_filename = std::filesystem::path(early_snapshot_path).filename().string();
-                            spdlog::info("EventManager: [{}] snapshot saved (post-roll) at {:.0f}ms: {}",
-                                         camera_id, first_det_ms, early_snap_filename);
-                        }
-
-                        json early_dets = json::array();
-                        for (const auto& d : dets) {
-                            early_dets.push_back({
-                                {"class", d.class_name},
-                                {"confidence", std::round(d.confidence * 1000) / 1000},
-                            });
-                        }
-
-                        json early_msg = {
-                            {"camera_id", camera_id},
-                            {"timestamp", hms::time_utils::now_iso8601()},
-                            {"detections", early_dets},
-                            {"detection_count", static_cast<int>(dets.size())},
-                            {"detected_objects", dets[0].class_name},
-                            {"snapshot_url", early_snap_filename.empty() ? json(nullptr)
-                                : json(base_url + "/snapshots/" + early_snap_filename)},
-                        };
-                        mqtt_->publish(prefix + "/" + camera_id + "/result", early_msg.dump());
-
-                        spdlog::info("EventManager: [{}] EARLY notification (post-roll) at {:.0f}ms "
-                                     "({} @ {:.1f}%)",
-                                     camera_id, first_det_ms,
-                                     best_detections.front().class_name, det_conf * 100);
-
-                        early_notification_sent = true;
-
-                        // Unload YOLO from GPU — detection is done, free GPU for LLaVA
-                        if (engine) {
-                            engine->unload();
-                        }
-
-                        // Launch LLaVA in parallel
-                        if (!early_snapshot_path.empty() && config_.llava.enabled) {
-                            std::vector<std::string> early_classes;
-                            for (const auto& d : dets) {
-                                early_classes.push_back(d.class_name);
-                            }
-                            std::string primary_class = VisionClient::selectPrimaryClass(early_classes);
-                            auto llava_config = config_.llava;
-                            auto snap_path = early_snapshot_path;
-
-                            llava_thread = std::thread([&llava_context, &llava_valid,
-                                                        llava_config, snap_path, camera_id, primary_class]() {
-                                try {
-                                    VisionClient vision(llava_config);
-                                    auto vr = vision.analyze(snap_path, camera_id, primary_class);
-                                    llava_context = vr.context;
-                                    llava_valid = vr.is_valid;
-                                } catch (const std::exception& e) {
-                                    spdlog::error("EventManager: LLaVA thread failed for {}: {}", camera_id, e.what());
-                                }
-                            });
-
-                            spdlog::info("EventManager: [{}] LLaVA launched (post-roll) at {:.0f}ms",
-                                         camera_id, first_det_ms);
-                        }
-                    }
-                }
-            }
+            sampleDetection(frame, " (post-roll)");
         }
-        frame.reset();  // release pool ref before sleeping
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / fps));
     }
 
     auto postroll_ms = std::chrono::duration<double, std::milli>(
@@ -593,33 +711,23 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
 
     // Nothing detected — delete recording, log to DB, skip snapshot/LLaVA
     if (all_detections.empty()) {
-        // Unload YOLO — no detections, no LLaVA needed
-        if (engine) {
-            engine->unload();
-        }
+        // No detections, no LLaVA needed — YOLO stays warm for the idle TTL
+        engine_lease.release();
 
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
             SteadyClock::now() - start_time);
         double duration_seconds = elapsed.count() / 1000.0;
 
         // Remove the recording file — no detections means no value
-        if (!recorder.fileName().empty()) {
-            std::string rec_path = events_dir + "/" + recorder.fileName();
-            std::error_code ec;
-            if (std::filesystem::remove(rec_path, ec)) {
-                spdlog::info("EventManager: [{}] removed empty recording {}", camera_id, recorder.fileName());
-            }
+        if (recorder.discard()) {
+            spdlog::info("EventManager: [{}] removed empty recording {}", camera_id, recorder.fileName());
         }
 
         // Log 0-detection event to DB for analytics
-        try {
-            if (db_) {
-                hms::EventLogger::create_event(*db_, event_id, camera_id, "", "");
-                hms::EventLogger::complete_event(*db_, event_id, duration_seconds,
-                                                  recorder.framesWritten(), 0);
-            }
-        } catch (const std::exception& e) {
-            spdlog::error("EventManager: DB logging failed for {}: {}", camera_id, e.what());
+        if (db_) {
+            db_->submit(DbWriter::CreateEvent{event_id, camera_id, "", ""});
+            db_->submit(DbWriter::CompleteEvent{event_id, duration_seconds,
+                                                recorder.framesWritten(), 0});
         }
 
         // Signal GPU coordinator — event done, periodic can resume
@@ -634,12 +742,15 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
 
     // 10. Save snapshot (best detection frame)
     //     If early snapshot was already saved, update only if we got a better detection
-    std::string snapshot_path = early_snapshot_path;  // use early snapshot by default
+    //     The snapshot stage has normally written it long before post-roll ends
+    std::string snapshot_path = early_snapshot.valid() ? early_snapshot.get() : "";
     std::string snapshots_dir = config_.timeline.snapshots_dir;
-    if (best_frame && !best_detections.empty() && early_snapshot_path.empty()) {
+    std::shared_ptr<const std::string> vision_image;  // for the step 16 fallback
+    if (best_frame && !best_detections.empty() && snapshot_path.empty()) {
         // No early snapshot was saved (edge case), save now
-        snapshot_path = SnapshotWriter::save(*best_frame, best_detections,
-                                             camera_id, snapshots_dir);
+        auto snap = encodeSnapshot(camera_id, *best_frame, best_detections);
+        if (SnapshotWriter::write(snap, camera_id, files_.get())) snapshot_path = snap.path;
+        vision_image = snap.vision_jpeg;
     }
 
     // 11. Compute duration
@@ -647,25 +758,33 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
         SteadyClock::now() - start_time);
     double duration_seconds = elapsed.count() / 1000.0;
 
-    // 12. Deduplicate detections for MQTT payload (one per class, highest confidence)
-    std::unordered_map<std::string, Detection> unique_dets;
-    for (const auto& d : all_detections) {
-        auto it2 = unique_dets.find(d.class_name);
-        if (it2 == unique_dets.end() || d.confidence > it2->second.confidence) {
-            unique_dets[d.class_name] = d;
+    // 12. Deduplicate detections for MQTT payload: one per tracked object
+    //     (two people are two detections), else one per class, highest confidence
+    std::vector<Detection> reported;
+    if (track_cfg.enabled) {
+        reported = tracker.objects();
+        spdlog::info("EventManager: [{}] {} tracked object(s), {} inference(s) skipped while stationary",
+                     camera_id, reported.size(), stationary_skips);
+    } else {
+        std::unordered_map<uint16_t, Detection> unique_dets;
+        for (const auto& d : all_detections) {
+            auto it2 = unique_dets.find(d.class_id);
+            if (it2 == unique_dets.end() || d.confidence > it2->second.confidence) {
+                unique_dets[d.class_id] = d;
+            }
         }
+        for (const auto& [cls, d] : unique_dets) reported.push_back(d);
     }
 
-    // Build class counts
-    std::unordered_map<std::string, int> class_counts;
-    for (const auto& d : all_detections) {
-        class_counts[d.class_name]++;
-    }
-
+    // Class names resolved once per class, not per detection
     std::vector<std::string> unique_classes;
-    for (const auto& [cls, _] : class_counts) {
-        unique_classes.push_back(cls);
+    std::vector<uint16_t> named;
+    for (const auto& d : reported) {
+        if (std::find(named.begin(), named.end(), d.class_id) != named.end()) continue;
+        named.push_back(d.class_id);
+        unique_classes.emplace_back(d.name());
     }
+    reported = scaleDetections(std::move(reported), width, height, report_width, report_height);
 
     // Build detection message
     std::string detection_message;
@@ -689,9 +808,9 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
 
     // Build deduplicated detection array for MQTT
     json dets_json = json::array();
-    for (const auto& [cls, d] : unique_dets) {
+    for (const auto& d : reported) {
         dets_json.push_back({
-            {"class", d.class_name},
+            {"class", d.name()},
             {"class_id", d.class_id},
             {"confidence", std::round(d.confidence * 1000) / 1000},
             {"bbox", {{"x1", static_cast<int>(d.x1)},
@@ -716,134 +835,92 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
         double conf_gate = (cam_conf_it != config_.cameras.end())
             ? cam_conf_it->second.immediate_notification_confidence : 0.70;
         below_gate = (best_conf < conf_gate);
-        if (below_gate && !recorder.fileName().empty()) {
-            std::string rec_path = events_dir + "/" + recorder.fileName();
-            std::error_code ec;
-            if (std::filesystem::remove(rec_path, ec)) {
-                spdlog::info("EventManager: [{}] removed low-confidence recording {} "
-                             "(best {:.1f}% < gate {:.0f}%)",
-                             camera_id, recorder.fileName(),
-                             best_conf * 100, conf_gate * 100);
-            }
+        if (below_gate && recorder.discard()) {
+            spdlog::info("EventManager: [{}] removed low-confidence recording {} "
+                         "(best {:.1f}% < gate {:.0f}%)",
+                         camera_id, recorder.fileName(),
+                         best_conf * 100, conf_gate * 100);
         }
     }
 
-    // 13. Log to database (non-blocking — catch exceptions to prevent hang)
-    try {
-        if (db_) {
-            std::string db_recording = below_gate ? "" : recorder.fileName();
-            hms::EventLogger::create_event(*db_, event_id, camera_id,
-                                            db_recording, snapshot_filename);
-
-            std::vector<hms::EventLogger::DetectionRecord> det_records;
-            for (const auto& [cls, d] : unique_dets) {
-                det_records.push_back({d.class_name, d.confidence, d.x1, d.y1, d.x2, d.y2});
-            }
-            hms::EventLogger::log_detections(*db_, event_id, det_records);
+    // 13. Log to database (queued; the DbWriter thread does the I/O)
+    if (db_) {
+        std::vector<hms::EventLogger::DetectionRecord> det_records;
+        for (const auto& d : reported) {
+            det_records.push_back({std::string(d.name()), d.confidence, d.x1, d.y1, d.x2, d.y2});
+        }
+        db_->submit(DbWriter::CreateEvent{event_id, camera_id, below_gate ? "" : recorder.fileName(),
+                                          snapshot_filename});
+        db_->submit(DbWriter::LogDetections{event_id, std::move(det_records)});
+        db_->submit(DbWriter::CompleteEvent{event_id, duration_seconds,
+                                            recorder.framesWritten(),
+                                            static_cast<int>(all_detections.size())});
+    }
+
+    // 16. LLaVA vision context. Queued at the early notification; otherwise
+    //     (no MQTT client) queued now if the best detection meets the gate
+    if (!vision && config_.llava.enabled && vision_image && !best_detections.empty()
+        && !early_notification_sent) {
+        float best_conf = best_detections.front().confidence;
+        auto cam_conf_it = config_.cameras.find(camera_id);
+        double conf_gate = (cam_conf_it != config_.cameras.end())
+            ? cam_conf_it->second.immediate_notification_confidence : 0.70;
 
-            hms::EventLogger::complete_event(*db_, event_id, duration_seconds,
-                                              recorder.framesWritten(),
-                                              static_cast<int>(all_detections.size()));
+        if (best_conf >= conf_gate) {
+            engine_lease.release();
+            freeGpuForVision();
+            vision = std::make_shared<VisionHandoff>();
+            launchVision(*executor_, config_.llava, vision, vision_image, camera_id,
+                         VisionClient::selectPrimaryClass(unique_classes));
         }
-    } catch (const std::exception& e) {
-        spdlog::error("EventManager: DB logging failed for {}: {}", camera_id, e.what());
     }
 
-    // 16. LLaVA vision context — join parallel thread if it was launched
-    try {
-        if (llava_thread.joinable()) {
-            spdlog::info("EventManager: [{}] waiting for LLaVA thread...", camera_id);
-            llava_thread.join();
-
-            if (llava_valid && mqtt_) {
+    // 17. Context message + DB row once LLaVA answers (queued behind the event
+    //     rows above, so written after them), then signal the GPU coordinator —
+    //     event processing fully done, periodic can resume
+    auto finishEvent = [this, event_id, camera_id, prefix, base_url, recording = recorder.fileName(),
+                        snapshot_filename, unique_classes](const VisionHandoff::Outcome* outcome) {
+        if (outcome && outcome->result.is_valid) {
+            const auto& context = outcome->result.context;
+            if (mqtt_) {
                 json context_msg = {
                     {"camera_id", camera_id},
                     {"timestamp", hms::time_utils::now_iso8601()},
-                    {"context", llava_context},
-                    {"recording_url", recorder.fileName().empty() ? json(nullptr)
-                        : json(base_url + "/events/" + recorder.fileName())},
-                    {"recording_filename", recorder.fileName()},
+                    {"context", context},
+                    {"recording_url", recording.empty() ? json(nullptr)
+                        : json(base_url + "/events/" + recording)},
+                    {"recording_filename", recording},
                     {"snapshot_url", snapshot_filename.empty() ? json(nullptr)
                         : json(base_url + "/snapshots/" + snapshot_filename)},
                     {"source", "llava"}
                 };
-                mqtt_->publish(prefix + "/" + camera_id + "/context",
-                               context_msg.dump());
-                spdlog::info("EventManager: published LLaVA context for {}: {}",
-                             camera_id, llava_context);
+                publisher_->publish(prefix + "/" + camera_id + "/context", std::move(context_msg));
+                spdlog::info("EventManager: published LLaVA context for {}: {}", camera_id, context);
             }
 
-            if (db_ && llava_valid) {
-                try {
-                    hms::EventLogger::log_ai_context(*db_, event_id, camera_id, {
-                        .context_text = llava_context,
-                        .detected_classes = unique_classes,
-                        .source_model = config_.llava.model,
-                        .prompt_used = "",  // not available from parallel thread
-                        .response_time_seconds = 0,  // tracked in VisionClient log
-                        .is_valid = llava_valid,
-                    });
-                } catch (const std::exception& e) {
-                    spdlog::error("EventManager: LLaVA DB log failed for {}: {}", camera_id, e.what());
-                }
-            }
-        } else if (config_.llava.enabled && !snapshot_path.empty() && !best_detections.empty()
-                   && !early_notification_sent) {
-            // Fallback: LLaVA wasn't launched early (no detection during live phase)
-            // Run synchronously now
-            float best_conf = best_detections.front().confidence;
-            auto cam_conf_it = config_.cameras.find(camera_id);
-            double conf_gate = (cam_conf_it != config_.cameras.end())
-                ? cam_conf_it->second.immediate_notification_confidence : 0.70;
-
-            if (best_conf >= conf_gate) {
-                std::string primary_class = VisionClient::selectPrimaryClass(unique_classes);
-
-                VisionClient vision(config_.llava);
-                auto vr = vision.analyze(snapshot_path, camera_id, primary_class);
-
-                if (vr.is_valid && mqtt_) {
-                    json context_msg = {
-                        {"camera_id", camera_id},
-                        {"timestamp", hms::time_utils::now_iso8601()},
-                        {"context", vr.context},
-                        {"recording_url", recorder.fileName().empty() ? json(nullptr)
-                            : json(base_url + "/events/" + recorder.fileName())},
-                        {"recording_filename", recorder.fileName()},
-                        {"snapshot_url", snapshot_filename.empty() ? json(nullptr)
-                            : json(base_url + "/snapshots/" + snapshot_filename)},
-                        {"source", "llava"}
-                    };
-                    mqtt_->publish(prefix + "/" + camera_id + "/context",
-                                   context_msg.dump());
-                    spdlog::info("EventManager: published LLaVA context for {}: {}",
-                                 camera_id, vr.context);
-                }
-
-                if (db_) {
-                    try {
-                        hms::EventLogger::log_ai_context(*db_, event_id, camera_id, {
-                            .context_text = vr.context,
-                            .detected_classes = unique_classes,
-                            .source_model = config_.llava.model,
-                            .prompt_used = vision.lastPrompt(),
-                            .response_time_seconds = vr.response_time_seconds,
-                            .is_valid = vr.is_valid,
-                        });
-                    } catch (const std::exception& e) {
-                        spdlog::error("EventManager: LLaVA DB log failed for {}: {}", camera_id, e.what());
-                    }
-                }
+            if (db_) {
+                db_->submit(DbWriter::LogAiContext{event_id, camera_id, {
+                    .context_text = context,
+                    .detected_classes = unique_classes,
+                    .source_model = config_.llava.model,
+                    .prompt_used = outcome->prompt,
+                    .response_time_seconds = outcome->result.response_time_seconds,
+                    .is_valid = true,
+                }});
             }
         }
-    } catch (const std::exception& e) {
-        spdlog::error("EventManager: LLaVA failed for {}: {}", camera_id, e.what());
-    }
 
-    // 17. Signal GPU coordinator — event processing fully done, periodic can resume
-    if (gpu_coord_) {
-        gpu_coord_->eventFinished();
-        spdlog::debug("EventManager: [{}] GPU coordinator signaled — event finished", camera_id);
+        if (gpu_coord_) {
+            gpu_coord_->eventFinished();
+            spdlog::debug("EventManager: [{}] GPU coordinator signaled — event finished", camera_id);
+        }
+    };
+    if (vision) {
+        vision->then([this, camera_id, finishEvent](const VisionHandoff::Outcome& outcome) {
+            runOnStage(Stage::Publish, camera_id, [finishEvent, outcome] { finishEvent(&outcome); });
+        });
+    } else {
+        finishEvent(nullptr);
     }
 
     spdlog::info("EventManager: event {} completed for {} ({:.1f}s, {} frames, {} detections)",
@@ -851,6 +928,22 @@ void EventManager::processEvent(const std::string& camera_id, int post_roll_seco
                  recorder.framesWritten(), all_detections.size());
 }
 
+SnapshotWriter::Encoded EventManager::encodeSnapshot(const std::string& camera_id, const FrameData& frame,
+                                                     const std::vector<Detection>& detections) const {
+    const auto& pipeline = buffer_service_->pipelineConfig();
+    if (pipeline.streams.full_res_snapshots && buffer_service_->isDualStream(camera_id)) {
+        // Substream frame times line up with main-stream packet arrivals
+        if (auto full = buffer_service_->decodeMainStream(camera_id, frame.timestamp)) {
+            return SnapshotWriter::encode(
+                *full, scaleDetections(detections, frame.width, frame.height, full->width, full->height),
+                camera_id, config_.timeline.snapshots_dir, pipeline.vision.event_width);
+        }
+        spdlog::warn("EventManager: [{}] main stream didn't decode, snapshot from the substream", camera_id);
+    }
+    return SnapshotWriter::encode(frame, detections, camera_id, config_.timeline.snapshots_dir,
+                                  pipeline.vision.event_width);
+}
+
 std::string EventManager::generateEventId() {
     // Simple UUID-like ID: timestamp + random suffix
     auto now = std::chrono::system_clock::now();
@@ -9,7 +9,9 @@ namespace fs = std::filesystem;
 
 namespace hms {
 
-EventRecorder::EventRecorder() = default;
+EventRecorder::EventRecorder() : EventRecorder(Output{}) {}
+
+EventRecorder::EventRecorder(Output output) : output_(std::move(output)) {}
 
 EventRecorder::~EventRecorder() {
     if (recording_) {
@@ -28,20 +30,15 @@ static std::string makeTimestamp() {
     return buf;
 }
 
-bool EventRecorder::start(const std::string& camera_id,
-                           const std::vector<std::shared_ptr<FrameData>>& preroll_frames,
-                           int width, int height, int fps,
-                           const std::string& output_dir) {
+bool EventRecorder::openOutput(const std::string& camera_id, const std::string& output_dir) {
     camera_id_ = camera_id;
-    width_ = width;
-    height_ = height;
-    fps_ = fps > 0 ? fps : 10;
+    write_metric_ = &Metrics::histogram(Metrics::Stage::RecordWrite, camera_id);
     frames_written_ = 0;
     pts_ = 0;
     stop_requested_ = false;
 
-    // Create output directory
-    fs::create_directories(output_dir);
+    // Create output directory (the FileWriter does that off this thread)
+    if (!async()) fs::create_directories(output_dir);
 
     // Generate filename: camera_id_YYYYMMDD_HHMMSS.mp4
     file_path_ = output_dir + "/" + camera_id + "_" + makeTimestamp() + ".mp4";
@@ -52,6 +49,64 @@ bool EventRecorder::start(const std::string& camera_id,
         spdlog::error("EventRecorder: failed to create MP4 context for {}", file_path_);
         return false;
     }
+    return true;
+}
+
+bool EventRecorder::writeHeader() {
+    // Fragmented: a moof per keyframe after an empty moov, nothing to rewrite
+    // at the end. Faststart: moov moved to the front (reads the file back).
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "movflags",
+                output_.fragmented ? "+frag_keyframe+empty_moov+default_base_moof" : "+faststart", 0);
+
+    int ret = 0;
+    if (async()) {
+        constexpr int kBufferSize = 256 * 1024;
+        auto* buffer = static_cast<unsigned char*>(av_malloc(kBufferSize));
+        file_id_ = output_.files->open(writePath());
+        write_offset_ = 0;
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+        auto write = &EventRecorder::queueWrite;
+#else
+        auto write = [](void* opaque, uint8_t* buf, int size) { return queueWrite(opaque, buf, size); };
+#endif
+        fmt_ctx_->pb = buffer ? avio_alloc_context(buffer, kBufferSize, 1, this, nullptr, write, nullptr)
+                              : nullptr;
+        if (!fmt_ctx_->pb) av_free(buffer);
+        fmt_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        ret = fmt_ctx_->pb ? 0 : AVERROR(ENOMEM);
+    } else {
+        ret = avio_open(&fmt_ctx_->pb, file_path_.c_str(), AVIO_FLAG_WRITE);
+    }
+    if (ret < 0) {
+        char errbuf[128];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        spdlog::error("EventRecorder: failed to open {}: {}", file_path_, errbuf);
+        av_dict_free(&opts);
+        cleanup();
+        return false;
+    }
+
+    ret = avformat_write_header(fmt_ctx_, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        spdlog::error("EventRecorder: failed to write header");
+        cleanup();
+        return false;
+    }
+    return true;
+}
+
+bool EventRecorder::start(const std::string& camera_id,
+                           const std::vector<std::shared_ptr<FrameData>>& preroll_frames,
+                           int width, int height, int fps,
+                           const std::string& output_dir) {
+    width_ = width;
+    height_ = height;
+    fps_ = fps > 0 ? fps : 10;
+    mode_ = Mode::Transcode;
+    if (!openOutput(camera_id, output_dir)) return false;
+    int ret = 0;
 
     // Find H.264 encoder
     const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
@@ -104,27 +159,7 @@ bool EventRecorder::start(const std::string& camera_id,
     avcodec_parameters_from_context(stream_->codecpar, enc_ctx_);
     stream_->time_base = enc_ctx_->time_base;
 
-    // Open output file with faststart (moov at beginning for streaming)
-    AVDictionary* opts = nullptr;
-    av_dict_set(&opts, "movflags", "+faststart", 0);
-
-    ret = avio_open(&fmt_ctx_->pb, file_path_.c_str(), AVIO_FLAG_WRITE);
-    if (ret < 0) {
-        char errbuf[128];
-        av_strerror(ret, errbuf, sizeof(errbuf));
-        spdlog::error("EventRecorder: failed to open {}: {}", file_path_, errbuf);
-        av_dict_free(&opts);
-        cleanup();
-        return false;
-    }
-
-    ret = avformat_write_header(fmt_ctx_, &opts);
-    av_dict_free(&opts);
-    if (ret < 0) {
-        spdlog::error("EventRecorder: failed to write header");
-        cleanup();
-        return false;
-    }
+    if (!writeHeader()) return false;
 
     // Allocate YUV frame for encoding
     yuv_frame_ = av_frame_alloc();
@@ -160,12 +195,116 @@ bool EventRecorder::start(const std::string& camera_id,
     return true;
 }
 
+bool EventRecorder::canRemux(const PacketRing::StreamInfo& stream) {
+    if (!stream.codecpar) return false;
+    // MP4 needs the decoder config (avcC/hvcC) up front; RTSP provides it via the SDP
+    if (stream.codecpar->extradata_size <= 0) return false;
+    const AVOutputFormat* mp4 = av_guess_format("mp4", nullptr, nullptr);
+    return mp4 && avformat_query_codec(mp4, stream.codecpar->codec_id, FF_COMPLIANCE_NORMAL) == 1;
+}
+
+bool EventRecorder::startPassthrough(const std::string& camera_id,
+                                     const PacketRing::StreamInfo& stream,
+                                     const std::vector<PacketRing::Entry>& preroll,
+                                     const std::string& output_dir) {
+    if (!canRemux(stream)) {
+        spdlog::warn("EventRecorder: [{}] stream can't be remuxed into MP4", camera_id);
+        return false;
+    }
+
+    mode_ = Mode::Passthrough;
+    width_ = stream.codecpar->width;
+    height_ = stream.codecpar->height;
+    src_time_base_ = stream.time_base;
+    generation_ = stream.generation;
+    last_seq_ = 0;
+    ts_offset_ = AV_NOPTS_VALUE;
+    last_dts_ = AV_NOPTS_VALUE;
+    written_seconds_ = 0;
+    generation_warned_ = false;
+    if (!openOutput(camera_id, output_dir)) return false;
+
+    stream_ = avformat_new_stream(fmt_ctx_, nullptr);
+    if (!stream_ || avcodec_parameters_copy(stream_->codecpar, stream.codecpar.get()) < 0) {
+        spdlog::error("EventRecorder: failed to create passthrough stream");
+        cleanup();
+        return false;
+    }
+    stream_->id = 0;
+    stream_->codecpar->codec_tag = 0;  // let the muxer pick the MP4 tag
+    stream_->time_base = src_time_base_;
+
+    if (!writeHeader()) return false;
+
+    pkt_ = av_packet_alloc();
+    recording_ = true;
+    spdlog::info("EventRecorder: started passthrough recording {} ({}x{} {}, {} preroll packets)",
+                 file_path_, width_, height_, avcodec_get_name(stream.codecpar->codec_id),
+                 preroll.size());
+
+    for (const auto& entry : preroll) writePacket(entry);
+    return true;
+}
+
+bool EventRecorder::writePacket(const PacketRing::Entry& entry) {
+    if (!recording_ || mode_ != Mode::Passthrough || !fmt_ctx_ || !entry.packet) return false;
+    if (entry.seq <= last_seq_) return true;  // already written
+    if (isMaxDurationReached()) return false;
+
+    if (entry.generation != generation_) {
+        // Camera reconnected: new SPS/PPS can't go into this file
+        if (!generation_warned_) {
+            spdlog::warn("EventRecorder: [{}] stream reconnected, passthrough recording ends here",
+                         camera_id_);
+            generation_warned_ = true;
+        }
+        return false;
+    }
+
+    Metrics::Timer timer(*write_metric_);
+    if (av_packet_ref(pkt_, entry.packet.get()) < 0) return false;
+    last_seq_ = entry.seq;
+
+    // Rebase to start at 0; RTSP streams without timestamps get wall-clock ones
+    if (pkt_->dts == AV_NOPTS_VALUE) pkt_->dts = pkt_->pts;
+    if (pkt_->dts == AV_NOPTS_VALUE) {
+        if (ts_offset_ == AV_NOPTS_VALUE) first_arrival_ = entry.arrival;
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            entry.arrival - first_arrival_).count();
+        pkt_->dts = av_rescale_q(us, AVRational{1, 1000000}, src_time_base_);
+        if (ts_offset_ == AV_NOPTS_VALUE) ts_offset_ = 0;
+    }
+    if (pkt_->pts == AV_NOPTS_VALUE) pkt_->pts = pkt_->dts;
+    if (ts_offset_ == AV_NOPTS_VALUE) ts_offset_ = pkt_->dts;
+    pkt_->dts -= ts_offset_;
+    pkt_->pts -= ts_offset_;
+
+    av_packet_rescale_ts(pkt_, src_time_base_, stream_->time_base);
+    // The muxer rejects non-increasing dts (camera clock jitter)
+    if (last_dts_ != AV_NOPTS_VALUE && pkt_->dts <= last_dts_) pkt_->dts = last_dts_ + 1;
+    if (pkt_->pts < pkt_->dts) pkt_->pts = pkt_->dts;
+    last_dts_ = pkt_->dts;
+
+    pkt_->stream_index = stream_->index;
+    pkt_->pos = -1;
+    written_seconds_ = pkt_->dts * av_q2d(stream_->time_base);
+
+    int ret = av_interleaved_write_frame(fmt_ctx_, pkt_);
+    av_packet_unref(pkt_);
+    if (ret < 0) return false;
+
+    frames_written_++;
+    return true;
+}
+
 bool EventRecorder::writeFrame(const FrameData& frame) {
-    if (!recording_ || !enc_ctx_ || !fmt_ctx_) return false;
+    if (!recording_ || mode_ != Mode::Transcode || !enc_ctx_ || !fmt_ctx_) return false;
 
     // Check max duration
     if (isMaxDurationReached()) return false;
+    if (!frame.ensureBgr()) return false;
 
+    Metrics::Timer timer(*write_metric_);
     av_frame_make_writable(yuv_frame_);
 
     // BGR24 → YUV420P
@@ -208,37 +347,64 @@ void EventRecorder::requestStop(int post_roll_seconds) {
 }
 
 bool EventRecorder::finalize() {
-    if (!recording_ || !enc_ctx_ || !fmt_ctx_) return false;
+    if (!recording_ || !fmt_ctx_) return false;
+    if (mode_ == Mode::Transcode && !enc_ctx_) return false;
 
     recording_ = false;
 
     // Flush encoder
-    avcodec_send_frame(enc_ctx_, nullptr);
-    while (true) {
-        int ret = avcodec_receive_packet(enc_ctx_, pkt_);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-        if (ret < 0) break;
-
-        av_packet_rescale_ts(pkt_, enc_ctx_->time_base, stream_->time_base);
-        pkt_->stream_index = stream_->index;
-        av_interleaved_write_frame(fmt_ctx_, pkt_);
-        av_packet_unref(pkt_);
+    if (mode_ == Mode::Transcode) {
+        avcodec_send_frame(enc_ctx_, nullptr);
+        while (true) {
+            int ret = avcodec_receive_packet(enc_ctx_, pkt_);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+            if (ret < 0) break;
+
+            av_packet_rescale_ts(pkt_, enc_ctx_->time_base, stream_->time_base);
+            pkt_->stream_index = stream_->index;
+            av_interleaved_write_frame(fmt_ctx_, pkt_);
+            av_packet_unref(pkt_);
+        }
     }
 
     av_write_trailer(fmt_ctx_);
 
-    double duration = static_cast<double>(frames_written_) / fps_;
+    double duration = mode_ == Mode::Passthrough
+        ? written_seconds_ : static_cast<double>(frames_written_) / fps_;
     spdlog::info("EventRecorder: finalized {} ({} frames, {:.1f}s)",
                  file_path_, frames_written_, duration);
 
-    cleanup();
+    cleanup(true);
     return true;
 }
 
+bool EventRecorder::discard() {
+    if (recording_ || file_path_.empty()) return false;
+    if (output_.files) {
+        output_.files->remove(file_path_);
+        return true;
+    }
+    std::error_code ec;
+    return fs::remove(file_path_, ec);
+}
+
 std::string EventRecorder::fileName() const {
     return fs::path(file_path_).filename().string();
 }
 
+std::string EventRecorder::writePath() const {
+    return output_.staging_dir.empty()
+        ? file_path_ : (fs::path(output_.staging_dir) / fileName()).string();
+}
+
+int EventRecorder::queueWrite(void* opaque, const uint8_t* buf, int size) {
+    auto* self = static_cast<EventRecorder*>(opaque);
+    self->output_.files->write(self->file_id_, self->write_offset_,
+                               std::string(reinterpret_cast<const char*>(buf), size));
+    self->write_offset_ += size;
+    return size;
+}
+
 bool EventRecorder::isPostRollComplete() const {
     if (!stop_requested_) return false;
     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
@@ -247,19 +413,39 @@ bool EventRecorder::isPostRollComplete() const {
 }
 
 bool EventRecorder::isMaxDurationReached() const {
+    if (mode_ == Mode::Passthrough) return written_seconds_ >= MAX_DURATION_SECONDS;
     return frames_written_ >= (fps_ * MAX_DURATION_SECONDS);
 }
 
-void EventRecorder::cleanup() {
+void EventRecorder::cleanup(bool publish) {
     if (sws_ctx_) { sws_freeContext(sws_ctx_); sws_ctx_ = nullptr; }
     if (yuv_frame_) { av_frame_free(&yuv_frame_); }
     if (pkt_) { av_packet_free(&pkt_); }
     if (enc_ctx_) { avcodec_free_context(&enc_ctx_); }
     if (fmt_ctx_) {
-        if (fmt_ctx_->pb) { avio_closep(&fmt_ctx_->pb); }
+        if (fmt_ctx_->flags & AVFMT_FLAG_CUSTOM_IO) {
+            if (fmt_ctx_->pb) {
+                avio_flush(fmt_ctx_->pb);
+                av_freep(&fmt_ctx_->pb->buffer);
+                avio_context_free(&fmt_ctx_->pb);
+            }
+        } else if (fmt_ctx_->pb) {
+            avio_closep(&fmt_ctx_->pb);
+            std::error_code ec;
+            if (!publish) fs::remove(file_path_, ec);
+        }
         avformat_free_context(fmt_ctx_);
         fmt_ctx_ = nullptr;
     }
+    if (file_id_) {
+        if (publish) {
+            output_.files->close(file_id_, file_path_);
+        } else {
+            output_.files->close(file_id_);  // stays where it was written
+            output_.files->remove(writePath());
+        }
+        file_id_ = 0;
+    }
     stream_ = nullptr;
 }
 
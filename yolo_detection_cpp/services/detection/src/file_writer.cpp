@@ -0,0 +1,294 @@
+#include "file_writer.h"
+#include "metrics.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace hms {
+
+namespace {
+
+template <typename... Fs>
+struct Overloaded : Fs... { using Fs::operator()...; };
+template <typename... Fs>
+Overloaded(Fs...) -> Overloaded<Fs...>;
+
+int openForWrite(const std::string& path) {
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+/// pwrite() all of it, through short writes and EINTR
+bool writeAll(int fd, const char* data, size_t size, int64_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+}  // namespace
+
+FileWriter::FileWriter() : FileWriter(Options{}) {}
+
+FileWriter::FileWriter(Options options) : options_(options) {
+    options_.queue_bytes = std::max<size_t>(1, options_.queue_bytes);
+    writer_ = std::thread(&FileWriter::run, this);
+}
+
+FileWriter::~FileWriter() {
+    stop();
+}
+
+FileWriter::FileId FileWriter::open(std::string path) {
+    FileId file;
+    {
+        std::lock_guard lock(mutex_);
+        file = next_file_++;
+        open_paths_[file] = path;
+    }
+    submit(Open{file, std::move(path)}, 0);
+    return file;
+}
+
+void FileWriter::write(FileId file, int64_t offset, std::string data) {
+    size_t bytes = data.size();
+    submit(Write{file, offset, std::move(data)}, bytes);
+}
+
+void FileWriter::close(FileId file, std::string final_path) {
+    submit(Close{file, std::move(final_path)}, 0);
+}
+
+void FileWriter::writeFile(std::string path, std::shared_ptr<const std::string> data) {
+    if (!data) return;
+    size_t bytes = data->size();
+    submit(WriteFile{std::move(path), std::move(data)}, bytes);
+}
+
+void FileWriter::remove(std::string path) {
+    submit(Remove{std::move(path)}, 0);
+}
+
+void FileWriter::submit(Op op, size_t bytes) {
+    {
+        std::unique_lock lock(mutex_);
+        if (exited_) {
+            // Producers are stopped before the writer; anything later is a bug
+            spdlog::warn("FileWriter: stopped, dropping a write");
+            stats_.failures++;
+            return;
+        }
+        // Backpressure only while something is in flight, so an op larger
+        // than the whole budget still goes through
+        if (queued_bytes_ > 0 && queued_bytes_ + bytes > options_.queue_bytes) {
+            stats_.producer_waits++;
+            space_cv_.wait(lock, [&] {
+                return stopping_ || queued_bytes_ == 0 || queued_bytes_ + bytes <= options_.queue_bytes;
+            });
+        }
+        if (auto* w = std::get_if<WriteFile>(&op)) pending_files_[w->path] = w->data;
+        if (auto* c = std::get_if<Close>(&op); c && !c->final_path.empty()) {
+            if (auto it = open_paths_.find(c->file); it != open_paths_.end() && it->second != c->final_path) {
+                staged_[c->final_path] = it->second;
+            }
+        }
+        queue_.emplace_back(std::move(op), bytes);
+        queued_bytes_ += bytes;
+        submitted_++;
+    }
+    cv_.notify_one();
+}
+
+std::shared_ptr<const std::string> FileWriter::pending(const std::string& path) const {
+    std::lock_guard lock(mutex_);
+    auto it = pending_files_.find(path);
+    return it != pending_files_.end() ? it->second : nullptr;
+}
+
+std::string FileWriter::locate(const std::string& final_path) const {
+    std::lock_guard lock(mutex_);
+    auto it = staged_.find(final_path);
+    return it != staged_.end() ? it->second : final_path;
+}
+
+void FileWriter::flush() {
+    std::unique_lock lock(mutex_);
+    uint64_t target = submitted_;
+    space_cv_.wait(lock, [&] { return done_ >= target || exited_; });
+}
+
+void FileWriter::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        if (stopping_ && !writer_.joinable()) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    space_cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+}
+
+FileWriter::Stats FileWriter::stats() const {
+    std::lock_guard lock(mutex_);
+    Stats s = stats_;
+    s.queued_bytes = queued_bytes_;
+    s.queued_ops = queue_.size();
+    return s;
+}
+
+void FileWriter::run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) break;  // stopping, and everything is written
+
+        auto [op, bytes] = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        auto t0 = std::chrono::steady_clock::now();
+        apply(op);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        lock.lock();
+        queued_bytes_ -= bytes;
+        done_++;
+        stats_.max_op_ms = std::max(stats_.max_op_ms, ms);
+        if (auto* w = std::get_if<WriteFile>(&op)) {
+            if (auto it = pending_files_.find(w->path); it != pending_files_.end() && it->second == w->data) {
+                pending_files_.erase(it);
+            }
+        }
+        if (auto* c = std::get_if<Close>(&op)) {
+            open_paths_.erase(c->file);
+            if (!c->final_path.empty()) staged_.erase(c->final_path);
+        }
+        space_cv_.notify_all();
+    }
+
+    exited_ = true;
+    space_cv_.notify_all();
+    lock.unlock();
+
+    // Files nobody closed (a recorder torn down mid-write)
+    for (auto& [file, handle] : handles_) {
+        if (handle.fd >= 0) ::close(handle.fd);
+    }
+    handles_.clear();
+}
+
+void FileWriter::apply(Op& op) {
+    static auto& metric = Metrics::histogram(Metrics::Stage::FileWrite);
+    Metrics::Timer timer(metric);
+
+    auto fail = [this](const std::string& what, const std::string& path) {
+        spdlog::error("FileWriter: {} {} failed: {}", what, path, std::strerror(errno));
+        std::lock_guard lock(mutex_);
+        stats_.failures++;
+    };
+
+    std::visit(Overloaded{
+        [&](Open& o) {
+            auto& h = handles_[o.file];
+            h.path = std::move(o.path);
+            h.fd = openForWrite(h.path);
+            if (h.fd < 0) {
+                h.failed = true;
+                fail("open", h.path);
+            }
+        },
+        [&](Write& w) {
+            auto it = handles_.find(w.file);
+            if (it == handles_.end() || it->second.failed) return;
+            auto& h = it->second;
+            if (!writeAll(h.fd, w.data.data(), w.data.size(), w.offset)) {
+                h.failed = true;
+                fail("write to", h.path);
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            stats_.bytes_written += w.data.size();
+        },
+        [&](Close& c) {
+            auto it = handles_.find(c.file);
+            if (it == handles_.end()) return;
+            Handle h = std::move(it->second);
+            handles_.erase(it);
+            if (h.fd >= 0 && ::close(h.fd) != 0 && !h.failed) {
+                h.failed = true;
+                fail("close", h.path);
+            }
+            bool moved = !c.final_path.empty() && c.final_path != h.path;
+            if (h.failed || (moved && !move(h.path, c.final_path))) {
+                // Failure already counted; don't strand the file in staging
+                // (tmpfs), where nothing would ever delete it
+                if (moved) ::unlink(h.path.c_str());
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            stats_.files_closed++;
+            if (moved) stats_.moves++;
+        },
+        [&](WriteFile& w) {
+            std::string part = w.path + ".part";
+            int fd = openForWrite(part);
+            if (fd < 0) return fail("open", part);
+            bool ok = writeAll(fd, w.data->data(), w.data->size(), 0);
+            if (::close(fd) != 0) ok = false;
+            if (!ok || ::rename(part.c_str(), w.path.c_str()) != 0) {
+                fail("write", w.path);
+                ::unlink(part.c_str());
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            stats_.bytes_written += w.data->size();
+            stats_.files_closed++;
+        },
+        [&](Remove& r) {
+            std::error_code ec;
+            fs::remove(r.path, ec);
+        },
+    }, op);
+}
+
+bool FileWriter::move(const std::string& from, const std::string& to) {
+    std::error_code ec;
+    fs::create_directories(fs::path(to).parent_path(), ec);
+    if (::rename(from.c_str(), to.c_str()) == 0) return true;
+
+    // Staging on another filesystem (tmpfs): copy next to the target, then swap it in
+    bool ok = false;
+    if (errno == EXDEV) {
+        std::string part = to + ".part";
+        ok = fs::copy_file(from, part, fs::copy_options::overwrite_existing, ec)
+             && ::rename(part.c_str(), to.c_str()) == 0;
+        if (ec) errno = ec.value();
+        if (!ok) fs::remove(part, ec);
+    }
+    if (!ok) {
+        spdlog::error("FileWriter: moving {} to {} failed: {}", from, to, std::strerror(errno));
+        std::lock_guard lock(mutex_);
+        stats_.failures++;
+        return false;
+    }
+    fs::remove(from, ec);
+    return true;
+}
+
+}  // namespace hms
@@ -0,0 +1,252 @@
+#include "gpu_letterbox.h"
+
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+
+#ifdef HMS_HAVE_CUDA_PREPROCESS
+#include "gpu_letterbox_kernels.h"
+
+#include <algorithm>
+#include <string>
+#endif
+
+namespace hms {
+
+#ifdef HMS_HAVE_CUDA_PREPROCESS
+
+namespace {
+
+/// cudaMalloc'd bytes that only ever grow. cudaFree waits for the device,
+/// so growing never pulls memory from under a queued kernel.
+struct DeviceBuffer {
+    void* ptr = nullptr;
+    size_t bytes = 0;
+
+    DeviceBuffer() = default;
+    DeviceBuffer(const DeviceBuffer&) = delete;
+    DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+    ~DeviceBuffer() {
+        if (ptr) cudaFree(ptr);
+    }
+
+    bool reserve(size_t n) {
+        if (n <= bytes) return true;
+        if (ptr) cudaFree(ptr);
+        ptr = nullptr;
+        bytes = 0;
+        if (cudaMalloc(&ptr, n) != cudaSuccess) return false;
+        bytes = n;
+        return true;
+    }
+
+    uint8_t* at(size_t offset) const { return static_cast<uint8_t*>(ptr) + offset; }
+};
+
+constexpr size_t kPlaneAlignment = 256;
+constexpr size_t kMaxPlans = 32;  // as DetectionEngine's plan cache
+
+size_t alignUp(size_t n) { return (n + kPlaneAlignment - 1) / kPlaneAlignment * kPlaneAlignment; }
+
+bool ok(cudaError_t err, const char* what) {
+    if (err == cudaSuccess) return true;
+    spdlog::warn("GpuLetterbox: {} failed: {}", what, cudaGetErrorString(err));
+    return false;
+}
+
+}  // namespace
+
+struct GpuLetterbox::Impl {
+    struct Tables {
+        std::shared_ptr<const LetterboxPlan> plan;  // keeps the key alive
+        DeviceBuffer data;
+        cuda::DevicePlan device;
+    };
+
+    int device = 0;
+    cudaStream_t stream = nullptr;
+    DeviceBuffer tensor;
+    DeviceBuffer staging;  // source planes of the inputs being letterboxed
+    std::vector<std::unique_ptr<Tables>> tables;
+
+    /// The plan's index tables on the device, uploaded once per plan
+    const cuda::DevicePlan* devicePlan(const std::shared_ptr<const LetterboxPlan>& plan) {
+        for (const auto& t : tables) {
+            if (t->plan == plan) return &t->device;
+        }
+        if (tables.size() >= kMaxPlans) tables.erase(tables.begin());
+
+        auto t = std::make_unique<Tables>();
+        t->plan = plan;
+        const size_t xs = plan->x0.size() * sizeof(int32_t), ys = plan->y0.size() * sizeof(int32_t);
+        const size_t wxs = plan->wx.size() * sizeof(int16_t), wys = plan->wy.size() * sizeof(int16_t);
+        const size_t offsets[] = {0, alignUp(xs), 2 * alignUp(xs), 2 * alignUp(xs) + alignUp(ys),
+                                  2 * alignUp(xs) + 2 * alignUp(ys),
+                                  2 * alignUp(xs) + 2 * alignUp(ys) + alignUp(wxs)};
+        if (!t->data.reserve(std::max<size_t>(1, offsets[5] + wys))) return nullptr;
+
+        const void* host[] = {plan->x0.data(), plan->x1.data(), plan->y0.data(), plan->y1.data(),
+                              plan->wx.data(), plan->wy.data()};
+        const size_t sizes[] = {xs, xs, ys, ys, wxs, wys};
+        for (int i = 0; i < 6; ++i) {
+            if (sizes[i] > 0 && !ok(cudaMemcpyAsync(t->data.at(offsets[i]), host[i], sizes[i],
+                                                    cudaMemcpyHostToDevice, stream), "table upload")) {
+                return nullptr;
+            }
+        }
+
+        auto& d = t->device;
+        d.dst_w = plan->dst_w;
+        d.dst_h = plan->dst_h;
+        d.new_w = plan->new_w;
+        d.new_h = plan->new_h;
+        d.pad_left = plan->pad_left;
+        d.pad_top = plan->pad_top;
+        d.bilinear = plan->mode == ResizeMode::Bilinear;
+        d.x0 = reinterpret_cast<const int32_t*>(t->data.at(offsets[0]));
+        d.x1 = reinterpret_cast<const int32_t*>(t->data.at(offsets[1]));
+        d.y0 = reinterpret_cast<const int32_t*>(t->data.at(offsets[2]));
+        d.y1 = reinterpret_cast<const int32_t*>(t->data.at(offsets[3]));
+        d.wx = reinterpret_cast<const int16_t*>(t->data.at(offsets[4]));
+        d.wy = reinterpret_cast<const int16_t*>(t->data.at(offsets[5]));
+        tables.push_back(std::move(t));
+        return &tables.back()->device;
+    }
+};
+
+bool GpuLetterbox::available(int device) {
+    int count = 0;
+    return device >= 0 && cudaGetDeviceCount(&count) == cudaSuccess && device < count;
+}
+
+GpuLetterbox::GpuLetterbox(int device) : impl_(std::make_unique<Impl>()) {
+    impl_->device = device;
+    cudaError_t err = cudaSetDevice(device);
+    if (err == cudaSuccess) err = cudaStreamCreateWithFlags(&impl_->stream, cudaStreamNonBlocking);
+    if (err != cudaSuccess) {
+        throw std::runtime_error(std::string("CUDA device ") + std::to_string(device) + ": "
+                                 + cudaGetErrorString(err));
+    }
+}
+
+GpuLetterbox::~GpuLetterbox() {
+    if (!impl_->stream) return;
+    cudaSetDevice(impl_->device);
+    cudaStreamSynchronize(impl_->stream);
+    cudaStreamDestroy(impl_->stream);
+}
+
+void* GpuLetterbox::reserveTensor(size_t bytes) {
+    cudaSetDevice(impl_->device);
+    return impl_->tensor.reserve(bytes) ? impl_->tensor.ptr : nullptr;
+}
+
+bool GpuLetterbox::fromYuv(const std::shared_ptr<const LetterboxPlan>& plan, const YuvPlanes& src,
+                           const Region& region, void* dst, bool fp16) {
+    cudaSetDevice(impl_->device);
+    const auto* device_plan = impl_->devicePlan(plan);
+    if (!device_plan) return false;
+
+    // Only the region's rows and columns cross the bus, luma plus the chroma
+    // that covers it: 1.5 bytes a pixel instead of 12 of float tensor
+    const int cx = region.x / 2, cy = region.y / 2;
+    const int cw = (region.x + region.w + 1) / 2 - cx, ch = (region.y + region.h + 1) / 2 - cy;
+    const bool nv12 = src.layout == YuvPlanes::Layout::Nv12;
+    const int chroma_planes = nv12 ? 1 : 2;
+    const size_t chroma_row = static_cast<size_t>(cw) * (nv12 ? 2 : 1);
+    const size_t luma_bytes = alignUp(static_cast<size_t>(region.w) * region.h);
+    const size_t chroma_bytes = alignUp(chroma_row * ch);
+    if (!impl_->staging.reserve(luma_bytes + chroma_planes * chroma_bytes)) return false;
+
+    cuda::DeviceSource dsrc;
+    dsrc.format = nv12 ? cuda::DeviceSource::Format::Nv12 : cuda::DeviceSource::Format::I420;
+    dsrc.chroma_x = region.x & 1;
+    dsrc.chroma_y = region.y & 1;
+    dsrc.full_range = src.full_range;
+
+    dsrc.data[0] = impl_->staging.at(0);
+    dsrc.stride[0] = region.w;
+    if (!ok(cudaMemcpy2DAsync(impl_->staging.at(0), region.w,
+                              src.data[0] + static_cast<size_t>(region.y) * src.stride[0] + region.x,
+                              src.stride[0], region.w, region.h, cudaMemcpyHostToDevice, impl_->stream),
+            "luma upload")) {
+        return false;
+    }
+    for (int p = 1; p <= chroma_planes; ++p) {
+        size_t offset = luma_bytes + (p - 1) * chroma_bytes;
+        dsrc.data[p] = impl_->staging.at(offset);
+        dsrc.stride[p] = static_cast<int>(chroma_row);
+        const uint8_t* origin = src.data[p] + static_cast<size_t>(cy) * src.stride[p]
+                                + static_cast<size_t>(cx) * (nv12 ? 2 : 1);
+        if (!ok(cudaMemcpy2DAsync(impl_->staging.at(offset), chroma_row, origin, src.stride[p],
+                                  chroma_row, ch, cudaMemcpyHostToDevice, impl_->stream),
+                "chroma upload")) {
+            return false;
+        }
+    }
+    return ok(cuda::letterbox(*device_plan, dsrc, dst, fp16, impl_->stream), "letterbox kernel");
+}
+
+bool GpuLetterbox::fromBgr(const std::shared_ptr<const LetterboxPlan>& plan, const uint8_t* src, int stride,
+                           const Region& region, void* dst, bool fp16) {
+    cudaSetDevice(impl_->device);
+    const auto* device_plan = impl_->devicePlan(plan);
+    const size_t row = static_cast<size_t>(region.w) * 3;
+    if (!device_plan || !impl_->staging.reserve(row * region.h)) return false;
+
+    cuda::DeviceSource dsrc;
+    dsrc.format = cuda::DeviceSource::Format::Bgr;
+    dsrc.data[0] = impl_->staging.at(0);
+    dsrc.stride[0] = static_cast<int>(row);
+    const uint8_t* origin = src + static_cast<size_t>(region.y) * stride + static_cast<size_t>(region.x) * 3;
+    if (!ok(cudaMemcpy2DAsync(impl_->staging.at(0), row, origin, stride, row, region.h,
+                              cudaMemcpyHostToDevice, impl_->stream), "BGR upload")) {
+        return false;
+    }
+    return ok(cuda::letterbox(*device_plan, dsrc, dst, fp16, impl_->stream), "letterbox kernel");
+}
+
+bool GpuLetterbox::fill(int dst_w, int dst_h, void* dst, bool fp16) {
+    cudaSetDevice(impl_->device);
+    cuda::DevicePlan plan;  // no picture area: padding everywhere
+    plan.dst_w = dst_w;
+    plan.dst_h = dst_h;
+    return ok(cuda::letterbox(plan, cuda::DeviceSource{}, dst, fp16, impl_->stream), "fill kernel");
+}
+
+bool GpuLetterbox::synchronize() {
+    cudaSetDevice(impl_->device);
+    return ok(cudaStreamSynchronize(impl_->stream), "letterbox");
+}
+
+#else  // !HMS_HAVE_CUDA_PREPROCESS
+
+struct GpuLetterbox::Impl {};
+
+bool GpuLetterbox::available(int) { return false; }
+
+GpuLetterbox::GpuLetterbox(int) {
+    throw std::runtime_error("built without HMS_CUDA_PREPROCESS");
+}
+
+GpuLetterbox::~GpuLetterbox() = default;
+
+void* GpuLetterbox::reserveTensor(size_t) { return nullptr; }
+
+bool GpuLetterbox::fromYuv(const std::shared_ptr<const LetterboxPlan>&, const YuvPlanes&,
+                           const Region&, void*, bool) {
+    return false;
+}
+
+bool GpuLetterbox::fromBgr(const std::shared_ptr<const LetterboxPlan>&, const uint8_t*, int,
+                           const Region&, void*, bool) {
+    return false;
+}
+
+bool GpuLetterbox::fill(int, int, void*, bool) { return false; }
+
+bool GpuLetterbox::synchronize() { return false; }
+
+#endif
+
+}  // namespace hms
@@ -0,0 +1,129 @@
+#include "gpu_letterbox_kernels.h"
+
+#include <cuda_fp16.h>
+
+namespace hms::cuda {
+
+namespace {
+
+constexpr float kInv255 = 1.0f / 255.0f;
+constexpr float kPadValue = 114.0f / 255.0f;
+constexpr int kWeightBits = 11;
+constexpr int kWeightOne = 1 << kWeightBits;
+
+__device__ __forceinline__ int clampU8(int v) { return min(max(v, 0), 255); }
+
+/// One BT.601 sample; integer coefficients of libswscale's default matrix
+__device__ __forceinline__ int3 yuvToRgb(int y, int u, int v, bool full_range) {
+    int d = u - 128, e = v - 128;
+    if (full_range) {
+        int c = y << 8;
+        return make_int3(clampU8((c + 359 * e + 128) >> 8),
+                         clampU8((c - 88 * d - 183 * e + 128) >> 8),
+                         clampU8((c + 454 * d + 128) >> 8));
+    }
+    int c = 298 * (y - 16);
+    return make_int3(clampU8((c + 409 * e + 128) >> 8),
+                     clampU8((c - 100 * d - 208 * e + 128) >> 8),
+                     clampU8((c + 516 * d + 128) >> 8));
+}
+
+/// RGB of source pixel (col, row); `xoff` is the plan's BGR byte offset
+template <DeviceSource::Format F>
+__device__ __forceinline__ int3 fetch(const DeviceSource& src, int32_t xoff, int32_t row) {
+    if constexpr (F == DeviceSource::Format::Bgr) {
+        const uint8_t* p = src.data[0] + static_cast<size_t>(row) * src.stride[0] + xoff;
+        return make_int3(p[2], p[1], p[0]);
+    } else {
+        int col = xoff / 3;
+        int y = src.data[0][static_cast<size_t>(row) * src.stride[0] + col];
+        int cc = (col + src.chroma_x) >> 1, cr = (row + src.chroma_y) >> 1;
+        int u, v;
+        if constexpr (F == DeviceSource::Format::Nv12) {
+            const uint8_t* uv = src.data[1] + static_cast<size_t>(cr) * src.stride[1] + 2 * cc;
+            u = uv[0];
+            v = uv[1];
+        } else {
+            u = src.data[1][static_cast<size_t>(cr) * src.stride[1] + cc];
+            v = src.data[2][static_cast<size_t>(cr) * src.stride[2] + cc];
+        }
+        return yuvToRgb(y, u, v, src.full_range);
+    }
+}
+
+template <typename T>
+__device__ __forceinline__ void store(T* dst, size_t i, float v);
+
+template <>
+__device__ __forceinline__ void store<float>(float* dst, size_t i, float v) { dst[i] = v; }
+
+template <>
+__device__ __forceinline__ void store<__half>(__half* dst, size_t i, float v) { dst[i] = __float2half(v); }
+
+/// One thread per tensor pixel, all three planes
+template <DeviceSource::Format F, typename T>
+__global__ void letterboxKernel(DevicePlan plan, DeviceSource src, T* dst) {
+    int dx = blockIdx.x * blockDim.x + threadIdx.x;
+    int dy = blockIdx.y * blockDim.y + threadIdx.y;
+    if (dx >= plan.dst_w || dy >= plan.dst_h) return;
+
+    const size_t plane = static_cast<size_t>(plan.dst_w) * plan.dst_h;
+    const size_t o = static_cast<size_t>(dy) * plan.dst_w + dx;
+    int ix = dx - plan.pad_left, iy = dy - plan.pad_top;
+    if (ix < 0 || iy < 0 || ix >= plan.new_w || iy >= plan.new_h) {
+        store(dst, o, kPadValue);
+        store(dst, plane + o, kPadValue);
+        store(dst, 2 * plane + o, kPadValue);
+        return;
+    }
+
+    int3 rgb;
+    if (!plan.bilinear) {
+        rgb = fetch<F>(src, plan.x0[ix], plan.y0[iy]);
+    } else {
+        // Same fixed-point blend as letterboxToTensor(), per converted tap
+        int wx1 = plan.wx[ix], wx0 = kWeightOne - wx1;
+        int wy1 = plan.wy[iy], wy0 = kWeightOne - wy1;
+        int3 p00 = fetch<F>(src, plan.x0[ix], plan.y0[iy]);
+        int3 p01 = fetch<F>(src, plan.x1[ix], plan.y0[iy]);
+        int3 p10 = fetch<F>(src, plan.x0[ix], plan.y1[iy]);
+        int3 p11 = fetch<F>(src, plan.x1[ix], plan.y1[iy]);
+        auto blend = [&](int a, int b, int c, int d) {
+            int top = a * wx0 + b * wx1;
+            int bot = c * wx0 + d * wx1;
+            return (top * wy0 + bot * wy1 + (1 << (2 * kWeightBits - 1))) >> (2 * kWeightBits);
+        };
+        rgb = make_int3(blend(p00.x, p01.x, p10.x, p11.x),
+                        blend(p00.y, p01.y, p10.y, p11.y),
+                        blend(p00.z, p01.z, p10.z, p11.z));
+    }
+    store(dst, o, rgb.x * kInv255);
+    store(dst, plane + o, rgb.y * kInv255);
+    store(dst, 2 * plane + o, rgb.z * kInv255);
+}
+
+template <DeviceSource::Format F>
+cudaError_t launch(const DevicePlan& plan, const DeviceSource& src, void* dst, bool fp16,
+                   cudaStream_t stream) {
+    dim3 block(32, 8);
+    dim3 grid((plan.dst_w + block.x - 1) / block.x, (plan.dst_h + block.y - 1) / block.y);
+    if (fp16) {
+        letterboxKernel<F, __half><<<grid, block, 0, stream>>>(plan, src, static_cast<__half*>(dst));
+    } else {
+        letterboxKernel<F, float><<<grid, block, 0, stream>>>(plan, src, static_cast<float*>(dst));
+    }
+    return cudaGetLastError();
+}
+
+}  // namespace
+
+cudaError_t letterbox(const DevicePlan& plan, const DeviceSource& src, void* dst, bool fp16,
+                      cudaStream_t stream) {
+    switch (src.format) {
+        case DeviceSource::Format::I420: return launch<DeviceSource::Format::I420>(plan, src, dst, fp16, stream);
+        case DeviceSource::Format::Nv12: return launch<DeviceSource::Format::Nv12>(plan, src, dst, fp16, stream);
+        default: return launch<DeviceSource::Format::Bgr>(plan, src, dst, fp16, stream);
+    }
+}
+
+}  // namespace hms::cuda
@@ -0,0 +1,58 @@
+#include "image_scale.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace hms {
+
+void scaledSize(int w, int h, int max_width, int& out_w, int& out_h) {
+    if (max_width <= 0 || max_width >= w) {
+        out_w = w;
+        out_h = h;
+        return;
+    }
+    out_w = max_width;
+    out_h = std::max(1, static_cast<int>((static_cast<int64_t>(h) * max_width + w / 2) / w));
+}
+
+void downscaleArea(const uint8_t* src, int src_w, int src_h, int src_stride,
+                   uint8_t* dst, int dst_w, int dst_h, int dst_stride) {
+    if (dst_w <= 0 || dst_h <= 0) return;
+
+    // Source column span of each destination column: [x0[d], x0[d + 1])
+    std::vector<int> x0(dst_w + 1);
+    for (int d = 0; d <= dst_w; ++d) {
+        x0[d] = static_cast<int>(static_cast<int64_t>(d) * src_w / dst_w);
+    }
+
+    // Column sums of the source rows under one destination row
+    std::vector<uint32_t> sums(static_cast<size_t>(src_w) * 3);
+    for (int dy = 0; dy < dst_h; ++dy) {
+        int y0 = static_cast<int>(static_cast<int64_t>(dy) * src_h / dst_h);
+        int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(dy + 1) * src_h / dst_h));
+
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t* row = src + static_cast<size_t>(y) * src_stride;
+            for (int i = 0; i < src_w * 3; ++i) sums[i] += row[i];
+        }
+
+        uint8_t* out = dst + static_cast<size_t>(dy) * dst_stride;
+        for (int dx = 0; dx < dst_w; ++dx) {
+            int xa = x0[dx];
+            int xb = std::max(xa + 1, x0[dx + 1]);
+            uint32_t count = static_cast<uint32_t>((xb - xa) * (y1 - y0));
+            uint32_t b = 0, g = 0, r = 0;
+            for (int x = xa; x < xb; ++x) {
+                b += sums[x * 3];
+                g += sums[x * 3 + 1];
+                r += sums[x * 3 + 2];
+            }
+            out[dx * 3] = static_cast<uint8_t>((b + count / 2) / count);
+            out[dx * 3 + 1] = static_cast<uint8_t>((g + count / 2) / count);
+            out[dx * 3 + 2] = static_cast<uint8_t>((r + count / 2) / count);
+        }
+    }
+}
+
+}  // namespace hms
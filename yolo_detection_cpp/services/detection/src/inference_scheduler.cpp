@@ -0,0 +1,383 @@
+#include "inference_scheduler.h"
+#include "metrics.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace hms {
+
+InferenceScheduler::InferenceScheduler(std::shared_ptr<EnginePool> engines,
+                                       const SchedulerConfig& config)
+    : engines_(std::move(engines))
+    , sessions_(std::make_unique<SessionState[]>(engines_ ? engines_->size() : 1))
+    , max_batch_size_(static_cast<size_t>(std::max(1, config.max_batch_size)))
+    , max_wait_(std::max(0, config.max_wait_ms))
+    , pipelined_(config.pipeline_depth > 1)
+{
+}
+
+InferenceScheduler::InferenceScheduler(std::shared_ptr<DetectionEngine> engine,
+                                       const SchedulerConfig& config)
+    : InferenceScheduler(engine ? std::make_shared<EnginePool>(
+                                      std::vector<std::shared_ptr<DetectionEngine>>{std::move(engine)})
+                                : nullptr,
+                         config)
+{
+}
+
+InferenceScheduler::~InferenceScheduler() {
+    stop();
+}
+
+void InferenceScheduler::start() {
+    if (running_.exchange(true)) return;
+    size_t sessions = engines_ ? engines_->size() : 1;
+    for (size_t i = 0; i < sessions; ++i) {
+        if (pipelined_) {
+            sessions_[i].to_infer.reopen();
+            sessions_[i].to_finish.reopen();
+            sessions_[i].infer_thread = std::thread(&InferenceScheduler::inferLoop, this, i);
+            sessions_[i].finish_thread = std::thread(&InferenceScheduler::finishLoop, this, i);
+        }
+        threads_.emplace_back(&InferenceScheduler::dispatchLoop, this, i);
+    }
+    auto primary = engine();
+    spdlog::info("InferenceScheduler: started (max_batch={}, max_wait={}ms, batching={}, sessions={}, {})",
+                 max_batch_size_, max_wait_.count(),
+                 primary && primary->supportsBatching() ? "dynamic" : "sequential", sessions,
+                 pipelined_ ? "pipelined" : "sequential stages");
+}
+
+void InferenceScheduler::stop() {
+    {
+        std::lock_guard lock(queue_mutex_);
+        if (!running_.exchange(false)) return;
+    }
+    queue_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+
+    // Batches already past the dispatch stage still run and resolve
+    if (pipelined_) {
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            sessions_[i].to_infer.close();
+            sessions_[i].infer_thread.join();
+            sessions_[i].to_finish.close();
+            sessions_[i].finish_thread.join();
+        }
+    }
+    threads_.clear();
+
+    // Nobody will dispatch these any more — resolve them so callers don't hang
+    // (outside the lock: callbacks may submit again, and then detect inline)
+    std::vector<Request> orphans;
+    {
+        std::lock_guard lock(queue_mutex_);
+        for (auto* queue : {&event_queue_, &continuous_queue_}) {
+            for (auto& req : *queue) orphans.push_back(std::move(req));
+            queue->clear();
+        }
+    }
+    for (auto& req : orphans) req.resolve({});
+    spdlog::info("InferenceScheduler: stopped");
+}
+
+std::future<std::vector<Detection>> InferenceScheduler::submit(std::shared_ptr<FrameData> frame,
+                                                               DetectParams params,
+                                                               Priority priority) {
+    Request req{
+        .frame = std::move(frame),
+        .params = std::move(params),
+        .promise = {},
+        .done = {},
+        .enqueued = SteadyClock::now(),
+    };
+    auto future = req.promise.get_future();
+    enqueue(std::move(req), priority);
+    return future;
+}
+
+void InferenceScheduler::submit(std::shared_ptr<FrameData> frame, DetectParams params, Priority priority,
+                                std::function<void(std::vector<Detection>)> done) {
+    enqueue(Request{
+        .frame = std::move(frame),
+        .params = std::move(params),
+        .promise = {},
+        .done = std::move(done),
+        .enqueued = SteadyClock::now(),
+    }, priority);
+}
+
+void InferenceScheduler::enqueue(Request req, Priority priority) {
+    requests_.fetch_add(1);
+    if (priority == Priority::Event) event_requests_.fetch_add(1);
+
+    {
+        std::lock_guard lock(queue_mutex_);
+        if (running_) {
+            auto& queue = priority == Priority::Event ? event_queue_ : continuous_queue_;
+            queue.push_back(std::move(req));
+            queue_cv_.notify_one();
+            return;
+        }
+    }
+
+    // Not running: detect inline on the caller's thread
+    std::vector<Request> single;
+    single.push_back(std::move(req));
+    runBatch(single, 0);
+}
+
+InferenceScheduler::Stats InferenceScheduler::stats() const {
+    uint64_t batches = batches_.load();
+    size_t depth;
+    {
+        std::lock_guard lock(queue_mutex_);
+        depth = event_queue_.size() + continuous_queue_.size();
+    }
+    return Stats{
+        .requests = requests_.load(),
+        .batches = batches,
+        .event_requests = event_requests_.load(),
+        .avg_batch_size = batches > 0
+            ? static_cast<double>(frames_batched_.load()) / static_cast<double>(batches) : 0.0,
+        .max_batch_size = largest_batch_.load(),
+        .queue_depth = depth,
+        .sessions = sessionStats(),
+    };
+}
+
+std::vector<InferenceScheduler::Stats::Session> InferenceScheduler::sessionStats() const {
+    size_t n = engines_ ? engines_->size() : 1;
+    std::vector<Stats::Session> result;
+    result.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const auto& state = sessions_[i];
+        const auto* engine = engines_ ? engines_->engine(i).get() : nullptr;
+        bool loaded = engine && engine->isLoaded();
+        // Requested provider until loaded; afterwards the one that registered
+        auto provider = !engine ? ExecutionProvider::Cpu
+                        : loaded ? engine->activeProvider() : engine->provider();
+        bool reduced = provider == ExecutionProvider::TensorRt || provider == ExecutionProvider::OpenVino;
+        result.push_back(Stats::Session{
+            .device = engine ? engine->device() : -1,
+            .threads = engine ? engine->threads() : 0,
+            .provider = provider,
+            .precision = reduced ? engine->precision() : Precision::Fp32,
+            .loaded = loaded,
+            .gpu_preprocess = loaded && engine->gpuPreprocessActive(),
+            .batches = state.batches.load(),
+            .frames = state.frames.load(),
+            .preprocess_ms = static_cast<double>(state.preprocess_ns.load()) / 1e6,
+            .busy_ms = static_cast<double>(state.busy_ns.load()) / 1e6,
+            .postprocess_ms = static_cast<double>(state.postprocess_ns.load()) / 1e6,
+            .utilization = state.utilization.load(),
+        });
+    }
+    return result;
+}
+
+void InferenceScheduler::dispatchLoop(size_t session) {
+    std::vector<Request> batch;
+    batch.reserve(max_batch_size_);
+
+    auto& state = sessions_[session];
+    auto* engine = engines_ ? engines_->engine(session).get() : nullptr;
+    auto window_start = SteadyClock::now();
+    uint64_t window_busy = state.busy_ns.load();
+
+    while (true) {
+        // Once a second: let an idle engine drop its session once the TTL expires,
+        // and sample how busy this session was
+        auto now = SteadyClock::now();
+        if (now - window_start >= kResidencyCheckInterval) {
+            if (engine) engine->unloadIfIdle();
+            uint64_t busy = state.busy_ns.load();
+            auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(now - window_start).count();
+            state.utilization.store(std::min(1.0, static_cast<double>(busy - window_busy) / wall));
+            window_start = now;
+            window_busy = busy;
+        }
+
+        {
+            std::unique_lock lock(queue_mutex_);
+            bool ready = queue_cv_.wait_for(lock, kResidencyCheckInterval, [this] {
+                return !running_ || !event_queue_.empty() || !continuous_queue_.empty();
+            });
+            if (!running_) return;
+            if (!ready) continue;
+
+            // Continuous-only batches wait for company until the oldest request's deadline;
+            // any pending event request dispatches immediately.
+            if (event_queue_.empty()) {
+                auto deadline = continuous_queue_.front().enqueued + max_wait_;
+                queue_cv_.wait_until(lock, deadline, [this] {
+                    return !running_ || !event_queue_.empty() ||
+                           continuous_queue_.size() >= max_batch_size_;
+                });
+                if (!running_) return;
+            }
+
+            // Events first, then fill with continuous work. Another session may
+            // have taken everything while we waited.
+            for (auto* queue : {&event_queue_, &continuous_queue_}) {
+                while (!queue->empty() && batch.size() < max_batch_size_) {
+                    batch.push_back(std::move(queue->front()));
+                    queue->pop_front();
+                }
+            }
+            // Leftovers: wake another idle session for them
+            if (!event_queue_.empty() || !continuous_queue_.empty()) queue_cv_.notify_one();
+        }
+        if (batch.empty()) continue;
+
+        if (pipelined_) {
+            state.to_infer.push(prepare(batch, session));
+        } else {
+            runBatch(batch, session);
+        }
+        batch.clear();
+    }
+}
+
+void InferenceScheduler::inferLoop(size_t session) {
+    auto& state = sessions_[session];
+    InFlight work;
+    while (state.to_infer.pop(work)) {
+        infer(work, session);
+        state.to_finish.push(std::move(work));
+    }
+}
+
+void InferenceScheduler::finishLoop(size_t session) {
+    InFlight work;
+    while (sessions_[session].to_finish.pop(work)) finish(work, session);
+}
+
+namespace {
+
+uint64_t elapsedNs(SteadyClock::time_point since) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now() - since).count());
+}
+
+}  // namespace
+
+InferenceScheduler::InFlight InferenceScheduler::prepare(std::vector<Request>& batch, size_t session) {
+    InFlight work;
+    work.batch = std::move(batch);
+    if (!engines_) return work;
+
+    std::vector<const FrameData*> frames;
+    std::vector<DetectParams> params;
+    frames.reserve(work.batch.size());
+    params.reserve(work.batch.size());
+    for (const auto& req : work.batch) {
+        frames.push_back(req.frame.get());
+        params.push_back(req.params);
+    }
+
+    auto start = SteadyClock::now();
+    try {
+        work.job = engines_->engine(session)->prepareBatch(frames, params);
+    } catch (const std::exception& e) {
+        spdlog::error("InferenceScheduler: preprocessing {} frame(s) failed on session {}: {}",
+                      work.batch.size(), session, e.what());
+    }
+    uint64_t ns = elapsedNs(start);
+    sessions_[session].preprocess_ns.fetch_add(ns);
+    static auto& metric = Metrics::histogram(Metrics::Stage::Preprocess);
+    if (Metrics::enabled()) metric.observe(std::chrono::nanoseconds(ns));
+    return work;
+}
+
+void InferenceScheduler::infer(InFlight& work, size_t session) {
+    if (!engines_ || work.job.empty()) return;
+    auto start = SteadyClock::now();
+    try {
+        engines_->engine(session)->runBatch(work.job);
+    } catch (const std::exception& e) {
+        spdlog::error("InferenceScheduler: batch of {} failed on session {}: {}",
+                      work.batch.size(), session, e.what());
+        work.job = DetectionEngine::BatchJob{};  // frees the slot; frames resolve empty
+    }
+    uint64_t ns = elapsedNs(start);
+    sessions_[session].busy_ns.fetch_add(ns);
+    static auto& metric = Metrics::histogram(Metrics::Stage::Inference);
+    if (Metrics::enabled()) metric.observe(std::chrono::nanoseconds(ns));
+}
+
+void InferenceScheduler::finish(InFlight& work, size_t session) {
+    auto& batch = work.batch;
+    if (batch.empty()) return;
+
+    auto start = SteadyClock::now();
+    std::vector<std::vector<Detection>> results;
+    if (engines_ && !work.job.empty()) {
+        try {
+            results = engines_->engine(session)->finishBatch(work.job);
+        } catch (const std::exception& e) {
+            spdlog::error("InferenceScheduler: postprocessing {} frame(s) failed on session {}: {}",
+                          batch.size(), session, e.what());
+        }
+    }
+    work.job = DetectionEngine::BatchJob{};
+    results.resize(batch.size());
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].resolve(std::move(results[i]));
+    }
+
+    auto& state = sessions_[session];
+    uint64_t ns = elapsedNs(start);
+    state.postprocess_ns.fetch_add(ns);
+    static auto& metric = Metrics::histogram(Metrics::Stage::Postprocess);
+    if (Metrics::enabled()) metric.observe(std::chrono::nanoseconds(ns));
+    state.batches.fetch_add(1);
+    state.frames.fetch_add(batch.size());
+
+    batches_.fetch_add(1);
+    frames_batched_.fetch_add(batch.size());
+    size_t prev = largest_batch_.load();
+    while (batch.size() > prev && !largest_batch_.compare_exchange_weak(prev, batch.size())) {}
+    batch.clear();
+}
+
+void InferenceScheduler::runBatch(std::vector<Request>& batch, size_t session) {
+    if (batch.empty()) return;
+    auto work = prepare(batch, session);
+    infer(work, session);
+    finish(work, session);
+}
+
+void InferenceScheduler::StageQueue::push(InFlight item) {
+    {
+        std::lock_guard lock(mutex_);
+        items_.push_back(std::move(item));
+    }
+    cv_.notify_one();
+}
+
+bool InferenceScheduler::StageQueue::pop(InFlight& item) {
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return false;
+    item = std::move(items_.front());
+    items_.pop_front();
+    return true;
+}
+
+void InferenceScheduler::StageQueue::close() {
+    {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+void InferenceScheduler::StageQueue::reopen() {
+    std::lock_guard lock(mutex_);
+    closed_ = false;
+}
+
+}  // namespace hms
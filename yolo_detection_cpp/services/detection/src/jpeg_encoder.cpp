@@ -0,0 +1,252 @@
+#include "jpeg_encoder.h"
+#include "image_scale.h"
+#include "metrics.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#ifdef HMS_HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#else
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+namespace hms {
+
+namespace {
+
+std::atomic<uint64_t> g_encodes{0};
+std::atomic<uint64_t> g_failures{0};
+std::atomic<uint64_t> g_contexts{0};
+std::atomic<int64_t> g_encode_ns{0};
+
+#ifdef HMS_HAVE_TURBOJPEG
+
+/// One compressor and output buffer per thread, grown to the largest frame
+struct TurboState {
+    tjhandle handle = nullptr;
+    unsigned char* buffer = nullptr;
+    unsigned long capacity = 0;
+
+    ~TurboState() {
+        if (buffer) tjFree(buffer);
+        if (handle) tjDestroy(handle);
+    }
+};
+
+bool encodeTurbo(const uint8_t* bgr, int width, int height, int stride, int quality, std::string& out) {
+    thread_local TurboState state;
+    if (!state.handle) {
+        state.handle = tjInitCompress();
+        if (!state.handle) return false;
+        g_contexts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    unsigned long needed = tjBufSize(width, height, TJSAMP_420);
+    if (needed > state.capacity) {
+        if (state.buffer) tjFree(state.buffer);
+        state.buffer = tjAlloc(static_cast<int>(needed));
+        state.capacity = state.buffer ? needed : 0;
+        if (!state.buffer) return false;
+    }
+
+    unsigned long size = state.capacity;
+    if (tjCompress2(state.handle, bgr, width, stride, height, TJPF_BGR, &state.buffer, &size,
+                    TJSAMP_420, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT) != 0) {
+        spdlog::warn("JpegEncoder: {}", tjGetErrorStr2(state.handle));
+        return false;
+    }
+    out.assign(reinterpret_cast<const char*>(state.buffer), size);
+    return true;
+}
+
+#else
+
+/// Opened MJPEG encoder for one size and quality, with its scaler and buffers
+struct MjpegContext {
+    int width = 0, height = 0, quality = 0;
+    AVCodecContext* codec = nullptr;
+    SwsContext* sws = nullptr;
+    AVFrame* yuv = nullptr;
+    AVPacket* packet = nullptr;
+    int64_t pts = 0;
+
+    ~MjpegContext() {
+        av_packet_free(&packet);
+        av_frame_free(&yuv);
+        sws_freeContext(sws);
+        avcodec_free_context(&codec);
+    }
+};
+
+/// Quality 1-100 → MJPEG qscale 31-2 (90 → 3, the old fixed setting's range)
+int qscale(int quality) {
+    return std::clamp(2 + (95 - quality) / 5, 2, 31);
+}
+
+std::unique_ptr<MjpegContext> openMjpeg(int width, int height, int quality) {
+    const AVCodec* mjpeg = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!mjpeg) return nullptr;
+
+    auto ctx = std::make_unique<MjpegContext>();
+    ctx->width = width;
+    ctx->height = height;
+    ctx->quality = quality;
+    ctx->codec = avcodec_alloc_context3(mjpeg);
+    if (!ctx->codec) return nullptr;
+    ctx->codec->width = width;
+    ctx->codec->height = height;
+    ctx->codec->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    ctx->codec->time_base = {1, 25};
+    ctx->codec->flags |= AV_CODEC_FLAG_QSCALE;
+    ctx->codec->qmin = ctx->codec->qmax = qscale(quality);
+    if (avcodec_open2(ctx->codec, mjpeg, nullptr) < 0) return nullptr;
+
+    ctx->sws = sws_getContext(width, height, AV_PIX_FMT_BGR24,
+                              width, height, AV_PIX_FMT_YUVJ420P,
+                              SWS_BILINEAR, nullptr, nullptr, nullptr);
+    ctx->yuv = av_frame_alloc();
+    ctx->packet = av_packet_alloc();
+    if (!ctx->sws || !ctx->yuv || !ctx->packet) return nullptr;
+    ctx->yuv->format = AV_PIX_FMT_YUVJ420P;
+    ctx->yuv->width = width;
+    ctx->yuv->height = height;
+    ctx->yuv->quality = FF_QP2LAMBDA * qscale(quality);
+    if (av_frame_get_buffer(ctx->yuv, 0) < 0) return nullptr;
+
+    g_contexts.fetch_add(1, std::memory_order_relaxed);
+    return ctx;
+}
+
+/// Most recently used first; a thread rarely sees more than a couple of sizes
+constexpr size_t kContextsPerThread = 4;
+
+bool encodeMjpeg(const uint8_t* bgr, int width, int height, int stride, int quality, std::string& out) {
+    thread_local std::vector<std::unique_ptr<MjpegContext>> contexts;
+
+    auto it = std::find_if(contexts.begin(), contexts.end(), [&](const auto& c) {
+        return c->width == width && c->height == height && c->quality == quality;
+    });
+    if (it == contexts.end()) {
+        auto ctx = openMjpeg(width, height, quality);
+        if (!ctx) return false;
+        if (contexts.size() >= kContextsPerThread) contexts.pop_back();
+        contexts.insert(contexts.begin(), std::move(ctx));
+    } else if (it != contexts.begin()) {
+        std::rotate(contexts.begin(), it, it + 1);
+    }
+    auto& ctx = *contexts.front();
+
+    // The encoder may still reference the previous picture
+    if (av_frame_make_writable(ctx.yuv) < 0) return false;
+    const uint8_t* src_data[1] = {bgr};
+    int src_linesize[1] = {stride};
+    sws_scale(ctx.sws, src_data, src_linesize, 0, height, ctx.yuv->data, ctx.yuv->linesize);
+    ctx.yuv->pts = ctx.pts++;
+
+    if (avcodec_send_frame(ctx.codec, ctx.yuv) < 0) return false;
+    bool ok = avcodec_receive_packet(ctx.codec, ctx.packet) == 0;
+    if (ok) out.assign(reinterpret_cast<const char*>(ctx.packet->data), ctx.packet->size);
+    av_packet_unref(ctx.packet);
+    return ok;
+}
+
+#endif
+
+}  // namespace
+
+bool JpegEncoder::encode(const uint8_t* bgr, int width, int height, int stride,
+                         int quality, std::string& out) {
+    out.clear();
+    if (!bgr || width <= 0 || height <= 0 || stride < width * 3) return false;
+    quality = std::clamp(quality, 1, 100);
+
+    auto start = std::chrono::steady_clock::now();
+#ifdef HMS_HAVE_TURBOJPEG
+    bool ok = encodeTurbo(bgr, width, height, stride, quality, out);
+#else
+    bool ok = encodeMjpeg(bgr, width, height, stride, quality, out);
+#endif
+    if (!ok) {
+        out.clear();
+        g_failures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    g_encode_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                          std::memory_order_relaxed);
+    static auto& metric = Metrics::histogram(Metrics::Stage::JpegEncode);
+    if (Metrics::enabled()) metric.observe(elapsed);
+    g_encodes.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+std::string JpegEncoder::encode(const uint8_t* bgr, int width, int height, int stride, int quality) {
+    std::string out;
+    encode(bgr, width, height, stride, quality, out);
+    return out;
+}
+
+bool JpegEncoder::encode(const uint8_t* bgr, int width, int height, int stride,
+                         std::span<Output> outputs) {
+    if (!bgr || width <= 0 || height <= 0 || stride < width * 3) {
+        for (auto& out : outputs) out.jpeg.clear();
+        return false;
+    }
+
+    // Largest rendition first so each downscale starts from the nearest size
+    std::vector<size_t> order(outputs.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    for (auto& out : outputs) scaledSize(width, height, out.max_width, out.width, out.height);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return outputs[a].width > outputs[b].width;
+    });
+
+    thread_local std::vector<uint8_t> scratch[2];
+    const uint8_t* src = bgr;
+    int src_w = width, src_h = height, src_stride = stride;
+    int next = 0;
+    bool ok = true;
+    for (size_t i : order) {
+        auto& out = outputs[i];
+        if (out.width != src_w) {
+            auto& buf = scratch[next];
+            next ^= 1;
+            buf.resize(static_cast<size_t>(out.width) * out.height * 3);
+            downscaleArea(src, src_w, src_h, src_stride, buf.data(), out.width, out.height, out.width * 3);
+            src = buf.data();
+            src_w = out.width;
+            src_h = out.height;
+            src_stride = out.width * 3;
+        }
+        ok &= encode(src, src_w, src_h, src_stride, out.quality, out.jpeg);
+    }
+    return ok;
+}
+
+JpegEncoder::Stats JpegEncoder::stats() {
+    uint64_t encodes = g_encodes.load(std::memory_order_relaxed);
+    return Stats{
+#ifdef HMS_HAVE_TURBOJPEG
+        .backend = "turbojpeg",
+#else
+        .backend = "ffmpeg",
+#endif
+        .encodes = encodes,
+        .failures = g_failures.load(std::memory_order_relaxed),
+        .contexts_created = g_contexts.load(std::memory_order_relaxed),
+        .avg_encode_ms = encodes > 0 ? g_encode_ns.load(std::memory_order_relaxed) / 1e6 / encodes : 0.0,
+    };
+}
+
+}  // namespace hms
@@ -0,0 +1,192 @@
+#include "letterbox.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace hms {
+
+namespace {
+
+constexpr float kInv255 = 1.0f / 255.0f;
+constexpr float kPadValue = 114.0f / 255.0f;
+constexpr int kWeightBits = 11;
+constexpr int kWeightOne = 1 << kWeightBits;
+
+/// Map destination coordinates to source samples for one axis
+void buildAxis(int src_len, int new_len, float scale, ResizeMode mode,
+               std::vector<int32_t>& i0, std::vector<int32_t>& i1,
+               std::vector<int16_t>& w, int32_t step) {
+    i0.resize(new_len);
+    i1.resize(new_len);
+    w.assign(mode == ResizeMode::Bilinear ? new_len : 0, 0);
+
+    if (mode == ResizeMode::Nearest) {
+        for (int d = 0; d < new_len; ++d) {
+            // Same float math as the original per-pixel loop
+            int s = static_cast<int>(d / scale);
+            if (s >= src_len) s = src_len - 1;
+            i0[d] = i1[d] = s * step;
+        }
+        return;
+    }
+
+    float inv = static_cast<float>(src_len) / static_cast<float>(new_len);
+    for (int d = 0; d < new_len; ++d) {
+        float f = (d + 0.5f) * inv - 0.5f;
+        int s = static_cast<int>(std::floor(f));
+        float frac = f - static_cast<float>(s);
+        if (s < 0) { s = 0; frac = 0.0f; }
+        if (s >= src_len - 1) { s = src_len - 1; frac = 0.0f; }
+        i0[d] = s * step;
+        i1[d] = std::min(s + 1, src_len - 1) * step;
+        w[d] = static_cast<int16_t>(std::lround(frac * kWeightOne));
+    }
+}
+
+void fill(float* dst, size_t n) {
+    std::fill(dst, dst + n, kPadValue);
+}
+
+}  // namespace
+
+LetterboxPlan LetterboxPlan::make(int src_w, int src_h, int dst_w, int dst_h, ResizeMode mode) {
+    LetterboxPlan plan;
+    plan.src_w = src_w;
+    plan.src_h = src_h;
+    plan.dst_w = dst_w;
+    plan.dst_h = dst_h;
+    plan.mode = mode;
+
+    // Letterbox: scale to fit dst_w x dst_h maintaining aspect ratio
+    plan.scale = std::min(static_cast<float>(dst_w) / src_w, static_cast<float>(dst_h) / src_h);
+    plan.new_w = static_cast<int>(std::round(src_w * plan.scale));
+    plan.new_h = static_cast<int>(std::round(src_h * plan.scale));
+
+    plan.pad_x = (dst_w - plan.new_w) / 2.0f;
+    plan.pad_y = (dst_h - plan.new_h) / 2.0f;
+    plan.pad_left = static_cast<int>(std::round(plan.pad_x));
+    plan.pad_top = static_cast<int>(std::round(plan.pad_y));
+
+    // Never write outside the tensor, whatever the rounding did
+    plan.new_w = std::clamp(plan.new_w, 0, dst_w - plan.pad_left);
+    plan.new_h = std::clamp(plan.new_h, 0, dst_h - plan.pad_top);
+
+    buildAxis(src_w, plan.new_w, plan.scale, mode, plan.x0, plan.x1, plan.wx, 3);
+    buildAxis(src_h, plan.new_h, plan.scale, mode, plan.y0, plan.y1, plan.wy, 1);
+    return plan;
+}
+
+void normalizeU8(const uint8_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 k = _mm256_set1_ps(kInv255);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(lo, k));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(hi, k));
+    }
+#elif defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(kInv255);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo16 = _mm_unpacklo_epi8(v, zero);
+        __m128i hi16 = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_ps(dst + i,      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo16, zero)), k));
+        _mm_storeu_ps(dst + i + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo16, zero)), k));
+        _mm_storeu_ps(dst + i + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi16, zero)), k));
+        _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi16, zero)), k));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t k = vdupq_n_f32(kInv255);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        uint16x8_t lo16 = vmovl_u8(vget_low_u8(v));
+        uint16x8_t hi16 = vmovl_u8(vget_high_u8(v));
+        vst1q_f32(dst + i,      vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo16))), k));
+        vst1q_f32(dst + i + 4,  vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo16))), k));
+        vst1q_f32(dst + i + 8,  vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi16))), k));
+        vst1q_f32(dst + i + 12, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi16))), k));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i] * kInv255;
+}
+
+void letterboxToTensor(const LetterboxPlan& plan, const uint8_t* src, int src_stride, float* tensor) {
+    const size_t plane = static_cast<size_t>(plan.dst_w) * plan.dst_h;
+    const int right = plan.pad_left + plan.new_w;
+    const int bottom = plan.pad_top + plan.new_h;
+
+    // Padding only: top/bottom bands and left/right margins of image rows
+    for (int c = 0; c < 3; ++c) {
+        float* ch = tensor + c * plane;
+        fill(ch, static_cast<size_t>(plan.pad_top) * plan.dst_w);
+        fill(ch + static_cast<size_t>(bottom) * plan.dst_w,
+             static_cast<size_t>(plan.dst_h - bottom) * plan.dst_w);
+        for (int y = plan.pad_top; y < bottom; ++y) {
+            float* row = ch + static_cast<size_t>(y) * plan.dst_w;
+            fill(row, plan.pad_left);
+            fill(row + right, plan.dst_w - right);
+        }
+    }
+
+    // Planar RGB scratch for one destination row, reused across frames
+    thread_local std::vector<uint8_t> scratch;
+    scratch.resize(static_cast<size_t>(3) * plan.new_w);
+    uint8_t* r = scratch.data();
+    uint8_t* g = r + plan.new_w;
+    uint8_t* b = g + plan.new_w;
+
+    for (int dy = 0; dy < plan.new_h; ++dy) {
+        const uint8_t* row0 = src + static_cast<size_t>(plan.y0[dy]) * src_stride;
+
+        if (plan.mode == ResizeMode::Nearest) {
+            for (int dx = 0; dx < plan.new_w; ++dx) {
+                const uint8_t* px = row0 + plan.x0[dx];
+                b[dx] = px[0];
+                g[dx] = px[1];
+                r[dx] = px[2];
+            }
+        } else {
+            const uint8_t* row1 = src + static_cast<size_t>(plan.y1[dy]) * src_stride;
+            const int32_t wy1 = plan.wy[dy];
+            const int32_t wy0 = kWeightOne - wy1;
+            for (int dx = 0; dx < plan.new_w; ++dx) {
+                const int32_t wx1 = plan.wx[dx];
+                const int32_t wx0 = kWeightOne - wx1;
+                const uint8_t* p00 = row0 + plan.x0[dx];
+                const uint8_t* p01 = row0 + plan.x1[dx];
+                const uint8_t* p10 = row1 + plan.x0[dx];
+                const uint8_t* p11 = row1 + plan.x1[dx];
+                uint8_t out[3];
+                for (int c = 0; c < 3; ++c) {
+                    int32_t top = p00[c] * wx0 + p01[c] * wx1;
+                    int32_t bot = p10[c] * wx0 + p11[c] * wx1;
+                    out[c] = static_cast<uint8_t>(
+                        (top * wy0 + bot * wy1 + (1 << (2 * kWeightBits - 1))) >> (2 * kWeightBits));
+                }
+                b[dx] = out[0];
+                g[dx] = out[1];
+                r[dx] = out[2];
+            }
+        }
+
+        // NCHW: R, G, B planes
+        size_t offset = static_cast<size_t>(plan.pad_top + dy) * plan.dst_w + plan.pad_left;
+        normalizeU8(r, tensor + offset, plan.new_w);
+        normalizeU8(g, tensor + plane + offset, plan.new_w);
+        normalizeU8(b, tensor + 2 * plane + offset, plan.new_w);
+    }
+}
+
+}  // namespace hms
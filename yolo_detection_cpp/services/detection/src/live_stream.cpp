@@ -0,0 +1,403 @@
+#include "live_stream.h"
+#include "buffer_service.h"
+#include "event_recorder.h"
+#include "jpeg_encoder.h"
+#include "snapshot_writer.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace hms {
+
+namespace {
+
+/// How often an idle stream checks whether its viewers are still there
+constexpr auto kPoll = std::chrono::milliseconds(500);
+
+/// Boxes from a detection this much older than the frame are not drawn
+constexpr auto kMaxBoxAge = std::chrono::seconds(2);
+
+/// Fragmented MP4 in memory, one fragment per packet (frag_every_frame), so
+/// a live viewer is a frame behind the muxer rather than a GOP
+class Fmp4Muxer {
+public:
+    ~Fmp4Muxer() { close(); }
+
+    bool open(const PacketRing::StreamInfo& info) {
+        close();
+        if (avformat_alloc_output_context2(&ctx_, nullptr, "mp4", nullptr) < 0 || !ctx_) return false;
+        stream_ = avformat_new_stream(ctx_, nullptr);
+        if (!stream_ || avcodec_parameters_copy(stream_->codecpar, info.codecpar.get()) < 0) {
+            close();
+            return false;
+        }
+        stream_->codecpar->codec_tag = 0;  // let the muxer pick the MP4 tag
+        stream_->time_base = info.time_base;
+        src_time_base_ = info.time_base;
+
+        constexpr int kBufferSize = 64 * 1024;
+        auto* buffer = static_cast<unsigned char*>(av_malloc(kBufferSize));
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+        auto write = &Fmp4Muxer::append;
+#else
+        auto write = [](void* opaque, uint8_t* buf, int size) { return append(opaque, buf, size); };
+#endif
+        ctx_->pb = buffer ? avio_alloc_context(buffer, kBufferSize, 1, this, nullptr, write, nullptr) : nullptr;
+        if (!ctx_->pb) {
+            av_free(buffer);
+            close();
+            return false;
+        }
+        ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        AVDictionary* opts = nullptr;
+        av_dict_set(&opts, "movflags", "+frag_every_frame+empty_moov+default_base_moof", 0);
+        int ret = avformat_write_header(ctx_, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            close();
+            return false;
+        }
+        avio_flush(ctx_->pb);
+        init_ = take();  // ftyp + moov
+        pkt_ = av_packet_alloc();
+        return pkt_ && init_;
+    }
+
+    void close() {
+        if (pkt_) av_packet_free(&pkt_);
+        if (ctx_) {
+            if (ctx_->pb) {
+                av_freep(&ctx_->pb->buffer);
+                avio_context_free(&ctx_->pb);
+            }
+            avformat_free_context(ctx_);
+            ctx_ = nullptr;
+        }
+        stream_ = nullptr;
+        init_.reset();
+        out_.clear();
+        ts_offset_ = last_dts_ = AV_NOPTS_VALUE;
+        prev_keyframe_ = false;
+    }
+
+    bool isOpen() const { return ctx_ != nullptr; }
+    const LiveStream::Chunk& init() const { return init_; }
+
+    /// Mux one packet. A fragment is closed when the next packet arrives, so
+    /// this returns the previous packet's fragment (null before there is
+    /// one); `keyframe` says whether it starts on a keyframe.
+    LiveStream::Chunk write(const PacketRing::Entry& entry, bool& keyframe) {
+        if (!ctx_ || !entry.packet || av_packet_ref(pkt_, entry.packet.get()) < 0) return nullptr;
+
+        // Rebase to start at 0; RTSP streams without timestamps get wall-clock ones
+        if (pkt_->dts == AV_NOPTS_VALUE) pkt_->dts = pkt_->pts;
+        if (pkt_->dts == AV_NOPTS_VALUE) {
+            if (ts_offset_ == AV_NOPTS_VALUE) first_arrival_ = entry.arrival;
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                entry.arrival - first_arrival_).count();
+            pkt_->dts = av_rescale_q(us, AVRational{1, 1000000}, src_time_base_);
+            if (ts_offset_ == AV_NOPTS_VALUE) ts_offset_ = 0;
+        }
+        if (pkt_->pts == AV_NOPTS_VALUE) pkt_->pts = pkt_->dts;
+        if (ts_offset_ == AV_NOPTS_VALUE) ts_offset_ = pkt_->dts;
+        pkt_->dts -= ts_offset_;
+        pkt_->pts -= ts_offset_;
+        av_packet_rescale_ts(pkt_, src_time_base_, stream_->time_base);
+        if (last_dts_ != AV_NOPTS_VALUE && pkt_->dts <= last_dts_) pkt_->dts = last_dts_ + 1;
+        if (pkt_->pts < pkt_->dts) pkt_->pts = pkt_->dts;
+        last_dts_ = pkt_->dts;
+        pkt_->stream_index = stream_->index;
+        pkt_->pos = -1;
+
+        int ret = av_write_frame(ctx_, pkt_);
+        av_packet_unref(pkt_);
+        if (ret < 0) return nullptr;
+        avio_flush(ctx_->pb);
+
+        keyframe = prev_keyframe_;
+        prev_keyframe_ = entry.keyframe;
+        return take();
+    }
+
+private:
+    static int append(void* opaque, const uint8_t* buf, int size) {
+        static_cast<Fmp4Muxer*>(opaque)->out_.append(reinterpret_cast<const char*>(buf), size);
+        return size;
+    }
+
+    LiveStream::Chunk take() {
+        if (out_.empty()) return nullptr;
+        auto chunk = std::make_shared<const std::string>(std::move(out_));
+        out_.clear();
+        return chunk;
+    }
+
+    AVFormatContext* ctx_ = nullptr;
+    AVStream* stream_ = nullptr;
+    AVPacket* pkt_ = nullptr;
+    AVRational src_time_base_{1, 90000};
+    LiveStream::Chunk init_;
+    std::string out_;  // muxer output since the last take()
+    int64_t ts_offset_ = AV_NOPTS_VALUE;
+    int64_t last_dts_ = AV_NOPTS_VALUE;
+    SteadyClock::time_point first_arrival_{};
+    bool prev_keyframe_ = false;
+};
+
+}  // namespace
+
+LiveStream::LiveStream(std::shared_ptr<BufferService> buffer_service, Options options)
+    : buffer_service_(std::move(buffer_service))
+    , options_(options)
+{
+}
+
+LiveStream::~LiveStream() {
+    stop();
+}
+
+bool LiveStream::canServe(const std::string& camera_id, Format format) const {
+    if (!buffer_service_->getCameraBuffer(camera_id)) return false;
+    return format != Format::Fmp4 || buffer_service_->getPacketRing(camera_id) != nullptr;
+}
+
+bool LiveStream::subscribe(const std::string& camera_id, const Variant& variant,
+                           std::shared_ptr<Subscriber> subscriber) {
+    if (!subscriber || !canServe(camera_id, variant.format)) return false;
+
+    std::lock_guard lock(mutex_);
+    if (stopping_) return false;
+
+    auto& stream = streams_[{camera_id, variant}];
+    if (stream && !stream->finished) {
+        stream->viewers.push_back(std::make_shared<Viewer>(Viewer{std::move(subscriber)}));
+        return true;
+    }
+    // The old thread has left the lock for good; it is only unwinding
+    if (stream && stream->thread.joinable()) stream->thread.join();
+
+    stream = std::make_unique<Stream>();
+    stream->camera_id = camera_id;
+    stream->variant = variant;
+    stream->viewers.push_back(std::make_shared<Viewer>(Viewer{std::move(subscriber)}));
+    auto* s = stream.get();
+    stream->thread = std::thread([this, s] {
+        if (s->variant.format == Format::Fmp4) runFmp4(*s);
+        else runMjpeg(*s);
+    });
+    spdlog::info("LiveStream: [{}] {} stream started", camera_id,
+                 variant.format == Format::Fmp4 ? "fMP4" : "MJPEG");
+    return true;
+}
+
+std::string LiveStream::contentType(const Variant& variant) {
+    if (variant.format == Format::Fmp4) return "video/mp4";
+    return std::string("multipart/x-mixed-replace; boundary=") + kBoundary;
+}
+
+std::string LiveStream::mjpegPart(const std::string& jpeg) {
+    std::string part = std::string("--") + kBoundary + "\r\nContent-Type: image/jpeg\r\nContent-Length: "
+                     + std::to_string(jpeg.size()) + "\r\n\r\n";
+    part.reserve(part.size() + jpeg.size() + 2);
+    part += jpeg;
+    part += "\r\n";
+    return part;
+}
+
+void LiveStream::stop() {
+    std::map<Key, std::unique_ptr<Stream>> streams;
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        streams.swap(streams_);
+    }
+    // Threads see stopping_ within one poll and drop their viewers
+    for (auto& [key, stream] : streams) {
+        if (stream->thread.joinable()) stream->thread.join();
+    }
+}
+
+LiveStream::Stats LiveStream::stats() const {
+    std::lock_guard lock(mutex_);
+    Stats s = stats_;
+    for (const auto& [key, stream] : streams_) {
+        if (stream->finished) continue;
+        s.streams++;
+        s.subscribers += stream->viewers.size();
+    }
+    return s;
+}
+
+std::vector<std::shared_ptr<LiveStream::Viewer>> LiveStream::viewers(Stream& stream) {
+    std::lock_guard lock(mutex_);
+    std::erase_if(stream.viewers, [](const auto& v) { return v->gone || !v->subscriber->connected(); });
+    if (stopping_) stream.viewers.clear();
+    if (stream.viewers.empty()) {
+        stream.finished = true;
+        spdlog::info("LiveStream: [{}] stream stopped (no viewers)", stream.camera_id);
+        return {};
+    }
+    return stream.viewers;
+}
+
+bool LiveStream::deliver(Viewer& viewer, const Chunk& chunk) {
+    if (viewer.gone) return false;
+    if (!viewer.subscriber->send(chunk)) {
+        viewer.gone = true;
+        return false;
+    }
+    std::lock_guard lock(mutex_);
+    stats_.chunks_sent++;
+    return true;
+}
+
+bool LiveStream::behind(const Viewer& viewer) const {
+    return viewer.subscriber->backlog() > options_.max_backlog;
+}
+
+void LiveStream::runMjpeg(Stream& stream) {
+    auto buffer = buffer_service_->getCameraBuffer(stream.camera_id);
+    const auto interval = options_.max_fps > 0
+        ? std::chrono::duration_cast<SteadyClock::duration>(std::chrono::seconds(1)) / options_.max_fps
+        : SteadyClock::duration::zero();
+
+    uint64_t seq = buffer->latestSeq() > 0 ? buffer->latestSeq() - 1 : 0;  // start on the newest frame
+    SteadyClock::time_point last_frame{};
+    std::vector<uint8_t> overlay;  // annotated copy, reused across frames
+    std::string jpeg;
+
+    for (;;) {
+        auto next = buffer->waitForFrame(seq, SteadyClock::now() + kPoll);
+        auto viewers = this->viewers(stream);
+        if (viewers.empty()) return;
+        if (!next.frame) continue;
+        seq = next.seq;
+        const FrameData& frame = *next.frame;
+        if (interval > SteadyClock::duration::zero() && frame.timestamp - last_frame < interval) continue;
+
+        // Only viewers that have caught up get this frame; if none have, skip
+        // the encode. viewers() pruned the disconnected ones, so every viewer
+        // left out here is a live one missing this frame.
+        std::vector<Viewer*> takers;
+        uint64_t dropped = 0;
+        for (const auto& v : viewers) {
+            if (v->gone) continue;
+            if (behind(*v)) {
+                dropped++;
+            } else {
+                takers.push_back(v.get());
+            }
+        }
+        {
+            std::lock_guard lock(mutex_);
+            stats_.frames_dropped += dropped;
+            if (takers.empty()) stats_.frames_skipped++;
+        }
+        if (takers.empty() || !frame.ensureBgr()) continue;
+        last_frame = frame.timestamp;
+
+        const uint8_t* pixels = frame.pixels.data();
+        if (stream.variant.annotate) {
+            auto result = buffer_service_->getDetectionResult(stream.camera_id);
+            if (result && !result->detections.empty() && frame.timestamp - result->timestamp < kMaxBoxAge) {
+                size_t size = static_cast<size_t>(frame.stride) * frame.height;
+                overlay.resize(size);
+                std::memcpy(overlay.data(), pixels, size);
+                SnapshotWriter::drawBoundingBoxes(overlay.data(), frame.width, frame.height,
+                                                  frame.stride, result->detections);
+                pixels = overlay.data();
+            }
+        }
+        if (!JpegEncoder::encode(pixels, frame.width, frame.height, frame.stride,
+                                 stream.variant.quality, jpeg)) {
+            continue;
+        }
+
+        auto part = std::make_shared<const std::string>(mjpegPart(jpeg));
+        {
+            std::lock_guard lock(mutex_);
+            stats_.frames_encoded++;
+            stats_.bytes_encoded += part->size();
+        }
+        for (auto* v : takers) deliver(*v, part);
+    }
+}
+
+void LiveStream::runFmp4(Stream& stream) {
+    auto buffer = buffer_service_->getCameraBuffer(stream.camera_id);
+    auto ring = buffer_service_->getPacketRing(stream.camera_id);
+
+    Fmp4Muxer muxer;
+    uint64_t generation = 0;
+    uint64_t last_seq = 0;
+    uint64_t frame_seq = buffer->latestSeq();
+
+    for (;;) {
+        auto viewers = this->viewers(stream);
+        if (viewers.empty()) return;
+
+        // (Re)open on the current connection, starting at its latest keyframe
+        auto info = ring->stream();
+        if (!muxer.isOpen() || info.generation != generation) {
+            muxer.close();
+            if (EventRecorder::canRemux(info) && muxer.open(info)) {
+                generation = info.generation;
+                last_seq = 0;
+                for (const auto& v : viewers) v->synced = v->has_init = false;
+            } else if (info.codecpar) {
+                // Connected with a codec MP4 can't carry: nothing will ever play
+                spdlog::warn("LiveStream: [{}] stream can't be remuxed into MP4, closing viewers",
+                             stream.camera_id);
+                for (const auto& v : viewers) v->gone = true;
+                continue;
+            }
+        }
+
+        if (muxer.isOpen()) {
+            auto entries = last_seq == 0 ? ring->preroll(std::chrono::milliseconds(0)) : ring->since(last_seq);
+            for (const auto& entry : entries) {
+                if (entry.generation != generation) break;  // reconnected: reopen next round
+                last_seq = entry.seq;
+                bool keyframe = false;
+                auto fragment = muxer.write(entry, keyframe);
+                if (!fragment) continue;
+                {
+                    std::lock_guard lock(mutex_);
+                    stats_.frames_encoded++;
+                    stats_.bytes_encoded += fragment->size();
+                }
+                for (const auto& v : viewers) {
+                    if (v->gone) continue;
+                    if (behind(*v)) {
+                        // Frames after a gap don't decode: wait for the next keyframe
+                        if (v->synced) {
+                            v->synced = false;
+                            std::lock_guard lock(mutex_);
+                            stats_.frames_dropped++;
+                        }
+                        continue;
+                    }
+                    if (!v->synced) {
+                        if (!keyframe) continue;
+                        if (!v->has_init && !deliver(*v, muxer.init())) continue;
+                        v->has_init = v->synced = true;
+                    }
+                    deliver(*v, fragment);
+                }
+            }
+        }
+
+        // Packets arrive with the frames; wake with them
+        auto next = buffer->waitForFrame(frame_seq, SteadyClock::now() + kPoll);
+        if (next.frame) frame_seq = next.seq;
+    }
+}
+
+}  // namespace hms
@@ -7,6 +7,9 @@
 #include <csignal>
 #include <atomic>
 #include <algorithm>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 extern "C" {
@@ -17,13 +20,20 @@ extern "C" {
 #include "version.h"
 #include "config_manager.h"
 #include "buffer_service.h"
+#include "pipeline_config.h"
 #include "mqtt_client.h"
 #include "db_pool.h"
+#include "db_writer.h"
+#include "file_writer.h"
 #include "event_manager.h"
 #include "periodic_snapshot_manager.h"
+#include "replay_driver.h"
 #include "gpu_coordinator.h"
+#include "live_stream.h"
+#include "readiness.h"
 #include "controllers/health_controller.h"
 #include "controllers/detection_controller.h"
+#include "controllers/stream_controller.h"
 
 namespace fs = std::filesystem;
 
@@ -34,16 +44,28 @@ std::shared_ptr<hms::BufferService> g_buffer_service;
 std::shared_ptr<hms::EventManager> g_event_manager;
 std::shared_ptr<hms::MqttClient> g_mqtt;
 std::unique_ptr<hms::PeriodicSnapshotManager> g_periodic_mgr;
+std::shared_ptr<hms::DbWriter> g_db_writer;
+std::shared_ptr<hms::FileWriter> g_file_writer;
+std::shared_ptr<hms::LiveStream> g_live_stream;
+std::unique_ptr<hms::ReplayDriver> g_replay;
+std::mutex g_db_mutex;                  // guards g_db_pool: connected in the background
+std::shared_ptr<hms::DbPool> g_db_pool;
 
 void signal_handler(int sig) {
     spdlog::info("Received signal {}, shutting down...", sig);
     g_shutdown = true;
+    if (g_replay) {
+        g_replay->stop();
+    }
     if (g_periodic_mgr) {
         g_periodic_mgr->stop();
     }
     if (g_event_manager) {
         g_event_manager->stop();
     }
+    if (g_live_stream) {
+        g_live_stream->stop();  // close viewers' responses while the HTTP loops still run
+    }
     if (g_buffer_service) {
         g_buffer_service->stopDetection();
         g_buffer_service->stopAll();
@@ -75,10 +97,16 @@ void setup_logging(const hms::LoggingConfig& log_config) {
     spdlog::flush_every(std::chrono::seconds(3));
 }
 
-std::string find_config_path(int argc, char* argv[]) {
+/// Value of `--name value` on the command line, or empty
+std::string find_arg(int argc, char* argv[], const std::string& name) {
     for (int i = 1; i < argc - 1; ++i) {
-        if (std::string(argv[i]) == "--config") return argv[i + 1];
+        if (argv[i] == name) return argv[i + 1];
     }
+    return "";
+}
+
+std::string find_config_path(int argc, char* argv[]) {
+    if (auto path = find_arg(argc, argv, "--config"); !path.empty()) return path;
     if (fs::exists("config.yaml")) return "config.yaml";
     if (fs::exists("/app/config/config.yaml")) return "/app/config/config.yaml";
     if (fs::exists("/opt/yolo_detection/config.yaml")) return "/opt/yolo_detection/config.yaml";
@@ -109,51 +137,80 @@ int main(int argc, char* argv[]) {
     try {
         auto config_path = find_config_path(argc, argv);
         auto config = hms::ConfigManager::load(config_path);
+        auto pipeline = hms::PipelineConfig::load(config_path);
+        if (auto file = find_arg(argc, argv, "--replay"); !file.empty()) {
+            pipeline.replay.file = file;
+        }
+        // Replay: synthetic cameras reading a recorded file stand in for the RTSP ones
+        if (pipeline.replay.enabled()) {
+            hms::ReplayDriver::addCameras(config, pipeline.replay);
+        }
 
         setup_logging(config.logging);
         spdlog::info("Starting hms-detection service v{}", HMS_VERSION);
         spdlog::info("Config: {}", config_path);
+        if (pipeline.replay.enabled()) {
+            spdlog::info("Replay mode: {} camera(s) from {}", pipeline.replay.cameras, pipeline.replay.file);
+        }
 
         // Initialize FFmpeg
         avformat_network_init();
         av_log_set_callback(ffmpeg_log_callback);
 
+        spdlog::info("Inference scheduler: max_batch={}, max_wait={}ms",
+                     pipeline.scheduler.max_batch_size, pipeline.scheduler.max_wait_ms);
+
         // Create buffer service
-        g_buffer_service = std::make_shared<hms::BufferService>(config);
+        g_buffer_service = std::make_shared<hms::BufferService>(config, pipeline);
+
+        // Startup runs behind the HTTP server: /health and /ready report each
+        // subsystem as it comes up. Required ones gate readiness; without the
+        // optional ones the service runs degraded.
+        auto readiness = std::make_shared<hms::Readiness>();
+        bool have_model = fs::exists(config.detection.model_path);
+        readiness->add("model", have_model);
+        readiness->add("mqtt", false);
+        readiness->add("database", false);
+        readiness->add("events");
+        if (!have_model) {
+            spdlog::warn("Detection model not found at '{}', detection disabled", config.detection.model_path);
+            readiness->set("model", hms::Readiness::State::Disabled, "model not found");
+        }
 
         // Wire controller dependencies
         hms::HealthController::setBufferService(g_buffer_service);
+        hms::HealthController::setReadiness(readiness);
         hms::DetectionController::setBufferService(g_buffer_service);
 
+        // Live view: one encode per camera frame, shared by every viewer
+        if (pipeline.live.enabled) {
+            g_live_stream = std::make_shared<hms::LiveStream>(g_buffer_service, hms::LiveStream::Options{
+                .quality = pipeline.live.quality,
+                .max_fps = pipeline.live.max_fps,
+                .max_backlog = static_cast<size_t>(pipeline.live.max_backlog_kb) << 10,
+            });
+            hms::StreamController::setLiveStream(g_live_stream);
+        }
+
         // Signal handlers
         std::signal(SIGINT, signal_handler);
         std::signal(SIGTERM, signal_handler);
 
-        // Start capturing
+        // Start capturing: one thread per camera, each connecting on its own
         g_buffer_service->startAll();
 
-        // Load detection model (but don't start continuous workers —
-        // detection only runs on-demand during motion events)
-        g_buffer_service->loadDetectionModel();
-
-        // --- MQTT (initialized BEFORE app.run(), independent subsystem) ---
+        // --- MQTT (independent subsystem, connected by the startup thread) ---
         g_mqtt = std::make_shared<hms::MqttClient>(config.mqtt);
-        try {
-            if (g_mqtt->connect()) {
-                // Publish online status (retained)
-                g_mqtt->publish(config.mqtt.topic_prefix + "/status", "online", 1, true);
-            }
-        } catch (const std::exception& e) {
-            spdlog::warn("MQTT unavailable: {} (HTTP will continue serving)", e.what());
-        }
-
-        // Inject MQTT into health controller for status reporting
         hms::HealthController::setMqttClient(g_mqtt);
-        // EventManager will be injected after creation (below)
 
         // --- Database pool (for event logging) ---
-        std::shared_ptr<hms::DbPool> db;
-        try {
+        // Created on first use: by the startup thread, or by the DbWriter's
+        // retries if the database comes up later. Rows queue meanwhile.
+        std::function<std::shared_ptr<hms::DbPool>()> connect_db;
+        if (pipeline.replay.enabled() && !pipeline.replay.database) {
+            spdlog::info("Replay mode: database disabled (pipeline.replay.database)");
+            readiness->set("database", hms::Readiness::State::Disabled, "pipeline.replay.database");
+        } else {
             hms::DbPool::Config db_cfg;
             db_cfg.host = config.database.host;
             db_cfg.port = config.database.port;
@@ -161,25 +218,65 @@ int main(int argc, char* argv[]) {
             db_cfg.password = config.database.password;
             db_cfg.database = config.database.database;
             db_cfg.pool_size = config.database.pool_size;
-            db = std::make_shared<hms::DbPool>(db_cfg);
-        } catch (const std::exception& e) {
-            spdlog::warn("Database unavailable: {} (event logging disabled)", e.what());
+            connect_db = [db_cfg] {
+                std::lock_guard lock(g_db_mutex);
+                if (!g_db_pool) g_db_pool = std::make_shared<hms::DbPool>(db_cfg);
+                return g_db_pool;
+            };
+        }
+
+        // Rows are written behind the event pipeline. The journal sits next to
+        // (not in) snapshots_dir, which is served over HTTP.
+        if (connect_db) {
+            const auto& dbw = pipeline.db_writer;
+            std::string journal = dbw.journal_path;
+            if (journal.empty()) {
+                auto dir = fs::path(config.timeline.snapshots_dir).lexically_normal();
+                if (dir.filename().empty()) dir = dir.parent_path();
+                journal = (dir.parent_path() / "db_journal.jsonl").string();
+            }
+            g_db_writer = std::make_shared<hms::DbWriter>(hms::DbWriter::PoolSource(connect_db),
+                                                          hms::DbWriter::Options{
+                .queue = dbw.queue,
+                .batch = dbw.batch,
+                .flush_ms = dbw.flush_ms,
+                .journal_path = journal,
+                .journal_max_bytes = static_cast<size_t>(dbw.journal_max_mb) << 20,
+                .max_attempts = dbw.max_attempts,
+            });
+            hms::HealthController::setDbWriter(g_db_writer);
         }
 
         // --- GPU Coordinator (shared between event manager and periodic snapshots) ---
         auto gpu_coord = std::make_shared<hms::GpuCoordinator>();
+        gpu_coord->setEvictionHandler([svc = std::weak_ptr(g_buffer_service)]() {
+            auto buffer_service = svc.lock();
+            auto engines = buffer_service ? buffer_service->getEnginePool() : nullptr;
+            return engines && engines->evict();
+        });
+
+        // Recordings and snapshots are written behind the event threads
+        if (pipeline.file_writer.enabled) {
+            g_file_writer = std::make_shared<hms::FileWriter>(hms::FileWriter::Options{
+                .queue_bytes = static_cast<size_t>(pipeline.file_writer.queue_mb) << 20,
+            });
+            hms::HealthController::setFileWriter(g_file_writer);
+        }
 
-        // --- EventManager (MQTT trigger → detect → record → publish) ---
+        // --- EventManager (MQTT trigger → detect → record → publish), started below ---
         g_event_manager = std::make_shared<hms::EventManager>(
-            g_buffer_service, g_mqtt, db, gpu_coord, config);
-        g_event_manager->start();
+            g_buffer_service, g_mqtt, g_db_writer, gpu_coord, config, g_file_writer);
         hms::HealthController::setEventManager(g_event_manager);
 
         // --- Periodic Snapshot Manager (ambient scene snapshots + moondream) ---
-        if (db) {
+        if (g_db_writer) {
             g_periodic_mgr = std::make_unique<hms::PeriodicSnapshotManager>(
-                g_buffer_service, db, gpu_coord, config);
-            g_periodic_mgr->start();
+                g_buffer_service, g_db_writer, gpu_coord, config, g_file_writer);
+        }
+
+        // Replay: synthetic motion once the pipeline is up
+        if (pipeline.replay.enabled()) {
+            g_replay = std::make_unique<hms::ReplayDriver>(pipeline.replay, g_buffer_service, g_event_manager);
         }
 
         // Configure Drogon
@@ -281,7 +378,7 @@ int main(int argc, char* argv[]) {
 
         app.registerHandler(
             "/snapshots/{filename}",
-            [snapshots_dir, &getMimeType](const drogon::HttpRequestPtr& /*req*/,
+            [snapshots_dir, files = g_file_writer, &getMimeType](const drogon::HttpRequestPtr& /*req*/,
                             std::function<void(const drogon::HttpResponsePtr&)>&& callback,
                             const std::string& filename) {
                 // Prevent path traversal
@@ -292,6 +389,14 @@ int main(int argc, char* argv[]) {
                     return;
                 }
                 auto path = snapshots_dir + "/" + filename;
+                // Published before the FileWriter got to it: serve the queued bytes
+                if (auto queued = files ? files->pending(path) : nullptr) {
+                    auto resp = drogon::HttpResponse::newHttpResponse();
+                    resp->setBody(std::string(*queued));
+                    resp->setContentTypeString(getMimeType(filename));
+                    callback(resp);
+                    return;
+                }
                 auto resp = drogon::HttpResponse::newFileResponse(path);
                 resp->setContentTypeString(getMimeType(filename));
                 callback(resp);
@@ -300,7 +405,7 @@ int main(int argc, char* argv[]) {
 
         app.registerHandler(
             "/events/{filename}",
-            [events_dir, &getMimeType](const drogon::HttpRequestPtr& /*req*/,
+            [events_dir, files = g_file_writer, &getMimeType](const drogon::HttpRequestPtr& /*req*/,
                          std::function<void(const drogon::HttpResponsePtr&)>&& callback,
                          const std::string& filename) {
                 if (filename.find("..") != std::string::npos || filename.find('/') != std::string::npos) {
@@ -310,6 +415,7 @@ int main(int argc, char* argv[]) {
                     return;
                 }
                 auto path = events_dir + "/" + filename;
+                if (files) path = files->locate(path);  // still in the staging dir
                 auto resp = drogon::HttpResponse::newFileResponse(path);
                 resp->setContentTypeString(getMimeType(filename));
                 callback(resp);
@@ -319,14 +425,105 @@ int main(int argc, char* argv[]) {
         spdlog::info("Listening on {}:{}", config.api.host, config.api.port);
         spdlog::info("Cameras: {}", g_buffer_service->cameraIds().size());
 
-        app.run();  // Blocks until quit
+        // Model build + warm-up, MQTT connect and DB pool run side by side while
+        // HTTP serves; the event pipeline starts once the model and MQTT are settled
+        std::thread startup([&config, &pipeline, readiness, connect_db, have_model] {
+            using State = hms::Readiness::State;
+            auto model = std::async(std::launch::async, [&] {
+                if (!have_model) return;
+                try {
+                    // Continuous workers only run with pipeline.sampling.continuous
+                    // (started below); otherwise detection runs on-demand during motion events
+                    g_buffer_service->loadDetectionModel();
+                    bool loaded = g_buffer_service->getDetectionEngine() != nullptr;
+                    readiness->set("model", loaded ? State::Ready : State::Failed,
+                                   loaded ? "" : "model failed validation");
+                } catch (const std::exception& e) {
+                    spdlog::error("Detection model failed to load: {}", e.what());
+                    readiness->set("model", State::Failed, e.what());
+                }
+            });
+            auto mqtt = std::async(std::launch::async, [&] {
+                try {
+                    if (g_mqtt->connect()) {
+                        // Publish online status (retained)
+                        g_mqtt->publish(config.mqtt.topic_prefix + "/status", "online", 1, true);
+                        readiness->set("mqtt", State::Ready);
+                    } else {
+                        readiness->set("mqtt", State::Failed, "not connected");
+                    }
+                } catch (const std::exception& e) {
+                    spdlog::warn("MQTT unavailable: {} (HTTP will continue serving)", e.what());
+                    readiness->set("mqtt", State::Failed, e.what());
+                }
+            });
+            std::future<void> db;
+            if (connect_db) {
+                db = std::async(std::launch::async, [&] {
+                    try {
+                        connect_db();
+                        readiness->set("database", State::Ready);
+                    } catch (const std::exception& e) {
+                        spdlog::warn("Database unavailable: {} (rows queue until it connects)", e.what());
+                        readiness->set("database", State::Failed, e.what());
+                    }
+                });
+            }
+
+            // Subscriptions need the connection; events and workers need the model
+            mqtt.wait();
+            model.wait();
+            if (g_shutdown) return;
+            g_event_manager->start();
+            if (pipeline.sampling.continuous) {
+                hms::DetectionWorker::MotionHandler on_motion;
+                if (pipeline.sampling.trigger_events) {
+                    on_motion = [mgr = std::weak_ptr(g_event_manager)](const std::string& id, bool active) {
+                        if (auto event_manager = mgr.lock()) event_manager->onLocalMotion(id, active);
+                    };
+                }
+                g_buffer_service->startDetection(std::move(on_motion));
+            }
+            if (g_periodic_mgr) g_periodic_mgr->start();
+            readiness->set("events", State::Ready,
+                           g_mqtt->isConnected() ? "" : "no MQTT: local motion only");
+
+            // Replay: synthetic motion from now on, quit once the run's duration is up
+            if (g_replay && !g_shutdown) {
+                g_replay->start([] {
+                    drogon::app().getLoop()->queueInLoop([] { drogon::app().quit(); });
+                });
+            }
+            spdlog::info("Startup complete");
+        });
 
-        // Cleanup
+        // Blocks until quit. If the server itself fails, the startup thread
+        // must still be joined and everything stopped in order below (a
+        // joinable std::thread going out of scope would terminate instead).
+        bool server_failed = false;
+        try {
+            app.run();
+        } catch (const std::exception& e) {
+            spdlog::error("HTTP server failed: {}", e.what());
+            g_shutdown = true;  // startup stops short of starting the pipeline
+            server_failed = true;
+        }
+
+        // Cleanup. Whatever the startup thread got to is running: wait for it
+        // (a model still compiling finishes first), then stop it all.
+        startup.join();
         spdlog::info("Shutting down...");
+        if (g_replay) {
+            g_replay->stop();
+            g_replay->writeReport();
+        }
         if (g_periodic_mgr) g_periodic_mgr->stop();
         if (g_event_manager) g_event_manager->stop();
+        if (g_live_stream) g_live_stream->stop();
         g_buffer_service->stopDetection();
         g_buffer_service->stopAll();
+        if (g_file_writer) g_file_writer->stop();  // everything queued lands
+        if (g_db_writer) g_db_writer->stop();  // flush, or journal what's left
 
         // MQTT offline + disconnect
         if (g_mqtt) {
@@ -334,12 +531,17 @@ int main(int argc, char* argv[]) {
             g_mqtt->disconnect();
         }
 
+        g_replay.reset();
         g_periodic_mgr.reset();
         g_event_manager.reset();
+        g_db_writer.reset();
+        g_db_pool.reset();
+        g_file_writer.reset();
         g_mqtt.reset();
         g_buffer_service.reset();
         avformat_network_deinit();
         spdlog::info("Shutdown complete");
+        if (server_failed) return 1;
 
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
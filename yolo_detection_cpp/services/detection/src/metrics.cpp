@@ -0,0 +1,187 @@
+#include "metrics.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace hms {
+
+namespace {
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+constexpr MetricInfo kStages[] = {
+    {"hms_decode_seconds", "Decoding one frame (send_packet + receive_frame)"},
+    {"hms_convert_seconds", "YUV to BGR24 conversion of one frame"},
+    {"hms_buffer_push_seconds", "Handing a decoded frame to the camera buffer"},
+    {"hms_preprocess_seconds", "Letterboxing one inference batch"},
+    {"hms_inference_seconds", "Session::Run of one inference batch"},
+    {"hms_postprocess_seconds", "Output decode and NMS of one inference batch"},
+    {"hms_nms_seconds", "NMS over one frame's candidates"},
+    {"hms_record_write_seconds", "Writing one frame to an event recording"},
+    {"hms_jpeg_encode_seconds", "Encoding one JPEG"},
+    {"hms_vision_seconds", "One LLaVA / moondream request"},
+    {"hms_db_write_seconds", "Writing one database row"},
+    {"hms_file_write_seconds", "One queued recording or snapshot file operation"},
+    {"hms_motion_to_detection_seconds", "Motion start to the event's first detection"},
+};
+static_assert(std::size(kStages) == static_cast<size_t>(Metrics::Stage::Count));
+
+constexpr MetricInfo kCounters[] = {
+    {"hms_events_total", "Motion events started"},
+    {"hms_frames_dropped_total", "Decoded frames dropped because the frame pool was exhausted"},
+};
+static_assert(std::size(kCounters) == static_cast<size_t>(Metrics::CounterId::Count));
+
+/// Metrics by (id, camera). Never destroyed: hot paths keep references
+/// to its entries until the process exits.
+struct Registry {
+    std::mutex mutex;
+    std::map<std::pair<int, std::string>, std::unique_ptr<Metrics::Histogram>> histograms;
+    std::map<std::pair<int, std::string>, std::unique_ptr<Metrics::Counter>> counters;
+};
+
+Registry& registry() {
+    static auto* r = new Registry;
+    return *r;
+}
+
+/// Prometheus label value: backslash, quote and newline escaped
+std::string escapeLabel(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    return out;
+}
+
+/// `{camera="x"}`, `{camera="x",extra}` or `{extra}`
+std::string labels(const std::string& camera, const std::string& extra = "") {
+    if (camera.empty()) return extra.empty() ? "" : "{" + extra + "}";
+    std::string out = "{camera=\"" + escapeLabel(camera) + "\"";
+    if (!extra.empty()) out += "," + extra;
+    return out + "}";
+}
+
+}  // namespace
+
+void Metrics::Histogram::observe(std::chrono::nanoseconds elapsed) {
+    uint64_t ns = elapsed.count() > 0 ? static_cast<uint64_t>(elapsed.count()) : 0;
+    // Bucket k holds (8 µs << (k - 1), 8 µs << k]
+    int k = ns <= 8000 ? 0 : static_cast<int>(std::bit_width((ns - 1) / 8000));
+    if (k > kBuckets) k = kBuckets;
+    buckets_[k].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+Metrics::Histogram::Snapshot Metrics::Histogram::snapshot() const {
+    Snapshot s;
+    for (int k = 0; k <= kBuckets; ++k) {
+        s.buckets[k] = buckets_[k].load(std::memory_order_relaxed);
+        s.count += s.buckets[k];
+    }
+    s.sum_seconds = static_cast<double>(sum_ns_.load(std::memory_order_relaxed)) / 1e9;
+    return s;
+}
+
+void Metrics::Histogram::Snapshot::merge(const Snapshot& other) {
+    for (int k = 0; k <= kBuckets; ++k) buckets[k] += other.buckets[k];
+    sum_seconds += other.sum_seconds;
+    count += other.count;
+}
+
+double Metrics::Histogram::Snapshot::quantileSeconds(double q) const {
+    if (count == 0) return 0.0;
+    double rank = std::clamp(q, 0.0, 1.0) * static_cast<double>(count);
+    uint64_t seen = 0;
+    for (int k = 0; k < kBuckets; ++k) {
+        if (buckets[k] > 0 && static_cast<double>(seen + buckets[k]) >= rank) {
+            double lower = k == 0 ? 0.0 : bound(k - 1);
+            double within = (rank - static_cast<double>(seen)) / static_cast<double>(buckets[k]);
+            return lower + (bound(k) - lower) * std::max(0.0, within);
+        }
+        seen += buckets[k];
+    }
+    return bound(kBuckets - 1);
+}
+
+Metrics::Histogram& Metrics::histogram(Stage stage, const std::string& camera) {
+    auto& r = registry();
+    std::lock_guard lock(r.mutex);
+    auto& slot = r.histograms[{static_cast<int>(stage), camera}];
+    if (!slot) slot = std::make_unique<Histogram>();
+    return *slot;
+}
+
+Metrics::Counter& Metrics::counter(CounterId id, const std::string& camera) {
+    auto& r = registry();
+    std::lock_guard lock(r.mutex);
+    auto& slot = r.counters[{static_cast<int>(id), camera}];
+    if (!slot) slot = std::make_unique<Counter>();
+    return *slot;
+}
+
+const char* Metrics::stageName(Stage stage) {
+    return kStages[static_cast<int>(stage)].name;
+}
+
+std::string Metrics::render() {
+    enable();
+
+    auto& r = registry();
+    std::lock_guard lock(r.mutex);
+    std::string out;
+    out.reserve(64 * 1024);
+
+    int current = -1;
+    for (const auto& [key, histogram] : r.histograms) {
+        const auto& [id, camera] = key;
+        const auto& info = kStages[id];
+        if (id != current) {
+            fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} histogram\n",
+                           info.name, info.help, info.name);
+            current = id;
+        }
+        auto s = histogram->snapshot();
+        uint64_t cumulative = 0;
+        for (int k = 0; k < Histogram::kBuckets; ++k) {
+            cumulative += s.buckets[k];
+            fmt::format_to(std::back_inserter(out), "{}_bucket{} {}\n", info.name,
+                           labels(camera, fmt::format("le=\"{}\"", Histogram::bound(k))), cumulative);
+        }
+        fmt::format_to(std::back_inserter(out), "{}_bucket{} {}\n", info.name,
+                       labels(camera, "le=\"+Inf\""), s.count);
+        fmt::format_to(std::back_inserter(out), "{}_sum{} {}\n", info.name, labels(camera), s.sum_seconds);
+        fmt::format_to(std::back_inserter(out), "{}_count{} {}\n", info.name, labels(camera), s.count);
+    }
+
+    current = -1;
+    for (const auto& [key, counter] : r.counters) {
+        const auto& [id, camera] = key;
+        const auto& info = kCounters[id];
+        if (id != current) {
+            fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} counter\n",
+                           info.name, info.help, info.name);
+            current = id;
+        }
+        fmt::format_to(std::back_inserter(out), "{}{} {}\n", info.name, labels(camera), counter->value());
+    }
+    return out;
+}
+
+}  // namespace hms
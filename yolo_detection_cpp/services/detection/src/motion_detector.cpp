@@ -0,0 +1,106 @@
+#include "motion_detector.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace hms {
+
+namespace {
+
+constexpr int kCells = MotionDetector::kCols * MotionDetector::kRows;
+constexpr int kSamples = 4;  // per cell and axis: 16 reads per cell
+
+/// Mean of a kSamples x kSamples lattice per cell; `luma(x, y)` reads one pixel
+template <typename Luma>
+void sampleGrid(int width, int height, Luma&& luma, std::array<uint8_t, kCells>& grid) {
+    constexpr int kXs = MotionDetector::kCols * kSamples;
+    constexpr int kYs = MotionDetector::kRows * kSamples;
+    std::array<int, kXs> xs;
+    std::array<int, kYs> ys;
+    for (int i = 0; i < kXs; ++i) xs[i] = (2 * i + 1) * width / (2 * kXs);
+    for (int i = 0; i < kYs; ++i) ys[i] = (2 * i + 1) * height / (2 * kYs);
+
+    for (int r = 0; r < MotionDetector::kRows; ++r) {
+        for (int c = 0; c < MotionDetector::kCols; ++c) {
+            int sum = 0;
+            for (int sy = 0; sy < kSamples; ++sy) {
+                int y = ys[r * kSamples + sy];
+                for (int sx = 0; sx < kSamples; ++sx) sum += luma(xs[c * kSamples + sx], y);
+            }
+            grid[r * MotionDetector::kCols + c] = static_cast<uint8_t>(sum / (kSamples * kSamples));
+        }
+    }
+}
+
+}  // namespace
+
+bool MotionDetector::lumaGrid(const FrameData& frame, std::array<uint8_t, kCols * kRows>& grid) {
+    if (frame.width < kCols * kSamples || frame.height < kRows * kSamples) return false;
+
+    // Y plane of the decoded picture: no BGR conversion for frames nobody else needs
+    bool native = frame.withLuma([&](const uint8_t* y, int stride) {
+        sampleGrid(frame.width, frame.height, [&](int px, int py) {
+            return static_cast<int>(y[static_cast<size_t>(py) * stride + px]);
+        }, grid);
+    });
+    if (native) return true;
+
+    if (!frame.ensureBgr()) return false;
+    const uint8_t* bgr = frame.pixels.data();
+    sampleGrid(frame.width, frame.height, [&](int px, int py) {
+        const uint8_t* p = bgr + static_cast<size_t>(py) * frame.stride + px * 3;
+        return (29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8;  // BT.601 luma
+    }, grid);
+    return true;
+}
+
+bool MotionDetector::touches(const CellMask& cells, const Region& region, int width, int height) {
+    if (cells.none() || width <= 0 || height <= 0) return false;
+    // Cells overlapped by the region: [c0, c1] x [r0, r1]
+    int c0 = std::clamp(region.x * kCols / width, 0, kCols - 1);
+    int c1 = std::clamp((region.x + region.w - 1) * kCols / width, 0, kCols - 1);
+    int r0 = std::clamp(region.y * kRows / height, 0, kRows - 1);
+    int r1 = std::clamp((region.y + region.h - 1) * kRows / height, 0, kRows - 1);
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            if (cells.test(r * kCols + c)) return true;
+        }
+    }
+    return false;
+}
+
+MotionDetector::Result MotionDetector::update(const FrameData& frame) {
+    std::array<uint8_t, kCells> grid;
+    changed_.reset();
+    if (!lumaGrid(frame, grid)) return {};
+
+    if (frame.width != width_ || frame.height != height_) {
+        width_ = frame.width;
+        height_ = frame.height;
+        for (int i = 0; i < kCells; ++i) background_[i] = static_cast<uint16_t>(grid[i] << 4);
+        return {};
+    }
+
+    // Global brightness shift between frame and background, removed per cell
+    int shift_sum = 0;
+    for (int i = 0; i < kCells; ++i) shift_sum += (grid[i] << 4) - background_[i];
+    int shift = shift_sum / kCells;
+
+    int changed = 0;
+    int threshold = options_.cell_threshold << 4;
+    for (int i = 0; i < kCells; ++i) {
+        int value = grid[i] << 4;
+        if (std::abs(value - background_[i] - shift) > threshold) {
+            changed_.set(i);
+            ++changed;
+        }
+        // Background follows the scene with a 1/8 step: slow lighting drifts fade in,
+        // an object has to keep moving to keep registering
+        background_[i] = static_cast<uint16_t>(background_[i] + (value - background_[i]) / 8);
+    }
+
+    double fraction = static_cast<double>(changed) / kCells;
+    return {.motion = fraction >= options_.min_changed, .changed = fraction};
+}
+
+}  // namespace hms
@@ -0,0 +1,154 @@
+#include "mqtt_publisher.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <ostream>
+#include <streambuf>
+
+namespace hms {
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+/// Stream buffer that appends to a caller-owned string, so json's public
+/// operator<< serializes into storage that is kept between messages
+class StringSink : public std::streambuf {
+public:
+    explicit StringSink(std::string& out) : out_(out) {}
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) out_.push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        out_.append(s, static_cast<size_t>(n));
+        return n;
+    }
+
+private:
+    std::string& out_;
+};
+
+}  // namespace
+
+MqttPublisher::MqttPublisher(std::shared_ptr<MqttClient> mqtt, Options options)
+    : MqttPublisher([mqtt](const std::string& topic, const std::string& payload, int qos, bool retain) {
+          mqtt->publish(topic, payload, qos, retain);
+      }, std::move(options))
+{
+}
+
+MqttPublisher::MqttPublisher(Transport transport, Options options)
+    : transport_(std::move(transport)), options_(std::move(options))
+{
+    options_.queue = std::max(1, options_.queue);
+    sender_ = std::thread(&MqttPublisher::senderLoop, this);
+}
+
+MqttPublisher::~MqttPublisher() {
+    stop();
+}
+
+void MqttPublisher::publish(std::string topic, nlohmann::json payload, bool coalesce, int qos, bool retain) {
+    {
+        std::lock_guard lock(mutex_);
+        if (stopping_) {
+            stats_.dropped++;
+            return;
+        }
+
+        if (coalesce) {
+            // A newer state replaces the queued one in place
+            auto it = std::find_if(queue_.begin(), queue_.end(), [&](const Message& m) {
+                return m.coalesce && m.topic == topic;
+            });
+            if (it != queue_.end()) {
+                it->payload = std::move(payload);
+                it->qos = qos;
+                it->retain = retain;
+                stats_.coalesced++;
+                return;
+            }
+        }
+
+        if (queue_.size() >= static_cast<size_t>(options_.queue)) {
+            if (stats_.dropped % 100 == 0) {
+                spdlog::warn("MqttPublisher: queue full ({}), dropping oldest message on {}",
+                             queue_.size(), queue_.front().topic);
+            }
+            queue_.pop_front();
+            stats_.dropped++;
+        }
+        queue_.push_back(Message{
+            .topic = std::move(topic),
+            .payload = std::move(payload),
+            .coalesce = coalesce,
+            .qos = qos,
+            .retain = retain,
+            .queued_at = Clock::now(),
+        });
+    }
+    cv_.notify_one();
+}
+
+void MqttPublisher::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (sender_.joinable()) sender_.join();
+}
+
+MqttPublisher::Stats MqttPublisher::stats() const {
+    std::lock_guard lock(mutex_);
+    Stats s = stats_;
+    s.queued = queue_.size();
+    s.avg_latency_ms = s.published > 0 ? latency_ns_total_ / 1e6 / s.published : 0.0;
+    return s;
+}
+
+void MqttPublisher::senderLoop() {
+    // One payload buffer for the thread's lifetime: clear() keeps its capacity
+    std::string payload;
+    payload.reserve(4096);
+    StringSink sink(payload);
+    std::ostream out(&sink);
+
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) break;  // stopping, nothing left
+
+        Message msg = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        payload.clear();
+        out << msg.payload;  // compact, same as dump()
+
+        bool ok = true;
+        try {
+            transport_(msg.topic, payload, msg.qos, msg.retain);
+        } catch (const std::exception& e) {
+            spdlog::error("MqttPublisher: publish to {} failed: {}", msg.topic, e.what());
+            ok = false;
+        }
+        auto latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - msg.queued_at).count();
+
+        lock.lock();
+        if (!ok) {
+            stats_.failures++;
+            continue;
+        }
+        stats_.published++;
+        latency_ns_total_ += latency_ns;
+        stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency_ns / 1e6);
+    }
+}
+
+}  // namespace hms
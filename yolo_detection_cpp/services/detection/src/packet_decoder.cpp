@@ -0,0 +1,97 @@
+#include "packet_decoder.h"
+
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+namespace hms {
+
+namespace {
+
+/// Decoder, scratch frames and scaler of one decodeAt() call
+struct OneShot {
+    AVCodecContext* ctx = nullptr;
+    AVFrame* frame = nullptr;
+    AVFrame* picture = nullptr;  // latest output
+    SwsContext* sws = nullptr;
+
+    ~OneShot() {
+        if (sws) sws_freeContext(sws);
+        av_frame_free(&picture);
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+    }
+};
+
+}  // namespace
+
+std::shared_ptr<FrameData> PacketDecoder::decodeAt(const PacketRing& ring, SteadyClock::time_point at) {
+    auto stream = ring.stream();
+    auto run = ring.gopUntil(at);
+    // A reconnect between the two calls: the packets don't fit these parameters
+    if (!stream.codecpar || run.empty() || run.front().generation != stream.generation) {
+        return nullptr;
+    }
+
+    const AVCodec* codec = avcodec_find_decoder(stream.codecpar->codec_id);
+    if (!codec) return nullptr;
+
+    OneShot d;
+    d.ctx = avcodec_alloc_context3(codec);
+    d.frame = av_frame_alloc();
+    d.picture = av_frame_alloc();
+    if (!d.ctx || !d.frame || !d.picture) return nullptr;
+    avcodec_parameters_to_context(d.ctx, stream.codecpar.get());
+    d.ctx->pkt_timebase = stream.time_base;
+    d.ctx->thread_count = 0;  // a 4K GOP at once: let FFmpeg use every core
+    if (avcodec_open2(d.ctx, codec, nullptr) < 0) return nullptr;
+
+    // Output follows display order; after the flush the last picture out is
+    // the one the target packet completes
+    auto drain = [&] {
+        while (avcodec_receive_frame(d.ctx, d.frame) == 0) {
+            av_frame_unref(d.picture);
+            av_frame_move_ref(d.picture, d.frame);
+        }
+    };
+    for (const auto& entry : run) {
+        if (avcodec_send_packet(d.ctx, entry.packet.get()) == 0) drain();
+    }
+    avcodec_send_packet(d.ctx, nullptr);
+    drain();
+    if (!d.picture->data[0]) return nullptr;
+
+    int w = d.picture->width, h = d.picture->height;
+    d.sws = sws_getContext(w, h, static_cast<AVPixelFormat>(d.picture->format),
+                           w, h, AV_PIX_FMT_BGR24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!d.sws) return nullptr;
+
+    auto out = std::make_shared<FrameData>();
+    out->resize(w, h);
+    uint8_t* dst[1] = {out->pixels.data()};
+    int dst_stride[1] = {out->stride};
+    sws_scale(d.sws, d.picture->data, d.picture->linesize, 0, h, dst, dst_stride);
+    out->timestamp = run.back().arrival;
+    out->frame_number = run.back().seq;
+    spdlog::debug("PacketDecoder: {}x{} from {} packet(s)", w, h, run.size());
+    return out;
+}
+
+std::vector<Detection> scaleDetections(std::vector<Detection> detections,
+                                       int from_w, int from_h, int to_w, int to_h) {
+    if (from_w <= 0 || from_h <= 0 || (from_w == to_w && from_h == to_h)) return detections;
+    float sx = static_cast<float>(to_w) / static_cast<float>(from_w);
+    float sy = static_cast<float>(to_h) / static_cast<float>(from_h);
+    for (auto& d : detections) {
+        d.x1 *= sx;
+        d.x2 *= sx;
+        d.y1 *= sy;
+        d.y2 *= sy;
+    }
+    return detections;
+}
+
+}  // namespace hms
@@ -0,0 +1,149 @@
+#include "packet_ring.h"
+
+#include <algorithm>
+
+namespace hms {
+
+PacketRing::PacketRing(std::chrono::milliseconds window, size_t max_bytes)
+    : window_(window)
+    , max_bytes_(max_bytes) {}
+
+void PacketRing::setStream(const AVCodecParameters* codecpar, AVRational time_base) {
+    std::shared_ptr<const AVCodecParameters> copy;
+    if (codecpar) {
+        AVCodecParameters* par = avcodec_parameters_alloc();
+        if (par && avcodec_parameters_copy(par, codecpar) >= 0) {
+            copy.reset(par, [](const AVCodecParameters* p) {
+                auto* q = const_cast<AVCodecParameters*>(p);
+                avcodec_parameters_free(&q);
+            });
+        } else if (par) {
+            avcodec_parameters_free(&par);
+        }
+    }
+
+    std::lock_guard lock(mutex_);
+    entries_.clear();
+    keyframes_.clear();
+    bytes_ = 0;
+    stream_.codecpar = std::move(copy);
+    stream_.time_base = time_base;
+    ++stream_.generation;
+}
+
+void PacketRing::push(const AVPacket* packet, SteadyClock::time_point arrival) {
+    if (!packet) return;
+    bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+    std::lock_guard lock(mutex_);
+    // A recording can only start on a keyframe
+    if (entries_.empty() && !keyframe) return;
+
+    AVPacket* ref = av_packet_clone(packet);
+    if (!ref) return;
+
+    Entry entry{
+        .packet = std::shared_ptr<const AVPacket>(ref, [](const AVPacket* p) {
+            auto* q = const_cast<AVPacket*>(p);
+            av_packet_free(&q);
+        }),
+        .seq = next_seq_++,
+        .generation = stream_.generation,
+        .arrival = arrival,
+        .keyframe = keyframe,
+    };
+    if (keyframe) keyframes_.push_back(entry.seq);
+    bytes_ += static_cast<size_t>(ref->size);
+    ++pushed_;
+    entries_.push_back(std::move(entry));
+
+    trimLocked();
+}
+
+void PacketRing::trimLocked() {
+    // Drop a GOP only once the next one alone still covers the window
+    auto cutoff = entries_.back().arrival - window_;
+    while (keyframes_.size() >= 2
+           && entries_[keyframes_[1] - entries_.front().seq].arrival <= cutoff) {
+        popGopLocked();
+    }
+
+    // Runaway bitrate: keep memory bounded, at the cost of a shorter preroll
+    while (bytes_ > max_bytes_ && keyframes_.size() >= 2) {
+        popGopLocked();
+        ++dropped_gops_;
+    }
+}
+
+void PacketRing::popGopLocked() {
+    uint64_t next_key = keyframes_[1];
+    while (!entries_.empty() && entries_.front().seq < next_key) {
+        bytes_ -= static_cast<size_t>(entries_.front().packet->size);
+        entries_.pop_front();
+    }
+    keyframes_.pop_front();
+}
+
+PacketRing::StreamInfo PacketRing::stream() const {
+    std::lock_guard lock(mutex_);
+    return stream_;
+}
+
+std::vector<PacketRing::Entry> PacketRing::preroll(std::chrono::milliseconds preroll) const {
+    std::lock_guard lock(mutex_);
+    if (entries_.empty()) return {};
+
+    auto cutoff = entries_.back().arrival - preroll;
+    uint64_t start = keyframes_.front();
+    for (auto it = keyframes_.rbegin(); it != keyframes_.rend(); ++it) {
+        if (entries_[*it - entries_.front().seq].arrival <= cutoff) {
+            start = *it;
+            break;
+        }
+    }
+    return {entries_.begin() + static_cast<ptrdiff_t>(start - entries_.front().seq), entries_.end()};
+}
+
+std::vector<PacketRing::Entry> PacketRing::gopUntil(SteadyClock::time_point at) const {
+    std::lock_guard lock(mutex_);
+    if (entries_.empty()) return {};
+
+    auto target = std::lower_bound(entries_.begin(), entries_.end(), at,
+        [](const Entry& e, SteadyClock::time_point t) { return e.arrival < t; });
+    if (target == entries_.end()) --target;
+
+    uint64_t start = keyframes_.front();
+    for (auto it = keyframes_.rbegin(); it != keyframes_.rend(); ++it) {
+        if (*it <= target->seq) {
+            start = *it;
+            break;
+        }
+    }
+    return {entries_.begin() + static_cast<ptrdiff_t>(start - entries_.front().seq), target + 1};
+}
+
+std::vector<PacketRing::Entry> PacketRing::since(uint64_t after_seq) const {
+    std::lock_guard lock(mutex_);
+    if (entries_.empty() || after_seq >= entries_.back().seq) return {};
+
+    size_t first = after_seq < entries_.front().seq
+        ? 0 : static_cast<size_t>(after_seq - entries_.front().seq + 1);
+    return {entries_.begin() + static_cast<ptrdiff_t>(first), entries_.end()};
+}
+
+uint64_t PacketRing::lastSeq() const {
+    std::lock_guard lock(mutex_);
+    return entries_.empty() ? 0 : entries_.back().seq;
+}
+
+PacketRing::Stats PacketRing::stats() const {
+    std::lock_guard lock(mutex_);
+    return Stats{
+        .packets = entries_.size(),
+        .bytes = bytes_,
+        .pushed = pushed_,
+        .dropped_gops = dropped_gops_,
+    };
+}
+
+}  // namespace hms
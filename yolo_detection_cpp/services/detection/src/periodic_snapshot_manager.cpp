@@ -1,13 +1,12 @@
 #include "periodic_snapshot_manager.h"
-#include "snapshot_writer.h"
+#include "jpeg_encoder.h"
 #include "vision_client.h"
-#include "embedding_client.h"
-#include "api_queries.h"
 #include "time_utils.h"
 
 #include <spdlog/spdlog.h>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <chrono>
 
 namespace fs = std::filesystem;
@@ -16,14 +15,25 @@ namespace hms {
 
 PeriodicSnapshotManager::PeriodicSnapshotManager(
     std::shared_ptr<BufferService> buffer_service,
-    std::shared_ptr<hms::DbPool> db,
+    std::shared_ptr<DbWriter> db,
     std::shared_ptr<GpuCoordinator> gpu_coord,
-    const hms::AppConfig& config)
+    const hms::AppConfig& config,
+    std::shared_ptr<FileWriter> files)
     : buffer_service_(std::move(buffer_service))
     , db_(std::move(db))
     , gpu_coord_(std::move(gpu_coord))
+    , files_(std::move(files))
     , config_(config)
 {
+    const auto& emb = buffer_service_->pipelineConfig().embedding;
+    embedding_ = std::make_unique<EmbeddingClient>(
+        config_.periodic_vision.endpoint, "nomic-embed-text",
+        EmbeddingClient::Options{
+            .batch_window_ms = emb.batch_window_ms,
+            .max_batch = emb.max_batch,
+            .cache_entries = emb.cache_entries,
+            .transport = {},
+        });
 }
 
 PeriodicSnapshotManager::~PeriodicSnapshotManager() {
@@ -56,6 +66,11 @@ void PeriodicSnapshotManager::stop() {
     threads_.clear();
 }
 
+void PeriodicSnapshotManager::freeGpuForVision() {
+    if (gpu_coord_ && gpu_coord_->requestVram()) return;
+    if (auto engines = buffer_service_->getEnginePool()) engines->evict();
+}
+
 void PeriodicSnapshotManager::cameraLoop(const std::string& camera_id,
                                           int interval_seconds) {
     spdlog::info("PeriodicSnapshotManager: thread started for {}", camera_id);
@@ -69,7 +84,7 @@ void PeriodicSnapshotManager::cameraLoop(const std::string& camera_id,
         try {
             // 1. Grab latest frame (CPU only — always safe)
             auto frame = buffer_service_->getLatestFrame(camera_id);
-            if (!frame || frame->pixels.empty()) {
+            if (!frame || !frame->ensureBgr()) {
                 spdlog::warn("PeriodicSnapshotManager: no frame for {}", camera_id);
                 for (int i = 0; i < interval_seconds && running_; ++i) {
                     std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -77,30 +92,36 @@ void PeriodicSnapshotManager::cameraLoop(const std::string& camera_id,
                 continue;
             }
 
-            // Deep-copy frame to avoid holding buffer references
-            FrameData frame_copy;
-            frame_copy.pixels = frame->pixels;
-            frame_copy.width = frame->width;
-            frame_copy.height = frame->height;
-            frame_copy.stride = frame->stride;
-            frame_copy.timestamp = frame->timestamp;
-            frame_copy.frame_number = frame->frame_number;
-
             auto snapshots_dir = config_.timeline.snapshots_dir;
 
-            // 2. Save full JPEG (no bounding boxes — ambient snapshot, CPU only)
-            auto snapshot_filename = saveSnapshot(frame_copy, camera_id, snapshots_dir);
-            if (snapshot_filename.empty()) {
-                spdlog::error("PeriodicSnapshotManager: failed to save snapshot for {}", camera_id);
+            // 2. Encode full JPEG + thumbnail + vision image (no bounding boxes —
+            // ambient snapshot, CPU only). All come from this one conversion, so
+            // the frame can go back to the pool now rather than being held (or
+            // copied) through the vision call.
+            auto snap = encodeSnapshot(*frame, camera_id);
+            frame.reset();
+            if (!snap.jpeg) {
+                spdlog::error("PeriodicSnapshotManager: failed to encode snapshot for {}", camera_id);
                 for (int i = 0; i < interval_seconds && running_; ++i)
                     std::this_thread::sleep_for(std::chrono::seconds(1));
                 continue;
             }
 
-            // 3. Save thumbnail (CPU only)
-            auto thumbnail_filename = saveThumbnail(frame_copy, camera_id, snapshots_dir);
+            // Files are queued to the FileWriter now, so a failed vision or
+            // embedding call can't lose them. Without one they're written on a
+            // thread of their own while moondream looks at the in-memory image.
+            std::future<bool> written;
+            if (files_) {
+                std::promise<bool> queued;
+                queued.set_value(writeSnapshot(snap, camera_id, snapshots_dir, files_.get()));
+                written = queued.get_future();
+            } else {
+                written = std::async(std::launch::async, [&snap, camera_id, snapshots_dir] {
+                    return writeSnapshot(snap, camera_id, snapshots_dir, nullptr);
+                });
+            }
 
-            // 4. Run moondream vision analysis (GPU — check coordinator first)
+            // 3. Run moondream vision analysis (GPU — check coordinator first)
             std::string context_text;
             bool is_valid = false;
             bool was_aborted = false;
@@ -111,12 +132,12 @@ void PeriodicSnapshotManager::cameraLoop(const std::string& camera_id,
                     spdlog::info("PeriodicSnapshotManager: [{}] skipping moondream — event active",
                                  camera_id);
                 } else {
+                    freeGpuForVision();
                     VisionClient vision(config_.periodic_vision);
-                    auto snapshot_path = snapshots_dir + "/" + snapshot_filename;
 
                     // Pass abort flag so curl cancels if an event fires mid-inference.
                     // The coordinator's abort flag gets set by EventManager::processEvent().
-                    auto result = vision.analyze(snapshot_path, camera_id, "scene",
+                    auto result = vision.analyze(snap.vision, camera_id, "scene",
                         gpu_coord_ ? &gpu_coord_->abortPeriodicFlag() : nullptr);
 
                     context_text = result.context;
@@ -133,29 +154,35 @@ void PeriodicSnapshotManager::cameraLoop(const std::string& camera_id,
                 }
             }
 
-            // 5. Generate embedding (only if we got valid context)
+            // 4. Generate embedding (only if we got valid context)
             std::vector<float> embedding;
             if (!context_text.empty() && is_valid && !was_aborted) {
                 // Skip embedding if event just started
                 if (!gpu_coord_ || !gpu_coord_->isEventActive()) {
-                    EmbeddingClient emb_client(config_.periodic_vision.endpoint, "nomic-embed-text");
-                    embedding = emb_client.embed(context_text);
+                    embedding = embedding_->embed(context_text);
                     if (embedding.empty()) {
                         spdlog::warn("PeriodicSnapshotManager: embedding failed for {}", camera_id);
                     }
                 }
             }
 
-            // 6. Insert into DB (always — even without context, the snapshot is valuable)
+            // 5. Insert into DB once the files are on disk (always — even
+            // without context, the snapshot is valuable)
+            if (!written.get()) {
+                spdlog::error("PeriodicSnapshotManager: failed to save snapshot for {}", camera_id);
+                for (int i = 0; i < interval_seconds && running_; ++i)
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
             if (db_) {
                 std::string model_used = was_aborted ? "" : config_.periodic_vision.model;
-                hms::api_queries::insert_periodic_snapshot(
-                    *db_, camera_id, snapshot_filename, thumbnail_filename,
-                    context_text, embedding, model_used, is_valid);
+                db_->submit(DbWriter::PeriodicSnapshot{
+                    camera_id, snap.filename, snap.thumbnail_filename, context_text,
+                    std::move(embedding), model_used, is_valid});
             }
 
             spdlog::info("PeriodicSnapshotManager: completed snapshot for {} -> {}{}",
-                        camera_id, snapshot_filename,
+                        camera_id, snap.filename,
                         was_aborted ? " (no context — aborted)" :
                         context_text.empty() ? " (no context)" : "");
 
@@ -172,69 +199,87 @@ void PeriodicSnapshotManager::cameraLoop(const std::string& camera_id,
     spdlog::info("PeriodicSnapshotManager: thread stopped for {}", camera_id);
 }
 
-std::string PeriodicSnapshotManager::saveSnapshot(const FrameData& frame,
-                                                    const std::string& camera_id,
-                                                    const std::string& snapshots_dir) {
-    // Generate filename: {camera_id}_periodic_{YYYYMMDD}_{HHMMSS}.jpg
-    auto now = std::chrono::system_clock::now();
-    auto time_t_now = std::chrono::system_clock::to_time_t(now);
-    std::tm tm{};
-    localtime_r(&time_t_now, &tm);
-
-    char buf[64];
-    std::snprintf(buf, sizeof(buf), "%s_periodic_%04d%02d%02d_%02d%02d%02d.jpg",
-                  camera_id.c_str(),
-                  tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-                  tm.tm_hour, tm.tm_min, tm.tm_sec);
-    std::string filename(buf);
-
-    // Encode to JPEG
-    auto jpeg = SnapshotWriter::encodeJpeg(frame.pixels.data(),
-                                            frame.width, frame.height, frame.stride);
-    if (jpeg.empty()) return {};
+namespace {
 
-    // Write file
-    fs::create_directories(snapshots_dir);
-    auto path = fs::path(snapshots_dir) / filename;
+bool writeFile(const fs::path& path, const std::string& data) {
     std::ofstream f(path, std::ios::binary);
-    if (!f) return {};
-    f.write(jpeg.data(), static_cast<std::streamsize>(jpeg.size()));
-    f.close();
-
-    return filename;
+    if (!f) return false;
+    f.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(f);
 }
 
-std::string PeriodicSnapshotManager::saveThumbnail(const FrameData& frame,
-                                                    const std::string& camera_id,
-                                                    const std::string& snapshots_dir) {
-    // Generate thumbnail filename
+}  // namespace
+
+PeriodicSnapshotManager::EncodedSnapshot PeriodicSnapshotManager::encodeSnapshot(
+    const FrameData& frame, const std::string& camera_id) {
+    // Generate filenames: {camera_id}_periodic_{YYYYMMDD}_{HHMMSS}[_thumb].jpg
     auto now = std::chrono::system_clock::now();
     auto time_t_now = std::chrono::system_clock::to_time_t(now);
     std::tm tm{};
     localtime_r(&time_t_now, &tm);
 
     char buf[64];
-    std::snprintf(buf, sizeof(buf), "%s_periodic_%04d%02d%02d_%02d%02d%02d_thumb.jpg",
+    std::snprintf(buf, sizeof(buf), "%s_periodic_%04d%02d%02d_%02d%02d%02d",
                   camera_id.c_str(),
                   tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
                   tm.tm_hour, tm.tm_min, tm.tm_sec);
-    std::string filename(buf);
+    std::string stem(buf);
+
+    EncodedSnapshot snap;
+    snap.filename = stem + ".jpg";
+    snap.thumbnail_filename = stem + "_thumb.jpg";
+
+    // Full frame, thumbnail and (optionally) the vision image from one pass over the pixels
+    const auto& pipeline = buffer_service_->pipelineConfig();
+    int vision_width = config_.periodic_vision.enabled ? pipeline.vision.periodic_width : 0;
+    bool scaled_vision = vision_width > 0 && vision_width < frame.width;
+    JpegEncoder::Output outputs[3];
+    outputs[1].max_width = pipeline.snapshots.thumbnail_width;
+    outputs[1].quality = pipeline.snapshots.thumbnail_quality;
+    outputs[2].max_width = vision_width;
+    JpegEncoder::encode(frame.pixels.data(), frame.width, frame.height, frame.stride,
+                        std::span(outputs, scaled_vision ? 3 : 2));
+
+    if (outputs[0].jpeg.empty()) return snap;
+
+    snap.jpeg = std::make_shared<const std::string>(std::move(outputs[0].jpeg));
+    snap.thumbnail = std::move(outputs[1].jpeg);
+    snap.vision = scaled_vision && !outputs[2].jpeg.empty()
+        ? std::make_shared<const std::string>(std::move(outputs[2].jpeg))
+        : snap.jpeg;
+    spdlog::debug("PeriodicSnapshotManager: [{}] {}x{} {} KB, thumbnail {}x{} {} KB",
+                  camera_id, outputs[0].width, outputs[0].height, snap.jpeg->size() / 1024,
+                  outputs[1].width, outputs[1].height, snap.thumbnail.size() / 1024);
+    return snap;
+}
 
-    // For thumbnail, we scale down. Since SnapshotWriter::encodeJpeg works with
-    // the full frame, and sub-streams are already 640x480, the "thumbnail" is
-    // just a higher-compression JPEG of the same frame.
-    // (Sub-stream is already small enough — 640x480 → ~15-25KB JPEG)
-    auto jpeg = SnapshotWriter::encodeJpeg(frame.pixels.data(),
-                                            frame.width, frame.height, frame.stride);
-    if (jpeg.empty()) return {};
+bool PeriodicSnapshotManager::writeSnapshot(EncodedSnapshot& snapshot, const std::string& camera_id,
+                                            const std::string& snapshots_dir, FileWriter* files) {
+    if (files) {
+        if (!snapshot.jpeg) return false;
+        files->writeFile((fs::path(snapshots_dir) / snapshot.filename).string(), snapshot.jpeg);
+        if (snapshot.thumbnail.empty()) {
+            spdlog::warn("PeriodicSnapshotManager: [{}] no thumbnail for {}", camera_id, snapshot.filename);
+            snapshot.thumbnail_filename.clear();
+        } else {
+            files->writeFile((fs::path(snapshots_dir) / snapshot.thumbnail_filename).string(),
+                             std::make_shared<const std::string>(std::move(snapshot.thumbnail)));
+        }
+        return true;
+    }
 
-    auto path = fs::path(snapshots_dir) / filename;
-    std::ofstream f(path, std::ios::binary);
-    if (!f) return {};
-    f.write(jpeg.data(), static_cast<std::streamsize>(jpeg.size()));
-    f.close();
+    std::error_code ec;
+    fs::create_directories(snapshots_dir, ec);
+    if (!snapshot.jpeg || !writeFile(fs::path(snapshots_dir) / snapshot.filename, *snapshot.jpeg)) {
+        return false;
+    }
 
-    return filename;
+    if (snapshot.thumbnail.empty()
+        || !writeFile(fs::path(snapshots_dir) / snapshot.thumbnail_filename, snapshot.thumbnail)) {
+        spdlog::warn("PeriodicSnapshotManager: [{}] no thumbnail for {}", camera_id, snapshot.filename);
+        snapshot.thumbnail_filename.clear();
+    }
+    return true;
 }
 
 }  // namespace hms
@@ -0,0 +1,332 @@
+#include "pipeline_config.h"
+
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+namespace hms {
+
+namespace {
+
+template <typename T>
+void read(const YAML::Node& node, const char* key, T& out) {
+    if (node && node[key]) out = node[key].as<T>();
+}
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+/// Canonical FFmpeg device type name; empty if unsupported
+std::string normalizeHwaccel(std::string name) {
+    name = lower(std::move(name));
+    if (name == "nvdec") return "cuda";
+    if (name == "none" || name == "auto" || name == "cuda" || name == "vaapi" || name == "qsv") {
+        return name;
+    }
+    return {};
+}
+
+void readHwaccel(const YAML::Node& node, const std::string& what, std::string& out) {
+    if (!node) return;
+    auto name = normalizeHwaccel(node.as<std::string>());
+    if (name.empty()) {
+        spdlog::warn("PipelineConfig: unknown {} '{}', using software decode",
+                     what, node.as<std::string>());
+        name = "none";
+    }
+    out = name;
+}
+
+/// Provider/precision keys of `node` over `session` (the engine-level default)
+void readProvider(const YAML::Node& node, SessionConfig& session) {
+    if (!node) return;
+    if (auto value = node["provider"]) {
+        auto name = lower(value.as<std::string>());
+        if (name == "cpu") session.provider = ExecutionProvider::Cpu;
+        else if (name == "cuda") session.provider = ExecutionProvider::Cuda;
+        else if (name == "tensorrt" || name == "trt") session.provider = ExecutionProvider::TensorRt;
+        else if (name == "openvino") session.provider = ExecutionProvider::OpenVino;
+        else spdlog::warn("PipelineConfig: unknown engine provider '{}', using {}",
+                          name, providerName(session.provider));
+    }
+    if (auto value = node["precision"]) {
+        auto name = lower(value.as<std::string>());
+        if (name == "fp32") session.precision = Precision::Fp32;
+        else if (name == "fp16") session.precision = Precision::Fp16;
+        else if (name == "int8") session.precision = Precision::Int8;
+        else spdlog::warn("PipelineConfig: unknown engine precision '{}', using {}",
+                          name, precisionName(session.precision));
+    }
+    read(node, "openvino_device", session.openvino_device);
+}
+
+/// Tiling keys of `node` over `cfg` (the section default, for camera overrides)
+void readTiling(const YAML::Node& node, TilingConfig& cfg) {
+    if (!node) return;
+    if (auto roi = node["roi"]; roi && roi.IsSequence() && roi.size() == 4) {
+        cfg.roi_x = roi[0].as<float>();
+        cfg.roi_y = roi[1].as<float>();
+        cfg.roi_w = roi[2].as<float>();
+        cfg.roi_h = roi[3].as<float>();
+    }
+    if (auto tiles = node["tiles"]; tiles && tiles.IsSequence() && tiles.size() == 2) {
+        cfg.cols = tiles[0].as<int>();
+        cfg.rows = tiles[1].as<int>();
+    }
+    read(node, "overlap", cfg.overlap);
+    read(node, "full_frame", cfg.full_frame);
+    read(node, "motion_tiles", cfg.motion_tiles);
+
+    // Keep the ROI inside the frame and the grid sane
+    cfg.roi_x = std::clamp(cfg.roi_x, 0.0f, 0.99f);
+    cfg.roi_y = std::clamp(cfg.roi_y, 0.0f, 0.99f);
+    cfg.roi_w = std::clamp(cfg.roi_w, 0.01f, 1.0f - cfg.roi_x);
+    cfg.roi_h = std::clamp(cfg.roi_h, 0.01f, 1.0f - cfg.roi_y);
+    cfg.cols = std::clamp(cfg.cols, 1, 8);
+    cfg.rows = std::clamp(cfg.rows, 1, 8);
+    cfg.overlap = std::clamp(cfg.overlap, 0.0f, 0.5f);
+}
+
+void readEventStage(const YAML::Node& node, EventStageConfig& cfg) {
+    read(node, "workers", cfg.workers);
+    read(node, "queue", cfg.queue);
+    cfg.workers = std::clamp(cfg.workers, 0, 64);
+    cfg.queue = std::clamp(cfg.queue, 0, 4096);
+}
+
+}  // namespace
+
+const char* providerName(ExecutionProvider provider) {
+    switch (provider) {
+        case ExecutionProvider::Cpu: return "cpu";
+        case ExecutionProvider::Cuda: return "cuda";
+        case ExecutionProvider::TensorRt: return "tensorrt";
+        case ExecutionProvider::OpenVino: return "openvino";
+    }
+    return "cpu";
+}
+
+const char* precisionName(Precision precision) {
+    switch (precision) {
+        case Precision::Fp32: return "fp32";
+        case Precision::Fp16: return "fp16";
+        case Precision::Int8: return "int8";
+    }
+    return "fp32";
+}
+
+PipelineConfig PipelineConfig::load(const std::string& config_path) {
+    PipelineConfig cfg;
+    if (!std::filesystem::exists(config_path)) return cfg;
+
+    try {
+        auto root = YAML::LoadFile(config_path);
+        auto pipeline = root["pipeline"];
+        if (!pipeline) return cfg;
+
+        auto sched = pipeline["scheduler"];
+        read(sched, "max_batch_size", cfg.scheduler.max_batch_size);
+        read(sched, "max_wait_ms", cfg.scheduler.max_wait_ms);
+        read(sched, "pipeline_depth", cfg.scheduler.pipeline_depth);
+
+        auto engine = pipeline["engine"];
+        read(engine, "idle_ttl_seconds", cfg.engine.idle_ttl_seconds);
+        read(engine, "warmup", cfg.engine.warmup);
+        read(engine, "cache_optimized_model", cfg.engine.cache_optimized_model);
+        read(engine, "optimized_model_path", cfg.engine.optimized_model_path);
+        read(engine, "provider_cache_dir", cfg.engine.provider_cache_dir);
+        // Engine-level provider/precision apply to every session that doesn't set its own
+        SessionConfig defaults;
+        readProvider(engine, defaults);
+        cfg.engine.sessions = {defaults};
+        if (auto sessions = engine["sessions"]; sessions && sessions.IsSequence() && sessions.size() > 0) {
+            cfg.engine.sessions.clear();
+            for (const auto& node : sessions) {
+                SessionConfig session = defaults;
+                read(node, "device", session.device);
+                read(node, "threads", session.threads);
+                readProvider(node, session);
+                cfg.engine.sessions.push_back(session);
+            }
+        }
+
+        std::string resize;
+        read(pipeline["preprocess"], "resize", resize);
+        read(pipeline["preprocess"], "gpu", cfg.preprocess.gpu);
+        if (resize == "bilinear") {
+            cfg.preprocess.resize = ResizeMode::Bilinear;
+        } else if (!resize.empty() && resize != "nearest") {
+            spdlog::warn("PipelineConfig: unknown preprocess.resize '{}', using nearest", resize);
+        }
+
+        auto recording = pipeline["recording"];
+        std::string mode;
+        read(recording, "mode", mode);
+        if (mode == "transcode") {
+            cfg.recording.mode = RecordingConfig::Mode::Transcode;
+        } else if (!mode.empty() && mode != "passthrough") {
+            spdlog::warn("PipelineConfig: unknown recording.mode '{}', using passthrough", mode);
+        }
+        read(recording, "burn_in_boxes", cfg.recording.burn_in_boxes);
+        read(recording, "fragmented", cfg.recording.fragmented);
+        read(recording, "staging_dir", cfg.recording.staging_dir);
+
+        auto decode = pipeline["decode"];
+        if (decode) {
+            readHwaccel(decode["hwaccel"], "decode.hwaccel", cfg.decode.hwaccel);
+            read(decode, "device", cfg.decode.device);
+            read(decode, "threads", cfg.decode.threads);
+            for (const auto& cam : decode["cameras"]) {
+                auto id = cam.first.as<std::string>();
+                readHwaccel(cam.second, "decode.cameras." + id, cfg.decode.camera_hwaccel[id]);
+            }
+        }
+
+        auto streams = pipeline["streams"];
+        if (streams) {
+            for (const auto& cam : streams["cameras"]) {
+                auto url = cam.second.as<std::string>();
+                if (!url.empty()) cfg.streams.record_urls[cam.first.as<std::string>()] = url;
+            }
+            read(streams, "full_res_snapshots", cfg.streams.full_res_snapshots);
+        }
+
+        auto memory = pipeline["memory"];
+        read(memory, "arena", cfg.memory.arena);
+        read(memory, "huge_pages", cfg.memory.huge_pages);
+        read(memory, "numa_node", cfg.memory.numa_node);
+
+        auto sampling = pipeline["sampling"];
+        read(sampling, "continuous", cfg.sampling.continuous);
+        read(sampling, "motion_gating", cfg.sampling.motion_gating);
+        read(sampling, "idle_interval_ms", cfg.sampling.idle_interval_ms);
+        read(sampling, "burst_interval_ms", cfg.sampling.burst_interval_ms);
+        read(sampling, "burst_hold_ms", cfg.sampling.burst_hold_ms);
+        read(sampling, "cell_threshold", cfg.sampling.cell_threshold);
+        read(sampling, "min_changed", cfg.sampling.min_changed);
+        read(sampling, "trigger_events", cfg.sampling.trigger_events);
+
+        if (auto events = pipeline["events"]) {
+            readEventStage(events["record"], cfg.events.record);
+            readEventStage(events["snapshot"], cfg.events.snapshot);
+            readEventStage(events["vision"], cfg.events.vision);
+            readEventStage(events["publish"], cfg.events.publish);
+            read(events, "mqtt_queue", cfg.events.mqtt_queue);
+        }
+
+        auto tracking = pipeline["tracking"];
+        read(tracking, "enabled", cfg.tracking.enabled);
+        read(tracking, "detect_interval", cfg.tracking.detect_interval);
+        read(tracking, "iou_threshold", cfg.tracking.iou_threshold);
+        read(tracking, "min_hits", cfg.tracking.min_hits);
+        read(tracking, "max_age_ms", cfg.tracking.max_age_ms);
+        read(tracking, "stationary_speed", cfg.tracking.stationary_speed);
+        read(tracking, "stationary_recheck_ms", cfg.tracking.stationary_recheck_ms);
+
+        auto snapshots = pipeline["snapshots"];
+        read(snapshots, "thumbnail_width", cfg.snapshots.thumbnail_width);
+        read(snapshots, "thumbnail_quality", cfg.snapshots.thumbnail_quality);
+
+        auto vision = pipeline["vision"];
+        read(vision, "event_width", cfg.vision.event_width);
+        read(vision, "periodic_width", cfg.vision.periodic_width);
+
+        auto embedding = pipeline["embedding"];
+        read(embedding, "batch_window_ms", cfg.embedding.batch_window_ms);
+        read(embedding, "max_batch", cfg.embedding.max_batch);
+        read(embedding, "cache_entries", cfg.embedding.cache_entries);
+
+        auto db_writer = pipeline["db_writer"];
+        read(db_writer, "queue", cfg.db_writer.queue);
+        read(db_writer, "batch", cfg.db_writer.batch);
+        read(db_writer, "flush_ms", cfg.db_writer.flush_ms);
+        read(db_writer, "journal_path", cfg.db_writer.journal_path);
+        read(db_writer, "journal_max_mb", cfg.db_writer.journal_max_mb);
+        read(db_writer, "max_attempts", cfg.db_writer.max_attempts);
+
+        auto file_writer = pipeline["file_writer"];
+        read(file_writer, "enabled", cfg.file_writer.enabled);
+        read(file_writer, "queue_mb", cfg.file_writer.queue_mb);
+
+        auto live = pipeline["live"];
+        read(live, "enabled", cfg.live.enabled);
+        read(live, "quality", cfg.live.quality);
+        read(live, "max_fps", cfg.live.max_fps);
+        read(live, "max_backlog_kb", cfg.live.max_backlog_kb);
+
+        auto replay = pipeline["replay"];
+        read(replay, "file", cfg.replay.file);
+        read(replay, "cameras", cfg.replay.cameras);
+        read(replay, "realtime", cfg.replay.realtime);
+        read(replay, "loop", cfg.replay.loop);
+        read(replay, "duration_seconds", cfg.replay.duration_seconds);
+        read(replay, "motion_interval_seconds", cfg.replay.motion_interval_seconds);
+        read(replay, "motion_seconds", cfg.replay.motion_seconds);
+        read(replay, "database", cfg.replay.database);
+        read(replay, "report_path", cfg.replay.report_path);
+
+        auto tiling = pipeline["tiling"];
+        readTiling(tiling, cfg.tiling);
+        if (tiling) {
+            for (const auto& cam : tiling["cameras"]) {
+                auto& cam_cfg = cfg.camera_tiling[cam.first.as<std::string>()] = cfg.tiling;
+                readTiling(cam.second, cam_cfg);
+            }
+        }
+    } catch (const YAML::Exception& e) {
+        spdlog::warn("PipelineConfig: failed to parse '{}': {} (using defaults)",
+                     config_path, e.what());
+        return PipelineConfig{};
+    }
+
+    cfg.scheduler.max_batch_size = std::max(1, cfg.scheduler.max_batch_size);
+    cfg.scheduler.max_wait_ms = std::max(0, cfg.scheduler.max_wait_ms);
+    cfg.scheduler.pipeline_depth = std::clamp(cfg.scheduler.pipeline_depth, 1, 8);
+    cfg.engine.idle_ttl_seconds = std::max(0, cfg.engine.idle_ttl_seconds);
+    for (auto& session : cfg.engine.sessions) {
+        session.device = std::max(-1, session.device);
+        session.threads = std::max(1, session.threads);
+    }
+    cfg.decode.threads = std::max(1, cfg.decode.threads);
+    cfg.sampling.burst_interval_ms = std::max(0, cfg.sampling.burst_interval_ms);
+    cfg.sampling.idle_interval_ms = std::max(cfg.sampling.burst_interval_ms, cfg.sampling.idle_interval_ms);
+    cfg.sampling.burst_hold_ms = std::max(0, cfg.sampling.burst_hold_ms);
+    cfg.sampling.cell_threshold = std::clamp(cfg.sampling.cell_threshold, 1, 255);
+    cfg.sampling.min_changed = std::clamp(cfg.sampling.min_changed, 0.0, 1.0);
+    cfg.snapshots.thumbnail_width = std::clamp(cfg.snapshots.thumbnail_width, 16, 3840);
+    cfg.snapshots.thumbnail_quality = std::clamp(cfg.snapshots.thumbnail_quality, 1, 100);
+    cfg.vision.event_width = std::max(0, cfg.vision.event_width);
+    cfg.vision.periodic_width = std::max(0, cfg.vision.periodic_width);
+    cfg.embedding.batch_window_ms = std::clamp(cfg.embedding.batch_window_ms, 0, 1000);
+    cfg.embedding.max_batch = std::clamp(cfg.embedding.max_batch, 1, 256);
+    cfg.embedding.cache_entries = std::max(0, cfg.embedding.cache_entries);
+    cfg.events.mqtt_queue = std::max(1, cfg.events.mqtt_queue);
+    cfg.tracking.detect_interval = std::clamp(cfg.tracking.detect_interval, 1, 100);
+    cfg.tracking.iou_threshold = std::clamp(cfg.tracking.iou_threshold, 0.01f, 1.0f);
+    cfg.tracking.min_hits = std::clamp(cfg.tracking.min_hits, 1, 100);
+    cfg.tracking.max_age_ms = std::max(0, cfg.tracking.max_age_ms);
+    cfg.tracking.stationary_speed = std::max(0.0f, cfg.tracking.stationary_speed);
+    cfg.tracking.stationary_recheck_ms = std::max(0, cfg.tracking.stationary_recheck_ms);
+    cfg.db_writer.queue = std::max(1, cfg.db_writer.queue);
+    cfg.db_writer.batch = std::clamp(cfg.db_writer.batch, 1, 1024);
+    cfg.db_writer.flush_ms = std::clamp(cfg.db_writer.flush_ms, 0, 10000);
+    cfg.db_writer.journal_max_mb = std::max(0, cfg.db_writer.journal_max_mb);
+    cfg.db_writer.max_attempts = std::max(1, cfg.db_writer.max_attempts);
+    cfg.file_writer.queue_mb = std::clamp(cfg.file_writer.queue_mb, 1, 4096);
+    cfg.live.quality = std::clamp(cfg.live.quality, 1, 100);
+    cfg.live.max_fps = std::clamp(cfg.live.max_fps, 0, 120);
+    cfg.live.max_backlog_kb = std::clamp(cfg.live.max_backlog_kb, 64, 65536);
+    cfg.replay.cameras = std::clamp(cfg.replay.cameras, 1, 256);
+    cfg.replay.duration_seconds = std::max(0, cfg.replay.duration_seconds);
+    cfg.replay.motion_interval_seconds = std::max(0, cfg.replay.motion_interval_seconds);
+    cfg.replay.motion_seconds = std::max(1, cfg.replay.motion_seconds);
+    return cfg;
+}
+
+}  // namespace hms
@@ -0,0 +1,104 @@
+#include "pixel_arena.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hms {
+
+namespace {
+
+constexpr size_t kPageBytes = 4096;
+constexpr size_t kHugePageBytes = 2 * 1024 * 1024;
+constexpr int kMpolPreferred = 1;  // <numaif.h>, without linking libnuma
+
+size_t roundUp(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+}  // namespace
+
+PixelArena::PixelArena(size_t slots, Options options)
+    : slots_(slots)
+    , options_(options) {}
+
+PixelArena::~PixelArena() {
+    if (base_) munmap(base_, length_);
+}
+
+uint8_t* PixelArena::slot(size_t index, size_t bytes) {
+    if (index >= slots_ || bytes == 0) return nullptr;
+
+    size_t slot_bytes = slot_bytes_.load(std::memory_order_acquire);
+    if (slot_bytes == 0) {
+        std::lock_guard lock(mutex_);
+        slot_bytes = slot_bytes_.load(std::memory_order_relaxed);
+        if (slot_bytes == 0 && !map_failed_ && mapLocked(roundUp(bytes, kPageBytes))) {
+            slot_bytes = slot_bytes_.load(std::memory_order_relaxed);
+        }
+    }
+    if (slot_bytes == 0 || bytes > slot_bytes) {
+        heap_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return base_ + index * slot_bytes;
+}
+
+bool PixelArena::mapLocked(size_t slot_bytes) {
+    size_t length = roundUp(slot_bytes * slots_, kHugePageBytes);
+    void* mem = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (options_.huge_pages) {
+        mem = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugetlb_ = mem != MAP_FAILED;
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        // No reserved huge pages (the usual case): regular pages, THP if enabled
+        mem = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            spdlog::warn("PixelArena: mmap of {} MB failed, frames use the heap", length >> 20);
+            map_failed_ = true;
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        thp_ = options_.huge_pages && madvise(mem, length, MADV_HUGEPAGE) == 0;
+#endif
+    }
+
+#ifdef SYS_mbind
+    if (options_.numa_node >= 0 && options_.numa_node < 64) {
+        unsigned long mask = 1UL << options_.numa_node;
+        if (syscall(SYS_mbind, mem, length, kMpolPreferred, &mask, sizeof(mask) * 8, 0) == 0) {
+            bound_node_ = options_.numa_node;
+        } else {
+            spdlog::warn("PixelArena: could not bind to NUMA node {}", options_.numa_node);
+        }
+    }
+#endif
+
+    base_ = static_cast<uint8_t*>(mem);
+    length_ = length;
+    slot_bytes_.store(slot_bytes, std::memory_order_release);
+    spdlog::info("PixelArena: {} x {} KB slots in {} MB ({})", slots_, slot_bytes >> 10,
+                 length >> 20, hugetlb_ ? "hugetlb" : thp_ ? "thp" : "4k pages");
+    return true;
+}
+
+PixelArena::Stats PixelArena::stats() const {
+    std::lock_guard lock(mutex_);
+    return Stats{
+        .reserved_bytes = length_,
+        .slot_bytes = slot_bytes_.load(),
+        .hugetlb = hugetlb_,
+        .thp = thp_,
+        .numa_node = bound_node_,
+        .heap_fallbacks = heap_fallbacks_.load(),
+    };
+}
+
+}  // namespace hms
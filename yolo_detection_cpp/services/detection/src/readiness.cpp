@@ -0,0 +1,65 @@
+#include "readiness.h"
+
+#include <algorithm>
+
+namespace hms {
+
+namespace {
+
+double msSince(SteadyClock::time_point start, SteadyClock::time_point now) {
+    return std::chrono::duration<double, std::milli>(now - start).count();
+}
+
+}  // namespace
+
+void Readiness::add(const std::string& name, bool required) {
+    std::lock_guard lock(mutex_);
+    auto it = std::find_if(tracked_.begin(), tracked_.end(),
+                           [&](const Tracked& t) { return t.entry.name == name; });
+    if (it == tracked_.end()) it = tracked_.insert(tracked_.end(), Tracked{});
+    it->entry = Entry{.name = name, .required = required};
+    it->started = SteadyClock::now();
+}
+
+void Readiness::set(const std::string& name, State state, std::string detail) {
+    std::lock_guard lock(mutex_);
+    for (auto& t : tracked_) {
+        if (t.entry.name != name) continue;
+        t.entry.state = state;
+        t.entry.detail = std::move(detail);
+        t.entry.ms = msSince(t.started, SteadyClock::now());
+        return;
+    }
+}
+
+std::vector<Readiness::Entry> Readiness::entries() const {
+    std::lock_guard lock(mutex_);
+    auto now = SteadyClock::now();
+    std::vector<Entry> out;
+    out.reserve(tracked_.size());
+    for (const auto& t : tracked_) {
+        out.push_back(t.entry);
+        if (t.entry.state == State::Pending) out.back().ms = msSince(t.started, now);
+    }
+    return out;
+}
+
+bool Readiness::ready() const {
+    std::lock_guard lock(mutex_);
+    return std::none_of(tracked_.begin(), tracked_.end(), [](const Tracked& t) {
+        return t.entry.state == State::Pending
+            || (t.entry.required && t.entry.state == State::Failed);
+    });
+}
+
+const char* Readiness::name(State state) {
+    switch (state) {
+        case State::Pending:  return "pending";
+        case State::Ready:    return "ready";
+        case State::Failed:   return "failed";
+        case State::Disabled: return "disabled";
+    }
+    return "unknown";
+}
+
+}  // namespace hms
@@ -0,0 +1,288 @@
+#include "replay_driver.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+namespace hms {
+
+using json = nlohmann::json;
+
+namespace {
+
+/// `stage` merged over every camera's histogram
+Metrics::Histogram::Snapshot merged(Metrics::Stage stage, const std::vector<std::string>& cameras) {
+    Metrics::Histogram::Snapshot total;
+    for (const auto& id : cameras) total.merge(Metrics::histogram(stage, id).snapshot());
+    return total;
+}
+
+Metrics::Histogram::Snapshot global(Metrics::Stage stage) {
+    return Metrics::histogram(stage).snapshot();
+}
+
+double round2(double x) { return std::round(x * 100) / 100; }
+
+}  // namespace
+
+ReplayDriver::ReplayDriver(ReplayConfig config,
+                           std::shared_ptr<BufferService> buffer_service,
+                           std::shared_ptr<EventManager> event_manager)
+    : config_(std::move(config))
+    , buffer_service_(std::move(buffer_service))
+    , event_manager_(std::move(event_manager))
+    , camera_ids_(buffer_service_->cameraIds())
+{
+}
+
+ReplayDriver::~ReplayDriver() {
+    stop();
+}
+
+void ReplayDriver::addCameras(AppConfig& config, const ReplayConfig& replay) {
+    CameraConfig base;
+    for (const auto& [id, cam] : config.cameras) {
+        if (cam.enabled) {
+            base = cam;
+            break;
+        }
+    }
+    base.enabled = true;
+    base.rtsp_url = replay.file;
+
+    config.cameras.clear();
+    for (int i = 1; i <= replay.cameras; ++i) {
+        auto id = "replay_" + std::to_string(i);
+        auto& cam = config.cameras[id] = base;
+        cam.name = "Replay " + std::to_string(i);
+    }
+}
+
+bool ReplayDriver::motionActive(const ReplayConfig& replay, int index, int cameras,
+                                std::chrono::milliseconds elapsed) {
+    if (replay.motion_interval_seconds <= 0 || cameras <= 0) return false;
+    const int64_t interval = replay.motion_interval_seconds * int64_t{1000};
+    const int64_t offset = interval * index / cameras;
+    const int64_t t = elapsed.count() - offset;
+    return t >= 0 && t % interval < replay.motion_seconds * int64_t{1000};
+}
+
+json ReplayDriver::summarize(const Metrics::Histogram::Snapshot& snapshot) {
+    return {
+        {"count", snapshot.count},
+        {"mean_ms", round2(snapshot.meanSeconds() * 1000)},
+        {"p50_ms", round2(snapshot.quantileSeconds(0.50) * 1000)},
+        {"p95_ms", round2(snapshot.quantileSeconds(0.95) * 1000)},
+        {"p99_ms", round2(snapshot.quantileSeconds(0.99) * 1000)},
+    };
+}
+
+void ReplayDriver::start(std::function<void()> on_finished) {
+    if (thread_.joinable()) return;
+    Metrics::enable();  // timing normally waits for the first /metrics scrape
+
+    for (const auto& cam : buffer_service_->getAllStats()) frames_at_start_ += cam.frames_captured;
+    if (auto scheduler = buffer_service_->getInferenceScheduler()) {
+        requests_at_start_ = scheduler->stats().requests;
+    }
+    started_at_ = SteadyClock::now();
+
+    spdlog::info("ReplayDriver: {} camera(s) on {}, {}, motion every {}s for {}s, {}",
+                 camera_ids_.size(), config_.file, config_.realtime ? "real time" : "max speed",
+                 config_.motion_interval_seconds, config_.motion_seconds,
+                 config_.duration_seconds > 0 ? std::to_string(config_.duration_seconds) + "s"
+                                              : std::string("until stopped"));
+    thread_ = std::thread(&ReplayDriver::run, this, std::move(on_finished));
+}
+
+void ReplayDriver::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    if (stopped_at_ == SteadyClock::time_point{}) stopped_at_ = SteadyClock::now();
+}
+
+void ReplayDriver::run(std::function<void()> on_finished) {
+    const auto deadline = config_.duration_seconds > 0
+        ? started_at_ + std::chrono::seconds(config_.duration_seconds)
+        : SteadyClock::time_point::max();
+    const int cameras = static_cast<int>(camera_ids_.size());
+    std::vector<bool> active(camera_ids_.size(), false);
+
+    auto setMotion = [&](size_t i, bool on) {
+        if (active[i] == on) return;
+        active[i] = on;
+        if (event_manager_) event_manager_->onLocalMotion(camera_ids_[i], on);
+    };
+
+    bool finished = false;
+    for (;;) {
+        auto now = SteadyClock::now();
+        if (now >= deadline) {
+            finished = true;
+            break;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - started_at_);
+        for (int i = 0; i < cameras; ++i) {
+            setMotion(i, motionActive(config_, i, cameras, elapsed));
+        }
+
+        std::unique_lock lock(mutex_);
+        if (cv_.wait_until(lock, std::min(now + std::chrono::milliseconds(100), deadline),
+                           [this] { return stopping_; })) {
+            break;
+        }
+    }
+    for (int i = 0; i < cameras; ++i) setMotion(i, false);
+
+    if (finished) {
+        stopped_at_ = SteadyClock::now();
+        spdlog::info("ReplayDriver: {}s elapsed, finishing", config_.duration_seconds);
+        if (on_finished) on_finished();
+    }
+}
+
+json ReplayDriver::report() const {
+    auto end = stopped_at_ != SteadyClock::time_point{} ? stopped_at_ : SteadyClock::now();
+    double elapsed = std::max(1e-3, std::chrono::duration<double>(end - started_at_).count());
+    const auto cameras = static_cast<double>(std::max<size_t>(1, camera_ids_.size()));
+
+    // --- Capture ---
+    uint64_t frames = 0, loops = 0, dropped = 0;
+    json per_camera = json::object();
+    for (const auto& cam : buffer_service_->getAllStats()) {
+        frames += cam.frames_captured;
+        loops += cam.replay_loops;
+        auto cam_dropped = Metrics::counter(Metrics::CounterId::FramesDropped, cam.camera_id).value();
+        dropped += cam_dropped;
+        per_camera[cam.camera_id] = {
+            {"frames", cam.frames_captured},
+            {"frames_converted", cam.frames_converted},
+            {"frames_dropped", cam_dropped},
+            {"pool_peak_in_use", cam.pool.peak_in_use},
+            {"resolution", std::to_string(cam.frame_width) + "x" + std::to_string(cam.frame_height)},
+        };
+    }
+    frames = frames >= frames_at_start_ ? frames - frames_at_start_ : frames;
+    double fps = frames / elapsed;
+
+    json report = {
+        {"replay", {
+            {"file", config_.file},
+            {"cameras", camera_ids_.size()},
+            {"realtime", config_.realtime},
+            {"elapsed_seconds", round2(elapsed)},
+        }},
+        {"capture", {
+            {"frames", frames},
+            {"fps", round2(fps)},
+            {"fps_per_camera", round2(fps / cameras)},
+            {"frames_dropped", dropped},
+            {"replay_loops", loops},
+            {"decode", summarize(merged(Metrics::Stage::Decode, camera_ids_))},
+            {"convert", summarize(merged(Metrics::Stage::Convert, camera_ids_))},
+            {"buffer_push", summarize(merged(Metrics::Stage::BufferPush, camera_ids_))},
+            {"cameras", per_camera},
+        }},
+    };
+
+    // --- Detection ---
+    json detection = {
+        {"preprocess", summarize(global(Metrics::Stage::Preprocess))},
+        {"inference", summarize(global(Metrics::Stage::Inference))},
+        {"postprocess", summarize(global(Metrics::Stage::Postprocess))},
+        {"nms", summarize(global(Metrics::Stage::Nms))},
+    };
+    if (auto scheduler = buffer_service_->getInferenceScheduler()) {
+        auto s = scheduler->stats();
+        uint64_t requests = s.requests >= requests_at_start_ ? s.requests - requests_at_start_ : s.requests;
+        detection["frames"] = requests;
+        detection["fps"] = round2(requests / elapsed);
+        detection["batches"] = s.batches;
+        detection["avg_batch_size"] = round2(s.avg_batch_size);
+    }
+    uint64_t worker_frames = 0;
+    for (const auto& [id, w] : buffer_service_->getDetectionStats()) worker_frames += w.frames_processed;
+    detection["continuous_frames"] = worker_frames;
+    report["detection"] = std::move(detection);
+
+    // --- Events and recording ---
+    uint64_t events = 0;
+    for (const auto& id : camera_ids_) events += Metrics::counter(Metrics::CounterId::Events, id).value();
+    json stages = json::array();
+    if (event_manager_) {
+        for (const auto& st : event_manager_->executorStats()) {
+            stages.push_back({
+                {"name", st.name},
+                {"completed", st.completed},
+                {"rejected", st.rejected},
+                {"avg_wait_ms", round2(st.avg_wait_ms)},
+                {"max_wait_ms", round2(st.max_wait_ms)},
+                {"avg_run_ms", round2(st.avg_run_ms)},
+                {"max_run_ms", round2(st.max_run_ms)},
+            });
+        }
+    }
+    report["events"] = {
+        {"started", events},
+        {"motion_to_detection", summarize(merged(Metrics::Stage::MotionToDetection, camera_ids_))},
+        {"record_write", summarize(merged(Metrics::Stage::RecordWrite, camera_ids_))},
+        {"jpeg_encode", summarize(global(Metrics::Stage::JpegEncode))},
+        {"vision", summarize(merged(Metrics::Stage::Vision, camera_ids_))},
+        {"stages", std::move(stages)},
+    };
+
+    // --- Publish ---
+    if (event_manager_) {
+        auto p = event_manager_->publisherStats();
+        report["publish"] = {
+            {"published", p.published},
+            {"coalesced", p.coalesced},
+            {"dropped", p.dropped},
+            {"failures", p.failures},
+            {"avg_latency_ms", round2(p.avg_latency_ms)},
+            {"max_latency_ms", round2(p.max_latency_ms)},
+        };
+    }
+    report["database"] = {{"write", summarize(global(Metrics::Stage::DbWrite))}};
+    return report;
+}
+
+bool ReplayDriver::writeReport() const {
+    auto r = report();
+    const auto& capture = r["capture"];
+    const auto& detection = r["detection"];
+    const auto& events = r["events"];
+    spdlog::info("Replay: {} camera(s) for {}s", r["replay"]["cameras"].get<size_t>(),
+                 r["replay"]["elapsed_seconds"].get<double>());
+    spdlog::info("Replay capture: {} fps ({} per camera), decode p95 {} ms, {} frames dropped",
+                 capture["fps"].get<double>(), capture["fps_per_camera"].get<double>(),
+                 capture["decode"]["p95_ms"].get<double>(), capture["frames_dropped"].get<uint64_t>());
+    spdlog::info("Replay detection: {} fps, inference p95 {} ms",
+                 detection.value("fps", 0.0), detection["inference"]["p95_ms"].get<double>());
+    spdlog::info("Replay events: {} started, motion→detection p95 {} ms, record write p95 {} ms",
+                 events["started"].get<uint64_t>(), events["motion_to_detection"]["p95_ms"].get<double>(),
+                 events["record_write"]["p95_ms"].get<double>());
+    if (r.contains("publish")) {
+        spdlog::info("Replay publish: {} messages, avg latency {} ms",
+                     r["publish"]["published"].get<uint64_t>(), r["publish"]["avg_latency_ms"].get<double>());
+    }
+
+    if (config_.report_path.empty()) return true;
+    std::ofstream out(config_.report_path);
+    out << r.dump(2) << "\n";
+    if (!out) {
+        spdlog::error("ReplayDriver: failed to write report to {}", config_.report_path);
+        return false;
+    }
+    spdlog::info("ReplayDriver: report written to {}", config_.report_path);
+    return true;
+}
+
+}  // namespace hms
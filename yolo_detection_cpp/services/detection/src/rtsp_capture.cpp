@@ -2,23 +2,187 @@
 
 #include <spdlog/spdlog.h>
 #include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 }
 
 namespace hms {
 
+/// YUV → BGR24 conversion, shared by every frame of one camera. Called from
+/// consumer threads, so the sws context is guarded.
+class BgrConverter {
+public:
+    explicit BgrConverter(Metrics::Histogram& metric) : metric_(metric) {}
+
+    ~BgrConverter() {
+        if (ctx_) sws_freeContext(ctx_);
+    }
+
+    bool convert(const AVFrame* src, uint8_t* dst, int stride) {
+        std::lock_guard lock(mutex_);
+        if (!ctx_ || src->width != width_ || src->height != height_ || src->format != format_) {
+            ctx_ = sws_getCachedContext(
+                ctx_, src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                src->width, src->height, AV_PIX_FMT_BGR24,
+                SWS_BILINEAR, nullptr, nullptr, nullptr);
+            if (!ctx_) return false;
+            width_ = src->width;
+            height_ = src->height;
+            format_ = src->format;
+        }
+        uint8_t* dst_data[1] = {dst};
+        int dst_linesize[1] = {stride};
+        Metrics::Timer timer(metric_);
+        sws_scale(ctx_, src->data, src->linesize, 0, src->height, dst_data, dst_linesize);
+        ++conversions_;
+        return true;
+    }
+
+    uint64_t conversions() const { return conversions_.load(); }
+
+private:
+    Metrics::Histogram& metric_;
+    std::mutex mutex_;
+    SwsContext* ctx_ = nullptr;
+    int width_ = 0;
+    int height_ = 0;
+    int format_ = -1;
+    std::atomic<uint64_t> conversions_{0};
+};
+
+namespace {
+
+/// A pooled frame's reference to a decoded AVFrame (no pixel copy).
+/// Hardware frames are the exception: the decoder has only a handful of
+/// device surfaces, so they are downloaded (still NV12, no colour
+/// conversion) into a host buffer the pooled frame keeps for reuse.
+class AvNativeFrame final : public NativeFrame {
+public:
+    explicit AvNativeFrame(std::shared_ptr<BgrConverter> converter)
+        : frame_(av_frame_alloc())
+        , converter_(std::move(converter)) {}
+
+    ~AvNativeFrame() override {
+        av_frame_free(&frame_);
+    }
+
+    bool assign(const AVFrame* src) {
+        if (!frame_) return false;
+        if (src->hw_frames_ctx) {
+            bool reusable = owned_ && frame_->buf[0] && av_frame_is_writable(frame_)
+                            && frame_->width == src->width && frame_->height == src->height;
+            if (!reusable) av_frame_unref(frame_);
+            owned_ = true;
+            return av_hwframe_transfer_data(frame_, src, 0) >= 0;
+        }
+        av_frame_unref(frame_);
+        owned_ = false;
+        return av_frame_ref(frame_, src) >= 0;
+    }
+
+    bool toBgr(uint8_t* dst, int stride) override {
+        if (!frame_ || !frame_->data[0]) return false;
+        return converter_->convert(frame_, dst, stride);
+    }
+
+    const uint8_t* luma(int& stride) override {
+        if (!frame_ || !frame_->data[0]) return nullptr;
+        switch (frame_->format) {
+            case AV_PIX_FMT_YUV420P:
+            case AV_PIX_FMT_YUVJ420P:
+            case AV_PIX_FMT_YUV422P:
+            case AV_PIX_FMT_YUVJ422P:
+            case AV_PIX_FMT_YUV444P:
+            case AV_PIX_FMT_YUVJ444P:
+            case AV_PIX_FMT_NV12:
+            case AV_PIX_FMT_NV21:
+            case AV_PIX_FMT_GRAY8:
+                stride = frame_->linesize[0];
+                return frame_->data[0];
+            default:
+                return nullptr;
+        }
+    }
+
+    bool yuv420(YuvPlanes& planes) override {
+        if (!frame_ || !frame_->data[0]) return false;
+        switch (frame_->format) {
+            case AV_PIX_FMT_YUV420P:
+            case AV_PIX_FMT_YUVJ420P:
+                planes.layout = YuvPlanes::Layout::I420;
+                break;
+            case AV_PIX_FMT_NV12:  // hardware downloads
+                planes.layout = YuvPlanes::Layout::Nv12;
+                break;
+            default:
+                return false;
+        }
+        for (int i = 0; i < 3; ++i) {
+            planes.data[i] = frame_->data[i];
+            planes.stride[i] = frame_->linesize[i];
+        }
+        planes.full_range = frame_->format == AV_PIX_FMT_YUVJ420P;
+        return true;
+    }
+
+    void release() override {
+        // A downloaded copy is our own memory, not a decoder buffer: keep it for reuse
+        if (frame_ && !owned_) av_frame_unref(frame_);
+    }
+
+private:
+    AVFrame* frame_;
+    bool owned_ = false;  // frame_ holds a host download of a hw frame
+    std::shared_ptr<BgrConverter> converter_;
+};
+
+/// One device context per (type, device) for the whole process: a CUDA
+/// context per camera would cost hundreds of MB of VRAM each.
+AVBufferRef* sharedHwDevice(AVHWDeviceType type, const std::string& device) {
+    static std::mutex mutex;
+    static std::map<std::pair<int, std::string>, AVBufferRef*> devices;  // process lifetime
+    std::lock_guard lock(mutex);
+
+    auto key = std::make_pair(static_cast<int>(type), device);
+    auto it = devices.find(key);
+    if (it == devices.end()) {
+        AVBufferRef* ctx = nullptr;
+        if (av_hwdevice_ctx_create(&ctx, type, device.empty() ? nullptr : device.c_str(),
+                                   nullptr, 0) < 0) {
+            return nullptr;
+        }
+        it = devices.emplace(key, ctx).first;
+    }
+    return av_buffer_ref(it->second);
+}
+
+}  // namespace
+
 RtspCapture::RtspCapture(std::string camera_id, std::string rtsp_url,
                          std::shared_ptr<FramePool> frame_pool,
-                         FrameCallback on_frame)
+                         FrameCallback on_frame,
+                         std::shared_ptr<PacketRing> packet_ring,
+                         DecodeOptions decode,
+                         ReplayOptions replay)
     : camera_id_(std::move(camera_id))
     , rtsp_url_(std::move(rtsp_url))
     , frame_pool_(std::move(frame_pool))
-    , on_frame_(std::move(on_frame)) {}
+    , on_frame_(std::move(on_frame))
+    , packet_ring_(std::move(packet_ring))
+    , decode_(std::move(decode))
+    , replay_(replay)
+    , converter_(std::make_shared<BgrConverter>(Metrics::histogram(Metrics::Stage::Convert, camera_id_)))
+    , decode_metric_(Metrics::histogram(Metrics::Stage::Decode, camera_id_))
+    , push_metric_(Metrics::histogram(Metrics::Stage::BufferPush, camera_id_))
+    , dropped_metric_(Metrics::counter(Metrics::CounterId::FramesDropped, camera_id_)) {}
 
 RtspCapture::~RtspCapture() {
     stop();
@@ -42,22 +206,28 @@ void RtspCapture::stop() {
 RtspCapture::Stats RtspCapture::stats() const {
     return Stats{
         .frames_captured = frames_captured_.load(),
+        .frames_converted = converter_->conversions(),
         .reconnect_count = reconnect_count_.load(),
         .consecutive_failures = consecutive_failures_.load(),
         .is_connected = is_connected_.load(),
         .last_frame_time = last_frame_time_.load(),
         .frame_width = frame_width_.load(),
         .frame_height = frame_height_.load(),
+        .hw_decode = hw_active_.load(),
+        .hw_fallbacks = hw_fallbacks_.load(),
+        .replay_loops = replay_loops_.load(),
     };
 }
 
 bool RtspCapture::openStream() {
     // RTSP options: TCP transport, 5s timeout, no buffering
     AVDictionary* opts = nullptr;
-    av_dict_set(&opts, "rtsp_transport", "tcp", 0);
-    av_dict_set(&opts, "stimeout", "5000000", 0);    // 5s connection timeout (microseconds)
-    av_dict_set(&opts, "fflags", "nobuffer", 0);
-    av_dict_set(&opts, "flags", "low_delay", 0);
+    if (!replay_.enabled) {
+        av_dict_set(&opts, "rtsp_transport", "tcp", 0);
+        av_dict_set(&opts, "stimeout", "5000000", 0);    // 5s connection timeout (microseconds)
+        av_dict_set(&opts, "fflags", "nobuffer", 0);
+        av_dict_set(&opts, "flags", "low_delay", 0);
+    }
 
     fmt_ctx_ = avformat_alloc_context();
     // Set a shorter interrupt timeout for av_read_frame
@@ -87,7 +257,8 @@ bool RtspCapture::openStream() {
     if (ret < 0) {
         char errbuf[256];
         av_strerror(ret, errbuf, sizeof(errbuf));
-        spdlog::error("[{}] Failed to open RTSP stream: {}", camera_id_, errbuf);
+        spdlog::error("[{}] Failed to open {}: {}", camera_id_,
+                      replay_.enabled ? rtsp_url_ : "RTSP stream", errbuf);
         closeStream();
         return false;
     }
@@ -114,6 +285,19 @@ bool RtspCapture::openStream() {
     }
 
     auto* codecpar = fmt_ctx_->streams[video_stream_idx_]->codecpar;
+    if (decode_.packets_only) {
+        packet_ = av_packet_alloc();
+        last_activity_time_ = SteadyClock::now();
+        spdlog::info("[{}] Connected: {}x{} ({}, packets only)", camera_id_,
+                     codecpar->width, codecpar->height, avcodec_get_name(codecpar->codec_id));
+        frame_width_ = codecpar->width;
+        frame_height_ = codecpar->height;
+        if (packet_ring_) {
+            packet_ring_->setStream(codecpar, fmt_ctx_->streams[video_stream_idx_]->time_base);
+        }
+        return true;
+    }
+
     const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
     if (!codec) {
         spdlog::error("[{}] Decoder not found for codec {}", camera_id_,
@@ -122,12 +306,7 @@ bool RtspCapture::openStream() {
         return false;
     }
 
-    codec_ctx_ = avcodec_alloc_context3(codec);
-    avcodec_parameters_to_context(codec_ctx_, codecpar);
-    codec_ctx_->thread_count = 1;  // Single thread per camera decoder
-
-    ret = avcodec_open2(codec_ctx_, codec, nullptr);
-    if (ret < 0) {
+    if (!openDecoder(codec, codecpar)) {
         spdlog::error("[{}] Failed to open codec", camera_id_);
         closeStream();
         return false;
@@ -135,35 +314,156 @@ bool RtspCapture::openStream() {
 
     // Allocate frames and packet
     av_frame_ = av_frame_alloc();
-    bgr_frame_ = av_frame_alloc();
     packet_ = av_packet_alloc();
 
     // Mark activity so stale-stream timeout starts from now
     last_activity_time_ = SteadyClock::now();
 
-    spdlog::info("[{}] Connected: {}x{} ({})", camera_id_,
-                 codec_ctx_->width, codec_ctx_->height,
-                 avcodec_get_name(codecpar->codec_id));
+    if (replay_loops_ == 0) {  // replay reopens the file every pass: log the first
+        spdlog::info("[{}] Connected: {}x{} ({})", camera_id_,
+                     codec_ctx_->width, codec_ctx_->height,
+                     avcodec_get_name(codecpar->codec_id));
+    }
 
     frame_width_ = codec_ctx_->width;
     frame_height_ = codec_ctx_->height;
 
+    // Replay: each pass starts its clock at its first packet
+    replay_epoch_ = {};
+    replay_packets_ = 0;
+
+    // New connection, new SPS/PPS: packets from the old one can't be remuxed with these
+    if (packet_ring_) {
+        packet_ring_->setStream(codecpar, fmt_ctx_->streams[video_stream_idx_]->time_base);
+    }
+
     return true;
 }
 
-void RtspCapture::closeStream() {
-    if (sws_ctx_) {
-        sws_freeContext(sws_ctx_);
-        sws_ctx_ = nullptr;
+bool RtspCapture::openDecoder(const AVCodec* codec, const AVCodecParameters* codecpar) {
+    bool try_hw = !hw_disabled_ && decode_.hwaccel != "none";
+    for (bool hw : {true, false}) {
+        if (hw && !try_hw) continue;
+
+        codec_ctx_ = avcodec_alloc_context3(codec);
+        if (!codec_ctx_) return false;
+        avcodec_parameters_to_context(codec_ctx_, codecpar);
+
+        if (hw) {
+            if (!attachHwDevice(codec)) {
+                avcodec_free_context(&codec_ctx_);
+                fallBackToSoftware("no usable device");
+                continue;
+            }
+        } else {
+            codec_ctx_->thread_count = std::max(1, decode_.threads);
+        }
+
+        if (avcodec_open2(codec_ctx_, codec, nullptr) == 0) {
+            hw_active_ = hw;
+            hw_errors_ = 0;
+            return true;
+        }
+        avcodec_free_context(&codec_ctx_);
+        if (hw) fallBackToSoftware("decoder rejected the device");
+    }
+    return false;
+}
+
+bool RtspCapture::attachHwDevice(const AVCodec* codec) {
+    std::vector<std::string> names;
+    if (decode_.hwaccel == "auto") {
+        names = {"cuda", "vaapi", "qsv"};
+    } else {
+        names = {decode_.hwaccel};
+    }
+
+    for (const auto& name : names) {
+        auto type = av_hwdevice_find_type_by_name(name.c_str());
+        if (type == AV_HWDEVICE_TYPE_NONE) {
+            spdlog::warn("[{}] Unknown hwaccel '{}'", camera_id_, name);
+            continue;
+        }
+
+        // The decoder must support this device type directly
+        int pix_fmt = -1;
+        for (int i = 0;; ++i) {
+            const AVCodecHWConfig* hw = avcodec_get_hw_config(codec, i);
+            if (!hw) break;
+            if ((hw->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && hw->device_type == type) {
+                pix_fmt = hw->pix_fmt;
+                break;
+            }
+        }
+        if (pix_fmt < 0) continue;
+
+        AVBufferRef* device = sharedHwDevice(type, decode_.device);
+        if (!device) {
+            spdlog::warn("[{}] Failed to open {} device{}", camera_id_, name,
+                         decode_.device.empty() ? "" : " " + decode_.device);
+            continue;
+        }
+
+        codec_ctx_->hw_device_ctx = device;
+        hw_pix_fmt_ = pix_fmt;
+        codec_ctx_->opaque = this;
+        codec_ctx_->get_format = [](AVCodecContext* ctx, const AVPixelFormat* fmts) {
+            auto* self = static_cast<RtspCapture*>(ctx->opaque);
+            const AVPixelFormat* p = fmts;
+            for (; *p != AV_PIX_FMT_NONE; ++p) {
+                if (*p == self->hw_pix_fmt_) return *p;
+            }
+            // Stream the device can't handle (e.g. 4:2:2): the software format is listed last
+            spdlog::warn("[{}] Hardware decode unsupported for this stream, decoding in software",
+                         self->camera_id_);
+            self->hw_active_ = false;
+            return p == fmts ? AV_PIX_FMT_NONE : *(p - 1);
+        };
+        spdlog::info("[{}] Hardware decode: {}", camera_id_, name);
+        return true;
+    }
+    return false;
+}
+
+void RtspCapture::fallBackToSoftware(const char* reason) {
+    if (hw_disabled_) return;
+    hw_disabled_ = true;
+    hw_active_ = false;
+    ++hw_fallbacks_;
+    spdlog::warn("[{}] Hardware decode ({}) disabled: {}; using software decoder",
+                 camera_id_, decode_.hwaccel, reason);
+}
+
+void RtspCapture::paceReplay(const AVPacket* packet) {
+    // Decode order: dts, falling back to pts, then to the nominal frame rate
+    // (raw H.264 carries no timestamps)
+    const AVStream* stream = fmt_ctx_->streams[video_stream_idx_];
+    int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    std::chrono::nanoseconds offset;
+    if (ts != AV_NOPTS_VALUE) {
+        offset = std::chrono::nanoseconds(av_rescale_q(ts, stream->time_base, AVRational{1, 1000000000}));
+    } else {
+        AVRational rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : AVRational{25, 1};
+        offset = std::chrono::nanoseconds(av_rescale_q(static_cast<int64_t>(replay_packets_),
+                                                       av_inv_q(rate), AVRational{1, 1000000000}));
+    }
+    ++replay_packets_;
+
+    auto now = SteadyClock::now();
+    if (replay_epoch_ == SteadyClock::time_point{}) replay_epoch_ = now - offset;
+    auto due = replay_epoch_ + offset;
+    while (running_ && now < due) {
+        std::this_thread::sleep_for(std::min<SteadyClock::duration>(due - now, std::chrono::milliseconds(200)));
+        now = SteadyClock::now();
     }
+    last_activity_time_ = now;  // a long gap in the file is not a stalled stream
+}
+
+void RtspCapture::closeStream() {
     if (packet_) {
         av_packet_free(&packet_);
         packet_ = nullptr;
     }
-    if (bgr_frame_) {
-        av_frame_free(&bgr_frame_);
-        bgr_frame_ = nullptr;
-    }
     if (av_frame_) {
         av_frame_free(&av_frame_);
         av_frame_ = nullptr;
@@ -178,6 +478,7 @@ void RtspCapture::closeStream() {
     }
     video_stream_idx_ = -1;
     is_connected_ = false;
+    hw_active_ = false;
 }
 
 void RtspCapture::captureLoop() {
@@ -187,7 +488,12 @@ void RtspCapture::captureLoop() {
     while (running_) {
         // Connect if needed
         if (!fmt_ctx_) {
-            spdlog::info("[{}] Connecting to RTSP stream...", camera_id_);
+            if (!replay_.enabled) {
+                spdlog::info("[{}] Connecting to RTSP stream...", camera_id_);
+            } else if (replay_loops_ == 0) {
+                spdlog::info("[{}] Replaying {}{}", camera_id_, rtsp_url_,
+                             replay_.realtime ? "" : " (max speed)");
+            }
             if (openStream()) {
                 is_connected_ = true;
                 consecutive_failures_ = 0;
@@ -211,6 +517,14 @@ void RtspCapture::captureLoop() {
 
         // Read frame
         int ret = av_read_frame(fmt_ctx_, packet_);
+        if (ret < 0 && replay_.enabled && ret == AVERROR_EOF) {
+            ++replay_loops_;
+            closeStream();
+            if (replay_.loop) continue;  // reopened from the start on the next pass
+            spdlog::info("[{}] Replay of {} finished", camera_id_, rtsp_url_);
+            while (running_) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            break;
+        }
         if (ret < 0) {
             if (ret == AVERROR_EOF || ret == AVERROR(EAGAIN)) {
                 spdlog::warn("[{}] Stream ended or timeout, reconnecting...", camera_id_);
@@ -230,26 +544,47 @@ void RtspCapture::captureLoop() {
             continue;
         }
 
-        // Decode
+        if (replay_.enabled && replay_.realtime) paceReplay(packet_);
+
+        // Keep the compressed packet for passthrough recording (payload is refcounted)
+        if (packet_ring_) packet_ring_->push(packet_);
+
+        if (decode_.packets_only) {
+            av_packet_unref(packet_);
+            ++frames_captured_;
+            last_frame_time_ = SteadyClock::now();
+            last_activity_time_ = SteadyClock::now();
+            continue;
+        }
+
+        // Decode (timed per frame out, including the send of the packet that produced it)
+        auto decode_start = Metrics::start();
         ret = avcodec_send_packet(codec_ctx_, packet_);
         av_packet_unref(packet_);
-        if (ret < 0) continue;
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            // A wedged hw device shows up as a run of decode errors: reconnect in software
+            if (hw_active_ && ++hw_errors_ >= kMaxHwErrors) {
+                fallBackToSoftware("repeated decode errors");
+                closeStream();
+                ++reconnect_count_;
+            }
+            continue;
+        }
+
+        bool first_frame = true;
+        auto receiveFrame = [&] {
+            if (!first_frame) decode_start = Metrics::start();
+            first_frame = false;
+            bool ok = avcodec_receive_frame(codec_ctx_, av_frame_) == 0;
+            if (ok) Metrics::observe(decode_metric_, decode_start);
+            return ok;
+        };
 
-        while (avcodec_receive_frame(codec_ctx_, av_frame_) == 0) {
+        while (receiveFrame()) {
             int w = av_frame_->width;
             int h = av_frame_->height;
 
-            // Initialize or reinitialize sws if resolution changed
-            if (!sws_ctx_ || frame_width_ != w || frame_height_ != h) {
-                if (sws_ctx_) sws_freeContext(sws_ctx_);
-                sws_ctx_ = sws_getContext(
-                    w, h, static_cast<AVPixelFormat>(av_frame_->format),
-                    w, h, AV_PIX_FMT_BGR24,
-                    SWS_BILINEAR, nullptr, nullptr, nullptr);
-                if (!sws_ctx_) {
-                    spdlog::error("[{}] Failed to create sws context", camera_id_);
-                    continue;
-                }
+            if (frame_width_ != w || frame_height_ != h) {
                 frame_width_ = w;
                 frame_height_ = h;
                 spdlog::info("[{}] Resolution: {}x{}", camera_id_, w, h);
@@ -259,19 +594,26 @@ void RtspCapture::captureLoop() {
             auto frame = frame_pool_->acquire();
             if (!frame) {
                 spdlog::warn("[{}] Frame pool exhausted, dropping frame", camera_id_);
+                dropped_metric_.add();
                 continue;
             }
 
-            // Resize pixel buffer if needed (lazy allocation)
-            if (frame->width != w || frame->height != h) {
-                frame->resize(w, h);
+            // Keep a ref to the decoded picture; BGR conversion waits for a consumer
+            if (!frame->native()) {
+                frame->attachNative(std::make_unique<AvNativeFrame>(converter_));
             }
-
-            // Convert YUV → BGR24
-            uint8_t* dst_data[1] = {frame->pixels.data()};
-            int dst_linesize[1] = {frame->stride};
-            sws_scale(sws_ctx_, av_frame_->data, av_frame_->linesize,
-                      0, h, dst_data, dst_linesize);
+            if (!static_cast<AvNativeFrame*>(frame->native())->assign(av_frame_)) {
+                spdlog::warn("[{}] Failed to reference decoded frame, dropping", camera_id_);
+                if (hw_active_ && ++hw_errors_ >= kMaxHwErrors) {
+                    fallBackToSoftware("frame download failing");
+                    closeStream();
+                    ++reconnect_count_;
+                    break;
+                }
+                continue;
+            }
+            hw_errors_ = 0;
+            frame->markNative(w, h);
 
             frame->timestamp = SteadyClock::now();
             frame->frame_number = ++frame_counter;
@@ -281,6 +623,7 @@ void RtspCapture::captureLoop() {
             last_activity_time_ = SteadyClock::now();
 
             // Deliver to buffer
+            Metrics::Timer push(push_metric_);
             on_frame_(std::move(frame));
         }
     }
@@ -0,0 +1,63 @@
+#include "snapshot_cache.h"
+
+namespace hms {
+
+void SnapshotCache::get(const std::string& camera_id, uint64_t frame_number, Slot slot,
+                        const Producer& produce, Done done) {
+    std::unique_lock lock(mutex_);
+    auto& entry = entries_[camera_id];
+    if (entry.frame_number != frame_number) {
+        // Newer (or, after a reconnect, restarted) frame: productions still
+        // running for the old one deliver to their own waiters
+        entry = Entry{.frame_number = frame_number, .values = {}};
+    }
+
+    auto& value = entry.values[static_cast<size_t>(slot)];
+    if (value.bytes) {
+        stats_.hits++;
+        auto bytes = value.bytes;
+        lock.unlock();  // done may call back into the cache
+        done(std::move(bytes));
+        return;
+    }
+    if (value.pending) {
+        stats_.coalesced++;
+        value.pending->waiters.push_back(std::move(done));
+        return;
+    }
+
+    stats_.misses++;
+    auto pending = std::make_shared<Pending>();
+    pending->waiters.push_back(std::move(done));
+    value.pending = pending;
+    lock.unlock();
+
+    produce([this, camera_id, frame_number, slot, pending](Bytes bytes) {
+        complete(camera_id, frame_number, slot, pending, std::move(bytes));
+    });
+}
+
+void SnapshotCache::complete(const std::string& camera_id, uint64_t frame_number, Slot slot,
+                             const std::shared_ptr<Pending>& pending, Bytes bytes) {
+    std::vector<Done> waiters;
+    {
+        std::lock_guard lock(mutex_);
+        auto it = entries_.find(camera_id);
+        if (it != entries_.end() && it->second.frame_number == frame_number) {
+            auto& value = it->second.values[static_cast<size_t>(slot)];
+            if (value.pending == pending) {
+                value.pending.reset();
+                value.bytes = bytes;
+            }
+        }
+        waiters = std::move(pending->waiters);
+    }
+    for (auto& waiter : waiters) waiter(bytes);
+}
+
+SnapshotCache::Stats SnapshotCache::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+}  // namespace hms
@@ -1,4 +1,5 @@
 #include "snapshot_writer.h"
+#include "jpeg_encoder.h"
 
 #include <spdlog/spdlog.h>
 #include <filesystem>
@@ -6,17 +7,11 @@
 #include <chrono>
 #include <ctime>
 
-extern "C" {
-#include <libavcodec/avcodec.h>
-#include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
-}
-
 namespace fs = std::filesystem;
 
 namespace hms {
 
-void SnapshotWriter::drawBoundingBoxes(std::vector<uint8_t>& pixels,
+void SnapshotWriter::drawBoundingBoxes(uint8_t* pixels,
                                         int width, int height, int stride,
                                         const std::vector<Detection>& detections) {
     static const uint8_t colors[][3] = {
@@ -42,13 +37,13 @@ void SnapshotWriter::drawBoundingBoxes(std::vector<uint8_t>& pixels,
             int top_y = y1 + t, bot_y = y2 - t;
             if (top_y >= 0 && top_y < height) {
                 for (int x = x1; x <= x2; ++x) {
-                    uint8_t* px = pixels.data() + top_y * stride + x * 3;
+                    uint8_t* px = pixels + top_y * stride + x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
             if (bot_y >= 0 && bot_y < height && bot_y != top_y) {
                 for (int x = x1; x <= x2; ++x) {
-                    uint8_t* px = pixels.data() + bot_y * stride + x * 3;
+                    uint8_t* px = pixels + bot_y * stride + x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
@@ -58,13 +53,13 @@ void SnapshotWriter::drawBoundingBoxes(std::vector<uint8_t>& pixels,
             int left_x = x1 + t, right_x = x2 - t;
             if (left_x >= 0 && left_x < width) {
                 for (int y = y1; y <= y2; ++y) {
-                    uint8_t* px = pixels.data() + y * stride + left_x * 3;
+                    uint8_t* px = pixels + y * stride + left_x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
             if (right_x >= 0 && right_x < width && right_x != left_x) {
                 for (int y = y1; y <= y2; ++y) {
-                    uint8_t* px = pixels.data() + y * stride + right_x * 3;
+                    uint8_t* px = pixels + y * stride + right_x * 3;
                     px[0] = color[0]; px[1] = color[1]; px[2] = color[2];
                 }
             }
@@ -74,60 +69,19 @@ void SnapshotWriter::drawBoundingBoxes(std::vector<uint8_t>& pixels,
 
 std::string SnapshotWriter::encodeJpeg(const uint8_t* pixels,
                                         int width, int height, int stride) {
-    const AVCodec* mjpeg_codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
-    if (!mjpeg_codec) return {};
-
-    AVCodecContext* enc_ctx = avcodec_alloc_context3(mjpeg_codec);
-    enc_ctx->width = width;
-    enc_ctx->height = height;
-    enc_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
-    enc_ctx->time_base = {1, 25};
-    enc_ctx->flags |= AV_CODEC_FLAG_QSCALE;
-    enc_ctx->qmin = 2;
-    enc_ctx->qmax = 5;
-
-    if (avcodec_open2(enc_ctx, mjpeg_codec, nullptr) < 0) {
-        avcodec_free_context(&enc_ctx);
-        return {};
-    }
-
-    SwsContext* sws = sws_getContext(
-        width, height, AV_PIX_FMT_BGR24,
-        width, height, AV_PIX_FMT_YUVJ420P,
-        SWS_BILINEAR, nullptr, nullptr, nullptr);
-
-    AVFrame* yuv_frame = av_frame_alloc();
-    yuv_frame->format = AV_PIX_FMT_YUVJ420P;
-    yuv_frame->width = width;
-    yuv_frame->height = height;
-    av_frame_get_buffer(yuv_frame, 0);
-
-    const uint8_t* src_data[1] = {pixels};
-    int src_linesize[1] = {stride};
-    sws_scale(sws, src_data, src_linesize, 0, height,
-              yuv_frame->data, yuv_frame->linesize);
-
-    AVPacket* pkt = av_packet_alloc();
-    avcodec_send_frame(enc_ctx, yuv_frame);
-
-    std::string result;
-    if (avcodec_receive_packet(enc_ctx, pkt) == 0) {
-        result.assign(reinterpret_cast<const char*>(pkt->data), pkt->size);
-    }
-
-    av_packet_free(&pkt);
-    av_frame_free(&yuv_frame);
-    sws_freeContext(sws);
-    avcodec_free_context(&enc_ctx);
-
-    return result;
+    return JpegEncoder::encode(pixels, width, height, stride);
 }
 
-std::string SnapshotWriter::save(const FrameData& frame,
-                                  const std::vector<Detection>& detections,
-                                  const std::string& camera_id,
-                                  const std::string& output_dir) {
-    fs::create_directories(output_dir);
+SnapshotWriter::Encoded SnapshotWriter::encode(const FrameData& frame,
+                                                const std::vector<Detection>& detections,
+                                                const std::string& camera_id,
+                                                const std::string& output_dir,
+                                                int vision_width) {
+    Encoded snapshot;
+    if (!frame.ensureBgr()) {
+        spdlog::error("SnapshotWriter: no pixels for {}", camera_id);
+        return snapshot;
+    }
 
     // Generate timestamp for filename
     auto now = std::chrono::system_clock::now();
@@ -137,32 +91,66 @@ std::string SnapshotWriter::save(const FrameData& frame,
     char ts[32];
     strftime(ts, sizeof(ts), "%Y%m%d_%H%M%S", &tm_buf);
 
-    std::string file_path = output_dir + "/" + camera_id + "_" + ts + ".jpg";
+    snapshot.path = output_dir + "/" + camera_id + "_" + ts + ".jpg";
 
-    // Copy pixels and draw bounding boxes
-    auto pixels = frame.pixels;
+    // Boxes go on a copy (the frame is shared); without any, encode the frame as is
+    const uint8_t* src = frame.pixels.data();
+    PixelBuffer annotated;
     if (!detections.empty()) {
-        drawBoundingBoxes(pixels, frame.width, frame.height, frame.stride, detections);
+        annotated = frame.pixels;
+        drawBoundingBoxes(annotated.data(), frame.width, frame.height, frame.stride, detections);
+        src = annotated.data();
     }
 
-    // Encode to JPEG
-    auto jpeg = encodeJpeg(pixels.data(), frame.width, frame.height, frame.stride);
-    if (jpeg.empty()) {
+    // Encode to JPEG (and the vision rendition in the same pass)
+    JpegEncoder::Output outputs[2];
+    outputs[1].max_width = vision_width;
+    std::span<JpegEncoder::Output> wanted(outputs, vision_width > 0 && vision_width < frame.width ? 2 : 1);
+    JpegEncoder::encode(src, frame.width, frame.height, frame.stride, wanted);
+    if (outputs[0].jpeg.empty()) {
         spdlog::error("SnapshotWriter: JPEG encoding failed for {}", camera_id);
-        return {};
+        return snapshot;
     }
 
-    // Write to disk
-    std::ofstream ofs(file_path, std::ios::binary);
+    snapshot.jpeg = std::make_shared<const std::string>(std::move(outputs[0].jpeg));
+    snapshot.vision_jpeg = wanted.size() > 1 && !outputs[1].jpeg.empty()
+        ? std::make_shared<const std::string>(std::move(outputs[1].jpeg))
+        : snapshot.jpeg;
+    return snapshot;
+}
+
+bool SnapshotWriter::write(const Encoded& snapshot, const std::string& camera_id, FileWriter* files) {
+    if (!snapshot.jpeg) return false;
+    if (files) {
+        files->writeFile(snapshot.path, snapshot.jpeg);
+        spdlog::info("SnapshotWriter: queued {} ({} bytes)", snapshot.path, snapshot.jpeg->size());
+        return true;
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path(snapshot.path).parent_path(), ec);
+    std::ofstream ofs(snapshot.path, std::ios::binary);
     if (!ofs) {
-        spdlog::error("SnapshotWriter: failed to open {}", file_path);
-        return {};
+        spdlog::error("SnapshotWriter: failed to open {} for {}", snapshot.path, camera_id);
+        return false;
     }
-    ofs.write(jpeg.data(), static_cast<std::streamsize>(jpeg.size()));
+    ofs.write(snapshot.jpeg->data(), static_cast<std::streamsize>(snapshot.jpeg->size()));
     ofs.close();
+    if (!ofs) {
+        spdlog::error("SnapshotWriter: failed to write {}", snapshot.path);
+        return false;
+    }
+
+    spdlog::info("SnapshotWriter: saved {} ({} bytes)", snapshot.path, snapshot.jpeg->size());
+    return true;
+}
 
-    spdlog::info("SnapshotWriter: saved {} ({} bytes)", file_path, jpeg.size());
-    return file_path;
+std::string SnapshotWriter::save(const FrameData& frame,
+                                  const std::vector<Detection>& detections,
+                                  const std::string& camera_id,
+                                  const std::string& output_dir) {
+    auto snapshot = encode(frame, detections, camera_id, output_dir);
+    return write(snapshot, camera_id) ? snapshot.path : std::string{};
 }
 
 }  // namespace hms
@@ -0,0 +1,46 @@
+#include "tiling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace hms {
+
+namespace {
+
+/// Start offsets and size of `n` equal spans covering [begin, begin + length)
+/// where neighbours share `overlap` of a span
+void split(int begin, int length, int n, float overlap, std::vector<int>& starts, int& size) {
+    size = n > 1 ? static_cast<int>(std::ceil(length / (n - (n - 1) * overlap))) : length;
+    size = std::min(size, length);
+    starts.clear();
+    double step = n > 1 ? static_cast<double>(length - size) / (n - 1) : 0.0;
+    for (int i = 0; i < n; ++i) starts.push_back(begin + static_cast<int>(std::lround(i * step)));
+}
+
+}  // namespace
+
+std::vector<Region> tileRegions(const TilingConfig& config, int width, int height) {
+    if (!config.enabled() || width <= 0 || height <= 0) return {};
+
+    int rx = std::clamp(static_cast<int>(std::lround(config.roi_x * width)), 0, width - 1);
+    int ry = std::clamp(static_cast<int>(std::lround(config.roi_y * height)), 0, height - 1);
+    int rw = std::clamp(static_cast<int>(std::lround(config.roi_w * width)), 1, width - rx);
+    int rh = std::clamp(static_cast<int>(std::lround(config.roi_h * height)), 1, height - ry);
+    Region roi{rx, ry, rw, rh};
+    if (!config.tiled()) return {roi};
+
+    std::vector<int> xs, ys;
+    int tw = 0, th = 0;
+    split(rx, rw, config.cols, config.overlap, xs, tw);
+    split(ry, rh, config.rows, config.overlap, ys, th);
+
+    std::vector<Region> regions;
+    regions.reserve(xs.size() * ys.size() + 1);
+    if (config.full_frame) regions.push_back(roi);
+    for (int y : ys) {
+        for (int x : xs) regions.push_back({x, y, tw, th});
+    }
+    return regions;
+}
+
+}  // namespace hms
@@ -0,0 +1,203 @@
+#include "tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace hms {
+
+namespace {
+
+// Noise, relative to the box height (ByteTrack-like weights)
+constexpr float kMeasurementStd = 0.05f;  // of a detected coordinate
+constexpr float kAccelStd = 1.0f;         // of the centre, in box heights per s^2
+constexpr float kSizeAccelStd = 0.2f;     // of width / height
+constexpr float kInitialSpeedStd = 1.0f;  // of a new track's velocity, box heights per s
+
+enum { kCx, kCy, kW, kH };
+
+float seconds(SteadyClock::duration d) {
+    return std::max(0.0f, std::chrono::duration<float>(d).count());
+}
+
+/// Box of the four filtered coordinates, keeping the class of `like`
+Detection boxOf(const std::array<float, 4>& c, const Detection& like) {
+    Detection d = like;
+    float w = std::max(1.0f, c[kW]), h = std::max(1.0f, c[kH]);
+    d.x1 = c[kCx] - w / 2;
+    d.y1 = c[kCy] - h / 2;
+    d.x2 = c[kCx] + w / 2;
+    d.y2 = c[kCy] + h / 2;
+    return d;
+}
+
+std::array<float, 4> coordsOf(const Detection& d) {
+    return {(d.x1 + d.x2) / 2, (d.y1 + d.y2) / 2, d.x2 - d.x1, d.y2 - d.y1};
+}
+
+}  // namespace
+
+void Tracker::Track::Axis::predict(float dt, float q) {
+    if (dt <= 0) return;
+    x += v * dt;
+    // F P F^T + white-noise-acceleration Q
+    float dt2 = dt * dt;
+    p00 += 2 * dt * p01 + dt2 * p11 + q * dt2 * dt2 / 4;
+    p01 += dt * p11 + q * dt2 * dt / 2;
+    p11 += q * dt2;
+}
+
+void Tracker::Track::Axis::update(float z, float r) {
+    float s = p00 + r;
+    float k0 = p00 / s, k1 = p01 / s;
+    float y = z - x;
+    x += k0 * y;
+    v += k1 * y;
+    p11 -= k1 * p01;
+    p01 *= 1 - k0;
+    p00 *= 1 - k0;
+}
+
+float Tracker::Track::speed() const {
+    float vx = axes_[kCx].v, vy = axes_[kCy].v;
+    return std::sqrt(vx * vx + vy * vy) / std::max(1.0f, axes_[kH].x);
+}
+
+Tracker::Tracker(TrackingConfig config) : config_(config) {}
+
+Tracker::Track Tracker::start(const Detection& det, SteadyClock::time_point t) {
+    Track track;
+    track.id = next_id_++;
+    track.box = det;
+    track.best = det;
+    track.hits = 1;
+    track.confirmed = config_.min_hits <= 1;
+    track.last_seen = t;
+    track.updated_at_ = t;
+
+    auto c = coordsOf(det);
+    float h = std::max(1.0f, c[kH]);
+    for (int i = 0; i < 4; ++i) {
+        auto& a = track.axes_[i];
+        a.x = c[i];
+        a.p00 = (kMeasurementStd * h) * (kMeasurementStd * h);
+        a.p11 = (kInitialSpeedStd * h) * (kInitialSpeedStd * h);
+    }
+    return track;
+}
+
+void Tracker::correct(Track& track, const Detection& det, SteadyClock::time_point t) {
+    auto c = coordsOf(det);
+    float r = kMeasurementStd * std::max(1.0f, c[kH]);
+    for (int i = 0; i < 4; ++i) track.axes_[i].update(c[i], r * r);
+
+    track.box = boxOf({track.axes_[kCx].x, track.axes_[kCy].x, track.axes_[kW].x, track.axes_[kH].x}, det);
+    track.box.confidence = det.confidence;
+    if (det.confidence > track.best.confidence) track.best = det;
+    ++track.hits;
+    track.confirmed = track.hits >= config_.min_hits;
+    track.last_seen = t;
+}
+
+std::vector<uint32_t> Tracker::update(const std::vector<Detection>& detections, SteadyClock::time_point t) {
+    // Every track where the filter expects it at `t`
+    for (auto& track : tracks_) {
+        float dt = seconds(t - track.updated_at_);
+        float h = std::max(1.0f, track.axes_[kH].x);
+        float q = (kAccelStd * h) * (kAccelStd * h);
+        float qs = (kSizeAccelStd * h) * (kSizeAccelStd * h);
+        track.axes_[kCx].predict(dt, q);
+        track.axes_[kCy].predict(dt, q);
+        track.axes_[kW].predict(dt, qs);
+        track.axes_[kH].predict(dt, qs);
+        track.updated_at_ = std::max(t, track.updated_at_);
+        track.box = boxOf({track.axes_[kCx].x, track.axes_[kCy].x, track.axes_[kW].x, track.axes_[kH].x},
+                          track.box);
+    }
+
+    // Greedy IoU association within a class, best overlaps first
+    struct Pair {
+        float iou;
+        size_t track, det;
+    };
+    std::vector<Pair> pairs;
+    for (size_t i = 0; i < tracks_.size(); ++i) {
+        for (size_t j = 0; j < detections.size(); ++j) {
+            if (tracks_[i].box.class_id != detections[j].class_id) continue;
+            float iou = DetectionEngine::iou(tracks_[i].box, detections[j]);
+            if (iou >= config_.iou_threshold) pairs.push_back({iou, i, j});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.iou > b.iou; });
+
+    std::vector<uint32_t> ids(detections.size(), 0);
+    std::vector<bool> track_matched(tracks_.size(), false);
+    for (const auto& p : pairs) {
+        if (track_matched[p.track] || ids[p.det] != 0) continue;
+        track_matched[p.track] = true;
+        correct(tracks_[p.track], detections[p.det], t);
+        ids[p.det] = tracks_[p.track].id;
+    }
+
+    // Lost tracks go first, so new ones aren't aged out on their first frame
+    auto max_age = std::chrono::milliseconds(config_.max_age_ms);
+    for (auto it = tracks_.begin(); it != tracks_.end();) {
+        if (t - it->last_seen > max_age) {
+            finished_.push_back(std::move(*it));
+            it = tracks_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (size_t j = 0; j < detections.size(); ++j) {
+        if (ids[j] != 0) continue;
+        tracks_.push_back(start(detections[j], t));
+        ids[j] = tracks_.back().id;
+    }
+    return ids;
+}
+
+std::vector<Detection> Tracker::predict(SteadyClock::time_point t) const {
+    std::vector<Detection> boxes;
+    boxes.reserve(tracks_.size());
+    for (const auto& track : tracks_) {
+        float dt = seconds(t - track.updated_at_);
+        std::array<float, 4> c;
+        for (int i = 0; i < 4; ++i) c[i] = track.axes_[i].x + track.axes_[i].v * dt;
+        boxes.push_back(boxOf(c, track.box));
+    }
+    return boxes;
+}
+
+const Tracker::Track* Tracker::find(uint32_t id) const {
+    for (const auto& track : tracks_) {
+        if (track.id == id) return &track;
+    }
+    return nullptr;
+}
+
+bool Tracker::allStationary() const {
+    if (tracks_.empty()) return false;
+    return std::all_of(tracks_.begin(), tracks_.end(), [this](const Track& track) {
+        return track.confirmed && track.speed() < config_.stationary_speed;
+    });
+}
+
+std::vector<Detection> Tracker::objects() const {
+    bool any_confirmed = false;
+    for (const auto* list : {&tracks_, &finished_}) {
+        for (const auto& track : *list) any_confirmed |= track.confirmed;
+    }
+
+    std::vector<Detection> out;
+    for (const auto* list : {&tracks_, &finished_}) {
+        for (const auto& track : *list) {
+            if (track.confirmed || !any_confirmed) out.push_back(track.best);
+        }
+    }
+    std::sort(out.begin(), out.end(),
+              [](const Detection& a, const Detection& b) { return a.confidence > b.confidence; });
+    return out;
+}
+
+}  // namespace hms
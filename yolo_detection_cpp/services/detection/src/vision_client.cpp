@@ -1,9 +1,11 @@
 #include "vision_client.h"
+#include "metrics.h"
 
 #include <spdlog/spdlog.h>
 
 #include <chrono>
 #include <fstream>
+#include <unordered_map>
 
 namespace hms {
 
@@ -46,30 +48,52 @@ VisionClient::Result VisionClient::analyze(const std::string& snapshot_path,
         spdlog::error("VisionClient: cannot open snapshot: {}", snapshot_path);
         return result;
     }
-    std::vector<unsigned char> image_data(
+    auto image_data = std::make_shared<std::string>(
         (std::istreambuf_iterator<char>(file)),
         std::istreambuf_iterator<char>());
     file.close();
 
-    if (image_data.empty()) {
+    if (image_data->empty()) {
         spdlog::error("VisionClient: empty snapshot file: {}", snapshot_path);
         return result;
     }
 
-    // Check abort after file read
+    return analyze(std::move(image_data), camera_id, detected_class, abort_flag);
+}
+
+VisionClient::Result VisionClient::analyze(std::shared_ptr<const std::string> jpeg,
+                                           const std::string& camera_id,
+                                           const std::string& detected_class,
+                                           const std::atomic<bool>* abort_flag) {
+    Result result;
+
+    if (!jpeg || jpeg->empty()) {
+        spdlog::error("VisionClient: no image for {}", camera_id);
+        return result;
+    }
+
+    // Check abort before building the request
     if (abort_flag && abort_flag->load(std::memory_order_acquire)) {
         result.was_aborted = true;
-        spdlog::info("VisionClient: aborted after file read for {}", camera_id);
+        spdlog::info("VisionClient: aborted before request for {}", camera_id);
         return result;
     }
 
-    // 2. Build prompt
+    // 1. Build prompt
     last_prompt_ = buildPrompt(camera_id, detected_class);
 
-    // 3. Delegate to LLMClient for the actual API call
+    // 2. Delegate to LLMClient for the actual API call
     LLMClient client(makeLLMConfig(config_));
-    LLMImage img{LLMClient::base64Encode(image_data), "image/jpeg"};
+    LLMImage img{LLMClient::base64Encode({jpeg->begin(), jpeg->end()}), "image/jpeg"};
     auto response = client.generateVision(last_prompt_, {img}, abort_flag);
+    if (Metrics::enabled() && !response.was_aborted) {
+        // Registry lookup once per camera (and thread); histograms live for the process
+        thread_local std::unordered_map<std::string, Metrics::Histogram*> histograms;
+        auto& metric = histograms[camera_id];
+        if (!metric) metric = &Metrics::histogram(Metrics::Stage::Vision, camera_id);
+        metric->observe(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(response.elapsed_seconds)));
+    }
 
     result.response_time_seconds = response.elapsed_seconds;
     result.was_aborted = response.was_aborted;
@@ -86,7 +110,7 @@ VisionClient::Result VisionClient::analyze(const std::string& snapshot_path,
         return result;
     }
 
-    // 4. Validate response
+    // 3. Validate response
     result.context = response.text.value();
 
     // Trim whitespace
@@ -1,6 +1,9 @@
 #include <catch2/catch_all.hpp>
 #include "buffer_service.h"
 
+#include <chrono>
+#include <future>
+
 using namespace hms;
 
 namespace {
@@ -104,3 +107,28 @@ TEST_CASE("BufferService all cameras disabled yields empty", "[buffer_service]")
     // cam1 disabled + cam3 disabled = only cam2
     REQUIRE(ids.size() == 1);
 }
+
+TEST_CASE("BufferService decodes the main stream on its own bounded workers", "[buffer_service]") {
+    auto config = makeTestConfig();
+    BufferService single(config);
+    REQUIRE_FALSE(single.decodeMainStreamAsync("test_cam1", SteadyClock::now(), [](auto) {}));
+
+    PipelineConfig pipeline;
+    pipeline.streams.record_urls["test_cam1"] = "rtsp://localhost:8554/nonexistent_main";
+    BufferService svc(config, pipeline);
+    REQUIRE(svc.isDualStream("test_cam1"));
+
+    // Nothing buffered yet: the decode runs and comes back empty
+    std::promise<std::shared_ptr<FrameData>> decoded;
+    REQUIRE(svc.decodeMainStreamAsync("test_cam1", SteadyClock::now(),
+                                      [&](std::shared_ptr<FrameData> frame) { decoded.set_value(frame); }));
+    auto result = decoded.get_future();
+    REQUIRE(result.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    REQUIRE(result.get() == nullptr);
+
+    // Shutdown drains the workers; later requests are turned away
+    svc.stopAll();
+    bool called = false;
+    REQUIRE_FALSE(svc.decodeMainStreamAsync("test_cam1", SteadyClock::now(), [&](auto) { called = true; }));
+    REQUIRE_FALSE(called);
+}
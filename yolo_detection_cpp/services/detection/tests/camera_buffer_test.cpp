@@ -1,6 +1,7 @@
 #include <catch2/catch_all.hpp>
 #include "camera_buffer.h"
 
+#include <atomic>
 #include <thread>
 #include <vector>
 
@@ -128,3 +129,152 @@ TEST_CASE("CameraBuffer concurrent read/write", "[camera_buffer]") {
     REQUIRE(reads.load() > 0);
     REQUIRE_FALSE(order_violation.load());
 }
+
+TEST_CASE("CameraBuffer snapshot view covers the buffered window", "[camera_buffer]") {
+    CameraBuffer buf(4);
+    REQUIRE(buf.snapshot().empty());
+
+    for (uint64_t i = 1; i <= 6; ++i) buf.push(makeFrame(i));
+
+    auto view = buf.snapshot();
+    REQUIRE(view.size() == 4);
+    REQUIRE(view[0]->frame_number == 3);
+    REQUIRE(view[3]->frame_number == 6);
+
+    std::vector<uint64_t> seen;
+    view.forEach([&](const std::shared_ptr<FrameData>& f) { seen.push_back(f->frame_number); });
+    REQUIRE(seen == std::vector<uint64_t>{3, 4, 5, 6});
+}
+
+TEST_CASE("CameraBuffer view skips frames overwritten after the snapshot", "[camera_buffer]") {
+    CameraBuffer buf(3);
+    for (uint64_t i = 1; i <= 3; ++i) buf.push(makeFrame(i));
+
+    auto view = buf.snapshot();
+    auto pinned = view[2];  // a frame read before the overwrite stays valid
+    buf.push(makeFrame(4));
+    buf.push(makeFrame(5));
+
+    REQUIRE(view[0] == nullptr);
+    REQUIRE(view[1] == nullptr);
+    REQUIRE(view[2]->frame_number == 3);
+    REQUIRE(pinned->frame_number == 3);
+
+    buf.clear();
+    REQUIRE(view[2] == nullptr);
+    REQUIRE(buf.snapshot().empty());
+    buf.push(makeFrame(6));
+    REQUIRE(buf.size() == 1);
+    REQUIRE(buf.getLatestFrame()->frame_number == 6);
+}
+
+TEST_CASE("CameraBuffer views stay ordered under a fast writer", "[camera_buffer]") {
+    CameraBuffer buf(8);  // small ring: readers get lapped constantly
+    std::atomic<bool> running{true};
+    std::atomic<bool> order_violation{false};
+    std::atomic<bool> stale_latest{false};
+
+    std::thread writer([&]() {
+        for (uint64_t i = 1; i <= 20000; ++i) buf.push(makeFrame(i));
+        running = false;
+    });
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&]() {
+            uint64_t last_latest = 0;
+            while (running.load()) {
+                if (auto f = buf.getLatestFrame()) {
+                    if (f->frame_number < last_latest) stale_latest = true;
+                    last_latest = f->frame_number;
+                }
+                uint64_t prev = 0;
+                buf.snapshot().forEach([&](const std::shared_ptr<FrameData>& f) {
+                    if (f->frame_number <= prev) order_violation = true;
+                    prev = f->frame_number;
+                });
+            }
+        });
+    }
+
+    writer.join();
+    for (auto& t : readers) t.join();
+
+    REQUIRE_FALSE(order_violation.load());
+    REQUIRE_FALSE(stale_latest.load());
+    REQUIRE(buf.getLatestFrame()->frame_number == 20000);
+}
+
+TEST_CASE("CameraBuffer waitForFrame times out without a push", "[camera_buffer]") {
+    CameraBuffer buf(4);
+    buf.push(makeFrame(1));
+
+    auto t0 = SteadyClock::now();
+    auto next = buf.waitForFrame(buf.latestSeq(), t0 + std::chrono::milliseconds(20));
+    REQUIRE(next.frame == nullptr);
+    REQUIRE(SteadyClock::now() - t0 >= std::chrono::milliseconds(20));
+
+    // Already newer than after_seq: no wait
+    next = buf.waitForFrame(0, SteadyClock::now());
+    REQUIRE(next.frame);
+    REQUIRE(next.seq == 1);
+}
+
+TEST_CASE("CameraBuffer waitForFrame wakes on push", "[camera_buffer]") {
+    CameraBuffer buf(4);
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        buf.push(makeFrame(7));
+    });
+
+    auto next = buf.waitForFrame(0, SteadyClock::now() + std::chrono::seconds(10));
+    writer.join();
+    REQUIRE(next.frame);
+    REQUIRE(next.frame->frame_number == 7);
+    REQUIRE(next.seq == buf.latestSeq());
+}
+
+TEST_CASE("CameraBuffer waitForFrame every_frame yields each frame once", "[camera_buffer]") {
+    CameraBuffer buf(4);
+    for (uint64_t i = 1; i <= 3; ++i) buf.push(makeFrame(i));
+
+    uint64_t seq = 0;
+    std::vector<uint64_t> seen;
+    for (;;) {
+        auto next = buf.waitForFrame(seq, SteadyClock::now(), true);
+        if (!next.frame) break;
+        seen.push_back(next.frame->frame_number);
+        seq = next.seq;
+    }
+    REQUIRE(seen == std::vector<uint64_t>{1, 2, 3});
+
+    // A consumer that fell more than a lap behind resumes at the oldest frame held
+    for (uint64_t i = 4; i <= 10; ++i) buf.push(makeFrame(i));
+    auto next = buf.waitForFrame(seq, SteadyClock::now(), true);
+    REQUIRE(next.frame->frame_number == 7);
+}
+
+TEST_CASE("CameraBuffer waitForFrame every_frame under a concurrent writer", "[camera_buffer]") {
+    constexpr uint64_t kFrames = 500;
+    CameraBuffer buf(64);
+    std::thread writer([&] {
+        for (uint64_t i = 1; i <= kFrames; ++i) {
+            buf.push(makeFrame(i));
+            if (i % 16 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    uint64_t seq = 0;
+    uint64_t last = 0;
+    bool ordered = true;
+    while (last < kFrames) {
+        auto next = buf.waitForFrame(seq, SteadyClock::now() + std::chrono::seconds(5), true);
+        if (!next.frame) break;
+        ordered = ordered && next.frame->frame_number > last;
+        last = next.frame->frame_number;
+        seq = next.seq;
+    }
+    writer.join();
+    REQUIRE(ordered);
+    REQUIRE(last == kFrames);
+}
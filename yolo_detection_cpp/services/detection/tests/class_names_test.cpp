@@ -0,0 +1,48 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "class_names.h"
+#include "detection_engine.h"
+
+using namespace hms;
+
+TEST_CASE("ClassNames interns identical tables once", "[class_names]") {
+    const auto* a = ClassNames::intern({"person", "car"});
+    const auto* b = ClassNames::intern({"person", "car"});
+    const auto* c = ClassNames::intern({"car", "person"});
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+
+    REQUIRE(a->size() == 2);
+    REQUIRE(a->name(1) == "car");
+    REQUIRE(a->name(2) == "unknown");
+    REQUIRE(a->name(-1) == "unknown");
+    REQUIRE(a->id("person") == 0);
+    REQUIRE(a->id("dog") == -1);
+}
+
+TEST_CASE("ClassMask compiles names against a table", "[class_names]") {
+    const auto* table = ClassNames::intern({"person", "car", "dog"});
+
+    auto none = ClassMask::compile(*table, {});
+    REQUIRE_FALSE(none.active);
+    REQUIRE(none.allows(2));
+
+    auto mask = ClassMask::compile(*table, {"dog", "unicorn"});
+    REQUIRE(mask.active);
+    REQUIRE(mask.allows(2));
+    REQUIRE_FALSE(mask.allows(0));
+    REQUIRE_FALSE(mask.allows(kUnknownClass));
+}
+
+TEST_CASE("Detection resolves its name through the engine table", "[class_names]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    Detection d{.class_id = 16, .confidence = 0.9f, .classes = &engine.classTable()};
+    REQUIRE(d.name() == "dog");
+
+    Detection bare{.class_id = 16};
+    REQUIRE(bare.name() == "unknown");
+
+    // Same model names, same interned table
+    DetectionEngine other("/nonexistent.onnx");
+    REQUIRE(&other.classTable() == &engine.classTable());
+}
@@ -0,0 +1,265 @@
+#include <catch2/catch_all.hpp>
+#include "db_writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hms;
+
+namespace {
+
+/// Sink that records event ids; throws while `down` or for ids in `poison`
+struct FakeDb {
+    std::mutex mutex;
+    std::vector<std::string> written;
+    std::atomic<bool> down{false};
+    std::atomic<int> fail_next{0};
+    std::string poison;
+
+    DbWriter::Sink sink() {
+        return [this](const DbWriter::Row& row) {
+            std::string id = std::visit([](const auto& r) -> std::string {
+                if constexpr (requires { r.event_id; }) return r.event_id;
+                else return r.filename;
+            }, row);
+            if (down || id == poison) throw std::runtime_error("connection refused");
+            if (fail_next > 0) {
+                --fail_next;
+                throw std::runtime_error("timeout");
+            }
+            std::lock_guard lock(mutex);
+            written.push_back(id);
+        };
+    }
+
+    std::vector<std::string> rows() {
+        std::lock_guard lock(mutex);
+        return written;
+    }
+};
+
+template <typename Pred>
+bool waitFor(Pred pred, int timeout_ms = 5000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+DbWriter::Row event(const std::string& id) {
+    return DbWriter::CreateEvent{id, "cam", id + ".mp4", id + ".jpg"};
+}
+
+std::string journalPath(const std::string& name) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+DbWriter::Options fastRetry(DbWriter::Options options = {}) {
+    options.flush_ms = 0;
+    options.retry_min_ms = 1;
+    options.retry_max_ms = 4;
+    return options;
+}
+
+}  // namespace
+
+TEST_CASE("DbWriter writes rows in submission order", "[db_writer]") {
+    FakeDb db;
+    DbWriter::Options options;
+    options.batch = 4;
+    options.flush_ms = 10;
+    DbWriter writer(db.sink(), options);
+
+    std::vector<std::string> expected;
+    for (int i = 0; i < 10; ++i) {
+        expected.push_back("e" + std::to_string(i));
+        writer.submit(event(expected.back()));
+    }
+    REQUIRE(waitFor([&] { return db.rows().size() == expected.size(); }));
+    REQUIRE(db.rows() == expected);
+
+    auto stats = writer.stats();
+    REQUIRE(stats.written == 10);
+    REQUIRE(stats.queued == 0);
+    REQUIRE(stats.healthy);
+}
+
+TEST_CASE("DbWriter retries a failed row without repeating earlier ones", "[db_writer]") {
+    FakeDb db;
+    DbWriter writer(db.sink(), fastRetry());
+
+    db.fail_next = 3;
+    writer.submit(event("a"));
+    writer.submit(event("b"));
+    REQUIRE(waitFor([&] { return db.rows().size() == 2; }));
+    REQUIRE(db.rows() == std::vector<std::string>{"a", "b"});
+
+    auto stats = writer.stats();
+    REQUIRE(stats.failures == 3);
+    REQUIRE(stats.dropped == 0);
+    REQUIRE(stats.healthy);
+}
+
+TEST_CASE("DbWriter drops a row the database keeps rejecting", "[db_writer]") {
+    FakeDb db;
+    db.poison = "bad";
+    auto options = fastRetry();
+    options.max_attempts = 3;
+    DbWriter writer(db.sink(), options);
+
+    writer.submit(event("a"));
+    writer.submit(event("bad"));
+    REQUIRE(waitFor([&] { return writer.stats().failures >= 5; }));
+    REQUIRE(writer.stats().dropped == 0);  // nothing behind it yet to tell it's not an outage
+
+    writer.submit(event("c"));
+    writer.submit(event("d"));
+    REQUIRE(waitFor([&] { return db.rows().size() == 3; }));
+    REQUIRE(db.rows() == std::vector<std::string>{"a", "c", "d"});
+    REQUIRE(writer.stats().dropped == 1);
+}
+
+TEST_CASE("DbWriter drops nothing during an outage", "[db_writer]") {
+    FakeDb db;
+    db.down = true;
+    auto options = fastRetry();
+    options.max_attempts = 2;
+    DbWriter writer(db.sink(), options);
+
+    writer.submit(event("a"));
+    writer.submit(event("b"));
+    REQUIRE(waitFor([&] { return writer.stats().failures >= 10; }));
+    REQUIRE(writer.stats().dropped == 0);
+
+    db.down = false;
+    REQUIRE(waitFor([&] { return db.rows().size() == 2; }));
+    REQUIRE(db.rows() == std::vector<std::string>{"a", "b"});
+}
+
+TEST_CASE("DbWriter holds rows until its pool is connected", "[db_writer]") {
+    // Startup connects the database in the background: no pool yet
+    std::atomic<int> asked{0};
+    DbWriter writer(DbWriter::PoolSource([&] {
+        asked++;
+        return std::shared_ptr<DbPool>();
+    }), fastRetry());
+
+    writer.submit(event("a"));
+    REQUIRE(waitFor([&] { return writer.stats().failures >= 3; }));
+    auto stats = writer.stats();
+    REQUIRE_FALSE(stats.healthy);
+    REQUIRE(stats.queued == 1);
+    REQUIRE(stats.dropped == 0);
+    REQUIRE(asked >= 3);
+}
+
+TEST_CASE("DbWriter spills to the journal while the database is down", "[db_writer]") {
+    FakeDb db;
+    db.down = true;
+    auto options = fastRetry();
+    options.queue = 2;
+    options.batch = 2;
+    options.journal_path = journalPath("hms_db_writer_spill.jsonl");
+    DbWriter writer(db.sink(), options);
+
+    std::vector<std::string> expected;
+    for (int i = 0; i < 6; ++i) {
+        expected.push_back("e" + std::to_string(i));
+        writer.submit(event(expected.back()));
+    }
+    REQUIRE(waitFor([&] { return writer.stats().journaled == 4; }));
+    REQUIRE(writer.stats().queued == 2);
+    REQUIRE_FALSE(writer.stats().healthy);
+    REQUIRE(std::filesystem::file_size(options.journal_path) == writer.stats().journal_bytes);
+
+    // Recovery: journal first (oldest), then memory
+    db.down = false;
+    REQUIRE(waitFor([&] { return db.rows().size() == expected.size(); }));
+    REQUIRE(db.rows() == expected);
+    REQUIRE(writer.stats().journaled == 0);
+    REQUIRE_FALSE(std::filesystem::exists(options.journal_path));
+}
+
+TEST_CASE("DbWriter journals on shutdown and replays on the next start", "[db_writer]") {
+    FakeDb db;
+    db.down = true;
+    auto options = fastRetry();
+    options.journal_path = journalPath("hms_db_writer_restart.jsonl");
+    {
+        DbWriter writer(db.sink(), options);
+        writer.submit(event("a"));
+        writer.submit(DbWriter::CompleteEvent{"b", 12.5, 300, 4});
+        REQUIRE(waitFor([&] { return writer.stats().failures > 0; }));
+        writer.stop();
+        writer.stop();  // idempotent
+        REQUIRE(writer.stats().journaled == 2);
+    }
+    REQUIRE(std::filesystem::exists(options.journal_path));
+
+    DbWriter writer(db.sink(), options);
+    REQUIRE(writer.stats().journaled == 2);
+    db.down = false;
+    writer.submit(event("c"));
+    REQUIRE(waitFor([&] { return db.rows().size() == 3; }));
+    REQUIRE(db.rows() == std::vector<std::string>{"a", "b", "c"});
+}
+
+TEST_CASE("DbWriter with a full journal drops and counts rows", "[db_writer]") {
+    FakeDb db;
+    db.down = true;
+    auto options = fastRetry();
+    options.queue = 1;
+    options.journal_path = journalPath("hms_db_writer_full.jsonl");
+    options.journal_max_bytes = DbWriter::serialize(event("e0")).size() + 1;  // one row
+    DbWriter writer(db.sink(), options);
+
+    for (int i = 0; i < 4; ++i) writer.submit(event("e" + std::to_string(i)));
+    REQUIRE(waitFor([&] { return writer.stats().dropped == 2; }));
+    REQUIRE(writer.stats().journaled == 1);
+
+    db.down = false;
+    REQUIRE(waitFor([&] { return db.rows().size() == 2; }));
+    REQUIRE(db.rows() == std::vector<std::string>{"e0", "e3"});
+}
+
+TEST_CASE("DbWriter journal round-trips every row type", "[db_writer]") {
+    std::vector<DbWriter::Row> rows = {
+        DbWriter::CreateEvent{"ev1", "front", "rec.mp4", "snap.jpg"},
+        DbWriter::LogDetections{"ev1", {{"person", 0.9f, 1, 2, 3, 4}, {"car", 0.5f, 5, 6, 7, 8}}},
+        DbWriter::CompleteEvent{"ev1", 31.5, 930, 12},
+        DbWriter::LogAiContext{"ev1", "front", {
+            .context_text = "A person at the \"door\"\nwith a parcel",
+            .detected_classes = {"person"},
+            .source_model = "llava:7b",
+            .prompt_used = "Describe",
+            .response_time_seconds = 2.25,
+            .is_valid = true,
+        }},
+        DbWriter::PeriodicSnapshot{"back", "back.jpg", "back_thumb.jpg", "Empty yard",
+                                   {0.25f, -1.0f, 3.5f}, "moondream", true},
+    };
+
+    for (const auto& row : rows) {
+        auto line = DbWriter::serialize(row);
+        REQUIRE(line.find('\n') == std::string::npos);
+        DbWriter::Row back;
+        REQUIRE(DbWriter::deserialize(line, back));
+        REQUIRE(back.index() == row.index());
+        REQUIRE(DbWriter::serialize(back) == line);
+    }
+
+    DbWriter::Row row;
+    REQUIRE_FALSE(DbWriter::deserialize("{\"type\":\"create_ev", row));
+    REQUIRE_FALSE(DbWriter::deserialize("{\"type\":\"unknown\"}", row));
+    REQUIRE_FALSE(DbWriter::deserialize("{\"type\":\"complete_event\",\"event_id\":\"x\"}", row));
+}
@@ -1,7 +1,12 @@
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
 #include "detection_engine.h"
+#include "onnx_test_model.h"
+
+#include <filesystem>
+#include <fstream>
 
 using namespace hms;
 using Catch::Matchers::WithinAbs;
@@ -229,7 +234,7 @@ TEST_CASE("Postprocess - single high-confidence detection", "[detection][postpro
                                    640, 640, {});
 
     REQUIRE(dets.size() == 1);
-    REQUIRE(dets[0].class_name == "person");
+    REQUIRE(dets[0].name() == "person");
     REQUIRE(dets[0].class_id == 0);
     REQUIRE_THAT(dets[0].confidence, WithinAbs(0.9f, 0.01f));
 
@@ -268,7 +273,7 @@ TEST_CASE("Postprocess - class filter", "[detection][postprocess]") {
                                    640, 640, {"person"});
 
     REQUIRE(dets.size() == 1);
-    REQUIRE(dets[0].class_name == "person");
+    REQUIRE(dets[0].name() == "person");
 }
 
 TEST_CASE("Postprocess - confidence threshold filters low scores", "[detection][postprocess]") {
@@ -329,6 +334,50 @@ TEST_CASE("Postprocess - reverse letterbox transforms coordinates", "[detection]
     REQUIRE_THAT(dets[0].y2, WithinAbs(690.0f, 5.0f));
 }
 
+// ============================================================
+// Regions (ROI / tiles)
+// ============================================================
+
+TEST_CASE("Preprocess region matches preprocessing the cropped frame", "[detection][preprocess]") {
+    DetectionEngine engine("/nonexistent.onnx");
+
+    // Left half blue, right half red: the crop sees only red
+    auto frame = makeFrame(400, 200, 255, 0, 0);
+    for (int y = 0; y < 200; ++y) {
+        for (int x = 200; x < 400; ++x) {
+            auto* px = frame.pixels.data() + y * frame.stride + x * 3;
+            px[0] = 0;
+            px[2] = 255;
+        }
+    }
+    auto crop = makeFrame(200, 100, 0, 0, 255);
+
+    const size_t plane = 640 * 640;
+    std::vector<float> from_region(3 * plane), from_crop(3 * plane);
+    float s1, px1, py1, s2, px2, py2;
+    engine.preprocessInto(frame, Region{200, 50, 200, 100}, from_region.data(), s1, px1, py1);
+    engine.preprocessInto(crop, from_crop.data(), s2, px2, py2);
+
+    REQUIRE(s1 == s2);
+    REQUIRE(py1 == py2);
+    REQUIRE(from_region == from_crop);
+}
+
+TEST_CASE("mergeRegions drops the same object seen by two tiles", "[detection][nms]") {
+    std::vector<Detection> dets = {
+        {0, 0.8f, 100, 100, 200, 300, nullptr},  // tile A
+        {0, 0.9f, 102, 98, 201, 302, nullptr},   // tile B, same person
+        {0, 0.7f, 900, 100, 950, 200, nullptr},  // elsewhere
+        {2, 0.6f, 100, 100, 200, 300, nullptr},  // other class, same box
+    };
+    DetectionEngine::mergeRegions(dets, 0.45f);
+
+    REQUIRE(dets.size() == 3);
+    REQUIRE(dets[0].confidence == 0.9f);
+    REQUIRE(dets[1].confidence == 0.7f);
+    REQUIRE(dets[2].class_id == 2);
+}
+
 // ============================================================
 // Class names
 // ============================================================
@@ -359,3 +408,132 @@ TEST_CASE("Constructor accepts gpu_enabled true and falls back", "[detection][gp
     REQUIRE_FALSE(engine.isLoaded());
     REQUIRE(engine.classNames().size() == 80);
 }
+
+// ============================================================
+// Execution providers
+// ============================================================
+
+TEST_CASE("Provider falls back to what the config can run", "[detection][gpu]") {
+    SessionConfig trt{.device = 0, .provider = ExecutionProvider::TensorRt, .precision = Precision::Fp16};
+    DetectionEngine without_gpu("/nonexistent.onnx", 80, false, "", trt);
+    REQUIRE(without_gpu.provider() == ExecutionProvider::Cpu);
+    REQUIRE(without_gpu.precision() == Precision::Fp32);  // CPU EP runs the model as exported
+    REQUIRE(without_gpu.device() == -1);
+
+    DetectionEngine with_gpu("/nonexistent.onnx", 80, true, "", trt);
+    REQUIRE(with_gpu.provider() == ExecutionProvider::TensorRt);
+    REQUIRE(with_gpu.precision() == Precision::Fp16);
+    REQUIRE(with_gpu.device() == 0);
+
+    SessionConfig ov{.device = -1, .provider = ExecutionProvider::OpenVino, .precision = Precision::Fp16};
+    DetectionEngine openvino("/nonexistent.onnx", 80, false, "", ov);
+    REQUIRE(openvino.provider() == ExecutionProvider::OpenVino);  // needs no CUDA device
+    REQUIRE(openvino.precision() == Precision::Fp16);
+    REQUIRE(openvino.device() == -1);
+}
+
+TEST_CASE("Engine cache key follows the model contents", "[detection][gpu]") {
+    auto path = (std::filesystem::temp_directory_path() / "hms_cache_key.onnx").string();
+    auto write = [&](const std::string& bytes) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    };
+
+    write("model-a");
+    auto a = DetectionEngine::engineCacheKey(path);
+    REQUIRE(a.rfind("hms_cache_key-", 0) == 0);
+    REQUIRE(a.size() == std::string("hms_cache_key-").size() + 16);
+    REQUIRE(DetectionEngine::engineCacheKey(path) == a);
+
+    write("model-b");  // re-exported model: different key, old engines are never read
+    REQUIRE(DetectionEngine::engineCacheKey(path) != a);
+
+    std::filesystem::remove(path);
+    REQUIRE(DetectionEngine::engineCacheKey(path).empty());
+}
+
+// ============================================================
+// IoBinding tests (generated model: conf = mean pixel, box = top-left quarter)
+// ============================================================
+
+namespace {
+
+/// detectBatch on one 64x64 gray frame per entry; checks each frame got its
+/// own detection, so a stale or misbound output shows up as a wrong confidence
+void requireBatch(DetectionEngine& engine, const std::vector<uint8_t>& grays) {
+    std::vector<FrameData> frames;
+    for (auto g : grays) frames.push_back(makeFrame(64, 64, g, g, g));
+    std::vector<const FrameData*> ptrs;
+    for (const auto& f : frames) ptrs.push_back(&f);
+    std::vector<DetectParams> params(frames.size(), DetectParams{.conf_threshold = 0.1f});
+
+    auto results = engine.detectBatch(ptrs, params);
+    REQUIRE(results.size() == grays.size());
+    for (size_t i = 0; i < grays.size(); ++i) {
+        INFO("batch of " << grays.size() << ", frame " << i);
+        REQUIRE(results[i].size() == 1);
+        const auto& det = results[i][0];
+        REQUIRE(det.class_id == 0);
+        REQUIRE_THAT(det.confidence, WithinAbs(grays[i] / 255.0f, 0.01));
+        REQUIRE_THAT(det.x1, WithinAbs(0.0, 0.5));
+        REQUIRE_THAT(det.y1, WithinAbs(0.0, 0.5));
+        REQUIRE_THAT(det.x2, WithinAbs(32.0, 0.5));  // 16 in the 32x32 input
+        REQUIRE_THAT(det.y2, WithinAbs(32.0, 0.5));
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Binding grows and shrinks with the batch without stale outputs", "[detection][binding]") {
+    bool symbolic = GENERATE(false, true);
+    INFO((symbolic ? "ORT-allocated output" : "preallocated output"));
+    auto path = test::writeMeanBoxModel(symbolic ? "hms_binding_dyn.onnx" : "hms_binding.onnx", 32, symbolic);
+
+    DetectionEngine engine(path, 80);
+    REQUIRE(engine.isModelValid());
+    engine.load();
+    REQUIRE(engine.supportsBatching());
+    REQUIRE(engine.inputWidth() == 32);
+
+    requireBatch(engine, {200});
+    requireBatch(engine, {60});                   // same view: binding reused
+    requireBatch(engine, {220, 120, 180});        // grows the buffers
+    requireBatch(engine, {90, 240});              // shrinks: rebinds a smaller view
+    requireBatch(engine, {30, 150, 210, 70, 130});
+    requireBatch(engine, {250});
+
+    engine.unload();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Binding is dropped and rebuilt across unload and evict", "[detection][binding]") {
+    auto path = test::writeMeanBoxModel("hms_binding_reload.onnx");
+    DetectionEngine engine(path, 80);
+    engine.load();
+    requireBatch(engine, {200, 100, 50});
+
+    engine.unload();
+    REQUIRE_FALSE(engine.isLoaded());
+    auto frame = makeFrame(64, 64, 200, 200, 200);
+    auto empty = engine.detectBatch({&frame}, {DetectParams{.conf_threshold = 0.1f}});
+    REQUIRE(empty.size() == 1);
+    REQUIRE(empty[0].empty());
+
+    engine.load();
+    requireBatch(engine, {80});
+    requireBatch(engine, {160, 40});
+
+    auto before = engine.residencyStats();
+    REQUIRE(engine.evict());
+    REQUIRE_FALSE(engine.isLoaded());
+    REQUIRE(engine.residencyStats().evictions == before.evictions + 1);
+    REQUIRE(engine.detectBatch({&frame}, {DetectParams{.conf_threshold = 0.1f}})[0].empty());
+
+    engine.acquire();  // reloads with fresh slots
+    REQUIRE(engine.residencyStats().loads == before.loads + 1);
+    requireBatch(engine, {120, 240, 30});
+    REQUIRE_FALSE(engine.evict());  // pinned
+    engine.release();
+
+    engine.unload();
+    std::filesystem::remove(path);
+}
@@ -2,6 +2,11 @@
 #include "embedding_client.h"
 #include "config_manager.h"
 
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 // ────────────────────────────────────────────────────────────────────
 // EmbeddingClient unit tests
 // ────────────────────────────────────────────────────────────────────
@@ -31,6 +36,98 @@ TEST_CASE("EmbeddingClient::embed returns empty for unreachable server", "[embed
     CHECK(result.empty());  // Should fail gracefully, not crash
 }
 
+namespace {
+
+/// Fake /api/embed: one-element embedding holding the text length; counts calls
+struct FakeOllama {
+    std::mutex mutex;
+    std::vector<std::vector<std::string>> calls;
+
+    hms::EmbeddingClient::Transport transport() {
+        return [this](const std::vector<std::string>& texts) {
+            std::lock_guard lock(mutex);
+            calls.push_back(texts);
+            std::vector<std::vector<float>> out;
+            for (const auto& t : texts) out.push_back({static_cast<float>(t.size())});
+            return out;
+        };
+    }
+};
+
+}  // namespace
+
+TEST_CASE("EmbeddingClient coalesces concurrent texts into one request", "[embedding]") {
+    FakeOllama ollama;
+    hms::EmbeddingClient client("http://unused", "nomic-embed-text",
+        {.batch_window_ms = 200, .max_batch = 16, .cache_entries = 0, .transport = ollama.transport()});
+
+    std::vector<std::string> texts = {"a", "bb", "ccc", "bb"};
+    std::vector<std::vector<float>> results(texts.size());
+    std::vector<std::thread> callers;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        callers.emplace_back([&, i] { results[i] = client.embed(texts[i]); });
+    }
+    for (auto& t : callers) t.join();
+
+    for (size_t i = 0; i < texts.size(); ++i) {
+        REQUIRE(results[i] == std::vector<float>{static_cast<float>(texts[i].size())});
+    }
+    REQUIRE(ollama.calls.size() == 1);
+    CHECK(ollama.calls[0].size() == 3);  // duplicate sent once
+    auto stats = client.stats();
+    CHECK(stats.batches == 1);
+    CHECK(stats.requests == 4);
+}
+
+TEST_CASE("EmbeddingClient splits batches at max_batch", "[embedding]") {
+    FakeOllama ollama;
+    hms::EmbeddingClient client("http://unused", "nomic-embed-text",
+        {.batch_window_ms = 200, .max_batch = 2, .cache_entries = 0, .transport = ollama.transport()});
+
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 5; ++i) {
+        callers.emplace_back([&, i] { REQUIRE(client.embed(std::string(i + 1, 'x')).size() == 1); });
+    }
+    for (auto& t : callers) t.join();
+    for (const auto& call : ollama.calls) REQUIRE(call.size() <= 2);
+    CHECK(client.stats().batched_texts == 5);
+}
+
+TEST_CASE("EmbeddingClient caches recent texts", "[embedding]") {
+    FakeOllama ollama;
+    hms::EmbeddingClient client("http://unused", "nomic-embed-text",
+        {.batch_window_ms = 0, .max_batch = 16, .cache_entries = 2, .transport = ollama.transport()});
+
+    REQUIRE(client.embed("empty patio at night") == std::vector<float>{20});
+    REQUIRE(client.embed("empty patio at night") == std::vector<float>{20});
+    CHECK(ollama.calls.size() == 1);
+    CHECK(client.stats().cache_hits == 1);
+
+    // LRU: touching the first text keeps it; the second is evicted by the third
+    client.embed("car in driveway");
+    client.embed("empty patio at night");
+    client.embed("person at the door");
+    auto before = ollama.calls.size();
+    client.embed("empty patio at night");
+    CHECK(ollama.calls.size() == before);
+    client.embed("car in driveway");
+    CHECK(ollama.calls.size() == before + 1);
+}
+
+TEST_CASE("EmbeddingClient does not cache failures", "[embedding]") {
+    int calls = 0;
+    hms::EmbeddingClient client("http://unused", "nomic-embed-text",
+        {.batch_window_ms = 0, .max_batch = 16, .cache_entries = 8,
+         .transport = [&](const std::vector<std::string>&) {
+             ++calls;
+             return std::vector<std::vector<float>>{};
+         }});
+    CHECK(client.embed("text").empty());
+    CHECK(client.embed("text").empty());
+    CHECK(calls == 2);
+    CHECK(client.stats().failures == 2);
+}
+
 // ────────────────────────────────────────────────────────────────────
 // PeriodicSnapshotManager config-level tests
 // ────────────────────────────────────────────────────────────────────
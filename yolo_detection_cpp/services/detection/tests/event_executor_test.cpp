@@ -0,0 +1,138 @@
+#include <catch2/catch_all.hpp>
+#include "event_executor.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace hms;
+using Stage = EventExecutor::Stage;
+
+namespace {
+
+EventExecutor::Options uniform(int workers, int queue) {
+    EventExecutor::Options options;
+    options.fill(EventExecutor::StageOptions{workers, queue});
+    return options;
+}
+
+const EventExecutor::StageStats& statsOf(const std::vector<EventExecutor::StageStats>& all, Stage stage) {
+    return all[static_cast<size_t>(stage)];
+}
+
+}  // namespace
+
+TEST_CASE("EventExecutor runs tasks of one key in order, one at a time", "[event_executor]") {
+    EventExecutor executor(uniform(4, 64));
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::atomic<int> running{0};
+    std::atomic<int> overlap{0};
+    for (int i = 0; i < 20; ++i) {
+        REQUIRE(executor.submit(Stage::Publish, "cam", [&, i] {
+            if (running.fetch_add(1) > 0) overlap++;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            {
+                std::lock_guard lock(mutex);
+                order.push_back(i);
+            }
+            running.fetch_sub(1);
+        }));
+    }
+    executor.stop();
+
+    REQUIRE(overlap == 0);
+    REQUIRE(order.size() == 20);
+    for (int i = 0; i < 20; ++i) REQUIRE(order[i] == i);
+}
+
+TEST_CASE("EventExecutor runs different keys in parallel", "[event_executor]") {
+    EventExecutor executor(uniform(2, 8));
+
+    // Each task waits for the other: only completes if both run at once
+    std::promise<void> a_started, b_started;
+    auto a_ready = a_started.get_future().share();
+    auto b_ready = b_started.get_future().share();
+    std::atomic<int> met{0};
+    REQUIRE(executor.submit(Stage::Record, "a", [&] {
+        a_started.set_value();
+        if (b_ready.wait_for(std::chrono::seconds(5)) == std::future_status::ready) met++;
+    }));
+    REQUIRE(executor.submit(Stage::Record, "b", [&] {
+        b_started.set_value();
+        if (a_ready.wait_for(std::chrono::seconds(5)) == std::future_status::ready) met++;
+    }));
+    executor.stop();
+    REQUIRE(met == 2);
+}
+
+TEST_CASE("EventExecutor rejects when a stage queue is full", "[event_executor]") {
+    EventExecutor executor(uniform(1, 2));
+
+    std::promise<void> release;
+    auto gate = release.get_future().share();
+    std::promise<void> started;
+    REQUIRE(executor.submit(Stage::Vision, "cam", [&] {
+        started.set_value();
+        gate.wait();
+    }));
+    started.get_future().wait();  // the worker holds the first task
+
+    REQUIRE(executor.submit(Stage::Vision, "cam", [] {}));
+    REQUIRE(executor.submit(Stage::Vision, "other", [] {}));
+    REQUIRE_FALSE(executor.submit(Stage::Vision, "cam", [] {}));
+
+    // Other stages have their own queues
+    REQUIRE(executor.submit(Stage::Publish, "cam", [] {}));
+
+    auto stats = statsOf(executor.stats(), Stage::Vision);
+    REQUIRE(std::string(stats.name) == "vision");
+    REQUIRE(stats.workers == 1);
+    REQUIRE(stats.capacity == 2);
+    REQUIRE(stats.queued == 2);
+    REQUIRE(stats.running == 1);
+    REQUIRE(stats.rejected == 1);
+
+    release.set_value();
+    executor.stop();
+
+    stats = statsOf(executor.stats(), Stage::Vision);
+    REQUIRE(stats.queued == 0);
+    REQUIRE(stats.running == 0);
+    REQUIRE(stats.completed == 3);
+    REQUIRE(stats.max_run_ms >= stats.avg_run_ms);
+    REQUIRE(stats.max_wait_ms > 0);
+}
+
+TEST_CASE("EventExecutor stop drains queued work and lets it reach later stages", "[event_executor]") {
+    EventExecutor executor(uniform(1, 16));
+
+    std::atomic<int> published{0};
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(executor.submit(Stage::Record, "cam", [&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            executor.submit(Stage::Publish, "cam", [&] { published++; });
+        }));
+    }
+    executor.stop();
+    REQUIRE(published == 5);
+
+    // Stopped: nothing more is accepted, and stop() is idempotent
+    REQUIRE_FALSE(executor.submit(Stage::Record, "cam", [] {}));
+    executor.stop();
+    REQUIRE(statsOf(executor.stats(), Stage::Record).rejected == 1);
+}
+
+TEST_CASE("EventExecutor survives a throwing task", "[event_executor]") {
+    EventExecutor executor(uniform(1, 4));
+    std::atomic<bool> ran{false};
+    REQUIRE(executor.submit(Stage::Snapshot, "cam", [] { throw std::runtime_error("boom"); }));
+    REQUIRE(executor.submit(Stage::Snapshot, "cam", [&] { ran = true; }));
+    executor.stop();
+    REQUIRE(ran);
+    REQUIRE(statsOf(executor.stats(), Stage::Snapshot).completed == 2);
+}
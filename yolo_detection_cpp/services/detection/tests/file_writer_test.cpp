@@ -0,0 +1,159 @@
+#include <catch2/catch_all.hpp>
+#include "file_writer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+using namespace hms;
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Fresh, empty directory under the temp dir
+fs::path scratchDir(const std::string& name) {
+    auto dir = fs::temp_directory_path() / name;
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir;
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+TEST_CASE("FileWriter applies positioned writes in order", "[file_writer]") {
+    auto dir = scratchDir("hms_file_writer_writes");
+    auto path = (dir / "event.mp4").string();
+
+    FileWriter writer;
+    auto file = writer.open(path);
+    writer.write(file, 0, "ftyp");
+    writer.write(file, 4, "moof");
+    writer.write(file, 2, "XX");  // a muxer seeking back to patch a header
+    writer.close(file);
+    writer.flush();
+
+    REQUIRE(readFile(path) == "ftXXmoof");
+    auto stats = writer.stats();
+    REQUIRE(stats.bytes_written == 10);
+    REQUIRE(stats.files_closed == 1);
+    REQUIRE(stats.failures == 0);
+    REQUIRE(stats.queued_ops == 0);
+    fs::remove_all(dir);
+}
+
+TEST_CASE("FileWriter moves a staged file to its final path", "[file_writer]") {
+    auto staging = scratchDir("hms_file_writer_staging");
+    auto events = scratchDir("hms_file_writer_events");
+    auto staged = (staging / "cam_1.mp4").string();
+    auto final_path = (events / "sub" / "cam_1.mp4").string();
+
+    FileWriter writer;
+    auto file = writer.open(staged);
+    writer.write(file, 0, "fragment");
+    writer.close(file, final_path);
+    writer.flush();
+
+    REQUIRE(readFile(final_path) == "fragment");
+    REQUIRE_FALSE(fs::exists(staged));
+    REQUIRE_FALSE(fs::exists(final_path + ".part"));
+    REQUIRE(writer.locate(final_path) == final_path);
+    REQUIRE(writer.stats().moves == 1);
+
+    SECTION("a removal queued behind the close deletes the moved file") {
+        auto again = writer.open(staged);
+        writer.write(again, 0, "empty event");
+        writer.close(again, final_path);
+        writer.remove(final_path);
+        writer.flush();
+        REQUIRE_FALSE(fs::exists(final_path));
+        REQUIRE_FALSE(fs::exists(staged));
+    }
+    fs::remove_all(staging);
+    fs::remove_all(events);
+}
+
+TEST_CASE("FileWriter deletes a staged file it couldn't move", "[file_writer]") {
+    auto staging = scratchDir("hms_file_writer_stranded");
+    std::ofstream(staging / "not_a_dir") << "x";
+    auto staged = (staging / "cam_1.mp4").string();
+    auto final_path = (staging / "not_a_dir" / "cam_1.mp4").string();
+
+    FileWriter writer;
+    auto file = writer.open(staged);
+    writer.write(file, 0, "fragment");
+    writer.close(file, final_path);
+    writer.flush();
+
+    REQUIRE_FALSE(fs::exists(staged));
+    REQUIRE_FALSE(fs::exists(final_path));
+    auto stats = writer.stats();
+    REQUIRE(stats.failures == 1);
+    REQUIRE(stats.moves == 0);
+    REQUIRE(stats.files_closed == 0);
+    fs::remove_all(staging);
+}
+
+TEST_CASE("FileWriter whole-file writes are served until they land", "[file_writer]") {
+    auto dir = scratchDir("hms_file_writer_whole");
+    auto path = (dir / "snap.jpg").string();
+    auto jpeg = std::make_shared<const std::string>("\xff\xd8 jpeg \xff\xd9");
+
+    FileWriter writer;
+    writer.writeFile(path, jpeg);
+    // Either still queued (same bytes) or already on disk
+    auto queued = writer.pending(path);
+    REQUIRE((queued == jpeg || (queued == nullptr && fs::exists(path))));
+    writer.flush();
+
+    REQUIRE(writer.pending(path) == nullptr);
+    REQUIRE(readFile(path) == *jpeg);
+    REQUIRE_FALSE(fs::exists(path + ".part"));
+    REQUIRE(writer.pending((dir / "other.jpg").string()) == nullptr);
+    fs::remove_all(dir);
+}
+
+TEST_CASE("FileWriter drops the writes of a file it couldn't open", "[file_writer]") {
+    auto dir = scratchDir("hms_file_writer_fail");
+    std::ofstream(dir / "not_a_dir") << "x";
+    auto bad = (dir / "not_a_dir" / "event.mp4").string();
+    auto good = (dir / "event.mp4").string();
+
+    FileWriter writer;
+    auto broken = writer.open(bad);
+    writer.write(broken, 0, "lost");
+    writer.close(broken);
+    auto file = writer.open(good);
+    writer.write(file, 0, "kept");
+    writer.close(file);
+    writer.flush();
+
+    auto stats = writer.stats();
+    REQUIRE(stats.failures == 1);  // the open; its write is skipped silently
+    REQUIRE(stats.files_closed == 1);
+    REQUIRE(readFile(good) == "kept");
+    fs::remove_all(dir);
+}
+
+TEST_CASE("FileWriter makes producers wait past its byte budget", "[file_writer]") {
+    auto dir = scratchDir("hms_file_writer_budget");
+    auto path = (dir / "big.mp4").string();
+
+    FileWriter writer(FileWriter::Options{.queue_bytes = 4096});
+    auto file = writer.open(path);
+    const std::string chunk(1000, 'a');
+    for (int i = 0; i < 64; ++i) writer.write(file, static_cast<int64_t>(i) * 1000, chunk);
+    writer.close(file);
+    REQUIRE(writer.stats().queued_bytes <= 4096);
+    writer.stop();  // drains the queue
+
+    REQUIRE(fs::file_size(path) == 64000u);
+    REQUIRE(writer.stats().bytes_written == 64000u);
+    fs::remove_all(dir);
+}
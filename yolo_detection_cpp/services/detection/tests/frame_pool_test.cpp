@@ -3,6 +3,7 @@
 
 #include <thread>
 #include <vector>
+#include <algorithm>
 #include <atomic>
 
 using namespace hms;
@@ -105,3 +106,154 @@ TEST_CASE("FramePool concurrent access", "[frame_pool]") {
     // Total attempts: 200, most should succeed
     REQUIRE(acquired.load() > 100);
 }
+
+namespace {
+// Stands in for the decoder's AVFrame ref: paints a known color, counts calls
+class FakeNativeFrame : public NativeFrame {
+public:
+    FakeNativeFrame(std::atomic<int>& conversions, std::atomic<int>& releases)
+        : conversions_(conversions), releases_(releases) {}
+
+    bool toBgr(uint8_t* dst, int stride) override {
+        ++conversions_;
+        std::fill(dst, dst + stride, uint8_t{42});
+        return true;
+    }
+    void release() override { ++releases_; }
+
+private:
+    std::atomic<int>& conversions_;
+    std::atomic<int>& releases_;
+};
+}  // namespace
+
+TEST_CASE("FrameData converts a native frame once, on demand", "[frame_pool]") {
+    std::atomic<int> conversions{0}, releases{0};
+    FrameData frame;
+    frame.attachNative(std::make_unique<FakeNativeFrame>(conversions, releases));
+    frame.markNative(4, 2);
+
+    REQUIRE(frame.isPendingBgr());
+    REQUIRE(frame.stride == 12);
+    REQUIRE(conversions == 0);
+
+    std::atomic<int> ok{0};
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 4; ++i) {
+        consumers.emplace_back([&] { if (frame.ensureBgr()) ++ok; });
+    }
+    for (auto& t : consumers) t.join();
+
+    REQUIRE(ok == 4);
+    REQUIRE(conversions == 1);
+    REQUIRE(releases == 1);  // native ref dropped once BGR exists
+    REQUIRE_FALSE(frame.isPendingBgr());
+    REQUIRE(frame.pixels.size() == 24);
+    REQUIRE(frame.pixels[0] == 42);
+}
+
+TEST_CASE("FrameData hands out YUV planes only while unconverted", "[frame_pool]") {
+    // I420 picture the native frame exposes without converting
+    class YuvFrame : public FakeNativeFrame {
+    public:
+        using FakeNativeFrame::FakeNativeFrame;
+        bool yuv420(YuvPlanes& planes) override {
+            planes.data[0] = y_;
+            planes.stride[0] = 4;
+            return true;
+        }
+
+    private:
+        uint8_t y_[8] = {16, 16, 16, 16, 235, 235, 235, 235};
+    };
+
+    std::atomic<int> conversions{0}, releases{0};
+    FrameData frame;
+    frame.attachNative(std::make_unique<YuvFrame>(conversions, releases));
+    frame.markNative(4, 2);
+
+    int luma = -1;
+    REQUIRE(frame.withYuv420([&](const YuvPlanes& planes) { luma = planes.data[0][4]; }));
+    REQUIRE(luma == 235);
+    REQUIRE(conversions == 0);
+    REQUIRE(frame.isPendingBgr());  // still unconverted for everyone else
+
+    REQUIRE(frame.ensureBgr());
+    REQUIRE_FALSE(frame.withYuv420([](const YuvPlanes&) {}));
+
+    // Native formats that aren't 4:2:0 have no planes to give
+    FrameData other;
+    other.attachNative(std::make_unique<FakeNativeFrame>(conversions, releases));
+    other.markNative(4, 2);
+    REQUIRE_FALSE(other.withYuv420([](const YuvPlanes&) {}));
+}
+
+TEST_CASE("FramePool drops native refs of unconverted frames", "[frame_pool]") {
+    std::atomic<int> conversions{0}, releases{0};
+    FramePool pool(1);
+    {
+        auto f = pool.acquire();
+        f->attachNative(std::make_unique<FakeNativeFrame>(conversions, releases));
+        f->markNative(640, 480);
+    }
+    REQUIRE(conversions == 0);  // nobody asked for pixels
+    REQUIRE(releases == 1);
+
+    // The adapter stays with the pooled frame for reuse
+    auto f = pool.acquire();
+    REQUIRE(f->native() != nullptr);
+    REQUIRE_FALSE(f->isPendingBgr());
+}
+
+TEST_CASE("FramePool lends spill frames beyond its soft capacity", "[frame_pool]") {
+    FramePool pool(2, 2);
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    auto c = pool.acquire();  // spill
+    auto d = pool.acquire();  // spill
+    REQUIRE(c != nullptr);
+    REQUIRE(d != nullptr);
+    REQUIRE(pool.acquire() == nullptr);  // hard limit reached
+
+    auto s = pool.stats();
+    REQUIRE(s.in_use == 4);
+    REQUIRE(s.spilled == 2);
+    REQUIRE(s.spill_allocs == 2);
+    REQUIRE(s.exhausted == 1);
+    REQUIRE(s.peak_in_use == 4);
+
+    // Spilled frames are freed on return, pooled ones go back on the stack
+    c.reset();
+    REQUIRE(pool.stats().spilled == 1);
+    REQUIRE(pool.available() == 0);
+    a.reset();
+    REQUIRE(pool.available() == 1);
+    REQUIRE(pool.stats().spilled == 1);
+    b.reset();
+    d.reset();
+    REQUIRE(pool.stats().spilled == 0);
+    REQUIRE(pool.available() == 2);
+    REQUIRE(pool.in_use() == 0);
+}
+
+TEST_CASE("FramePool reuses the same frames without reallocating", "[frame_pool]") {
+    FramePool pool(2);
+    std::vector<const FrameData*> seen;
+    for (int i = 0; i < 10; ++i) {
+        auto f = pool.acquire();
+        f->resize(8, 8);
+        seen.push_back(f.get());
+    }
+    // LIFO free stack: a single user keeps getting the same slot back
+    REQUIRE(std::all_of(seen.begin(), seen.end(), [&](const FrameData* p) { return p == seen[0]; }));
+
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    REQUIRE(a.get() != b.get());
+    REQUIRE(a->pixels.size() == 8 * 8 * 3);  // recycled frame keeps its buffer
+    auto s = pool.stats();
+    REQUIRE(s.in_use == 2);
+    REQUIRE(s.available == 0);
+    REQUIRE(s.peak_in_use == 2);
+    REQUIRE(s.spill_allocs == 0);
+}
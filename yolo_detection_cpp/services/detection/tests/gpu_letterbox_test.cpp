@@ -0,0 +1,136 @@
+#include <catch2/catch_all.hpp>
+
+#include "detection_engine.h"
+#include "gpu_letterbox.h"
+#include "letterbox.h"
+
+#ifdef HMS_HAVE_CUDA_PREPROCESS
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+#endif
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace hms;
+
+TEST_CASE("GPU preprocessing stays off without a CUDA session", "[gpu_letterbox]") {
+    REQUIRE_FALSE(GpuLetterbox::available(-1));
+
+    DetectionEngine engine("/nonexistent.onnx", 80, true);
+    REQUIRE_FALSE(engine.gpuPreprocess());
+    engine.setGpuPreprocess(true);
+    REQUIRE(engine.gpuPreprocess());
+    REQUIRE_FALSE(engine.gpuPreprocessActive());  // nothing loaded
+
+    // The CPU letterbox is untouched by the setting
+    FrameData frame;
+    frame.resize(64, 48);
+    std::fill(frame.pixels.begin(), frame.pixels.end(), uint8_t{255});
+    float scale, pad_x, pad_y;
+    auto tensor = engine.preprocess(frame, scale, pad_x, pad_y);
+    REQUIRE(tensor.size() == 3u * 640 * 640);
+    REQUIRE(tensor[320 * 640 + 320] == Catch::Approx(1.0f));
+}
+
+#ifdef HMS_HAVE_CUDA_PREPROCESS
+
+namespace {
+
+/// Device tensor back on the host as floats
+std::vector<float> download(const void* dst, size_t n, bool fp16) {
+    std::vector<float> out(n);
+    if (fp16) {
+        std::vector<__half> halves(n);
+        cudaMemcpy(halves.data(), dst, n * sizeof(__half), cudaMemcpyDeviceToHost);
+        for (size_t i = 0; i < n; ++i) out[i] = __half2float(halves[i]);
+    } else {
+        cudaMemcpy(out.data(), dst, n * sizeof(float), cudaMemcpyDeviceToHost);
+    }
+    return out;
+}
+
+}  // namespace
+
+TEST_CASE("GPU letterbox matches the CPU one on BGR frames", "[gpu_letterbox]") {
+    if (!GpuLetterbox::available(0)) SKIP("no CUDA device");
+
+    // Gradient so every sample position matters
+    constexpr int kW = 320, kH = 180;
+    std::vector<uint8_t> bgr(static_cast<size_t>(kW) * kH * 3);
+    for (size_t i = 0; i < bgr.size(); ++i) bgr[i] = static_cast<uint8_t>((i * 7) % 251);
+
+    auto mode = GENERATE(ResizeMode::Nearest, ResizeMode::Bilinear);
+    auto plan = std::make_shared<const LetterboxPlan>(LetterboxPlan::make(kW, kH, 640, 640, mode));
+    std::vector<float> expected(3u * 640 * 640);
+    letterboxToTensor(*plan, bgr.data(), kW * 3, expected.data());
+
+    GpuLetterbox gpu(0);
+    void* dst = gpu.reserveTensor(expected.size() * sizeof(float));
+    REQUIRE(dst != nullptr);
+    REQUIRE(gpu.fromBgr(plan, bgr.data(), kW * 3, Region{0, 0, kW, kH}, dst, false));
+    REQUIRE(gpu.synchronize());
+
+    auto got = download(dst, expected.size(), false);
+    for (size_t i = 0; i < got.size(); ++i) REQUIRE(got[i] == expected[i]);
+
+    SECTION("FP16 output is the same tensor, rounded") {
+        REQUIRE(gpu.fromBgr(plan, bgr.data(), kW * 3, Region{0, 0, kW, kH}, dst, true));
+        REQUIRE(gpu.synchronize());
+        auto halves = download(dst, expected.size(), true);
+        for (size_t i = 0; i < halves.size(); i += 97) {
+            REQUIRE(halves[i] == Catch::Approx(expected[i]).margin(1e-3));
+        }
+    }
+}
+
+TEST_CASE("GPU letterbox converts I420 and NV12 crops", "[gpu_letterbox]") {
+    if (!GpuLetterbox::available(0)) SKIP("no CUDA device");
+
+    // Limited-range mid gray (Y 126, neutral chroma) with a white right half
+    constexpr int kW = 64, kH = 32;
+    std::vector<uint8_t> y(kW * kH, 126), u(kW / 2 * kH / 2, 128), v(u.size(), 128);
+    std::vector<uint8_t> uv(kW * kH / 2, 128);
+    for (int row = 0; row < kH; ++row) std::fill_n(y.begin() + row * kW + kW / 2, kW / 2, uint8_t{235});
+
+    YuvPlanes i420;
+    i420.data[0] = y.data();
+    i420.data[1] = u.data();
+    i420.data[2] = v.data();
+    i420.stride[0] = kW;
+    i420.stride[1] = i420.stride[2] = kW / 2;
+
+    YuvPlanes nv12;
+    nv12.layout = YuvPlanes::Layout::Nv12;
+    nv12.data[0] = y.data();
+    nv12.data[1] = uv.data();
+    nv12.stride[0] = nv12.stride[1] = kW;
+
+    auto planes = GENERATE_COPY(i420, nv12);
+
+    // The odd-origin left half of the picture: all gray
+    Region crop{1, 1, 31, 31};
+    auto plan = std::make_shared<const LetterboxPlan>(
+        LetterboxPlan::make(crop.w, crop.h, 64, 64, ResizeMode::Nearest));
+
+    GpuLetterbox gpu(0);
+    void* dst = gpu.reserveTensor(3u * 64 * 64 * sizeof(float));
+    REQUIRE(gpu.fromYuv(plan, planes, crop, dst, false));
+    REQUIRE(gpu.synchronize());
+    auto got = download(dst, 3u * 64 * 64, false);
+
+    float gray = std::round(1.164f * (126 - 16)) / 255.0f;  // 128
+    for (int c = 0; c < 3; ++c) {
+        REQUIRE(got[c * 64 * 64 + 32 * 64 + 32] == Catch::Approx(gray).margin(1.0f / 255));
+    }
+
+    SECTION("fill() pads the whole tensor") {
+        REQUIRE(gpu.fill(64, 64, dst, false));
+        REQUIRE(gpu.synchronize());
+        auto padded = download(dst, 3u * 64 * 64, false);
+        REQUIRE(padded[32 * 64 + 32] == Catch::Approx(114.0f / 255.0f));
+    }
+}
+
+#endif  // HMS_HAVE_CUDA_PREPROCESS
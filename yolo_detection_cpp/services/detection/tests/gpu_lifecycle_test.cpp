@@ -4,8 +4,12 @@
 #include "buffer_service.h"
 #include "event_manager.h"
 #include "config_manager.h"
+#include "gpu_coordinator.h"
+#include "periodic_snapshot_manager.h"
+#include "onnx_test_model.h"
 
 #include <atomic>
+#include <filesystem>
 #include <chrono>
 #include <future>
 #include <thread>
@@ -244,6 +248,96 @@ TEST_CASE("Concurrent events on different cameras simulate load/unload", "[gpu_l
     REQUIRE_FALSE(engine.isLoaded());
 }
 
+// ============================================================================
+// Session residency (idle TTL + coordinator eviction)
+// ============================================================================
+
+TEST_CASE("Acquire/release track active users", "[gpu_lifecycle][residency]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    engine.setIdleTtl(std::chrono::seconds(60));
+
+    engine.acquire();
+    engine.acquire();
+    REQUIRE(engine.residencyStats().active_users == 2);
+
+    engine.release();
+    engine.release();
+    REQUIRE(engine.residencyStats().active_users == 0);
+
+    // Extra release is harmless
+    engine.release();
+    REQUIRE(engine.residencyStats().active_users == 0);
+}
+
+TEST_CASE("Evict and idle unload are no-ops without a session", "[gpu_lifecycle][residency]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    engine.setIdleTtl(std::chrono::seconds(0));
+    REQUIRE(engine.idleTtl().count() == 0);
+
+    REQUIRE_FALSE(engine.evict());
+    REQUIRE_FALSE(engine.unloadIfIdle());
+
+    auto rs = engine.residencyStats();
+    REQUIRE_FALSE(rs.loaded);
+    REQUIRE(rs.loads == 0);
+    REQUIRE(rs.evictions == 0);
+}
+
+TEST_CASE("GpuCoordinator requestVram invokes eviction handler", "[gpu_lifecycle][residency]") {
+    GpuCoordinator coord;
+
+    // No handler installed: nothing evicted
+    REQUIRE_FALSE(coord.requestVram());
+
+    int calls = 0;
+    coord.setEvictionHandler([&calls]() { ++calls; return true; });
+    REQUIRE(coord.requestVram());
+    REQUIRE(calls == 1);
+    REQUIRE(coord.vramRequests() == 2);
+}
+
+TEST_CASE("Periodic vision request evicts unpinned detection sessions", "[gpu_lifecycle][residency]") {
+    auto model = test::writeMeanBoxModel("hms_periodic_vram.onnx");
+    hms::AppConfig config;
+    config.detection.model_path = model;
+    config.detection.gpu_enabled = false;
+    config.buffer.preroll_seconds = 2;
+    config.buffer.fps = 15;
+
+    auto service = std::make_shared<BufferService>(config);
+    service->loadDetectionModel();
+    auto engines = service->getEnginePool();
+    REQUIRE(engines);
+    auto engine = engines->primary();
+
+    // Handler as installed by main()
+    auto coord = std::make_shared<GpuCoordinator>();
+    coord->setEvictionHandler([engines]() { return engines->evict(); });
+    bool with_coordinator = GENERATE(true, false);
+    PeriodicSnapshotManager periodic(service, nullptr, with_coordinator ? coord : nullptr, config);
+
+    // Released after the last event: resident for the idle TTL
+    engines->acquire();
+    engines->release();
+    REQUIRE(engines->isLoaded());
+    auto evictions = engine->residencyStats().evictions;
+
+    // An event holds the session: moondream has to make do
+    engines->acquire();
+    periodic.freeGpuForVision();
+    REQUIRE(engines->isLoaded());
+    engines->release();
+
+    periodic.freeGpuForVision();
+    REQUIRE_FALSE(engines->isLoaded());
+    REQUIRE(engine->residencyStats().evictions == evictions + 1);
+    REQUIRE(coord->vramRequests() == (with_coordinator ? 2u : 0u));
+
+    service.reset();
+    std::filesystem::remove(model);
+    std::filesystem::remove(std::filesystem::path(model).replace_extension(".cpu.opt.onnx"));
+}
+
 // ============================================================================
 // VisionClient keep_alive=0 (Ollama model unloading)
 // ============================================================================
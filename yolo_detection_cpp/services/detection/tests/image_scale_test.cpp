@@ -0,0 +1,69 @@
+#include <catch2/catch_all.hpp>
+#include "image_scale.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace hms;
+
+TEST_CASE("scaledSize keeps the aspect ratio and never upscales", "[image_scale]") {
+    int w = 0, h = 0;
+    scaledSize(1920, 1080, 320, w, h);
+    REQUIRE(w == 320);
+    REQUIRE(h == 180);
+
+    scaledSize(640, 480, 320, w, h);
+    REQUIRE(w == 320);
+    REQUIRE(h == 240);
+
+    scaledSize(640, 480, 0, w, h);
+    REQUIRE(w == 640);
+    REQUIRE(h == 480);
+
+    scaledSize(200, 100, 320, w, h);  // already smaller
+    REQUIRE(w == 200);
+    REQUIRE(h == 100);
+
+    scaledSize(4000, 2, 100, w, h);   // at least one row
+    REQUIRE(h == 1);
+}
+
+TEST_CASE("downscaleArea averages each covered block", "[image_scale]") {
+    // 4x2 source: left 2x2 block black/white checker, right block solid (10,20,30)
+    const int sw = 4, sh = 2, sstride = 16;  // padded rows
+    std::vector<uint8_t> src(sstride * sh, 0xEE);
+    auto set = [&](int x, int y, uint8_t b, uint8_t g, uint8_t r) {
+        uint8_t* p = &src[y * sstride + x * 3];
+        p[0] = b; p[1] = g; p[2] = r;
+    };
+    set(0, 0, 0, 0, 0);       set(1, 0, 255, 255, 255);
+    set(0, 1, 255, 255, 255); set(1, 1, 0, 0, 0);
+    for (int y = 0; y < 2; ++y)
+        for (int x = 2; x < 4; ++x) set(x, y, 10, 20, 30);
+
+    std::vector<uint8_t> dst(2 * 3);
+    downscaleArea(src.data(), sw, sh, sstride, dst.data(), 2, 1, 2 * 3);
+    REQUIRE(dst[0] == 128);  // (0 + 255 + 255 + 0) / 4, rounded
+    REQUIRE(dst[1] == 128);
+    REQUIRE(dst[2] == 128);
+    REQUIRE(dst[3] == 10);
+    REQUIRE(dst[4] == 20);
+    REQUIRE(dst[5] == 30);
+}
+
+TEST_CASE("downscaleArea handles non-integer ratios and same size", "[image_scale]") {
+    const int sw = 7, sh = 5;
+    std::vector<uint8_t> src(sw * sh * 3);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<uint8_t>(i * 7);
+
+    // Same size is a copy
+    std::vector<uint8_t> same(src.size());
+    downscaleArea(src.data(), sw, sh, sw * 3, same.data(), sw, sh, sw * 3);
+    REQUIRE(same == src);
+
+    // A flat image stays flat at any ratio
+    std::vector<uint8_t> flat(sw * sh * 3, 77);
+    std::vector<uint8_t> out(3 * 2 * 3, 0);
+    downscaleArea(flat.data(), sw, sh, sw * 3, out.data(), 3, 2, 3 * 3);
+    for (auto v : out) REQUIRE(v == 77);
+}
@@ -0,0 +1,213 @@
+#include <catch2/catch_all.hpp>
+#include "inference_scheduler.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace hms;
+
+namespace {
+std::shared_ptr<FrameData> makeFrame(int w = 64, int h = 48, uint64_t n = 1) {
+    auto frame = std::make_shared<FrameData>();
+    frame->resize(w, h);
+    frame->frame_number = n;
+    frame->timestamp = SteadyClock::now();
+    return frame;
+}
+
+std::shared_ptr<DetectionEngine> makeUnloadedEngine() {
+    return std::make_shared<DetectionEngine>("/nonexistent.onnx");
+}
+}  // namespace
+
+TEST_CASE("detectBatch returns one result per frame", "[inference_scheduler]") {
+    auto engine = makeUnloadedEngine();
+    auto f1 = makeFrame();
+    auto f2 = makeFrame();
+    FrameData empty;
+
+    auto results = engine->detectBatch({f1.get(), &empty, f2.get()},
+                                       {DetectParams{}, DetectParams{}, DetectParams{}});
+    REQUIRE(results.size() == 3);
+    for (const auto& r : results) REQUIRE(r.empty());
+}
+
+TEST_CASE("Scheduler detects inline when not started", "[inference_scheduler]") {
+    InferenceScheduler scheduler(makeUnloadedEngine(), SchedulerConfig{});
+    REQUIRE_FALSE(scheduler.isRunning());
+
+    auto fut = scheduler.submit(makeFrame(), DetectParams{});
+    REQUIRE(fut.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    REQUIRE(fut.get().empty());
+
+    auto s = scheduler.stats();
+    REQUIRE(s.requests == 1);
+    REQUIRE(s.batches == 1);
+}
+
+TEST_CASE("Scheduler coalesces concurrent requests into batches", "[inference_scheduler]") {
+    SchedulerConfig cfg{.max_batch_size = 4, .max_wait_ms = 200};
+    InferenceScheduler scheduler(makeUnloadedEngine(), cfg);
+    scheduler.start();
+
+    std::vector<std::future<std::vector<Detection>>> futures;
+    for (int i = 0; i < 8; ++i) {
+        futures.push_back(scheduler.submit(makeFrame(64, 48, i + 1), DetectParams{}));
+    }
+    for (auto& f : futures) {
+        REQUIRE(f.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE(f.get().empty());
+    }
+
+    auto s = scheduler.stats();
+    REQUIRE(s.requests == 8);
+    REQUIRE(s.batches < 8);
+    REQUIRE(s.max_batch_size <= 4);
+    REQUIRE(s.queue_depth == 0);
+    scheduler.stop();
+}
+
+TEST_CASE("Scheduler dispatches event requests without waiting for deadline", "[inference_scheduler]") {
+    SchedulerConfig cfg{.max_batch_size = 8, .max_wait_ms = 2000};
+    InferenceScheduler scheduler(makeUnloadedEngine(), cfg);
+    scheduler.start();
+
+    auto start = std::chrono::steady_clock::now();
+    auto fut = scheduler.submit(makeFrame(), DetectParams{}, InferenceScheduler::Priority::Event);
+    REQUIRE(fut.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(elapsed < std::chrono::milliseconds(1000));
+
+    REQUIRE(scheduler.stats().event_requests == 1);
+    scheduler.stop();
+}
+
+TEST_CASE("Scheduler callback submit resolves off the caller's thread", "[inference_scheduler]") {
+    SchedulerConfig cfg{.max_batch_size = 8, .max_wait_ms = 2000};
+    InferenceScheduler scheduler(makeUnloadedEngine(), cfg);
+
+    // Not running: the callback runs inline
+    bool inline_done = false;
+    scheduler.submit(makeFrame(), DetectParams{}, InferenceScheduler::Priority::Event,
+                     [&](std::vector<Detection> dets) { inline_done = dets.empty(); });
+    REQUIRE(inline_done);
+
+    scheduler.start();
+    std::promise<std::thread::id> resolved_on;
+    scheduler.submit(makeFrame(), DetectParams{}, InferenceScheduler::Priority::Event,
+                     [&](std::vector<Detection>) { resolved_on.set_value(std::this_thread::get_id()); });
+    auto fut = resolved_on.get_future();
+    REQUIRE(fut.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    REQUIRE(fut.get() != std::this_thread::get_id());
+
+    // Still queued at stop: resolved with an empty result
+    std::promise<size_t> orphan;
+    scheduler.submit(makeFrame(), DetectParams{}, InferenceScheduler::Priority::Continuous,
+                     [&](std::vector<Detection> dets) { orphan.set_value(dets.size()); });
+    scheduler.stop();
+    auto orphan_fut = orphan.get_future();
+    REQUIRE(orphan_fut.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    REQUIRE(orphan_fut.get() == 0);
+    REQUIRE(scheduler.stats().requests == 3);
+}
+
+TEST_CASE("Scheduler stop resolves pending requests", "[inference_scheduler]") {
+    SchedulerConfig cfg{.max_batch_size = 64, .max_wait_ms = 5000};
+    InferenceScheduler scheduler(makeUnloadedEngine(), cfg);
+    scheduler.start();
+
+    auto fut = scheduler.submit(makeFrame(), DetectParams{});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    scheduler.stop();
+
+    REQUIRE(fut.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    REQUIRE(fut.get().empty());
+    REQUIRE_FALSE(scheduler.isRunning());
+}
+
+TEST_CASE("Scheduler spreads batches across pool sessions", "[inference_scheduler]") {
+    auto pool = std::make_shared<EnginePool>(std::vector<std::shared_ptr<DetectionEngine>>{
+        makeUnloadedEngine(),
+        std::make_shared<DetectionEngine>("/nonexistent.onnx", 80, false, "",
+                                          SessionConfig{.device = -1, .threads = 4}),
+    });
+    REQUIRE(pool->size() == 2);
+    REQUIRE_FALSE(pool->isLoaded());
+
+    SchedulerConfig cfg{.max_batch_size = 2, .max_wait_ms = 5};
+    InferenceScheduler scheduler(pool, cfg);
+    REQUIRE(scheduler.engine() == pool->primary());
+    scheduler.start();
+
+    std::vector<std::future<std::vector<Detection>>> futures;
+    for (int i = 0; i < 32; ++i) {
+        futures.push_back(scheduler.submit(makeFrame(64, 48, i + 1), DetectParams{}));
+    }
+    for (auto& f : futures) {
+        REQUIRE(f.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE(f.get().empty());
+    }
+
+    auto s = scheduler.stats();
+    REQUIRE(s.sessions.size() == 2);
+    REQUIRE(s.sessions[0].device == -1);  // CPU-only engine
+    REQUIRE(s.sessions[1].threads == 4);
+    uint64_t batches = 0, frames = 0;
+    for (const auto& session : s.sessions) {
+        REQUIRE_FALSE(session.loaded);
+        batches += session.batches;
+        frames += session.frames;
+    }
+    REQUIRE(batches == s.batches);
+    REQUIRE(frames == 32);
+    scheduler.stop();
+}
+
+TEST_CASE("Staged detection on an unloaded engine yields empty results", "[inference_scheduler]") {
+    auto engine = makeUnloadedEngine();
+    engine->setPipelineDepth(3);
+    REQUIRE(engine->pipelineDepth() == 3);
+    auto f1 = makeFrame();
+    auto f2 = makeFrame();
+
+    auto job = engine->prepareBatch({f1.get(), f2.get()}, {DetectParams{}, DetectParams{}});
+    REQUIRE(job.empty());
+    engine->runBatch(job);
+    auto results = engine->finishBatch(job);
+    REQUIRE(results.size() == 2);
+    for (const auto& r : results) REQUIRE(r.empty());
+}
+
+TEST_CASE("Scheduler pipelined and sequential stages resolve every request", "[inference_scheduler]") {
+    for (int depth : {1, 3}) {
+        SchedulerConfig cfg{.max_batch_size = 4, .max_wait_ms = 5, .pipeline_depth = depth};
+        InferenceScheduler scheduler(makeUnloadedEngine(), cfg);
+        scheduler.start();
+
+        std::vector<std::future<std::vector<Detection>>> futures;
+        for (int i = 0; i < 24; ++i) {
+            auto priority = i % 5 == 0 ? InferenceScheduler::Priority::Event
+                                       : InferenceScheduler::Priority::Continuous;
+            futures.push_back(scheduler.submit(makeFrame(64, 48, i + 1), DetectParams{}, priority));
+        }
+        for (auto& f : futures) {
+            REQUIRE(f.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            REQUIRE(f.get().empty());
+        }
+        scheduler.stop();
+
+        auto s = scheduler.stats();
+        REQUIRE(s.sessions.size() == 1);
+        REQUIRE(s.sessions[0].frames == 24);
+        REQUIRE(s.sessions[0].preprocess_ms >= 0);
+        REQUIRE(s.sessions[0].postprocess_ms >= 0);
+
+        // Restartable: the stage queues reopen
+        scheduler.start();
+        auto fut = scheduler.submit(makeFrame(), DetectParams{}, InferenceScheduler::Priority::Event);
+        REQUIRE(fut.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+        scheduler.stop();
+    }
+}
@@ -0,0 +1,117 @@
+#include <catch2/catch_all.hpp>
+#include "jpeg_encoder.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hms;
+
+namespace {
+
+/// Noisy BGR image (so quality affects size), rows padded to `stride`
+std::vector<uint8_t> makeImage(int width, int height, int stride) {
+    std::vector<uint8_t> bgr(static_cast<size_t>(stride) * height, 0);
+    uint32_t seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width * 3; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            bgr[static_cast<size_t>(y) * stride + x] = static_cast<uint8_t>((x + y) / 2 + (seed >> 28));
+        }
+    }
+    return bgr;
+}
+
+bool isJpeg(const std::string& jpeg) {
+    return jpeg.size() > 4
+        && static_cast<uint8_t>(jpeg[0]) == 0xFF && static_cast<uint8_t>(jpeg[1]) == 0xD8
+        && static_cast<uint8_t>(jpeg[jpeg.size() - 2]) == 0xFF
+        && static_cast<uint8_t>(jpeg[jpeg.size() - 1]) == 0xD9;
+}
+
+}  // namespace
+
+TEST_CASE("JpegEncoder encodes padded BGR rows", "[jpeg_encoder]") {
+    const int w = 160, h = 90, stride = 512;
+    auto bgr = makeImage(w, h, stride);
+    auto jpeg = JpegEncoder::encode(bgr.data(), w, h, stride);
+    REQUIRE(isJpeg(jpeg));
+}
+
+TEST_CASE("JpegEncoder reuses its per-thread state", "[jpeg_encoder]") {
+    const int w = 320, h = 180;
+    auto bgr = makeImage(w, h, w * 3);
+
+    // On a fresh thread: the first encode sets the encoder up, repeats reuse it
+    uint64_t created = 0;
+    std::thread([&] {
+        std::string out;
+        REQUIRE(JpegEncoder::encode(bgr.data(), w, h, w * 3, 85, out));
+        auto after_first = JpegEncoder::stats().contexts_created;
+        for (int i = 0; i < 5; ++i) {
+            REQUIRE(JpegEncoder::encode(bgr.data(), w, h, w * 3, 85, out));
+            REQUIRE(isJpeg(out));
+        }
+        created = JpegEncoder::stats().contexts_created - after_first;
+    }).join();
+    REQUIRE(created == 0);
+
+    auto stats = JpegEncoder::stats();
+    REQUIRE(stats.encodes >= 6);
+    REQUIRE(stats.avg_encode_ms > 0);
+    REQUIRE((std::string(stats.backend) == "turbojpeg" || std::string(stats.backend) == "ffmpeg"));
+}
+
+TEST_CASE("JpegEncoder quality trades size", "[jpeg_encoder]") {
+    const int w = 320, h = 180;
+    auto bgr = makeImage(w, h, w * 3);
+    auto high = JpegEncoder::encode(bgr.data(), w, h, w * 3, 95);
+    auto low = JpegEncoder::encode(bgr.data(), w, h, w * 3, 30);
+    REQUIRE(isJpeg(high));
+    REQUIRE(isJpeg(low));
+    REQUIRE(low.size() < high.size());
+
+    // Alternating sizes on one thread stay correct
+    auto small = makeImage(64, 48, 64 * 3);
+    REQUIRE(isJpeg(JpegEncoder::encode(small.data(), 64, 48, 64 * 3, 95)));
+    REQUIRE(JpegEncoder::encode(bgr.data(), w, h, w * 3, 95) == high);
+}
+
+TEST_CASE("JpegEncoder rejects invalid input", "[jpeg_encoder]") {
+    std::vector<uint8_t> bgr(64 * 3 * 8);
+    auto failures = JpegEncoder::stats().failures;
+    std::string out = "stale";
+    REQUIRE_FALSE(JpegEncoder::encode(nullptr, 64, 8, 64 * 3, 90, out));
+    REQUIRE(out.empty());
+    REQUIRE(JpegEncoder::encode(bgr.data(), 0, 8, 64 * 3).empty());
+    REQUIRE(JpegEncoder::encode(bgr.data(), 64, 8, 64).empty());  // stride shorter than a row
+    REQUIRE(JpegEncoder::stats().failures == failures);           // rejected before encoding
+}
+
+TEST_CASE("JpegEncoder encodes a frame and its thumbnail in one call", "[jpeg_encoder]") {
+    const int w = 640, h = 360, stride = 640 * 3 + 64;
+    auto bgr = makeImage(w, h, stride);
+
+    // Listed smallest first: order doesn't matter
+    JpegEncoder::Output outputs[3];
+    outputs[0].max_width = 160;
+    outputs[0].quality = 70;
+    outputs[2].max_width = 320;
+    REQUIRE(JpegEncoder::encode(bgr.data(), w, h, stride, outputs));
+
+    REQUIRE(outputs[1].width == w);
+    REQUIRE(outputs[1].height == h);
+    REQUIRE(outputs[1].jpeg == JpegEncoder::encode(bgr.data(), w, h, stride));
+    REQUIRE(outputs[2].width == 320);
+    REQUIRE(outputs[2].height == 180);
+    REQUIRE(outputs[0].width == 160);
+    REQUIRE(outputs[0].height == 90);
+    for (const auto& out : outputs) REQUIRE(isJpeg(out.jpeg));
+    REQUIRE(outputs[0].jpeg.size() < outputs[2].jpeg.size());
+    REQUIRE(outputs[2].jpeg.size() < outputs[1].jpeg.size());
+
+    JpegEncoder::Output bad[1];
+    REQUIRE_FALSE(JpegEncoder::encode(nullptr, w, h, stride, bad));
+    REQUIRE(bad[0].jpeg.empty());
+}
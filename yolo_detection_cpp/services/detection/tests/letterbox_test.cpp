@@ -0,0 +1,151 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "detection_engine.h"
+#include "letterbox.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace hms;
+using Catch::Matchers::WithinAbs;
+
+namespace {
+// Pseudo-random BGR24 frame so index mistakes show up as value mismatches
+FrameData makeNoiseFrame(int w, int h) {
+    FrameData frame;
+    frame.resize(w, h);
+    uint32_t state = 12345;
+    for (auto& px : frame.pixels) {
+        state = state * 1664525u + 1013904223u;
+        px = static_cast<uint8_t>(state >> 24);
+    }
+    return frame;
+}
+
+// The original per-pixel nearest-neighbor letterbox, kept as the reference
+std::vector<float> referenceNearest(const FrameData& frame, int dst_w, int dst_h) {
+    float scale = std::min(static_cast<float>(dst_w) / frame.width,
+                           static_cast<float>(dst_h) / frame.height);
+    int new_w = static_cast<int>(std::round(frame.width * scale));
+    int new_h = static_cast<int>(std::round(frame.height * scale));
+    int pad_left = static_cast<int>(std::round((dst_w - new_w) / 2.0f));
+    int pad_top = static_cast<int>(std::round((dst_h - new_h) / 2.0f));
+
+    size_t plane = static_cast<size_t>(dst_w) * dst_h;
+    std::vector<float> tensor(3 * plane, 114.0f / 255.0f);
+    for (int dy = 0; dy < new_h; ++dy) {
+        int sy = std::min(static_cast<int>(dy / scale), frame.height - 1);
+        int oy = dy + pad_top;
+        if (oy < 0 || oy >= dst_h) continue;
+        for (int dx = 0; dx < new_w; ++dx) {
+            int sx = std::min(static_cast<int>(dx / scale), frame.width - 1);
+            int ox = dx + pad_left;
+            if (ox < 0 || ox >= dst_w) continue;
+            const uint8_t* px = frame.pixels.data() + sy * frame.stride + sx * 3;
+            size_t off = static_cast<size_t>(oy) * dst_w + ox;
+            tensor[off] = px[2] / 255.0f;
+            tensor[plane + off] = px[1] / 255.0f;
+            tensor[2 * plane + off] = px[0] / 255.0f;
+        }
+    }
+    return tensor;
+}
+}  // namespace
+
+TEST_CASE("normalizeU8 matches scalar for all lengths", "[letterbox]") {
+    std::vector<uint8_t> src(67);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<uint8_t>(i * 37);
+
+    for (size_t n : {0u, 1u, 15u, 16u, 17u, 33u, 67u}) {
+        std::vector<float> dst(n + 1, -1.0f);
+        normalizeU8(src.data(), dst.data(), n);
+        for (size_t i = 0; i < n; ++i) {
+            REQUIRE_THAT(dst[i], WithinAbs(src[i] / 255.0f, 1e-6f));
+        }
+        REQUIRE(dst[n] == -1.0f);  // no overrun
+    }
+}
+
+TEST_CASE("Nearest letterbox matches the original scalar preprocess", "[letterbox]") {
+    for (auto [w, h] : {std::pair{640, 480}, std::pair{1920, 1080}, std::pair{703, 997}}) {
+        auto frame = makeNoiseFrame(w, h);
+        auto plan = LetterboxPlan::make(w, h, 640, 640, ResizeMode::Nearest);
+
+        std::vector<float> tensor(3 * 640 * 640, -1.0f);
+        letterboxToTensor(plan, frame.pixels.data(), frame.stride, tensor.data());
+
+        auto expected = referenceNearest(frame, 640, 640);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < tensor.size(); ++i) {
+            if (std::abs(tensor[i] - expected[i]) > 1e-6f) ++mismatches;
+        }
+        INFO(w << "x" << h);
+        REQUIRE(mismatches == 0);
+    }
+}
+
+TEST_CASE("Bilinear letterbox preserves uniform color and padding", "[letterbox]") {
+    FrameData frame;
+    frame.resize(1280, 720);
+    for (size_t i = 0; i < frame.pixels.size(); i += 3) {
+        frame.pixels[i] = 10;       // B
+        frame.pixels[i + 1] = 100;  // G
+        frame.pixels[i + 2] = 200;  // R
+    }
+
+    auto plan = LetterboxPlan::make(1280, 720, 640, 640, ResizeMode::Bilinear);
+    REQUIRE(plan.new_w == 640);
+    REQUIRE(plan.new_h == 360);
+    REQUIRE(plan.pad_top == 140);
+
+    std::vector<float> tensor(3 * 640 * 640);
+    letterboxToTensor(plan, frame.pixels.data(), frame.stride, tensor.data());
+
+    size_t plane = 640 * 640;
+    size_t center = 320 * 640 + 320;
+    REQUIRE_THAT(tensor[center], WithinAbs(200 / 255.0f, 1e-6f));
+    REQUIRE_THAT(tensor[plane + center], WithinAbs(100 / 255.0f, 1e-6f));
+    REQUIRE_THAT(tensor[2 * plane + center], WithinAbs(10 / 255.0f, 1e-6f));
+    REQUIRE_THAT(tensor[0], WithinAbs(114 / 255.0f, 1e-6f));
+    REQUIRE_THAT(tensor[plane - 1], WithinAbs(114 / 255.0f, 1e-6f));
+}
+
+TEST_CASE("Bilinear letterbox interpolates a horizontal ramp", "[letterbox]") {
+    // 2x downscale of a ramp: each output is the mean of two neighbouring inputs
+    FrameData frame;
+    frame.resize(1280, 1280);
+    for (int y = 0; y < 1280; ++y) {
+        for (int x = 0; x < 1280; ++x) {
+            auto* px = frame.pixels.data() + y * frame.stride + x * 3;
+            px[0] = px[1] = px[2] = static_cast<uint8_t>(x / 8);
+        }
+    }
+
+    auto plan = LetterboxPlan::make(1280, 1280, 640, 640, ResizeMode::Bilinear);
+    std::vector<float> tensor(3 * 640 * 640);
+    letterboxToTensor(plan, frame.pixels.data(), frame.stride, tensor.data());
+
+    for (int dx : {1, 100, 321, 638}) {
+        float expected = ((2 * dx) / 8 + (2 * dx + 1) / 8) / 2.0f / 255.0f;
+        REQUIRE_THAT(tensor[100 * 640 + dx], WithinAbs(expected, 1.0f / 255.0f));
+    }
+}
+
+TEST_CASE("Engine caches plans and honors resize mode", "[letterbox]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    REQUIRE(engine.resizeMode() == ResizeMode::Nearest);
+
+    auto frame = makeNoiseFrame(800, 600);
+    float scale, pad_x, pad_y;
+    auto nearest = engine.preprocess(frame, scale, pad_x, pad_y);
+    auto again = engine.preprocess(frame, scale, pad_x, pad_y);
+    REQUIRE(nearest == again);
+
+    engine.setResizeMode(ResizeMode::Bilinear);
+    auto bilinear = engine.preprocess(frame, scale, pad_x, pad_y);
+    REQUIRE(bilinear.size() == nearest.size());
+    REQUIRE(bilinear != nearest);
+    REQUIRE_THAT(scale, WithinAbs(0.8f, 1e-6f));
+    REQUIRE_THAT(pad_y, WithinAbs(80.0f, 1e-6f));
+}
@@ -0,0 +1,193 @@
+#include <catch2/catch_all.hpp>
+#include "live_stream.h"
+#include "buffer_service.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace hms;
+
+namespace {
+
+hms::AppConfig makeConfig() {
+    hms::AppConfig config;
+    config.buffer.preroll_seconds = 1;
+    config.buffer.fps = 15;
+
+    hms::CameraConfig cam;
+    cam.id = "cam";
+    cam.name = "Live Camera";
+    cam.rtsp_url = "rtsp://localhost:8554/nonexistent";
+    cam.enabled = true;
+    config.cameras["cam"] = cam;
+    return config;
+}
+
+/// Records what it is sent; `backlog` is set by the test
+struct FakeViewer : LiveStream::Subscriber {
+    mutable std::mutex mutex;
+    std::vector<LiveStream::Chunk> chunks;
+    std::atomic<size_t> pending{0};
+    std::atomic<bool> open{true};
+
+    bool send(const LiveStream::Chunk& chunk) override {
+        if (!open) return false;
+        std::lock_guard lock(mutex);
+        chunks.push_back(chunk);
+        return true;
+    }
+    size_t backlog() const override { return pending; }
+    bool connected() const override { return open; }
+
+    size_t count() const {
+        std::lock_guard lock(mutex);
+        return chunks.size();
+    }
+    LiveStream::Chunk last() const {
+        std::lock_guard lock(mutex);
+        return chunks.empty() ? nullptr : chunks.back();
+    }
+};
+
+void pushFrame(BufferService& svc, uint64_t n) {
+    auto frame = std::make_shared<FrameData>();
+    frame->resize(64, 48);
+    std::fill(frame->pixels.data(), frame->pixels.data() + frame->pixels.size(), static_cast<uint8_t>(n * 7));
+    frame->frame_number = n;
+    frame->timestamp = SteadyClock::now();
+    svc.getCameraBuffer("cam")->push(std::move(frame));
+}
+
+template <typename Pred>
+bool waitFor(Pred pred, int timeout_ms = 5000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+/// Push frames until `pred` holds (the stream thread may join late)
+template <typename Pred>
+bool feedUntil(BufferService& svc, Pred pred, int max_frames = 200) {
+    for (int n = 1; n <= max_frames; ++n) {
+        pushFrame(svc, n);
+        if (waitFor(pred, 20)) return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+TEST_CASE("LiveStream MJPEG parts are framed for multipart/x-mixed-replace", "[live_stream]") {
+    std::string jpeg = "\xff\xd8 JPEG \xff\xd9";
+    auto part = LiveStream::mjpegPart(jpeg);
+    REQUIRE(part.starts_with("--hmsframe\r\nContent-Type: image/jpeg\r\nContent-Length: 10\r\n\r\n"));
+    REQUIRE(part.ends_with(jpeg + "\r\n"));
+
+    REQUIRE(LiveStream::contentType({}) == "multipart/x-mixed-replace; boundary=hmsframe");
+    REQUIRE(LiveStream::contentType({.format = LiveStream::Format::Fmp4}) == "video/mp4");
+}
+
+TEST_CASE("LiveStream encodes once for every viewer of a variant", "[live_stream]") {
+    auto svc = std::make_shared<BufferService>(makeConfig());
+    LiveStream live(svc, {});
+
+    auto a = std::make_shared<FakeViewer>();
+    auto b = std::make_shared<FakeViewer>();
+    auto other = std::make_shared<FakeViewer>();
+    REQUIRE(live.subscribe("cam", {}, a));
+    REQUIRE(live.subscribe("cam", {}, b));
+    REQUIRE(live.subscribe("cam", {.quality = 40}, other));
+    REQUIRE_FALSE(live.subscribe("nope", {}, std::make_shared<FakeViewer>()));
+
+    REQUIRE(feedUntil(*svc, [&] { return a->count() >= 3 && b->count() >= 3 && other->count() >= 3; }));
+    REQUIRE(live.stats().streams == 2);
+    REQUIRE(live.stats().subscribers == 3);
+
+    live.stop();
+    live.stop();  // idempotent
+    REQUIRE(live.stats().streams == 0);
+
+    // Same bytes, same buffer: each JPEG was produced once and shared
+    REQUIRE(a->chunks == b->chunks);
+    REQUIRE_FALSE(a->chunks.front() == other->chunks.front());
+    REQUIRE(a->chunks.front()->starts_with("--hmsframe\r\n"));
+
+    auto stats = live.stats();
+    REQUIRE(stats.frames_encoded == a->count() + other->count());
+    REQUIRE(stats.chunks_sent == a->count() + b->count() + other->count());
+    REQUIRE_FALSE(live.subscribe("cam", {}, std::make_shared<FakeViewer>()));
+}
+
+TEST_CASE("LiveStream drops frames for a slow viewer instead of buffering", "[live_stream]") {
+    auto svc = std::make_shared<BufferService>(makeConfig());
+    LiveStream live(svc, {.max_backlog = 1000});
+
+    auto fast = std::make_shared<FakeViewer>();
+    auto slow = std::make_shared<FakeViewer>();
+    slow->pending = 5000;
+    REQUIRE(live.subscribe("cam", {}, fast));
+    REQUIRE(live.subscribe("cam", {}, slow));
+
+    REQUIRE(feedUntil(*svc, [&] { return fast->count() >= 3; }));
+    REQUIRE(slow->count() == 0);
+    REQUIRE(live.stats().frames_dropped >= 3);
+
+    // Caught up: it gets the next frame, not the ones it missed
+    slow->pending = 0;
+    REQUIRE(feedUntil(*svc, [&] { return slow->count() >= 1; }));
+    REQUIRE(slow->last() == fast->last());
+
+    SECTION("nobody able to take a frame: nothing is encoded") {
+        fast->pending = 5000;
+        slow->pending = 5000;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));  // in-flight frame lands
+        auto encoded = live.stats().frames_encoded;
+        feedUntil(*svc, [&] { return live.stats().frames_skipped >= 3; });
+        REQUIRE(live.stats().frames_skipped >= 3);
+        REQUIRE(live.stats().frames_encoded <= encoded + 1);
+    }
+}
+
+TEST_CASE("LiveStream does not count a departed viewer's frames as dropped", "[live_stream]") {
+    auto svc = std::make_shared<BufferService>(makeConfig());
+    LiveStream live(svc, {.max_backlog = 1000});
+
+    auto fast = std::make_shared<FakeViewer>();
+    auto slow = std::make_shared<FakeViewer>();
+    slow->pending = 5000;  // never sent to, so send() can't notice it left
+    REQUIRE(live.subscribe("cam", {}, fast));
+    REQUIRE(live.subscribe("cam", {}, slow));
+    REQUIRE(feedUntil(*svc, [&] { return live.stats().frames_dropped >= 1; }));
+
+    slow->open = false;
+    REQUIRE(feedUntil(*svc, [&] { return live.stats().subscribers == 1; }));
+    auto dropped = live.stats().frames_dropped;
+    auto sent = fast->count();
+    REQUIRE(feedUntil(*svc, [&] { return fast->count() >= sent + 3; }));
+    REQUIRE(live.stats().frames_dropped == dropped);
+}
+
+TEST_CASE("LiveStream stops a variant when its last viewer leaves", "[live_stream]") {
+    auto svc = std::make_shared<BufferService>(makeConfig());
+    LiveStream live(svc, {});
+
+    auto viewer = std::make_shared<FakeViewer>();
+    REQUIRE(live.subscribe("cam", {.annotate = true}, viewer));
+    REQUIRE(feedUntil(*svc, [&] { return viewer->count() >= 1; }));
+
+    viewer->open = false;  // client disconnected
+    REQUIRE(feedUntil(*svc, [&] { return live.stats().streams == 0; }));
+    REQUIRE(live.stats().subscribers == 0);
+
+    // A new viewer restarts it
+    auto again = std::make_shared<FakeViewer>();
+    REQUIRE(live.subscribe("cam", {.annotate = true}, again));
+    REQUIRE(feedUntil(*svc, [&] { return again->count() >= 1; }));
+    REQUIRE(live.stats().streams == 1);
+}
@@ -0,0 +1,107 @@
+#include <catch2/catch_all.hpp>
+#include "metrics.h"
+
+#include <chrono>
+#include <string>
+
+using namespace hms;
+using namespace std::chrono_literals;
+
+namespace {
+
+bool contains(const std::string& text, const std::string& line) {
+    return text.find(line + "\n") != std::string::npos;
+}
+
+}  // namespace
+
+TEST_CASE("Metrics histogram buckets are powers of two from 8us", "[metrics]") {
+    Metrics::Histogram h;
+    h.observe(0ns);
+    h.observe(8us);          // bucket 0 (le 8us)
+    h.observe(8001ns);       // bucket 1 (le 16us)
+    h.observe(16us);
+    h.observe(1ms);          // 1000us: (512, 1024] -> bucket 7
+    h.observe(1000s);        // beyond 67s: +Inf
+
+    auto s = h.snapshot();
+    REQUIRE(s.count == 6);
+    REQUIRE(s.buckets[0] == 2);
+    REQUIRE(s.buckets[1] == 2);
+    REQUIRE(s.buckets[7] == 1);
+    REQUIRE(s.buckets[Metrics::Histogram::kBuckets] == 1);
+    REQUIRE(s.sum_seconds == Catch::Approx(1000.001032));
+    REQUIRE(Metrics::Histogram::bound(0) == Catch::Approx(8e-6));
+    REQUIRE(Metrics::Histogram::bound(Metrics::Histogram::kBuckets - 1) == Catch::Approx(67.108864));
+}
+
+TEST_CASE("Metrics snapshots merge and estimate quantiles", "[metrics]") {
+    Metrics::Histogram a, b;
+    for (int i = 0; i < 90; ++i) a.observe(1ms);  // (512us, 1024us]
+    for (int i = 0; i < 10; ++i) b.observe(30ms);  // (16.4ms, 32.8ms]
+
+    auto s = a.snapshot();
+    s.merge(b.snapshot());
+    REQUIRE(s.count == 100);
+    REQUIRE(s.meanSeconds() == Catch::Approx(0.0039));
+    REQUIRE(s.quantileSeconds(0.5) > 512e-6);
+    REQUIRE(s.quantileSeconds(0.5) <= 1024e-6);
+    REQUIRE(s.quantileSeconds(0.99) > 16.384e-3);
+    REQUIRE(s.quantileSeconds(0.99) <= 32.768e-3);
+    REQUIRE(s.quantileSeconds(0.0) >= 512e-6);
+    REQUIRE(Metrics::Histogram::Snapshot{}.quantileSeconds(0.5) == 0.0);
+}
+
+TEST_CASE("Metrics registry hands out one histogram per stage and camera", "[metrics]") {
+    auto& a = Metrics::histogram(Metrics::Stage::Decode, "metrics_test_cam");
+    auto& b = Metrics::histogram(Metrics::Stage::Decode, "metrics_test_cam");
+    auto& c = Metrics::histogram(Metrics::Stage::Decode, "metrics_test_other");
+    auto& d = Metrics::histogram(Metrics::Stage::Convert, "metrics_test_cam");
+    REQUIRE(&a == &b);
+    REQUIRE(&a != &c);
+    REQUIRE(&a != &d);
+    REQUIRE(&Metrics::counter(Metrics::CounterId::Events, "x") == &Metrics::counter(Metrics::CounterId::Events, "x"));
+}
+
+TEST_CASE("Metrics timers skip spans begun while disabled", "[metrics]") {
+    Metrics::Histogram h;
+    Metrics::observe(h, std::chrono::steady_clock::time_point{});
+    REQUIRE(h.snapshot().count == 0);
+
+    Metrics::enable();
+    {
+        Metrics::Timer timer(h);
+    }
+    Metrics::observe(h, Metrics::start());
+    REQUIRE(h.snapshot().count == 2);
+}
+
+TEST_CASE("Metrics render Prometheus text format", "[metrics]") {
+    auto& h = Metrics::histogram(Metrics::Stage::JpegEncode, "render \"cam\"\\1");
+    h.observe(10us);
+    h.observe(3ms);
+    Metrics::counter(Metrics::CounterId::FramesDropped, "render_cam").add(3);
+    Metrics::histogram(Metrics::Stage::Decode, "render_a");
+    Metrics::histogram(Metrics::Stage::Decode, "render_b");
+
+    auto text = Metrics::render();
+    REQUIRE(Metrics::enabled());
+
+    const std::string name = "hms_jpeg_encode_seconds";
+    const std::string label = "camera=\"render \\\"cam\\\"\\\\1\"";
+    REQUIRE(contains(text, "# TYPE " + name + " histogram"));
+    REQUIRE(contains(text, name + "_bucket{" + label + ",le=\"8e-06\"} 0"));
+    REQUIRE(contains(text, name + "_bucket{" + label + ",le=\"1.6e-05\"} 1"));  // cumulative
+    REQUIRE(contains(text, name + "_bucket{" + label + ",le=\"0.004096\"} 2"));
+    REQUIRE(contains(text, name + "_bucket{" + label + ",le=\"+Inf\"} 2"));
+    REQUIRE(contains(text, name + "_count{" + label + "} 2"));
+    REQUIRE(contains(text, name + "_sum{" + label + "} 0.00301"));
+
+    REQUIRE(contains(text, "# TYPE hms_frames_dropped_total counter"));
+    REQUIRE(contains(text, "hms_frames_dropped_total{camera=\"render_cam\"} 3"));
+
+    // One HELP/TYPE header per metric, however many cameras
+    auto first = text.find("# TYPE hms_decode_seconds");
+    REQUIRE(first != std::string::npos);
+    REQUIRE(text.find("# TYPE hms_decode_seconds", first + 1) == std::string::npos);
+}
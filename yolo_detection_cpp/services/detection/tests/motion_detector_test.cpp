@@ -0,0 +1,145 @@
+#include <catch2/catch_all.hpp>
+#include "motion_detector.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace hms;
+
+namespace {
+
+constexpr int kW = 320;
+constexpr int kH = 180;
+
+/// Grey BGR frame with an optional bright square at (x, y)
+FrameData makeScene(uint8_t grey, int square_x = -1, int square_y = 0, int square = 60) {
+    FrameData f;
+    f.resize(kW, kH);
+    std::fill(f.pixels.begin(), f.pixels.end(), grey);
+    if (square_x >= 0) {
+        for (int y = square_y; y < square_y + square; ++y) {
+            std::fill_n(f.pixels.data() + static_cast<size_t>(y) * f.stride + square_x * 3,
+                        square * 3, uint8_t{250});
+        }
+    }
+    return f;
+}
+
+/// Native picture with only a Y plane; counts BGR conversions
+class LumaOnlyFrame : public NativeFrame {
+public:
+    LumaOnlyFrame(std::vector<uint8_t> y, std::atomic<int>& conversions)
+        : y_(std::move(y)), conversions_(conversions) {}
+
+    bool toBgr(uint8_t* dst, int stride) override {
+        ++conversions_;
+        for (int row = 0; row < kH; ++row) {
+            for (int x = 0; x < kW; ++x) {
+                std::fill_n(dst + static_cast<size_t>(row) * stride + x * 3, 3, y_[row * kW + x]);
+            }
+        }
+        return true;
+    }
+    void release() override {}
+    const uint8_t* luma(int& stride) override {
+        stride = kW;
+        return y_.data();
+    }
+
+private:
+    std::vector<uint8_t> y_;
+    std::atomic<int>& conversions_;
+};
+
+}  // namespace
+
+TEST_CASE("MotionDetector static scene is not motion", "[motion_detector]") {
+    MotionDetector md;
+    auto scene = makeScene(90, 100, 40);
+
+    auto first = md.update(scene);
+    REQUIRE_FALSE(first.motion);  // seeds the background
+    for (int i = 0; i < 5; ++i) {
+        auto r = md.update(scene);
+        REQUIRE_FALSE(r.motion);
+        REQUIRE(r.changed == 0.0);
+    }
+}
+
+TEST_CASE("MotionDetector ignores a global brightness shift", "[motion_detector]") {
+    MotionDetector md;
+    md.update(makeScene(90));
+    REQUIRE_FALSE(md.update(makeScene(130)).motion);  // exposure / IR switch-over
+}
+
+TEST_CASE("MotionDetector detects a moving object", "[motion_detector]") {
+    MotionDetector md;
+    md.update(makeScene(60, 0, 40));
+    auto r = md.update(makeScene(60, 200, 40));
+    REQUIRE(r.motion);
+    REQUIRE(r.changed > 0.01);
+    REQUIRE(r.changed < 0.5);
+}
+
+TEST_CASE("MotionDetector reports which regions changed", "[motion_detector]") {
+    MotionDetector md;
+    md.update(makeScene(60, 0, 40));
+    REQUIRE(md.update(makeScene(60, 200, 40)).motion);
+
+    const auto& cells = md.changedCells();
+    REQUIRE(MotionDetector::touches(cells, Region{0, 0, 160, 180}, kW, kH));     // left: square left
+    REQUIRE(MotionDetector::touches(cells, Region{160, 0, 160, 180}, kW, kH));   // right: square arrived
+    REQUIRE_FALSE(MotionDetector::touches(cells, Region{0, 120, kW, 60}, kW, kH));  // below both
+}
+
+TEST_CASE("MotionDetector respects the changed-area threshold", "[motion_detector]") {
+    MotionDetector md(MotionDetector::Options{.cell_threshold = 12, .min_changed = 0.5});
+    md.update(makeScene(60, 0, 40));
+    auto r = md.update(makeScene(60, 200, 40));
+    REQUIRE_FALSE(r.motion);
+    REQUIRE(r.changed > 0.0);
+}
+
+TEST_CASE("MotionDetector resolution change reseeds", "[motion_detector]") {
+    MotionDetector md;
+    md.update(makeScene(60));
+    FrameData bigger;
+    bigger.resize(kW * 2, kH * 2);
+    std::fill(bigger.pixels.begin(), bigger.pixels.end(), uint8_t{200});
+    REQUIRE_FALSE(md.update(bigger).motion);
+
+    FrameData tiny;
+    tiny.resize(8, 8);
+    REQUIRE(md.update(tiny).changed == 0.0);  // too small for the grid: ignored
+}
+
+TEST_CASE("MotionDetector reads the native luma plane without converting", "[motion_detector]") {
+    std::atomic<int> conversions{0};
+    auto nativeFrame = [&](int square_x) {
+        std::vector<uint8_t> y(static_cast<size_t>(kW) * kH, 70);
+        for (int row = 40; row < 100; ++row) {
+            std::fill_n(y.data() + row * kW + square_x, 60, uint8_t{240});
+        }
+        auto f = std::make_unique<FrameData>();
+        f->attachNative(std::make_unique<LumaOnlyFrame>(std::move(y), conversions));
+        f->markNative(kW, kH);
+        return f;
+    };
+
+    MotionDetector md;
+    auto a = nativeFrame(0);
+    auto b = nativeFrame(200);
+    md.update(*a);
+    REQUIRE(md.update(*b).motion);
+    REQUIRE(conversions == 0);
+    REQUIRE(b->isPendingBgr());
+
+    // Once converted, the grid comes from the BGR pixels instead
+    REQUIRE(b->ensureBgr());
+    REQUIRE(conversions == 1);
+    std::array<uint8_t, MotionDetector::kCols * MotionDetector::kRows> native_grid, bgr_grid;
+    REQUIRE(MotionDetector::lumaGrid(*a, native_grid));
+    REQUIRE(MotionDetector::lumaGrid(*b, bgr_grid));
+    REQUIRE(native_grid != bgr_grid);
+    REQUIRE(conversions == 1);
+}
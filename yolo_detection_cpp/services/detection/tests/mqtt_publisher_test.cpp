@@ -0,0 +1,164 @@
+#include <catch2/catch_all.hpp>
+#include "mqtt_publisher.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace hms;
+using json = nlohmann::json;
+
+namespace {
+
+/// Transport that records messages and can hold the sender (a stalled broker)
+struct FakeBroker {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool held = false;
+    bool in_send = false;
+    std::vector<std::pair<std::string, std::string>> sent;
+
+    MqttPublisher::Transport transport() {
+        return [this](const std::string& topic, const std::string& payload, int, bool) {
+            std::unique_lock lock(mutex);
+            in_send = true;
+            cv.notify_all();
+            cv.wait(lock, [this] { return !held; });
+            in_send = false;
+            if (topic == "fail") throw std::runtime_error("not connected");
+            sent.emplace_back(topic, payload);
+            cv.notify_all();
+        };
+    }
+
+    void hold() {
+        std::lock_guard lock(mutex);
+        held = true;
+    }
+    void release() {
+        {
+            std::lock_guard lock(mutex);
+            held = false;
+        }
+        cv.notify_all();
+    }
+    /// Wait until the sender is blocked inside a send
+    void waitInSend() {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this] { return in_send; });
+    }
+    bool waitSent(size_t n) {
+        std::unique_lock lock(mutex);
+        return cv.wait_for(lock, std::chrono::seconds(5), [&] { return sent.size() >= n; });
+    }
+    std::vector<std::pair<std::string, std::string>> messages() {
+        std::lock_guard lock(mutex);
+        return sent;
+    }
+};
+
+}  // namespace
+
+TEST_CASE("MqttPublisher sends messages in order off the caller's thread", "[mqtt_publisher]") {
+    FakeBroker broker;
+    MqttPublisher publisher(broker.transport(), {});
+
+    broker.hold();
+    publisher.publish("a", json{{"n", 1}});
+    broker.waitInSend();
+    // The broker is stuck; publish() still returns at once
+    auto start = std::chrono::steady_clock::now();
+    publisher.publish("b", json{{"n", 2}});
+    publisher.publish("c", json{{"text", "with \"quotes\""}});
+    publisher.publish("d", json{{"n", 4}});  // shorter than the last: no stale tail
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+    REQUIRE(publisher.stats().queued == 3);
+
+    broker.release();
+    REQUIRE(broker.waitSent(4));
+    auto sent = broker.messages();
+    REQUIRE(sent[0] == std::pair<std::string, std::string>{"a", R"({"n":1})"});
+    REQUIRE(sent[1] == std::pair<std::string, std::string>{"b", R"({"n":2})"});
+    REQUIRE(json::parse(sent[2].second)["text"] == "with \"quotes\"");
+    REQUIRE(sent[3] == std::pair<std::string, std::string>{"d", R"({"n":4})"});
+
+    publisher.stop();
+    auto stats = publisher.stats();
+    REQUIRE(stats.published == 4);
+    REQUIRE(stats.queued == 0);
+    REQUIRE(stats.max_latency_ms >= stats.avg_latency_ms);
+    REQUIRE(stats.avg_latency_ms > 0);
+}
+
+TEST_CASE("MqttPublisher coalesces queued state messages per topic", "[mqtt_publisher]") {
+    FakeBroker broker;
+    MqttPublisher publisher(broker.transport(), {});
+
+    broker.hold();
+    publisher.publish("busy", json{{"n", 0}});
+    broker.waitInSend();
+
+    publisher.publish("cam1/result", json{{"n", 1}}, true);
+    publisher.publish("cam1/context", json{{"n", 2}});
+    publisher.publish("cam2/result", json{{"n", 3}}, true);
+    publisher.publish("cam1/result", json{{"n", 4}}, true);  // replaces n=1 in place
+    publisher.publish("cam1/context", json{{"n", 5}});        // not a state message: kept
+    REQUIRE(publisher.stats().queued == 4);
+    REQUIRE(publisher.stats().coalesced == 1);
+
+    broker.release();
+    REQUIRE(broker.waitSent(5));
+    std::vector<std::string> got;
+    for (const auto& [topic, payload] : broker.messages()) {
+        got.push_back(topic + "=" + std::to_string(json::parse(payload)["n"].get<int>()));
+    }
+    REQUIRE(got == std::vector<std::string>{
+        "busy=0", "cam1/result=4", "cam1/context=2", "cam2/result=3", "cam1/context=5"});
+}
+
+TEST_CASE("MqttPublisher drops the oldest message when the queue is full", "[mqtt_publisher]") {
+    FakeBroker broker;
+    MqttPublisher publisher(broker.transport(), MqttPublisher::Options{.queue = 2});
+
+    broker.hold();
+    publisher.publish("busy", json::object());
+    broker.waitInSend();
+    publisher.publish("m1", json::object());
+    publisher.publish("m2", json::object());
+    publisher.publish("m3", json::object());
+    REQUIRE(publisher.stats().dropped == 1);
+
+    broker.release();
+    REQUIRE(broker.waitSent(3));
+    publisher.stop();
+    auto sent = broker.messages();
+    REQUIRE(sent.size() == 3);
+    REQUIRE(sent[1].first == "m2");
+    REQUIRE(sent[2].first == "m3");
+}
+
+TEST_CASE("MqttPublisher stop sends what's queued and counts failures", "[mqtt_publisher]") {
+    FakeBroker broker;
+    MqttPublisher publisher(broker.transport(), {});
+
+    broker.hold();
+    publisher.publish("busy", json::object());
+    broker.waitInSend();
+    publisher.publish("fail", json::object());
+    publisher.publish("last", json::object());
+    broker.release();
+    publisher.stop();
+    publisher.stop();  // idempotent
+
+    publisher.publish("late", json::object());
+    auto stats = publisher.stats();
+    REQUIRE(stats.published == 2);
+    REQUIRE(stats.failures == 1);
+    REQUIRE(stats.dropped == 1);  // after stop
+    REQUIRE(broker.messages().back().first == "last");
+}
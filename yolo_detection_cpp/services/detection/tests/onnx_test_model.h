@@ -0,0 +1,161 @@
+#pragma once
+
+// Tiny ONNX models generated at test time, so session, binding and residency
+// code runs against a real Ort::Session without a multi-megabyte YOLO file.
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace hms::test {
+
+/// Just enough protobuf wire format to write an ONNX ModelProto
+class ProtoWriter {
+public:
+    ProtoWriter& varint(int field, int64_t value) {
+        key(field, 0);
+        raw(static_cast<uint64_t>(value));
+        return *this;
+    }
+    ProtoWriter& bytes(int field, const std::string& data) {
+        key(field, 2);
+        raw(data.size());
+        out_ += data;
+        return *this;
+    }
+    ProtoWriter& message(int field, const ProtoWriter& msg) { return bytes(field, msg.out_); }
+    const std::string& str() const { return out_; }
+
+private:
+    void key(int field, int wire_type) { raw((static_cast<uint64_t>(field) << 3) | wire_type); }
+    void raw(uint64_t v) {
+        while (v >= 0x80) {
+            out_ += static_cast<char>(v | 0x80);
+            v >>= 7;
+        }
+        out_ += static_cast<char>(v);
+    }
+    std::string out_;
+};
+
+namespace onnx {
+
+constexpr int kFloat = 1;  // TensorProto.DataType
+constexpr int kInt64 = 7;
+
+template <typename T>
+ProtoWriter tensor(const std::string& name, int type, const std::vector<int64_t>& dims,
+                   const std::vector<T>& values) {
+    ProtoWriter t;
+    for (auto d : dims) t.varint(1, d);
+    t.varint(2, type).bytes(8, name);
+    std::string raw(values.size() * sizeof(T), '\0');
+    std::memcpy(raw.data(), values.data(), raw.size());
+    return t.bytes(9, raw);  // raw_data, little-endian
+}
+
+/// Float tensor value info; dims < 0 become the symbolic dim params[i]
+inline ProtoWriter valueInfo(const std::string& name, const std::vector<int64_t>& dims,
+                             const std::vector<std::string>& params = {}) {
+    ProtoWriter shape;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        ProtoWriter dim;
+        if (dims[i] >= 0) dim.varint(1, dims[i]);
+        else dim.bytes(2, i < params.size() ? params[i] : "d" + std::to_string(i));
+        shape.message(1, dim);
+    }
+    ProtoWriter tensor_type;
+    tensor_type.varint(1, kFloat).message(2, shape);
+    ProtoWriter type;
+    type.message(1, tensor_type);
+    ProtoWriter info;
+    return info.bytes(1, name).message(2, type);
+}
+
+inline ProtoWriter intAttr(const std::string& name, int64_t value) {
+    ProtoWriter a;
+    return a.bytes(1, name).varint(3, value).varint(20, 2);  // INT
+}
+
+inline ProtoWriter intsAttr(const std::string& name, const std::vector<int64_t>& values) {
+    ProtoWriter a;
+    a.bytes(1, name);
+    for (auto v : values) a.varint(8, v);
+    return a.varint(20, 7);  // INTS
+}
+
+inline ProtoWriter node(const std::string& op, const std::vector<std::string>& inputs,
+                        const std::string& output, const std::vector<ProtoWriter>& attrs = {}) {
+    ProtoWriter n;
+    for (const auto& in : inputs) n.bytes(1, in);
+    n.bytes(2, output).bytes(3, output).bytes(4, op);
+    for (const auto& a : attrs) n.message(5, a);
+    return n;
+}
+
+}  // namespace onnx
+
+/// "images" [batch, 3, size, size] -> "output0" [batch, 1, 6]: one
+/// end-to-end row [0, 0, size/2, size/2, mean pixel value, class 0] per item,
+/// so each detection's confidence is its own input's mean. With
+/// `symbolic_output` the output's last two dims are only known at run time
+/// (the row count is computed from the data), as in models exported with
+/// dynamic shapes.
+inline std::string meanBoxModel(int size, bool symbolic_output) {
+    using namespace onnx;
+    float half = static_cast<float>(size) / 2;
+    std::vector<ProtoWriter> nodes = {
+        node("ReduceMean", {"images"}, "mean", {intsAttr("axes", {1, 2, 3}), intAttr("keepdims", 1)}),
+        node("Reshape", {"mean", "items"}, "mean3"),
+        node("Mul", {"mean3", "conf_mask"}, "conf"),
+        node("Add", {"conf", "box"}, symbolic_output ? "rows" : "output0"),
+    };
+    std::vector<ProtoWriter> initializers = {
+        tensor<int64_t>("items", kInt64, {3}, {-1, 1, 1}),
+        tensor<float>("conf_mask", kFloat, {1, 1, 6}, {0, 0, 0, 0, 1, 0}),
+        tensor<float>("box", kFloat, {1, 1, 6}, {0, 0, half, half, 0, 0}),
+    };
+    if (symbolic_output) {
+        // Row count = max(mean * 0) + 1 = 1, out of shape inference's reach
+        nodes.push_back(node("Mul", {"mean", "zero"}, "zeros"));
+        nodes.push_back(node("ReduceMax", {"zeros"}, "zero_max", {intAttr("keepdims", 0)}));
+        nodes.push_back(node("Add", {"zero_max", "one"}, "count_f"));
+        nodes.push_back(node("Cast", {"count_f"}, "count", {intAttr("to", kInt64)}));
+        nodes.push_back(node("Concat", {"minus_one", "count", "six"}, "out_shape", {intAttr("axis", 0)}));
+        nodes.push_back(node("Reshape", {"rows", "out_shape"}, "output0"));
+        initializers.push_back(tensor<float>("zero", kFloat, {}, {0}));
+        initializers.push_back(tensor<float>("one", kFloat, {1}, {1}));
+        initializers.push_back(tensor<int64_t>("minus_one", kInt64, {1}, {-1}));
+        initializers.push_back(tensor<int64_t>("six", kInt64, {1}, {6}));
+    }
+
+    ProtoWriter graph;
+    for (const auto& n : nodes) graph.message(1, n);
+    graph.bytes(2, "mean_box");
+    for (const auto& t : initializers) graph.message(5, t);
+    graph.message(11, valueInfo("images", {-1, 3, size, size}, {"batch"}));
+    graph.message(12, symbolic_output
+        ? valueInfo("output0", {-1, -1, -1}, {"batch", "rows", "values"})
+        : valueInfo("output0", {-1, 1, 6}, {"batch"}));
+
+    ProtoWriter opset;
+    opset.bytes(1, "").varint(2, 13);
+    ProtoWriter model;
+    model.varint(1, 7)  // ir_version
+         .bytes(2, "hms-tests")
+         .message(7, graph)
+         .message(8, opset);
+    return model.str();
+}
+
+/// meanBoxModel() written to the temp directory; returns its path
+inline std::string writeMeanBoxModel(const std::string& name, int size = 32, bool symbolic_output = false) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << meanBoxModel(size, symbolic_output);
+    return path.string();
+}
+
+}  // namespace hms::test
@@ -0,0 +1,44 @@
+#include <catch2/catch_all.hpp>
+
+#include "packet_decoder.h"
+
+using namespace hms;
+using namespace std::chrono_literals;
+
+TEST_CASE("scaleDetections maps substream boxes onto the main stream", "[packet_decoder]") {
+    std::vector<Detection> dets(2);
+    dets[0].class_id = 0;
+    dets[0].confidence = 0.9f;
+    dets[0].x1 = 64;  dets[0].y1 = 48;  dets[0].x2 = 320; dets[0].y2 = 240;
+    dets[1].x1 = 0;   dets[1].y1 = 0;   dets[1].x2 = 640; dets[1].y2 = 480;
+
+    // 640x480 (squashed 4:3) substream of a 3840x2160 main stream
+    auto scaled = scaleDetections(dets, 640, 480, 3840, 2160);
+    REQUIRE(scaled.size() == 2);
+    REQUIRE(scaled[0].x1 == Catch::Approx(384));
+    REQUIRE(scaled[0].y1 == Catch::Approx(216));
+    REQUIRE(scaled[0].x2 == Catch::Approx(1920));
+    REQUIRE(scaled[0].y2 == Catch::Approx(1080));
+    REQUIRE(scaled[0].confidence == dets[0].confidence);
+    REQUIRE(scaled[1].x2 == Catch::Approx(3840));
+    REQUIRE(scaled[1].y2 == Catch::Approx(2160));
+
+    SECTION("same size or unknown source size leaves boxes alone") {
+        REQUIRE(scaleDetections(dets, 640, 480, 640, 480)[0].x2 == Catch::Approx(320));
+        REQUIRE(scaleDetections(dets, 0, 0, 3840, 2160)[0].x2 == Catch::Approx(320));
+    }
+}
+
+TEST_CASE("PacketDecoder has nothing to decode without packets", "[packet_decoder]") {
+    PacketRing ring(2s);
+    REQUIRE(PacketDecoder::decodeAt(ring, SteadyClock::now()) == nullptr);
+
+    // Packets but no codec parameters (never connected): nothing to open a decoder with
+    std::vector<uint8_t> data(100, 0);
+    AVPacket pkt{};
+    pkt.data = data.data();
+    pkt.size = static_cast<int>(data.size());
+    pkt.flags = AV_PKT_FLAG_KEY;
+    ring.push(&pkt);
+    REQUIRE(PacketDecoder::decodeAt(ring, SteadyClock::now()) == nullptr);
+}
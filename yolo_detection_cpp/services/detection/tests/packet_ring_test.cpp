@@ -0,0 +1,128 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "packet_ring.h"
+
+#include <vector>
+
+using namespace hms;
+using namespace std::chrono_literals;
+
+namespace {
+// Push one packet per 100ms with a keyframe every `gop` packets
+void pushStream(PacketRing& ring, int count, int gop, SteadyClock::time_point t0,
+                int payload = 1000) {
+    std::vector<uint8_t> data(payload, 0xAB);
+    for (int i = 0; i < count; ++i) {
+        AVPacket pkt{};
+        pkt.data = data.data();
+        pkt.size = payload;
+        pkt.pts = pkt.dts = i * 9000;
+        pkt.flags = (i % gop == 0) ? AV_PKT_FLAG_KEY : 0;
+        ring.push(&pkt, t0 + i * 100ms);
+    }
+}
+}  // namespace
+
+TEST_CASE("PacketRing starts on a keyframe", "[packet_ring]") {
+    PacketRing ring(2s);
+    AVPacket delta{};
+    delta.size = 10;
+    ring.push(&delta);
+    REQUIRE(ring.stats().packets == 0);
+
+    auto t0 = SteadyClock::now();
+    pushStream(ring, 5, 10, t0);
+    auto all = ring.since(0);
+    REQUIRE(all.size() == 5);
+    REQUIRE(all.front().keyframe);
+}
+
+TEST_CASE("PacketRing keeps at least the window, trimmed by GOP", "[packet_ring]") {
+    PacketRing ring(2s);
+    auto t0 = SteadyClock::now();
+    pushStream(ring, 100, 10, t0);  // 10s of stream, 1s GOPs
+
+    auto all = ring.since(0);
+    REQUIRE(all.front().keyframe);
+    auto span = all.back().arrival - all.front().arrival;
+    REQUIRE(span >= 2s);
+    REQUIRE(span < 3s + 100ms);
+
+    // Preroll cut lands on a keyframe at least 1s before the newest packet
+    auto pre = ring.preroll(1s);
+    REQUIRE(pre.front().keyframe);
+    REQUIRE(all.back().arrival - pre.front().arrival >= 1s);
+    REQUIRE(pre.back().seq == ring.lastSeq());
+}
+
+TEST_CASE("PacketRing since() returns only newer packets", "[packet_ring]") {
+    PacketRing ring(5s);
+    auto t0 = SteadyClock::now();
+    pushStream(ring, 20, 10, t0);
+
+    uint64_t last = ring.lastSeq();
+    REQUIRE(ring.since(last).empty());
+    pushStream(ring, 3, 10, t0 + 2s);
+    auto tail = ring.since(last);
+    REQUIRE(tail.size() == 3);
+    REQUIRE(tail.front().seq == last + 1);
+}
+
+TEST_CASE("PacketRing gopUntil() runs from the keyframe to the packet at a time", "[packet_ring]") {
+    PacketRing ring(5s);
+    REQUIRE(ring.gopUntil(SteadyClock::now()).empty());
+
+    auto t0 = SteadyClock::now();
+    pushStream(ring, 30, 10, t0);  // keyframes at 0, 1s, 2s
+
+    // 1.45s: the packet at 1.5s, decoded from the 1s keyframe
+    auto run = ring.gopUntil(t0 + 1450ms);
+    REQUIRE(run.size() == 6);
+    REQUIRE(run.front().keyframe);
+    REQUIRE(run.front().arrival == t0 + 1s);
+    REQUIRE(run.back().arrival == t0 + 1500ms);
+
+    // Exactly on a keyframe: that packet alone
+    run = ring.gopUntil(t0 + 2s);
+    REQUIRE(run.size() == 1);
+    REQUIRE(run.front().keyframe);
+
+    // Past the newest packet: the newest, and before the oldest: the oldest
+    run = ring.gopUntil(t0 + 10s);
+    REQUIRE(run.back().seq == ring.lastSeq());
+    REQUIRE(run.front().arrival == t0 + 2s);
+    run = ring.gopUntil(t0 - 1s);
+    REQUIRE(run.size() == 1);
+    REQUIRE(run.front().seq == ring.since(0).front().seq);
+}
+
+TEST_CASE("PacketRing byte cap drops whole GOPs", "[packet_ring]") {
+    PacketRing ring(60s, 25 * 1000);
+    pushStream(ring, 50, 10, SteadyClock::now());  // 50 KB in 10 KB GOPs
+
+    auto stats = ring.stats();
+    REQUIRE(stats.bytes <= 25 * 1000);
+    REQUIRE(stats.dropped_gops >= 3);
+    REQUIRE(ring.since(0).front().keyframe);
+}
+
+TEST_CASE("PacketRing setStream starts a new generation", "[packet_ring]") {
+    PacketRing ring(5s);
+    REQUIRE(ring.stream().codecpar == nullptr);
+
+    AVCodecParameters par{};
+    par.codec_id = AV_CODEC_ID_H264;
+    par.width = 1280;
+    par.height = 720;
+    ring.setStream(&par, AVRational{1, 90000});
+    auto first = ring.stream();
+    REQUIRE(first.codecpar);
+    REQUIRE(first.codecpar->width == 1280);
+
+    pushStream(ring, 5, 5, SteadyClock::now());
+    REQUIRE(ring.since(0).front().generation == first.generation);
+
+    ring.setStream(&par, AVRational{1, 90000});
+    REQUIRE(ring.stream().generation == first.generation + 1);
+    REQUIRE(ring.stats().packets == 0);
+}
@@ -0,0 +1,360 @@
+#include <catch2/catch_all.hpp>
+#include "pipeline_config.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace hms;
+
+namespace {
+std::string writeTempConfig(const std::string& name, const std::string& yaml) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream out(path);
+    out << yaml;
+    return path.string();
+}
+}  // namespace
+
+TEST_CASE("PipelineConfig defaults when file is missing", "[pipeline_config]") {
+    auto cfg = PipelineConfig::load("/nonexistent/config.yaml");
+    REQUIRE(cfg.scheduler.max_batch_size == 8);
+    REQUIRE(cfg.scheduler.max_wait_ms == 10);
+    REQUIRE(cfg.engine.idle_ttl_seconds == 300);
+    REQUIRE(cfg.engine.warmup);
+    REQUIRE(cfg.engine.cache_optimized_model);
+    REQUIRE(cfg.engine.optimized_model_path.empty());
+}
+
+TEST_CASE("PipelineConfig defaults when section is absent", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_absent.yaml", "detection:\n  model_path: x.onnx\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.scheduler.max_batch_size == 8);
+    REQUIRE(cfg.scheduler.max_wait_ms == 10);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses scheduler section", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_sched.yaml",
+        "pipeline:\n"
+        "  scheduler:\n"
+        "    max_batch_size: 4\n"
+        "    max_wait_ms: 25\n"
+        "    pipeline_depth: 2\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.scheduler.max_batch_size == 4);
+    REQUIRE(cfg.scheduler.max_wait_ms == 25);
+    REQUIRE(cfg.scheduler.pipeline_depth == 2);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses engine residency section", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_engine.yaml",
+        "pipeline:\n"
+        "  engine:\n"
+        "    idle_ttl_seconds: 0\n"
+        "    warmup: false\n"
+        "    cache_optimized_model: false\n"
+        "    optimized_model_path: /cache/model.opt.onnx\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.engine.idle_ttl_seconds == 0);
+    REQUIRE_FALSE(cfg.engine.warmup);
+    REQUIRE_FALSE(cfg.engine.cache_optimized_model);
+    REQUIRE(cfg.engine.optimized_model_path == "/cache/model.opt.onnx");
+    REQUIRE(cfg.scheduler.max_batch_size == 8);
+    REQUIRE(cfg.preprocess.resize == ResizeMode::Nearest);
+    REQUIRE_FALSE(cfg.preprocess.gpu);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses engine sessions", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_sessions.yaml",
+        "pipeline:\n"
+        "  engine:\n"
+        "    sessions:\n"
+        "      - { device: 0, threads: 2 }\n"
+        "      - { device: 1 }\n"
+        "      - { device: -1, threads: 6 }\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.engine.sessions.size() == 3);
+    REQUIRE(cfg.engine.sessions[0].device == 0);
+    REQUIRE(cfg.engine.sessions[1].device == 1);
+    REQUIRE(cfg.engine.sessions[1].threads == 2);
+    REQUIRE(cfg.engine.sessions[2].device == -1);
+    REQUIRE(cfg.engine.sessions[2].threads == 6);
+    std::filesystem::remove(path);
+
+    // Default: one session on device 0
+    auto defaults = PipelineConfig::load("/nonexistent/pipeline.yaml");
+    REQUIRE(defaults.engine.sessions.size() == 1);
+    REQUIRE(defaults.engine.sessions[0].device == 0);
+}
+
+TEST_CASE("PipelineConfig parses execution providers", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_providers.yaml",
+        "pipeline:\n"
+        "  engine:\n"
+        "    provider: tensorrt\n"
+        "    precision: FP16\n"
+        "    provider_cache_dir: /cache/engines\n"
+        "    sessions:\n"
+        "      - { device: 0 }\n"
+        "      - { device: -1, provider: openvino, precision: int8, openvino_device: GPU }\n"
+        "      - { device: 1, provider: dxml, precision: fp64 }\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.engine.provider_cache_dir == "/cache/engines");
+    REQUIRE(cfg.engine.sessions.size() == 3);
+    REQUIRE(cfg.engine.sessions[0].provider == ExecutionProvider::TensorRt);  // engine-level default
+    REQUIRE(cfg.engine.sessions[0].precision == Precision::Fp16);
+    REQUIRE(cfg.engine.sessions[1].provider == ExecutionProvider::OpenVino);
+    REQUIRE(cfg.engine.sessions[1].precision == Precision::Int8);
+    REQUIRE(cfg.engine.sessions[1].openvino_device == "GPU");
+    REQUIRE(cfg.engine.sessions[2].provider == ExecutionProvider::TensorRt);  // unknown: keeps default
+    REQUIRE(cfg.engine.sessions[2].precision == Precision::Fp16);
+    std::filesystem::remove(path);
+
+    // Without sessions the engine-level choice applies to the single default session
+    path = writeTempConfig("hms_pipeline_providers.yaml",
+        "pipeline:\n"
+        "  engine:\n"
+        "    provider: cpu\n");
+    cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.engine.sessions.size() == 1);
+    REQUIRE(cfg.engine.sessions[0].provider == ExecutionProvider::Cpu);
+    REQUIRE(std::string(providerName(ExecutionProvider::OpenVino)) == "openvino");
+    REQUIRE(std::string(precisionName(Precision::Int8)) == "int8");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses preprocess resize mode", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_resize.yaml",
+        "pipeline:\n  preprocess:\n    resize: bilinear\n    gpu: true\n");
+    REQUIRE(PipelineConfig::load(path).preprocess.resize == ResizeMode::Bilinear);
+    REQUIRE(PipelineConfig::load(path).preprocess.gpu);
+
+    path = writeTempConfig("hms_pipeline_resize.yaml",
+        "pipeline:\n  preprocess:\n    resize: lanczos\n");
+    REQUIRE(PipelineConfig::load(path).preprocess.resize == ResizeMode::Nearest);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses recording mode", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_recording.yaml",
+        "pipeline:\n  recording:\n    mode: transcode\n    burn_in_boxes: true\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.recording.mode == RecordingConfig::Mode::Transcode);
+    REQUIRE(cfg.recording.burn_in_boxes);
+
+    path = writeTempConfig("hms_pipeline_recording.yaml",
+        "pipeline:\n  recording:\n    mode: copy\n");
+    cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.recording.mode == RecordingConfig::Mode::Passthrough);
+    REQUIRE_FALSE(cfg.recording.burn_in_boxes);
+    REQUIRE(cfg.recording.fragmented);
+    REQUIRE(cfg.recording.staging_dir.empty());
+
+    path = writeTempConfig("hms_pipeline_recording.yaml",
+        "pipeline:\n  recording:\n    fragmented: false\n    staging_dir: /dev/shm/hms\n"
+        "  file_writer:\n    queue_mb: 0\n");
+    cfg = PipelineConfig::load(path);
+    REQUIRE_FALSE(cfg.recording.fragmented);
+    REQUIRE(cfg.recording.staging_dir == "/dev/shm/hms");
+    REQUIRE(cfg.file_writer.enabled);
+    REQUIRE(cfg.file_writer.queue_mb == 1);          // clamped
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses live view section", "[pipeline_config]") {
+    auto cfg = PipelineConfig::load("/nonexistent/config.yaml");
+    REQUIRE(cfg.live.enabled);
+    REQUIRE(cfg.live.quality == 75);
+    REQUIRE(cfg.live.max_fps == 0);
+    REQUIRE(cfg.live.max_backlog_kb == 1024);
+
+    auto path = writeTempConfig("hms_pipeline_live.yaml",
+        "pipeline:\n  live:\n    enabled: false\n    quality: 150\n"
+        "    max_fps: 10\n    max_backlog_kb: 1\n");
+    cfg = PipelineConfig::load(path);
+    REQUIRE_FALSE(cfg.live.enabled);
+    REQUIRE(cfg.live.quality == 100);       // clamped
+    REQUIRE(cfg.live.max_fps == 10);
+    REQUIRE(cfg.live.max_backlog_kb == 64); // clamped
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses decode hwaccel with per-camera overrides", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_decode.yaml",
+        "pipeline:\n  decode:\n    hwaccel: NVDEC\n    threads: 0\n"
+        "    cameras:\n      garage: vaapi\n      porch: dxva9\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.decode.hwaccel == "cuda");
+    REQUIRE(cfg.decode.threads == 1);
+    REQUIRE(cfg.decode.hwaccelFor("garage") == "vaapi");
+    REQUIRE(cfg.decode.hwaccelFor("porch") == "none");
+    REQUIRE(cfg.decode.hwaccelFor("front_door") == "cuda");
+
+    REQUIRE(PipelineConfig{}.decode.hwaccelFor("garage") == "none");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses dual-stream cameras", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_streams.yaml",
+        "pipeline:\n  streams:\n    full_res_snapshots: true\n"
+        "    cameras:\n      garage: rtsp://cam/main\n      porch: \"\"\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.streams.full_res_snapshots);
+    REQUIRE(cfg.streams.recordUrlFor("garage") == "rtsp://cam/main");
+    REQUIRE(cfg.streams.recordUrlFor("porch").empty());
+    REQUIRE(cfg.streams.record_urls.size() == 1);
+
+    REQUIRE_FALSE(PipelineConfig{}.streams.full_res_snapshots);
+    REQUIRE(PipelineConfig{}.streams.recordUrlFor("garage").empty());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses sampling section", "[pipeline_config]") {
+    REQUIRE_FALSE(PipelineConfig{}.sampling.continuous);
+    REQUIRE(PipelineConfig{}.sampling.motion_gating);
+
+    auto path = writeTempConfig("hms_pipeline_sampling.yaml",
+        "pipeline:\n  sampling:\n    continuous: true\n    idle_interval_ms: 100\n"
+        "    burst_interval_ms: 250\n    cell_threshold: 400\n    min_changed: 0.05\n"
+        "    trigger_events: true\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.sampling.continuous);
+    REQUIRE(cfg.sampling.trigger_events);
+    REQUIRE(cfg.sampling.burst_interval_ms == 250);
+    REQUIRE(cfg.sampling.idle_interval_ms == 250);  // never faster than the burst rate
+    REQUIRE(cfg.sampling.burst_hold_ms == 3000);
+    REQUIRE(cfg.sampling.cell_threshold == 255);
+    REQUIRE(cfg.sampling.min_changed == Catch::Approx(0.05));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses event stages", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_events.yaml",
+        "pipeline:\n"
+        "  events:\n"
+        "    record: { workers: 3, queue: 4 }\n"
+        "    vision: { workers: 0, queue: -1 }\n"
+        "    publish: { workers: 500 }\n"
+        "    mqtt_queue: 0\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.events.record.workers == 3);
+    REQUIRE(cfg.events.record.queue == 4);
+    REQUIRE(cfg.events.snapshot.workers == 2);   // default
+    REQUIRE(cfg.events.vision.workers == 0);     // one per camera
+    REQUIRE(cfg.events.vision.queue == 0);       // clamped
+    REQUIRE(cfg.events.publish.workers == 64);   // clamped
+    REQUIRE(cfg.events.publish.queue == 64);     // default
+    REQUIRE(cfg.events.mqtt_queue == 1);         // clamped
+
+    auto defaults = PipelineConfig{};
+    REQUIRE(defaults.events.record.workers == 0);
+    REQUIRE(defaults.events.vision.workers == 1);
+    REQUIRE(defaults.events.mqtt_queue == 256);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses event tracking", "[pipeline_config]") {
+    auto defaults = PipelineConfig{}.tracking;
+    REQUIRE(defaults.enabled);
+    REQUIRE(defaults.detect_interval == 3);
+
+    auto path = writeTempConfig("hms_pipeline_tracking.yaml",
+        "pipeline:\n  tracking:\n    enabled: false\n    detect_interval: 8\n"
+        "    iou_threshold: 2.0\n    min_hits: 0\n    stationary_recheck_ms: 500\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE_FALSE(cfg.tracking.enabled);
+    REQUIRE(cfg.tracking.detect_interval == 8);
+    REQUIRE(cfg.tracking.iou_threshold == 1.0f);
+    REQUIRE(cfg.tracking.min_hits == 1);
+    REQUIRE(cfg.tracking.max_age_ms == defaults.max_age_ms);
+    REQUIRE(cfg.tracking.stationary_recheck_ms == 500);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses snapshot and vision renditions", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_snapshots.yaml",
+        "pipeline:\n  snapshots:\n    thumbnail_width: 8\n    thumbnail_quality: 60\n"
+        "  vision:\n    event_width: 672\n    periodic_width: -5\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.snapshots.thumbnail_width == 16);   // clamped
+    REQUIRE(cfg.snapshots.thumbnail_quality == 60);
+    REQUIRE(cfg.vision.event_width == 672);
+    REQUIRE(cfg.vision.periodic_width == 0);         // clamped: full snapshot
+    REQUIRE(PipelineConfig{}.snapshots.thumbnail_width == 320);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses the DB writer", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_db_writer.yaml",
+        "pipeline:\n  db_writer:\n    batch: 5000\n    flush_ms: 50\n"
+        "    journal_path: /data/db.jsonl\n    journal_max_mb: -1\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.db_writer.batch == 1024);            // clamped
+    REQUIRE(cfg.db_writer.flush_ms == 50);
+    REQUIRE(cfg.db_writer.journal_path == "/data/db.jsonl");
+    REQUIRE(cfg.db_writer.journal_max_mb == 0);      // clamped: spilled rows are dropped
+    REQUIRE(cfg.db_writer.queue == 1024);
+    REQUIRE(PipelineConfig{}.db_writer.journal_path.empty());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses replay mode", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_replay.yaml",
+        "pipeline:\n  replay:\n    file: /data/driveway.mp4\n    cameras: 1000\n"
+        "    realtime: false\n    motion_interval_seconds: 10\n    motion_seconds: 0\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.replay.enabled());
+    REQUIRE(cfg.replay.file == "/data/driveway.mp4");
+    REQUIRE(cfg.replay.cameras == 256);          // clamped
+    REQUIRE_FALSE(cfg.replay.realtime);
+    REQUIRE(cfg.replay.loop);
+    REQUIRE(cfg.replay.duration_seconds == 60);
+    REQUIRE(cfg.replay.motion_interval_seconds == 10);
+    REQUIRE(cfg.replay.motion_seconds == 1);     // clamped
+    REQUIRE_FALSE(cfg.replay.database);
+    REQUIRE_FALSE(PipelineConfig{}.replay.enabled());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig parses tiling with per-camera overrides", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_tiling.yaml",
+        "pipeline:\n  tiling:\n    overlap: 0.9\n"
+        "    cameras:\n"
+        "      backyard:\n        roi: [0, 0.4, 1, 0.6]\n        tiles: [3, 2]\n        full_frame: true\n"
+        "      porch:\n        tiles: [20, 0]\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE_FALSE(cfg.tilingFor("garage").enabled());
+    REQUIRE(cfg.tilingFor("garage").overlap == Catch::Approx(0.5f));
+
+    const auto& backyard = cfg.tilingFor("backyard");
+    REQUIRE(backyard.cropped());
+    REQUIRE(backyard.roi_y == Catch::Approx(0.4f));
+    REQUIRE(backyard.roi_h == Catch::Approx(0.6f));
+    REQUIRE(backyard.cols == 3);
+    REQUIRE(backyard.rows == 2);
+    REQUIRE(backyard.full_frame);
+    REQUIRE(backyard.overlap == Catch::Approx(0.5f));  // inherited from the section default
+
+    REQUIRE(cfg.tilingFor("porch").cols == 8);
+    REQUIRE(cfg.tilingFor("porch").rows == 1);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PipelineConfig clamps invalid values and survives bad YAML", "[pipeline_config]") {
+    auto path = writeTempConfig("hms_pipeline_clamp.yaml",
+        "pipeline:\n  scheduler:\n    max_batch_size: 0\n    max_wait_ms: -5\n    pipeline_depth: 99\n");
+    auto cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.scheduler.max_batch_size == 1);
+    REQUIRE(cfg.scheduler.max_wait_ms == 0);
+    REQUIRE(cfg.scheduler.pipeline_depth == 8);
+
+    {
+        std::ofstream out(path);
+        out << "pipeline:\n  scheduler:\n    max_batch_size: [not, a, number\n";
+    }
+    cfg = PipelineConfig::load(path);
+    REQUIRE(cfg.scheduler.max_batch_size == 8);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,73 @@
+#include <catch2/catch_all.hpp>
+#include "frame_data.h"
+#include "pixel_arena.h"
+
+#include <cstdint>
+#include <set>
+
+using namespace hms;
+
+namespace {
+std::unique_ptr<PixelArena> makeArena(size_t slots) {
+    // No huge pages: the test must not depend on the host's hugetlb reservation
+    return std::make_unique<PixelArena>(slots, PixelArena::Options{.huge_pages = false});
+}
+}  // namespace
+
+TEST_CASE("PixelArena maps lazily and hands out page-aligned slots", "[pixel_arena]") {
+    auto arena = makeArena(4);
+    REQUIRE(arena->stats().reserved_bytes == 0);
+
+    uint8_t* a = arena->slot(0, 10000);
+    uint8_t* b = arena->slot(1, 10000);
+    REQUIRE(a != nullptr);
+    REQUIRE(b == a + arena->slotBytes());
+    REQUIRE(arena->slotBytes() % 4096 == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(a) % 4096 == 0);
+    REQUIRE(arena->stats().reserved_bytes >= 4 * arena->slotBytes());
+
+    REQUIRE(arena->slot(4, 100) == nullptr);                       // out of range
+    REQUIRE(arena->slot(2, arena->slotBytes() + 1) == nullptr);    // too large
+    REQUIRE(arena->stats().heap_fallbacks == 1);
+}
+
+TEST_CASE("FramePool frames live in the arena with aligned rows", "[pixel_arena]") {
+    FramePool pool(3, 1, makeArena(3));
+    REQUIRE(pool.arena() != nullptr);
+
+    std::vector<std::shared_ptr<FrameData>> frames;
+    std::set<const uint8_t*> buffers;
+    for (int i = 0; i < 3; ++i) {
+        auto f = pool.acquire();
+        f->resize(641, 10);
+        REQUIRE(f->stride == 1984);  // 641 * 3 rounded up to 64
+        REQUIRE(f->pixels.inArena());
+        REQUIRE(reinterpret_cast<uintptr_t>(f->pixels.data()) % PixelArena::kRowAlignment == 0);
+        buffers.insert(f->pixels.data());
+        frames.push_back(std::move(f));
+    }
+    REQUIRE(buffers.size() == 3);
+
+    // Spill frames and copies use the heap
+    auto spill = pool.acquire();
+    spill->resize(641, 10);
+    REQUIRE_FALSE(spill->pixels.inArena());
+
+    FrameData copy;
+    copy.pixels = frames[0]->pixels;
+    REQUIRE_FALSE(copy.pixels.inArena());
+    REQUIRE(copy.pixels.size() == frames[0]->pixels.size());
+}
+
+TEST_CASE("Arena frame falls back to the heap when it outgrows its slot", "[pixel_arena]") {
+    FramePool pool(1, 0, makeArena(1));
+    auto f = pool.acquire();
+    f->resize(320, 240);
+    REQUIRE(f->pixels.inArena());
+
+    f->resize(1920, 1080);
+    REQUIRE_FALSE(f->pixels.inArena());
+    REQUIRE(f->pixels.size() == static_cast<size_t>(f->stride) * 1080);
+    f->pixels[f->pixels.size() - 1] = 7;  // heap buffer is really that large
+    REQUIRE(pool.arena()->stats().heap_fallbacks == 0);  // slot was never asked for more
+}
@@ -0,0 +1,193 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "detection_engine.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+// Postprocess micro-benchmark on full-size [1, 84, 8400] YOLO outputs.
+// Benchmarks are hidden from the default run:
+//   detection_tests "[benchmark]" --benchmark-samples 50
+
+using namespace hms;
+using Catch::Matchers::WithinAbs;
+
+namespace {
+
+constexpr int kCandidates = 8400;
+constexpr int kClasses = 80;
+
+/// Synthetic output shaped like a real YOLO11 frame: background noise on
+/// every candidate plus clusters of overlapping high-score candidates
+/// around a few objects (what NMS actually has to chew through).
+std::vector<float> makeOutput(int objects, unsigned seed = 42) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> noise(0.0f, 0.04f);
+    std::uniform_real_distribution<float> pos(40.0f, 600.0f);
+    std::uniform_real_distribution<float> jitter(-6.0f, 6.0f);
+    std::uniform_int_distribution<int> cls_dist(0, 7);
+
+    std::vector<float> out(static_cast<size_t>(4 + kClasses) * kCandidates);
+    auto at = [&](int row, int i) -> float& { return out[static_cast<size_t>(row) * kCandidates + i]; };
+
+    for (int i = 0; i < kCandidates; ++i) {
+        at(0, i) = pos(rng);
+        at(1, i) = pos(rng);
+        at(2, i) = 20.0f;
+        at(3, i) = 20.0f;
+        for (int c = 0; c < kClasses; ++c) at(4 + c, i) = noise(rng);
+    }
+
+    // ~25 candidates per object, spread over the three detection heads
+    for (int o = 0; o < objects; ++o) {
+        float cx = pos(rng), cy = pos(rng);
+        int cls = cls_dist(rng);
+        for (int k = 0; k < 25; ++k) {
+            int i = (o * 331 + k * 97) % kCandidates;
+            at(0, i) = cx + jitter(rng);
+            at(1, i) = cy + jitter(rng);
+            at(2, i) = 80.0f + jitter(rng);
+            at(3, i) = 160.0f + jitter(rng);
+            at(4 + cls, i) = 0.55f + 0.015f * k + 0.001f * o;  // no ties
+        }
+    }
+    return out;
+}
+
+// ---- The pre-rewrite implementation, kept verbatim for comparison ----
+
+struct LegacyDetection {
+    std::string class_name;
+    int class_id = -1;
+    float confidence = 0.0f;
+    float x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+};
+
+float legacyIou(const LegacyDetection& a, const LegacyDetection& b) {
+    float inter_w = std::max(0.0f, std::min(a.x2, b.x2) - std::max(a.x1, b.x1));
+    float inter_h = std::max(0.0f, std::min(a.y2, b.y2) - std::max(a.y1, b.y1));
+    float inter_area = inter_w * inter_h;
+    float union_area = (a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter_area;
+    if (union_area <= 0.0f) return 0.0f;
+    return inter_area / union_area;
+}
+
+std::vector<int> legacyNms(const std::vector<LegacyDetection>& dets, float iou_threshold) {
+    std::unordered_map<int, std::vector<int>> class_indices;
+    for (int i = 0; i < static_cast<int>(dets.size()); ++i) {
+        class_indices[dets[i].class_id].push_back(i);
+    }
+    std::vector<int> keep;
+    for (auto& [cls, indices] : class_indices) {
+        std::sort(indices.begin(), indices.end(),
+                  [&dets](int a, int b) { return dets[a].confidence > dets[b].confidence; });
+        std::vector<bool> suppressed(indices.size(), false);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (suppressed[i]) continue;
+            keep.push_back(indices[i]);
+            for (size_t j = i + 1; j < indices.size(); ++j) {
+                if (suppressed[j]) continue;
+                if (legacyIou(dets[indices[i]], dets[indices[j]]) > iou_threshold) {
+                    suppressed[j] = true;
+                }
+            }
+        }
+    }
+    return keep;
+}
+
+std::vector<LegacyDetection> legacyPostprocess(const float* output, int num_candidates,
+                                         const std::vector<std::string>& names,
+                                         const std::vector<std::string>& filter_classes) {
+    std::unordered_set<std::string> filter_set(filter_classes.begin(), filter_classes.end());
+    bool has_filter = !filter_set.empty();
+    std::vector<LegacyDetection> detections;
+    for (int i = 0; i < num_candidates; ++i) {
+        float cx = output[0 * num_candidates + i];
+        float cy = output[1 * num_candidates + i];
+        float w  = output[2 * num_candidates + i];
+        float h  = output[3 * num_candidates + i];
+        int best_class = -1;
+        float best_score = 0.0f;
+        for (int c = 0; c < kClasses; ++c) {
+            float score = output[(4 + c) * num_candidates + i];
+            if (score > best_score) { best_score = score; best_class = c; }
+        }
+        if (best_score < 0.5f) continue;
+        if (has_filter && filter_set.find(names[best_class]) == filter_set.end()) continue;
+        float x1 = std::clamp(cx - w / 2.0f, 0.0f, 640.0f);
+        float y1 = std::clamp(cy - h / 2.0f, 0.0f, 640.0f);
+        float x2 = std::clamp(cx + w / 2.0f, 0.0f, 640.0f);
+        float y2 = std::clamp(cy + h / 2.0f, 0.0f, 640.0f);
+        if (x2 - x1 < 1.0f || y2 - y1 < 1.0f) continue;
+        detections.push_back({names[best_class], best_class, best_score, x1, y1, x2, y2});
+    }
+    auto keep = legacyNms(detections, 0.45f);
+    std::vector<LegacyDetection> result;
+    for (int idx : keep) result.push_back(std::move(detections[idx]));
+    std::sort(result.begin(), result.end(),
+              [](const LegacyDetection& a, const LegacyDetection& b) { return a.confidence > b.confidence; });
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE("Postprocess matches the legacy implementation on 8400 candidates", "[detection][postprocess]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    const std::vector<std::string> filters[] = {{}, {"person", "car"}, {"unknown-class"}};
+
+    for (int objects : {0, 3, 12}) {
+        auto output = makeOutput(objects, 1000 + objects);
+        for (const auto& filter : filters) {
+            auto expected = legacyPostprocess(output.data(), kCandidates, engine.classNames(), filter);
+            auto actual = engine.postprocess(output.data(), kCandidates, 0.5f, 0.45f,
+                                             1.0f, 0.0f, 0.0f, 640, 640, filter);
+
+            INFO("objects=" << objects << " filters=" << filter.size());
+            REQUIRE(actual.size() == expected.size());
+            for (size_t i = 0; i < actual.size(); ++i) {
+                REQUIRE(actual[i].class_id == expected[i].class_id);
+                REQUIRE(actual[i].name() == expected[i].class_name);
+                REQUIRE_THAT(actual[i].confidence, WithinAbs(expected[i].confidence, 1e-6f));
+                REQUIRE_THAT(actual[i].x1, WithinAbs(expected[i].x1, 1e-3f));
+                REQUIRE_THAT(actual[i].y2, WithinAbs(expected[i].y2, 1e-3f));
+            }
+        }
+    }
+}
+
+TEST_CASE("Postprocess micro-benchmark", "[.][benchmark][postprocess]") {
+    DetectionEngine engine("/nonexistent.onnx");
+    auto quiet = makeOutput(0);
+    auto busy = makeOutput(12);
+    const std::vector<std::string> filter = {"person", "car", "dog"};
+
+    BENCHMARK("legacy, 12 objects") {
+        return legacyPostprocess(busy.data(), kCandidates, engine.classNames(), {});
+    };
+    BENCHMARK("current, 12 objects") {
+        return engine.postprocess(busy.data(), kCandidates, 0.5f, 0.45f, 1.0f, 0.0f, 0.0f, 640, 640,
+                                  std::vector<std::string>{});
+    };
+    BENCHMARK("legacy, empty scene") {
+        return legacyPostprocess(quiet.data(), kCandidates, engine.classNames(), filter);
+    };
+    BENCHMARK("current, empty scene") {
+        return engine.postprocess(quiet.data(), kCandidates, 0.5f, 0.45f, 1.0f, 0.0f, 0.0f, 640, 640, filter);
+    };
+
+    std::vector<LegacyDetection> legacy_boxes;
+    std::vector<Detection> boxes;
+    for (int i = 0; i < 300; ++i) {
+        float x = static_cast<float>((i * 37) % 600), y = static_cast<float>((i * 53) % 600);
+        float conf = 0.5f + (i % 50) / 100.0f;
+        legacy_boxes.push_back({"", i % 4, conf, x, y, x + 60, y + 120});
+        boxes.push_back({static_cast<uint16_t>(i % 4), conf, x, y, x + 60, y + 120});
+    }
+    BENCHMARK("legacy NMS, 300 boxes") { return legacyNms(legacy_boxes, 0.45f); };
+    BENCHMARK("current NMS, 300 boxes") { return DetectionEngine::nms(boxes, 0.45f); };
+}
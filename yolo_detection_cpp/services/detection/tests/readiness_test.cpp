@@ -0,0 +1,66 @@
+#include <catch2/catch_all.hpp>
+#include "readiness.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace hms;
+using State = Readiness::State;
+
+TEST_CASE("Readiness waits for every subsystem", "[readiness]") {
+    Readiness readiness;
+    REQUIRE(readiness.ready());  // nothing registered
+
+    readiness.add("model");
+    readiness.add("mqtt", false);
+    REQUIRE_FALSE(readiness.ready());
+
+    readiness.set("model", State::Ready);
+    REQUIRE_FALSE(readiness.ready());  // optional, but still pending
+    readiness.set("mqtt", State::Ready);
+    REQUIRE(readiness.ready());
+
+    auto entries = readiness.entries();
+    REQUIRE(entries.size() == 2);
+    REQUIRE(entries[0].name == "model");  // registration order
+    REQUIRE(entries[0].required);
+    REQUIRE(entries[1].name == "mqtt");
+    REQUIRE_FALSE(entries[1].required);
+}
+
+TEST_CASE("Readiness: only required failures block", "[readiness]") {
+    Readiness readiness;
+    readiness.add("model");
+    readiness.add("database", false);
+    readiness.set("model", State::Ready);
+    readiness.set("database", State::Failed, "connection refused");
+    REQUIRE(readiness.ready());
+
+    auto db = readiness.entries()[1];
+    REQUIRE(db.state == State::Failed);
+    REQUIRE(db.detail == "connection refused");
+
+    readiness.set("model", State::Failed, "model failed validation");
+    REQUIRE_FALSE(readiness.ready());
+
+    SECTION("disabled subsystems count as settled") {
+        readiness.set("model", State::Disabled, "model not found");
+        REQUIRE(readiness.ready());
+    }
+}
+
+TEST_CASE("Readiness times each subsystem", "[readiness]") {
+    Readiness readiness;
+    readiness.add("model");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(readiness.entries()[0].ms >= 20);  // running clock while pending
+
+    readiness.set("model", State::Ready);
+    double took = readiness.entries()[0].ms;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(readiness.entries()[0].ms == took);  // frozen once settled
+
+    readiness.set("unknown", State::Ready);  // ignored
+    REQUIRE(readiness.entries().size() == 1);
+    REQUIRE(std::string(Readiness::name(State::Disabled)) == "disabled");
+}
@@ -0,0 +1,83 @@
+#include <catch2/catch_all.hpp>
+#include "replay_driver.h"
+
+#include <chrono>
+
+using namespace hms;
+using namespace std::chrono_literals;
+
+TEST_CASE("ReplayDriver replaces cameras with synthetic ones", "[replay]") {
+    AppConfig config;
+    config.cameras["disabled"].enabled = false;
+    config.cameras["front"].rtsp_url = "rtsp://front";
+    config.cameras["front"].classes = {"person", "car"};
+
+    ReplayConfig replay;
+    replay.file = "/recordings/front.mp4";
+    replay.cameras = 3;
+    ReplayDriver::addCameras(config, replay);
+
+    REQUIRE(config.cameras.size() == 3);
+    for (const auto& id : {"replay_1", "replay_2", "replay_3"}) {
+        REQUIRE(config.cameras.count(id) == 1);
+        const auto& cam = config.cameras.at(id);
+        REQUIRE(cam.enabled);
+        REQUIRE(cam.rtsp_url == "/recordings/front.mp4");
+        REQUIRE(cam.classes == std::vector<std::string>{"person", "car"});
+    }
+    REQUIRE(config.cameras.at("replay_2").name == "Replay 2");
+}
+
+TEST_CASE("ReplayDriver adds cameras when none are configured", "[replay]") {
+    AppConfig config;
+    ReplayConfig replay;
+    replay.file = "clip.mp4";
+    ReplayDriver::addCameras(config, replay);
+
+    REQUIRE(config.cameras.size() == 1);
+    REQUIRE(config.cameras.at("replay_1").rtsp_url == "clip.mp4");
+    REQUIRE(config.cameras.at("replay_1").enabled);
+}
+
+TEST_CASE("ReplayDriver staggers the motion schedule", "[replay]") {
+    ReplayConfig replay;
+    replay.motion_interval_seconds = 10;
+    replay.motion_seconds = 2;
+
+    // Camera 0 of 2 moves at 0-2s, 10-12s, ...
+    REQUIRE(ReplayDriver::motionActive(replay, 0, 2, 0ms));
+    REQUIRE(ReplayDriver::motionActive(replay, 0, 2, 1999ms));
+    REQUIRE_FALSE(ReplayDriver::motionActive(replay, 0, 2, 2000ms));
+    REQUIRE(ReplayDriver::motionActive(replay, 0, 2, 10500ms));
+
+    // Camera 1 of 2 half an interval later: 5-7s, 15-17s, ...
+    REQUIRE_FALSE(ReplayDriver::motionActive(replay, 1, 2, 0ms));
+    REQUIRE_FALSE(ReplayDriver::motionActive(replay, 1, 2, 4999ms));
+    REQUIRE(ReplayDriver::motionActive(replay, 1, 2, 5000ms));
+    REQUIRE_FALSE(ReplayDriver::motionActive(replay, 1, 2, 7000ms));
+    REQUIRE(ReplayDriver::motionActive(replay, 1, 2, 16000ms));
+
+    SECTION("interval 0 disables synthetic motion") {
+        replay.motion_interval_seconds = 0;
+        REQUIRE_FALSE(ReplayDriver::motionActive(replay, 0, 1, 0ms));
+        REQUIRE_FALSE(ReplayDriver::motionActive(replay, 0, 1, 60s));
+    }
+}
+
+TEST_CASE("ReplayDriver summarizes a stage in milliseconds", "[replay]") {
+    Metrics::Histogram h;
+    for (int i = 0; i < 100; ++i) h.observe(1ms);
+
+    auto summary = ReplayDriver::summarize(h.snapshot());
+    REQUIRE(summary["count"] == 100);
+    REQUIRE(summary["mean_ms"].get<double>() == Catch::Approx(1.0));
+    // Quantiles are bucket estimates: 1ms falls in the 512us..1.024ms bucket
+    REQUIRE(summary["p50_ms"].get<double>() > 0.5);
+    REQUIRE(summary["p99_ms"].get<double>() <= 1.03);
+    REQUIRE(summary["p50_ms"].get<double>() <= summary["p95_ms"].get<double>());
+
+    auto empty = ReplayDriver::summarize(Metrics::Histogram::Snapshot{});
+    REQUIRE(empty["count"] == 0);
+    REQUIRE(empty["mean_ms"].get<double>() == 0.0);
+    REQUIRE(empty["p99_ms"].get<double>() == 0.0);
+}
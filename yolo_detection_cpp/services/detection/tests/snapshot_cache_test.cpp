@@ -0,0 +1,124 @@
+#include <catch2/catch_all.hpp>
+#include "snapshot_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace hms;
+
+namespace {
+
+SnapshotCache::Bytes bytes(const std::string& s) {
+    return std::make_shared<const std::string>(s);
+}
+
+}  // namespace
+
+TEST_CASE("SnapshotCache produces once per frame and slot", "[snapshot_cache]") {
+    SnapshotCache cache;
+    int produced = 0;
+    auto produce = [&](SnapshotCache::Done done) { ++produced; done(bytes("jpeg")); };
+
+    std::vector<std::string> got;
+    auto collect = [&](SnapshotCache::Bytes b) { got.push_back(b ? *b : "<null>"); };
+
+    cache.get("cam", 7, SnapshotCache::Slot::Plain, produce, collect);
+    cache.get("cam", 7, SnapshotCache::Slot::Plain, produce, collect);
+    REQUIRE(produced == 1);
+
+    // Other slots and cameras are separate
+    cache.get("cam", 7, SnapshotCache::Slot::Annotated, produce, collect);
+    cache.get("other", 7, SnapshotCache::Slot::Plain, produce, collect);
+    REQUIRE(produced == 3);
+
+    // A new frame replaces the camera's entry
+    cache.get("cam", 8, SnapshotCache::Slot::Plain, produce, collect);
+    cache.get("cam", 8, SnapshotCache::Slot::Annotated, produce, collect);
+    REQUIRE(produced == 5);
+
+    REQUIRE(got == std::vector<std::string>(6, "jpeg"));
+    auto stats = cache.stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 5);
+    REQUIRE(stats.coalesced == 0);
+}
+
+TEST_CASE("SnapshotCache coalesces requests behind a production underway", "[snapshot_cache]") {
+    SnapshotCache cache;
+    int produced = 0;
+    SnapshotCache::Done finish;
+    auto produce = [&](SnapshotCache::Done done) { ++produced; finish = std::move(done); };
+
+    int answered = 0;
+    auto expect = [&](SnapshotCache::Bytes b) { REQUIRE(b); REQUIRE(*b == "json"); ++answered; };
+    for (int i = 0; i < 3; ++i) {
+        cache.get("cam", 1, SnapshotCache::Slot::Detections, produce, expect);
+    }
+    REQUIRE(produced == 1);
+    REQUIRE(answered == 0);
+
+    finish(bytes("json"));
+    REQUIRE(answered == 3);
+    REQUIRE(cache.stats().coalesced == 2);
+
+    cache.get("cam", 1, SnapshotCache::Slot::Detections, produce, expect);
+    REQUIRE(produced == 1);
+    REQUIRE(answered == 4);
+}
+
+TEST_CASE("SnapshotCache does not cache failures", "[snapshot_cache]") {
+    SnapshotCache cache;
+    int produced = 0;
+    auto fail = [&](SnapshotCache::Done done) { ++produced; done(nullptr); };
+
+    int nulls = 0;
+    auto collect = [&](SnapshotCache::Bytes b) { if (!b) ++nulls; };
+    cache.get("cam", 3, SnapshotCache::Slot::Plain, fail, collect);
+    cache.get("cam", 3, SnapshotCache::Slot::Plain, fail, collect);
+    REQUIRE(produced == 2);
+    REQUIRE(nulls == 2);
+}
+
+TEST_CASE("SnapshotCache delivers a superseded frame to its own waiters", "[snapshot_cache]") {
+    SnapshotCache cache;
+    SnapshotCache::Done finish_old;
+    cache.get("cam", 1, SnapshotCache::Slot::Plain,
+              [&](SnapshotCache::Done done) { finish_old = std::move(done); },
+              [](SnapshotCache::Bytes b) { REQUIRE(*b == "old"); });
+
+    std::string latest;
+    cache.get("cam", 2, SnapshotCache::Slot::Plain,
+              [](SnapshotCache::Done done) { done(bytes("new")); },
+              [&](SnapshotCache::Bytes b) { latest = *b; });
+    REQUIRE(latest == "new");
+
+    // The late result doesn't displace the newer frame
+    finish_old(bytes("old"));
+    int produced = 0;
+    cache.get("cam", 2, SnapshotCache::Slot::Plain,
+              [&](SnapshotCache::Done done) { ++produced; done(bytes("again")); },
+              [&](SnapshotCache::Bytes b) { latest = *b; });
+    REQUIRE(produced == 0);
+    REQUIRE(latest == "new");
+}
+
+TEST_CASE("SnapshotCache allows nested lookups from a producer", "[snapshot_cache]") {
+    // The controller serves an annotated request without detections from the plain slot
+    SnapshotCache cache;
+    auto plain = [](SnapshotCache::Done done) { done(bytes("plain")); };
+    std::string got;
+    cache.get("cam", 5, SnapshotCache::Slot::Annotated,
+              [&](SnapshotCache::Done done) {
+                  cache.get("cam", 5, SnapshotCache::Slot::Plain, plain, std::move(done));
+              },
+              [&](SnapshotCache::Bytes b) { got = *b; });
+    REQUIRE(got == "plain");
+
+    int produced = 0;
+    cache.get("cam", 5, SnapshotCache::Slot::Plain,
+              [&](SnapshotCache::Done done) { ++produced; done(bytes("x")); },
+              [&](SnapshotCache::Bytes b) { got = *b; });
+    REQUIRE(produced == 0);
+    REQUIRE(got == "plain");
+}
@@ -0,0 +1,56 @@
+#include <catch2/catch_all.hpp>
+#include "tiling.h"
+
+using namespace hms;
+
+TEST_CASE("tileRegions is empty when tiling is off", "[tiling]") {
+    REQUIRE(tileRegions(TilingConfig{}, 3840, 2160).empty());
+}
+
+TEST_CASE("tileRegions ROI only", "[tiling]") {
+    TilingConfig cfg;
+    cfg.roi_x = 0.25f;
+    cfg.roi_y = 0.5f;
+    cfg.roi_w = 0.5f;
+    cfg.roi_h = 0.5f;
+    auto regions = tileRegions(cfg, 3840, 2160);
+    REQUIRE(regions.size() == 1);
+    REQUIRE(regions[0] == Region{960, 1080, 1920, 1080});
+}
+
+TEST_CASE("tileRegions grid covers the ROI with overlapping equal tiles", "[tiling]") {
+    TilingConfig cfg;
+    cfg.cols = 3;
+    cfg.rows = 2;
+    cfg.overlap = 0.2f;
+    auto regions = tileRegions(cfg, 3840, 2160);
+    REQUIRE(regions.size() == 6);
+
+    const auto& first = regions.front();
+    const auto& last = regions.back();
+    REQUIRE(first.x == 0);
+    REQUIRE(first.y == 0);
+    REQUIRE(last.x + last.w == 3840);
+    REQUIRE(last.y + last.h == 2160);
+    for (const auto& r : regions) {
+        REQUIRE(r.w == first.w);
+        REQUIRE(r.h == first.h);
+    }
+
+    // Neighbours share about `overlap` of a tile
+    int shared = regions[0].x + regions[0].w - regions[1].x;
+    REQUIRE(shared == Catch::Approx(0.2 * first.w).margin(2));
+}
+
+TEST_CASE("tileRegions full_frame pass comes first", "[tiling]") {
+    TilingConfig cfg;
+    cfg.roi_y = 0.5f;
+    cfg.roi_h = 0.5f;
+    cfg.cols = 2;
+    cfg.full_frame = true;
+    auto regions = tileRegions(cfg, 1920, 1080);
+    REQUIRE(regions.size() == 3);
+    REQUIRE(regions[0] == Region{0, 540, 1920, 540});
+    REQUIRE(regions[1].y == 540);
+    REQUIRE(regions[2].x + regions[2].w == 1920);
+}
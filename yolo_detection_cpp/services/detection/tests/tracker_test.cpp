@@ -0,0 +1,128 @@
+#include <catch2/catch_all.hpp>
+
+#include "tracker.h"
+
+using namespace hms;
+using namespace std::chrono_literals;
+
+namespace {
+
+Detection box(float x, float y, float w, float h, float conf = 0.8f, uint16_t cls = 0) {
+    Detection d;
+    d.class_id = cls;
+    d.confidence = conf;
+    d.x1 = x;
+    d.y1 = y;
+    d.x2 = x + w;
+    d.y2 = y + h;
+    return d;
+}
+
+float centreX(const Detection& d) { return (d.x1 + d.x2) / 2; }
+
+}  // namespace
+
+TEST_CASE("Tracker keeps an object's id while it moves", "[tracker]") {
+    Tracker tracker;
+    auto t0 = SteadyClock::now();
+
+    // 100x200 person walking right at 100 px/s, seen every 100ms
+    uint32_t id = 0;
+    for (int i = 0; i < 10; ++i) {
+        auto ids = tracker.update({box(100.0f + 10 * i, 100, 100, 200)}, t0 + i * 100ms);
+        REQUIRE(ids.size() == 1);
+        if (i == 0) id = ids[0];
+        REQUIRE(ids[0] == id);
+    }
+    REQUIRE(tracker.tracks().size() == 1);
+    const auto* track = tracker.find(id);
+    REQUIRE(track != nullptr);
+    REQUIRE(track->confirmed);
+    REQUIRE(track->hits == 10);
+    REQUIRE(track->speed() == Catch::Approx(0.5f).margin(0.1f));  // 100 px/s over a 200 px box
+
+    SECTION("predict() extrapolates between inferences") {
+        auto predicted = tracker.predict(t0 + 1000ms);
+        REQUIRE(predicted.size() == 1);
+        // Last seen centred at 240 at 900ms; 100ms later it should be near 250
+        REQUIRE(centreX(predicted[0]) == Catch::Approx(250).margin(4));
+        REQUIRE(predicted[0].y2 - predicted[0].y1 == Catch::Approx(200).margin(4));
+    }
+
+    SECTION("a second object of the class gets its own track") {
+        auto ids = tracker.update({box(200, 100, 100, 200), box(900, 100, 100, 200)}, t0 + 1000ms);
+        REQUIRE(ids[0] == id);
+        REQUIRE(ids[1] != id);
+        REQUIRE(tracker.tracks().size() == 2);
+    }
+
+    SECTION("an overlapping box of another class does not steal the track") {
+        auto ids = tracker.update({box(200, 100, 100, 200, 0.9f, 2)}, t0 + 1000ms);
+        REQUIRE(ids[0] != id);
+    }
+}
+
+TEST_CASE("Tracker confirms after min_hits and ages out lost tracks", "[tracker]") {
+    TrackingConfig cfg;
+    cfg.min_hits = 3;
+    cfg.max_age_ms = 500;
+    Tracker tracker(cfg);
+    auto t0 = SteadyClock::now();
+
+    auto id = tracker.update({box(0, 0, 50, 50)}, t0)[0];
+    tracker.update({box(0, 0, 50, 50)}, t0 + 100ms);
+    REQUIRE_FALSE(tracker.find(id)->confirmed);
+    tracker.update({box(0, 0, 50, 50)}, t0 + 200ms);
+    REQUIRE(tracker.find(id)->confirmed);
+
+    // Unseen for longer than max_age_ms: dropped from the live tracks
+    tracker.update({}, t0 + 400ms);
+    REQUIRE(tracker.find(id) != nullptr);
+    tracker.update({}, t0 + 800ms);
+    REQUIRE(tracker.find(id) == nullptr);
+    REQUIRE(tracker.tracks().empty());
+    REQUIRE(tracker.predict(t0 + 800ms).empty());
+
+    // ...but still an object of the event
+    REQUIRE(tracker.objects().size() == 1);
+}
+
+TEST_CASE("Tracker reports stationary scenes", "[tracker]") {
+    Tracker tracker;
+    auto t0 = SteadyClock::now();
+    REQUIRE_FALSE(tracker.allStationary());  // nothing tracked: keep looking
+
+    // A parked car: the same box, give or take detector jitter
+    for (int i = 0; i < 6; ++i) {
+        float jitter = (i % 2) ? 1.0f : -1.0f;
+        tracker.update({box(300 + jitter, 200, 200, 100, 0.9f, 2)}, t0 + i * 200ms);
+    }
+    REQUIRE(tracker.allStationary());
+
+    // Someone walks in: not confirmed yet, so the scene is live again
+    tracker.update({box(302, 200, 200, 100, 0.9f, 2), box(0, 0, 80, 160)}, t0 + 1200ms);
+    REQUIRE_FALSE(tracker.allStationary());
+}
+
+TEST_CASE("Tracker objects() gives one detection per object", "[tracker]") {
+    Tracker tracker;
+    auto t0 = SteadyClock::now();
+
+    // Two people for three inferences, plus a one-frame false positive
+    tracker.update({box(0, 0, 100, 200, 0.6f), box(500, 0, 100, 200, 0.7f),
+                    box(1000, 500, 30, 30, 0.95f, 16)}, t0);
+    tracker.update({box(5, 0, 100, 200, 0.9f), box(505, 0, 100, 200, 0.75f)}, t0 + 100ms);
+    tracker.update({box(10, 0, 100, 200, 0.8f), box(510, 0, 100, 200, 0.65f)}, t0 + 200ms);
+
+    auto objects = tracker.objects();
+    REQUIRE(objects.size() == 2);  // unconfirmed false positive left out
+    REQUIRE(objects[0].confidence == Catch::Approx(0.9f));   // each track's best,
+    REQUIRE(objects[1].confidence == Catch::Approx(0.75f));  // highest first
+    REQUIRE(objects[0].class_id == 0);
+
+    SECTION("with nothing confirmed, every track counts") {
+        Tracker single;
+        single.update({box(0, 0, 10, 10, 0.5f, 16)}, t0);
+        REQUIRE(single.objects().size() == 1);
+    }
+}
@@ -123,3 +123,15 @@ TEST_CASE("VisionClient::analyze returns invalid for nonexistent file", "[vision
     CHECK_FALSE(result.is_valid);
     CHECK(result.context.empty());
 }
+
+TEST_CASE("VisionClient::analyze returns invalid for an empty in-memory image", "[vision]") {
+    auto cfg = makeConfig();
+    hms::VisionClient client(cfg);
+
+    // Fails before any network call
+    CHECK_FALSE(client.analyze(std::shared_ptr<const std::string>{}, "patio", "person").is_valid);
+    auto empty = std::make_shared<const std::string>();
+    auto result = client.analyze(empty, "patio", "person");
+    CHECK_FALSE(result.is_valid);
+    CHECK(result.context.empty());
+}